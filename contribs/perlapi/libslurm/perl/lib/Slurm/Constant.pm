@@ -1176,6 +1176,10 @@ head2 SLURM ERRNO
 
 =item * ESLURMD_INVALID_SOCKET_NAME_LEN         4030
 
+=item * ESLURMD_FILE_BCAST_CURRENT              4031
+
+=item * ESLURMD_FILE_BCAST_ANY_ORDER            4032
+
 =back
 
 =head3 slurmd errors in user batch job
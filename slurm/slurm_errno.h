@@ -208,6 +208,7 @@ enum {
 	ESLURM_INVALID_NICE,
 	ESLURM_INVALID_TIME_MIN_LIMIT,
 	ESLURM_DEFER,
+	ESLURM_JOB_LIST_TOO_LONG,
 
 	/* slurmd error codes */
 	ESLURMD_PIPE_ERROR_ON_TASK_SPAWN =		4000,
@@ -241,6 +242,9 @@ enum {
 	ESLURMD_STEP_SUSPENDED,
 	ESLURMD_STEP_NOTSUSPENDED,
 	ESLURMD_INVALID_SOCKET_NAME_LEN =		4030,
+	ESLURMD_FILE_BCAST_CURRENT,
+	ESLURMD_FILE_BCAST_ANY_ORDER,
+	ESLURMD_BURST_BUFFER_STAGE_IN,
 
 	/* slurmd errors in user batch job */
 	ESCRIPT_CHDIR_FAILED =			4100,
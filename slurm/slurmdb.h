@@ -331,6 +331,14 @@ typedef struct {
 	List wckey_list;	/* list of char * */
 } slurmdb_job_cond_t;
 
+/* Position of a job query returned a page at a time */
+typedef struct {
+	char *cluster;		/* cluster of the next page, NULL to start */
+	uint16_t done;		/* set once all the jobs were returned */
+	uint32_t last_jobid;	/* next page starts after this job id */
+	uint32_t max_jobs;	/* jobs per page, 0 for no limit */
+} slurmdb_job_cursor_t;
+
 /* slurmdb_stats_t needs to be defined before slurmdb_job_rec_t and
  * slurmdb_step_rec_t.
  */
@@ -1645,6 +1653,18 @@ extern List slurmdb_job_modify(void *db_conn,
  */
 extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage a page of about cursor->max_jobs jobs at a time,
+ * clusters are returned one after the other in job id order.
+ * IN/OUT: cursor - zeroed but for max_jobs on the first call, call again
+ *	   until cursor->done is set then free with
+ *	   slurmdb_free_job_cursor_members()
+ * returns List of slurmdb_job_rec_t *, possibly empty, or NULL on error
+ * note List needs to be freed with slurm_list_destroy() when called
+ */
+extern List slurmdb_jobs_get_page(void *db_conn, slurmdb_job_cond_t *job_cond,
+				  slurmdb_job_cursor_t *cursor);
+
 /*
  * Fix runaway jobs
  * IN: jobs, a list of all the runaway jobs
@@ -1796,6 +1816,7 @@ extern void slurmdb_free_assoc_rec_members(slurmdb_assoc_rec_t *assoc);
 extern void slurmdb_destroy_assoc_rec(void *object);
 extern void slurmdb_destroy_event_rec(void *object);
 extern void slurmdb_destroy_job_rec(void *object);
+extern void slurmdb_free_job_cursor_members(slurmdb_job_cursor_t *cursor);
 extern void slurmdb_free_qos_rec_members(slurmdb_qos_rec_t *qos);
 extern void slurmdb_destroy_qos_rec(void *object);
 extern void slurmdb_destroy_reservation_rec(void *object);
@@ -70,6 +70,21 @@ extern List slurmdb_jobs_get(void *db_conn, slurmdb_job_cond_t *job_cond)
 	return jobacct_storage_g_get_jobs_cond(db_conn, db_api_uid, job_cond);
 }
 
+/*
+ * get info from the storage a page at a time
+ * returns List of slurmdb_job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List slurmdb_jobs_get_page(void *db_conn, slurmdb_job_cond_t *job_cond,
+				  slurmdb_job_cursor_t *cursor)
+{
+	if (db_api_uid == -1)
+		db_api_uid = getuid();
+
+	return jobacct_storage_g_get_jobs_page(db_conn, db_api_uid, job_cond,
+					       cursor);
+}
+
 /*
  * Fix runaway jobs
  * IN: jobs, a list of all the runaway jobs
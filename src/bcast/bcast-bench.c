@@ -0,0 +1,419 @@
+/*****************************************************************************\
+ *  bcast-bench.c - throughput of bcast_file() against simulated nodes
+ *****************************************************************************
+ *  A file of the given size is broadcast with bcast_file() to the given
+ *  number of nodes, once with one block in flight (the sequential path) and
+ *  once for each --parallel value listed. slurm_send_recv_msgs() is replaced
+ *  by a simulation: each REQUEST_FILE_BCAST is packed as it would be sent,
+ *  takes the given latency plus its length at the given bandwidth to
+ *  arrive, and is written into one file per node. Nodes either behave as
+ *  this slurmd, unpacking the message and writing each block at its offset,
+ *  or as a slurmd which predates FILE_BCAST_ANY_ORDER, reading the old force
+ *  field of the packed message and appending the blocks in the order they
+ *  arrive. The files written are compared with the source.
+ *
+ *  Usage: bcast-bench [-b block_KB] [-l latency_usec] [-n nodes] [-o]
+ *		       [-s size_MB] [-w MB/s] [parallel ...]
+ *	-o		the nodes predate FILE_BCAST_ANY_ORDER
+ *	parallel	values compared with 1, by default 2 4 8
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "src/common/forward.h"
+#include "src/common/hostlist.h"
+#include "src/common/list.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_cred.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/slurm_protocol_pack.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#include "file_bcast.h"
+
+#define BENCH_NODE_PREFIX "bench"
+
+typedef struct {
+	int fd;			/* file written by the node, -1 if none */
+	uint32_t next_block;	/* next block an old node expects */
+	bool misordered;	/* an old node appended a block out of order */
+	pthread_mutex_t mutex;	/* one message processed at a time */
+} bench_node_t;
+
+static bench_node_t *nodes = NULL;
+static int node_cnt = 4;
+static char *out_dir = NULL;
+static bool old_nodes = false;
+static bool force_sent = false;
+static uint32_t latency = 500;		/* usec per message */
+static uint32_t bandwidth = 1000;	/* MB/s */
+static job_sbcast_cred_msg_t bench_cred;
+
+/* A credential which is only packed, the simulated nodes do not verify it */
+static sbcast_cred_t *_bench_sbcast_cred(void)
+{
+	Buf buffer = init_buf(256);
+	sbcast_cred_t *cred;
+	char sig[] = "bench";
+
+	pack_time(time(NULL), buffer);
+	pack_time(time(NULL) + 3600, buffer);
+	pack32(1, buffer);
+	pack32(NO_VAL, buffer);
+	pack32(getuid(), buffer);
+	pack32(getgid(), buffer);
+	packnull(buffer);
+	pack32_array(NULL, 0, buffer);
+	packstr(bench_cred.node_list, buffer);
+	packmem(sig, sizeof(sig), buffer);
+	set_buf_offset(buffer, 0);
+	cred = unpack_sbcast_cred(buffer, SLURM_PROTOCOL_VERSION);
+	free_buf(buffer);
+
+	return cred;
+}
+
+extern int slurm_sbcast_lookup(uint32_t job_id, uint32_t pack_job_offset,
+			       uint32_t step_id,
+			       job_sbcast_cred_msg_t **info)
+{
+	*info = &bench_cred;
+	return SLURM_SUCCESS;
+}
+
+/* Receive a block as the current slurmd does, RET its return code */
+static int _recv_current(bench_node_t *node, Buf buffer)
+{
+	slurm_msg_t msg;
+	file_bcast_msg_t *req;
+	int rc = SLURM_SUCCESS;
+
+	slurm_msg_t_init(&msg);
+	msg.msg_type = REQUEST_FILE_BCAST;
+	msg.protocol_version = SLURM_PROTOCOL_VERSION;
+	if (unpack_msg(&msg, buffer) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+	req = msg.data;
+
+	if ((req->block_no == 1) && (req->flags & FILE_BCAST_ANY_ORDER))
+		rc = ESLURMD_FILE_BCAST_ANY_ORDER;
+	if (pwrite(node->fd, req->block, req->block_len, req->block_offset) !=
+	    req->block_len)
+		rc = SLURM_ERROR;
+	if (req->last_block && ftruncate(node->fd, req->file_size))
+		rc = SLURM_ERROR;
+	slurm_free_file_bcast_msg(req);
+
+	return rc;
+}
+
+/*
+ * Receive a block as a slurmd predating FILE_BCAST_ANY_ORDER does, reading
+ * the force field which followed block_no, compress and last_block, RET its
+ * return code
+ */
+static int _recv_old(bench_node_t *node, Buf buffer)
+{
+	slurm_msg_t msg;
+	file_bcast_msg_t *req;
+	uint32_t block_no;
+	uint16_t force;
+	int rc = SLURM_SUCCESS;
+
+	if (unpack32(&block_no, buffer) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+	set_buf_offset(buffer, 8);
+	if ((unpack16(&force, buffer) != SLURM_SUCCESS) ||
+	    (force != force_sent))
+		return SLURM_ERROR;
+	set_buf_offset(buffer, 0);
+
+	slurm_msg_t_init(&msg);
+	msg.msg_type = REQUEST_FILE_BCAST;
+	msg.protocol_version = SLURM_PROTOCOL_VERSION;
+	if (unpack_msg(&msg, buffer) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+	req = msg.data;
+
+	if (block_no != node->next_block)
+		node->misordered = true;
+	node->next_block = block_no + 1;
+	if (write(node->fd, req->block, req->block_len) != req->block_len)
+		rc = SLURM_ERROR;
+	slurm_free_file_bcast_msg(req);
+
+	return rc;
+}
+
+extern List slurm_send_recv_msgs(const char *nodelist, slurm_msg_t *msg,
+				 int timeout)
+{
+	file_bcast_msg_t *req = msg->data;
+	hostlist_t hl = hostlist_create(nodelist);
+	List ret_list = list_create(destroy_data_info);
+	ret_data_info_t *ret_data_info;
+	return_code_msg_t *rc_msg;
+	Buf buffer;
+	char *host;
+	uint32_t len;
+	int inx;
+
+	/* the message is sent once and forwarded to every node */
+	buffer = init_buf(req->block_len + 1024);
+	pack_msg(msg, buffer);
+	len = get_buf_offset(buffer);
+	buffer = create_buf(xfer_buf_data(buffer), len);
+	usleep(latency + ((uint64_t) len / bandwidth));
+
+	while ((host = hostlist_shift(hl))) {
+		inx = atoi(host + strlen(BENCH_NODE_PREFIX));
+		rc_msg = xmalloc(sizeof(return_code_msg_t));
+		set_buf_offset(buffer, 0);
+		slurm_mutex_lock(&nodes[inx].mutex);
+		if (old_nodes)
+			rc_msg->return_code = _recv_old(&nodes[inx], buffer);
+		else
+			rc_msg->return_code = _recv_current(&nodes[inx],
+							    buffer);
+		slurm_mutex_unlock(&nodes[inx].mutex);
+
+		ret_data_info = xmalloc(sizeof(ret_data_info_t));
+		ret_data_info->type = RESPONSE_SLURM_RC;
+		ret_data_info->node_name = xstrdup(host);
+		ret_data_info->data = rc_msg;
+		list_append(ret_list, ret_data_info);
+		free(host);
+	}
+	hostlist_destroy(hl);
+	free_buf(buffer);
+
+	return ret_list;
+}
+
+/* RET count of nodes whose file differs from the source */
+static int _verify(char *src, uint64_t size)
+{
+	char *dst;
+	struct stat st;
+	int i, bad = 0;
+
+	for (i = 0; i < node_cnt; i++) {
+		if (nodes[i].misordered || fstat(nodes[i].fd, &st) ||
+		    (st.st_size != size)) {
+			bad++;
+			continue;
+		}
+		dst = mmap(NULL, size, PROT_READ, MAP_SHARED, nodes[i].fd, 0);
+		if ((dst == MAP_FAILED) || memcmp(src, dst, size))
+			bad++;
+		if (dst != MAP_FAILED)
+			munmap(dst, size);
+	}
+
+	return bad;
+}
+
+/* Broadcast the source once, RET MB/s or -1 on error */
+static double _run(struct bcast_parameters *params, char *src, uint64_t size)
+{
+	struct timeval tv1, tv2;
+	char *path;
+	double usec;
+	int i, rc;
+
+	for (i = 0; i < node_cnt; i++) {
+		path = xstrdup_printf("%s/%s%d", out_dir, BENCH_NODE_PREFIX, i);
+		nodes[i].fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+		nodes[i].next_block = 1;
+		nodes[i].misordered = false;
+		unlink(path);
+		xfree(path);
+		if (nodes[i].fd < 0) {
+			perror("open");
+			exit(1);
+		}
+	}
+
+	gettimeofday(&tv1, NULL);
+	rc = bcast_file(params);
+	gettimeofday(&tv2, NULL);
+	usec = ((tv2.tv_sec - tv1.tv_sec) * 1000000.0) +
+	       (tv2.tv_usec - tv1.tv_usec);
+
+	if (rc != SLURM_SUCCESS) {
+		printf("parallel %2d: bcast_file failed: %s\n",
+		       params->parallel, slurm_strerror(rc));
+		usec = -1;
+	} else if ((i = _verify(src, size))) {
+		printf("parallel %2d: %d of %d node files differ\n",
+		       params->parallel, i, node_cnt);
+		usec = -1;
+	}
+	for (i = 0; i < node_cnt; i++)
+		close(nodes[i].fd);
+
+	return (usec > 0) ? (size / usec) : -1;
+}
+
+int main(int argc, char **argv)
+{
+	char conf_file[] = "/tmp/bcast-bench.conf.XXXXXX";
+	char src_file[] = "/tmp/bcast-bench.src.XXXXXX";
+	char dir[] = "/tmp/bcast-bench.XXXXXX";
+	struct bcast_parameters params;
+	uint32_t block_kb = 512, size_mb = 64;
+	uint64_t size, i;
+	double seq_rate, rate;
+	char *conf_str, *src;
+	int parallel_def[] = { 2, 4, 8 }, *parallel = parallel_def;
+	int parallel_cnt = 3, fd, opt, p;
+
+	while ((opt = getopt(argc, argv, "b:l:n:os:w:")) != -1) {
+		switch (opt) {
+		case 'b':
+			block_kb = atoi(optarg);
+			break;
+		case 'l':
+			latency = atoi(optarg);
+			break;
+		case 'n':
+			node_cnt = atoi(optarg);
+			break;
+		case 'o':
+			old_nodes = true;
+			break;
+		case 's':
+			size_mb = atoi(optarg);
+			break;
+		case 'w':
+			bandwidth = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-b block_KB] [-l latency_usec] [-n nodes] [-o] [-s size_MB] [-w MB/s] [parallel ...]\n",
+				argv[0]);
+			exit(1);
+		}
+	}
+	if (!block_kb || !size_mb || !bandwidth || (node_cnt < 1)) {
+		fprintf(stderr, "%s: invalid argument\n", argv[0]);
+		exit(1);
+	}
+
+	if ((fd = mkstemp(conf_file)) < 0) {
+		perror("mkstemp");
+		exit(1);
+	}
+	conf_str = xstrdup("ClusterName=unit\n"
+			   "SlurmctldHost=localhost\n"
+			   "PluginDir=/tmp\n");
+	if (write(fd, conf_str, strlen(conf_str)) != strlen(conf_str)) {
+		perror("write");
+		exit(1);
+	}
+	close(fd);
+	xfree(conf_str);
+	setenv("SLURM_CONF", conf_file, 1);
+
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	out_dir = dir;
+
+	/* pseudo random data, so that nothing looks sparse */
+	size = (uint64_t) size_mb * 1024 * 1024;
+	if (((fd = mkstemp(src_file)) < 0) || ftruncate(fd, size)) {
+		perror("mkstemp");
+		exit(1);
+	}
+	src = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (src == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+	srand(1);
+	for (i = 0; i < size; i++)
+		src[i] = rand();
+
+	nodes = xcalloc(node_cnt, sizeof(bench_node_t));
+	for (i = 0; i < node_cnt; i++)
+		slurm_mutex_init(&nodes[i].mutex);
+	bench_cred.job_id = 1;
+	bench_cred.node_cnt = node_cnt;
+	bench_cred.node_list = xstrdup_printf("%s[0-%d]", BENCH_NODE_PREFIX,
+					      node_cnt - 1);
+	bench_cred.sbcast_cred = _bench_sbcast_cred();
+
+	memset(&params, 0, sizeof(params));
+	params.block_size = block_kb * 1024;
+	params.compress = COMPRESS_OFF;
+	params.force = true;
+	force_sent = params.force;
+	params.job_id = 1;
+	params.pack_job_offset = NO_VAL;
+	params.step_id = NO_VAL;
+	params.src_fname = src_file;
+	params.dst_fname = "/tmp/bcast-bench.dst";
+	params.timeout = 0;
+
+	if (optind < argc) {
+		parallel_cnt = argc - optind;
+		parallel = xcalloc(parallel_cnt, sizeof(int));
+		for (p = 0; p < parallel_cnt; p++)
+			parallel[p] = atoi(argv[optind + p]);
+	}
+
+	printf("%u MB in %u KB blocks to %d %s nodes, %u usec latency, %u MB/s\n",
+	       size_mb, block_kb, node_cnt, old_nodes ? "old" : "current",
+	       latency, bandwidth);
+
+	/* the first run faults the source and node files in */
+	params.parallel = 1;
+	(void) _run(&params, src, size);
+	seq_rate = _run(&params, src, size);
+	if (seq_rate > 0)
+		printf("parallel %2d: %8.1f MB/s\n", 1, seq_rate);
+	for (p = 0; p < parallel_cnt; p++) {
+		params.parallel = parallel[p];
+		if ((rate = _run(&params, src, size)) <= 0)
+			continue;
+		printf("parallel %2d: %8.1f MB/s", params.parallel, rate);
+		if (seq_rate > 0)
+			printf(", %.2fx the sequential path", rate / seq_rate);
+		printf("\n");
+	}
+
+	munmap(src, size);
+	close(fd);
+	unlink(src_file);
+	rmdir(dir);
+	unlink(conf_file);
+
+	return 0;
+}
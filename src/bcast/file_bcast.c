@@ -40,6 +40,7 @@
 
 #include "config.h"
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
@@ -61,6 +62,7 @@
 #include "slurm/slurm_errno.h"
 #include "src/common/forward.h"
 #include "src/common/hostlist.h"
+#include "src/common/list.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
 #include "src/common/read_config.h"
@@ -77,50 +79,169 @@
 
 #define MAX_THREADS      8	/* These can be huge messages, so
 				 * only run MAX_THREADS at one time */
+#define BCAST_PARALLEL	 4	/* default blocks in flight at once */
+#define MAX_PARALLEL	 64
+
+/*
+ * A file being broadcast. Its first block registers the file on the nodes and
+ * is sent alone, the blocks between the first and last one are then sent in
+ * parallel and the last block, which closes the file, once they all arrived.
+ * Nodes which do not acknowledge FILE_BCAST_ANY_ORDER in their reply to the
+ * first block write the data sequentially, the blocks of the file are then
+ * sent one at a time and in order.
+ */
+typedef struct bcast_file {
+	char *src_fname;
+	char *dst_fname;
+	int fd;			/* source file descriptor */
+	void *src;		/* source mmap'd address */
+	struct stat f_stat;	/* source file stats */
+	char *user_name;	/* owner of the source file */
+	uint32_t block_len;	/* block size */
+	uint32_t block_cnt;	/* number of blocks, at least one */
+	uint32_t next_block;	/* next block to send */
+	bool first_done;	/* first block received by every node */
+	bool current;		/* file already current on every node */
+	bool any_order;		/* every node accepts blocks in any order */
+	int inflight;		/* blocks being sent */
+} bcast_file_t;
+
+static job_sbcast_cred_msg_t *sbcast_cred; /* job alloc info and sbcast cred */
+
+static pthread_mutex_t bcast_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bcast_cond = PTHREAD_COND_INITIALIZER;
+static struct bcast_parameters *bcast_params;
+static uint16_t bcast_flags;		/* FILE_BCAST_* flags of the files */
+static List pending_list;		/* bcast_file_t not opened yet */
+static List active_list;		/* bcast_file_t being sent */
+static int active_max;			/* files opened at once */
+static bool cred_cached;		/* nodes verified the credential */
+static int bcast_inflight;		/* blocks being sent */
+static int bcast_rc;
+static uint64_t size_uncompressed, size_compressed, size_sparse;
+static uint64_t time_compression;
+
+static void _free_file(void *x)
+{
+	bcast_file_t *f = x;
+
+	if (!f)
+		return;
+	if (f->src)
+		(void) munmap(f->src, f->f_stat.st_size);
+	if (f->fd >= 0)
+		(void) close(f->fd);
+	xfree(f->src_fname);
+	xfree(f->dst_fname);
+	xfree(f->user_name);
+	xfree(f);
+}
 
-int block_len;				/* block size */
-int fd;					/* source file descriptor */
-void *src;				/* source mmap'd address */
-struct stat f_stat;			/* source file stats */
-job_sbcast_cred_msg_t *sbcast_cred;	/* job alloc info and sbcast cred */
-
-static int   _bcast_file(struct bcast_parameters *params);
-static int   _file_bcast(struct bcast_parameters *params,
-			 file_bcast_msg_t *bcast_msg,
-			 job_sbcast_cred_msg_t *sbcast_cred);
-static int   _file_state(struct bcast_parameters *params);
-static int   _get_job_info(struct bcast_parameters *params);
+/* queue a file to broadcast */
+static void _queue_file(char *src_fname, char *dst_fname)
+{
+	bcast_file_t *f = xmalloc(sizeof(bcast_file_t));
 
+	f->fd = -1;
+	f->src_fname = xstrdup(src_fname);
+	f->dst_fname = xstrdup(dst_fname);
+	f->next_block = 1;
+	list_append(pending_list, f);
+}
 
-static int _file_state(struct bcast_parameters *params)
+/* queue a file or, with --recursive, the regular files of a directory tree */
+static int _queue_path(struct bcast_parameters *params, char *src_fname,
+		       char *dst_fname)
 {
-	/* validate the source file */
-	if ((fd = open(params->src_fname, O_RDONLY)) < 0) {
-		error("Can't open `%s`: %s", params->src_fname,
-			strerror(errno));
+	struct stat st;
+	struct dirent *ent;
+	DIR *dir;
+	char *src_path, *dst_path;
+	int rc = SLURM_SUCCESS;
+
+	if (stat(src_fname, &st)) {
+		error("Can't stat `%s`: %s", src_fname, strerror(errno));
 		return SLURM_ERROR;
 	}
-	if (fstat(fd, &f_stat)) {
-		error("Can't stat `%s`: %s", params->src_fname,
-			strerror(errno));
+	if (!S_ISDIR(st.st_mode)) {
+		_queue_file(src_fname, dst_fname);
+		return SLURM_SUCCESS;
+	}
+	if (!params->recursive) {
+		error("`%s` is a directory, use --recursive to copy it",
+		      src_fname);
 		return SLURM_ERROR;
 	}
 
-	verbose("modes    = %o", (unsigned int) f_stat.st_mode);
-	verbose("uid      = %d", (int) f_stat.st_uid);
-	verbose("gid      = %d", (int) f_stat.st_gid);
-	verbose("atime    = %s", slurm_ctime2(&f_stat.st_atime));
-	verbose("mtime    = %s", slurm_ctime2(&f_stat.st_mtime));
-	verbose("ctime    = %s", slurm_ctime2(&f_stat.st_ctime));
-	verbose("size     = %ld", (long) f_stat.st_size);
+	if (!(dir = opendir(src_fname))) {
+		error("Can't open directory `%s`: %s", src_fname,
+		      strerror(errno));
+		return SLURM_ERROR;
+	}
+	while ((rc == SLURM_SUCCESS) && (ent = readdir(dir))) {
+		if (!xstrcmp(ent->d_name, ".") || !xstrcmp(ent->d_name, ".."))
+			continue;
+		src_path = xstrdup_printf("%s/%s", src_fname, ent->d_name);
+		dst_path = xstrdup_printf("%s/%s", dst_fname, ent->d_name);
+		/* symbolic links to files are copied, not those to dirs */
+		if (lstat(src_path, &st) || (!S_ISDIR(st.st_mode) &&
+					     stat(src_path, &st))) {
+			error("Can't stat `%s`: %s", src_path, strerror(errno));
+			rc = SLURM_ERROR;
+		} else if (S_ISDIR(st.st_mode)) {
+			rc = _queue_path(params, src_path, dst_path);
+		} else if (S_ISREG(st.st_mode)) {
+			_queue_file(src_path, dst_path);
+		} else {
+			verbose("Skipping `%s`, not a regular file", src_path);
+		}
+		xfree(src_path);
+		xfree(dst_path);
+	}
+	closedir(dir);
+
+	return rc;
+}
+
+/* validate and map a source file */
+static int _file_state(bcast_file_t *f)
+{
+	uint32_t block_size = bcast_params->block_size;
 
-	if (!f_stat.st_size) {
-		error("Warning: file `%s` is empty.", params->src_fname);
+	if ((f->fd = open(f->src_fname, O_RDONLY)) < 0) {
+		error("Can't open `%s`: %s", f->src_fname, strerror(errno));
+		return SLURM_ERROR;
+	}
+	if (fstat(f->fd, &f->f_stat)) {
+		error("Can't stat `%s`: %s", f->src_fname, strerror(errno));
+		return SLURM_ERROR;
+	}
+
+	debug("file     = %s", f->src_fname);
+	debug("modes    = %o", (unsigned int) f->f_stat.st_mode);
+	debug("uid      = %d", (int) f->f_stat.st_uid);
+	debug("gid      = %d", (int) f->f_stat.st_gid);
+	debug("atime    = %s", slurm_ctime2(&f->f_stat.st_atime));
+	debug("mtime    = %s", slurm_ctime2(&f->f_stat.st_mtime));
+	debug("ctime    = %s", slurm_ctime2(&f->f_stat.st_ctime));
+	debug("size     = %ld", (long) f->f_stat.st_size);
+
+	f->user_name = uid_to_string(f->f_stat.st_uid);
+	if (!block_size)
+		block_size = 512 * 1024;
+	f->block_len = MIN(block_size, f->f_stat.st_size);
+	f->block_cnt = 1;
+
+	if (!f->f_stat.st_size) {
+		error("Warning: file `%s` is empty.", f->src_fname);
 		return SLURM_SUCCESS;
 	}
-	src = mmap(NULL, f_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
-	if (src == MAP_FAILED) {
-		error("Can't mmap file `%s`, %m.", params->src_fname);
+	f->block_cnt = (f->f_stat.st_size + f->block_len - 1) / f->block_len;
+	f->src = mmap(NULL, f->f_stat.st_size, PROT_READ, MAP_SHARED, f->fd,
+		      0);
+	if (f->src == MAP_FAILED) {
+		f->src = NULL;
+		error("Can't mmap file `%s`, %m.", f->src_fname);
 		return SLURM_ERROR;
 	}
 
@@ -178,15 +299,50 @@ static int _get_job_info(struct bcast_parameters *params)
 	return rc;
 }
 
-/* Issue the RPC to transfer the file's data */
+/*
+ * Build the node list of each sender, rotated so that the first nodes, which
+ * forward the blocks to the others, differ from one sender to the next
+ */
+static char **_node_lists(char *node_list, int cnt)
+{
+	char **lists = xmalloc(sizeof(char *) * cnt);
+	hostlist_t hl = hostlist_create(node_list), rotated;
+	int node_cnt = hostlist_count(hl), i, j, offset;
+	char *host;
+
+	for (i = 0; i < cnt; i++) {
+		offset = ((int64_t) node_cnt * i) / cnt;
+		if (!offset) {
+			lists[i] = xstrdup(node_list);
+			continue;
+		}
+		rotated = hostlist_create(NULL);
+		for (j = 0; j < node_cnt; j++) {
+			host = hostlist_nth(hl, (j + offset) % node_cnt);
+			hostlist_push_host(rotated, host);
+			free(host);
+		}
+		lists[i] = hostlist_ranged_string_xmalloc(rotated);
+		hostlist_destroy(rotated);
+	}
+	hostlist_destroy(hl);
+
+	return lists;
+}
+
+/*
+ * Issue the RPC to transfer the file's data
+ * OUT current - set if the file was already current on every node
+ * OUT any_order - set if every node accepts the next blocks in any order
+ */
 static int _file_bcast(struct bcast_parameters *params,
-		       file_bcast_msg_t *bcast_msg,
-		       job_sbcast_cred_msg_t *sbcast_cred)
+		       file_bcast_msg_t *bcast_msg, char *node_list,
+		       bool *current, bool *any_order)
 {
 	List ret_list = NULL;
 	ListIterator itr;
 	ret_data_info_t *ret_data_info = NULL;
-	int rc = 0, msg_rc;
+	int rc = 0, msg_rc, current_cnt = 0, updated_cnt = 0, ordered_cnt = 0;
 	slurm_msg_t msg;
 
 	slurm_msg_t_init(&msg);
@@ -194,19 +350,29 @@ static int _file_bcast(struct bcast_parameters *params,
 	msg.flags = USE_BCAST_NETWORK;
 	msg.msg_type = REQUEST_FILE_BCAST;
 
-	ret_list = slurm_send_recv_msgs(sbcast_cred->node_list, &msg,
-					params->timeout);
+	ret_list = slurm_send_recv_msgs(node_list, &msg, params->timeout);
 	if (ret_list == NULL) {
 		error("slurm_send_recv_msgs: %m");
-		exit(1);
+		return SLURM_ERROR;
 	}
 
 	itr = list_iterator_create(ret_list);
 	while ((ret_data_info = list_next(itr))) {
 		msg_rc = slurm_get_return_code(ret_data_info->type,
 					       ret_data_info->data);
-		if (msg_rc == SLURM_SUCCESS)
+		if (msg_rc == SLURM_SUCCESS) {
+			updated_cnt++;
+			ordered_cnt++;
 			continue;
+		}
+		if (msg_rc == ESLURMD_FILE_BCAST_ANY_ORDER) {
+			updated_cnt++;
+			continue;
+		}
+		if (msg_rc == ESLURMD_FILE_BCAST_CURRENT) {
+			current_cnt++;
+			continue;
+		}
 
 		error("REQUEST_FILE_BCAST(%s): %s",
 		      ret_data_info->node_name,
@@ -216,231 +382,310 @@ static int _file_bcast(struct bcast_parameters *params,
 	list_iterator_destroy(itr);
 	FREE_NULL_LIST(ret_list);
 
+	*current = (current_cnt && !updated_cnt);
+	*any_order = !ordered_cnt;
 	return rc;
 }
 
-/* load a buffer with data from the file to broadcast,
- * return number of bytes read, zero on end of file */
-static int _get_block_none(char **buffer, int *orig_len, bool *more)
+/*
+ * Compress a block into *out, growing it as needed
+ * RET compressed length or 0 if not compressed
+ */
+static int _compress_block(uint16_t compress, char *in, int in_len,
+			   char **out, int *out_size)
 {
-	static int64_t remaining = -1;
-	static void *position;
-	int size;
-
-	if (remaining < 0) {
-		*buffer = xmalloc(block_len);
-		remaining = f_stat.st_size;
-		position = src;
-	}
-
-	size = MIN(block_len, remaining);
-	memcpy(*buffer, position, size);
-	remaining -= size;
-	position += size;
+	int bound = 0, len = 0;
 
-	*orig_len = size;
-	*more = (remaining) ? true : false;
-	return size;
-}
+	if (!in_len)
+		return 0;
 
-static int _get_block_zlib(struct bcast_parameters *params,
-			   char **buffer,
-			   int *orig_len,
-			   bool *more)
-{
+	switch (compress) {
 #if HAVE_LIBZ
-	static z_stream strm;
-	int chunk = (256 * 1024);
-	int flush = Z_NO_FLUSH;
-
-	static int64_t remaining = -1;
-	static int max_out;
-	static void *position;
-	int chunk_remaining, out_remaining, chunk_bite, size = 0;
+	case COMPRESS_ZLIB:
+	{
+		uLongf zlen;
 
-	/* allocate deflate state, compress each block independently */
-	strm.zalloc = Z_NULL;
-	strm.zfree = Z_NULL;
-	strm.opaque = Z_NULL;
-	strm.avail_in = 0;
-	strm.next_in = Z_NULL;
-	if (deflateInit(&strm, Z_DEFAULT_COMPRESSION) != Z_OK) {
-		error("File compression configuration error,"
-		      "sending uncompressed file.");
-		params->compress = 0;
-		return _get_block_none(buffer, orig_len, more);
+		bound = compressBound(in_len);
+		if (*out_size < bound) {
+			xrealloc_nz(*out, bound);
+			*out_size = bound;
+		}
+		zlen = bound;
+		if (compress2((Bytef *) *out, &zlen, (Bytef *) in, in_len,
+			      Z_DEFAULT_COMPRESSION) == Z_OK)
+			len = zlen;
+		break;
 	}
-
-	/* first pass through, initialize */
-	if (remaining < 0) {
-		remaining = f_stat.st_size;
-		max_out = deflateBound(&strm, block_len);
-		*buffer = xmalloc(max_out);
-		position = src;
+#endif
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+		bound = LZ4_compressBound(in_len);
+		if (*out_size < bound) {
+			xrealloc_nz(*out, bound);
+			*out_size = bound;
+		}
+		len = LZ4_compress_default(in, *out, in_len, bound);
+		break;
+#endif
+	default:
+		break;
 	}
 
-	chunk_remaining = MIN(block_len, remaining);
-	out_remaining = max_out;
-	strm.next_out = (void *) *buffer;
-	while (chunk_remaining) {
-		strm.next_in = position;
-		chunk_bite = MIN(chunk, chunk_remaining);
-		strm.avail_in = chunk_bite;
-		strm.avail_out = out_remaining;
+	return MAX(len, 0);
+}
 
-		if (chunk_remaining <= chunk)
-			flush = Z_FINISH;
+/* RET true if a block only holds zeros */
+static bool _zero_block(char *data, int len)
+{
+	if (!len || data[0])
+		return false;
+	return !memcmp(data, data + 1, len - 1);
+}
 
-		if (deflate(&strm, flush) == Z_STREAM_ERROR)
-			fatal("Error compressing file");
+/*
+ * Hand out the next block to send, opening more files as needed
+ * RET false once every block was sent or on error
+ */
+static bool _next_block(bcast_file_t **file, uint32_t *block_no)
+{
+	ListIterator itr;
+	bcast_file_t *f;
+	bool found = false;
+
+	slurm_mutex_lock(&bcast_mutex);
+	while (!found && !bcast_rc) {
+		itr = list_iterator_create(active_list);
+		while ((f = list_next(itr))) {
+			if (f->next_block > f->block_cnt) {
+				if (!f->inflight)	/* file complete */
+					list_delete_item(itr);
+				continue;
+			}
+			if (f->next_block == 1) {
+				/* the first one verifies the credential */
+				if (!cred_cached && bcast_inflight)
+					continue;
+			} else if (!f->first_done) {
+				continue;
+			} else if (f->current) {
+				/* only close the file on the nodes */
+				if (f->inflight)
+					continue;
+				f->next_block = f->block_cnt;
+			} else if (((f->next_block == f->block_cnt) ||
+				    !f->any_order) && f->inflight) {
+				continue;
+			}
+			found = true;
+			break;
+		}
+		list_iterator_destroy(itr);
+		if (found)
+			break;
 
-		position += chunk_bite;
-		size += chunk_bite;
-		chunk_remaining -= chunk_bite;
-		out_remaining = strm.avail_out;
+		if ((list_count(active_list) < active_max) &&
+		    (f = list_dequeue(pending_list))) {
+			if (_file_state(f) != SLURM_SUCCESS) {
+				_free_file(f);
+				bcast_rc = SLURM_ERROR;
+				break;
+			}
+			list_append(active_list, f);
+			continue;
+		}
+		if (!bcast_inflight)
+			break;		/* all done */
+		slurm_cond_wait(&bcast_cond, &bcast_mutex);
+	}
+	if (found) {
+		*file = f;
+		*block_no = f->next_block++;
+		f->inflight++;
+		bcast_inflight++;
 	}
-	remaining -= size;
+	slurm_mutex_unlock(&bcast_mutex);
 
-	(void) deflateEnd(&strm);
+	return found;
+}
 
-	*orig_len = size;
-	*more = (remaining) ? true : false;
-	return (max_out - out_remaining);
-#else
-	info("zlib compression not supported, sending uncompressed file.");
-	params->compress = 0;
-	return _get_block_none(buffer, orig_len, more);
-#endif
+/* Record the outcome of sending a block */
+static void _block_done(bcast_file_t *f, uint32_t block_no, int rc,
+			bool current, bool any_order)
+{
+	slurm_mutex_lock(&bcast_mutex);
+	f->inflight--;
+	bcast_inflight--;
+	if (rc != SLURM_SUCCESS) {
+		bcast_rc = MAX(bcast_rc, rc);
+	} else if (block_no == 1) {
+		f->first_done = true;
+		f->current = current;
+		f->any_order = any_order;
+		cred_cached = true;
+		if (current)
+			verbose("`%s` already current", f->dst_fname);
+	}
+	slurm_cond_broadcast(&bcast_cond);
+	slurm_mutex_unlock(&bcast_mutex);
 }
 
-static int _get_block_lz4(struct bcast_parameters *params,
-			  char **buffer,
-			  int32_t *orig_len,
-			  bool *more)
+/* Read, compress and send one block of a file */
+static int _send_block(bcast_file_t *f, uint32_t block_no, char *node_list,
+		       char **buffer, int *buffer_size, bool *current,
+		       bool *any_order)
 {
-#if HAVE_LZ4
-	int size_out;
-	static int64_t remaining = -1;
-	static void *position;
-	int size;
+	struct bcast_parameters *params = bcast_params;
+	file_bcast_msg_t bcast_msg;
+	uint64_t offset = (uint64_t) (block_no - 1) * f->block_len;
+	char *data = (char *) f->src + offset;
+	int len, comp_len;
+	DEF_TIMERS;
 
-	if (!f_stat.st_size) {
-		*more = false;
-		return 0;
+	len = MIN(f->block_len, f->f_stat.st_size - offset);
+	*current = false;
+	*any_order = false;
+
+	memset(&bcast_msg, 0, sizeof(file_bcast_msg_t));
+	bcast_msg.fname		= f->dst_fname;
+	bcast_msg.block_no	= block_no;
+	bcast_msg.last_block	= (block_no == f->block_cnt);
+	bcast_msg.flags		= bcast_flags;
+	bcast_msg.modes		= f->f_stat.st_mode;
+	bcast_msg.uid		= f->f_stat.st_uid;
+	bcast_msg.user_name	= f->user_name;
+	bcast_msg.gid		= f->f_stat.st_gid;
+	bcast_msg.file_size	= f->f_stat.st_size;
+	bcast_msg.cred		= sbcast_cred->sbcast_cred;
+	bcast_msg.block_offset	= offset;
+
+	if (params->preserve) {
+		bcast_msg.atime     = f->f_stat.st_atime;
+		bcast_msg.mtime     = f->f_stat.st_mtime;
 	}
 
-	if (remaining < 0) {
-		position = src;
-		remaining = f_stat.st_size;
-		*buffer = xmalloc(block_len);
+	/* the nodes ignore the data of a file already current */
+	if (f->current)
+		len = 0;
+
+	/*
+	 * holes read back as zeros, the first and last block set the size,
+	 * nodes writing sequentially need every block
+	 */
+	if (params->sparse && f->any_order && (block_no != 1) &&
+	    !bcast_msg.last_block && _zero_block(data, len)) {
+		slurm_mutex_lock(&bcast_mutex);
+		size_uncompressed += len;
+		size_sparse += len;
+		slurm_mutex_unlock(&bcast_mutex);
+		debug("block %u of `%s` skipped, all zeros", block_no,
+		      f->src_fname);
+		return SLURM_SUCCESS;
 	}
 
-	/* intentionally limit decompressed size to 10x compressed
-	 * to avoid problems on receive size when decompressed */
-	size = MIN(block_len * 10, remaining);
-	if (!(size_out = LZ4_compress_destSize(position, *buffer,
-					       &size, block_len))) {
-		/* compression failure */
-		fatal("LZ4 compression error");
+	START_TIMER;
+	comp_len = _compress_block(params->compress, data, len, buffer,
+				   buffer_size);
+	END_TIMER;
+	if (comp_len) {
+		bcast_msg.compress = params->compress;
+		bcast_msg.block = *buffer;
+		bcast_msg.block_len = comp_len;
+	} else {
+		bcast_msg.compress = COMPRESS_OFF;
+		bcast_msg.block = data;
+		bcast_msg.block_len = len;
 	}
-	position += size;
-	remaining -= size;
+	bcast_msg.uncomp_len = len;
 
-	*orig_len = size;
-	*more = (remaining) ? true : false;
-	return size_out;
-#else
-	info("lz4 compression not supported, sending uncompressed file.");
-	params->compress = 0;
-	return _get_block_none(buffer, orig_len, more);
-#endif
+	slurm_mutex_lock(&bcast_mutex);
+	time_compression += DELTA_TIMER;
+	size_uncompressed += len;
+	size_compressed += bcast_msg.block_len;
+	slurm_mutex_unlock(&bcast_mutex);
 
+	debug("block %u of `%s`, size %u", block_no, f->src_fname,
+	      bcast_msg.block_len);
+	return _file_bcast(params, &bcast_msg, node_list, current, any_order);
 }
 
-static int _next_block(struct bcast_parameters *params,
-		       char **buffer,
-		       int32_t *orig_len,
-		       bool *more)
+/* Send blocks until none are left */
+static void *_bcast_thread(void *arg)
 {
-	switch (params->compress) {
-	case COMPRESS_OFF:
-		return _get_block_none(buffer, orig_len, more);
-	case COMPRESS_ZLIB:
-		return _get_block_zlib(params, buffer, orig_len, more);
-	case COMPRESS_LZ4:
-		return _get_block_lz4(params, buffer, orig_len, more);
+	char *node_list = arg;
+	char *buffer = NULL;
+	int buffer_size = 0, rc;
+	bcast_file_t *f;
+	uint32_t block_no;
+	bool current, any_order;
+
+	while (_next_block(&f, &block_no)) {
+		rc = _send_block(f, block_no, node_list, &buffer, &buffer_size,
+				 &current, &any_order);
+		_block_done(f, block_no, rc, current, any_order);
 	}
+	xfree(buffer);
 
-	/* compression type not recognized */
-	error("File compression type %u not supported,"
-	      " sending uncompressed file.", params->compress);
-	params->compress = 0;
-	return _get_block_none(buffer, orig_len, more);
+	return NULL;
 }
 
-/* read and broadcast the file */
-static int _bcast_file(struct bcast_parameters *params)
+/* read and broadcast the queued files */
+static int _bcast_files(struct bcast_parameters *params)
 {
-	int rc = SLURM_SUCCESS;
-	file_bcast_msg_t bcast_msg;
-	char *buffer = NULL;
-	int32_t orig_len = 0;
-	uint64_t size_uncompressed = 0, size_compressed = 0;
-	uint32_t time_compression = 0;
-	bool more = true;
+	pthread_t *threads;
+	char **node_lists;
+	int thread_cnt, file_cnt, i;
+	uint64_t elapsed;
 	DEF_TIMERS;
 
-	if (params->block_size)
-		block_len = MIN(params->block_size, f_stat.st_size);
-	else
-		block_len = MIN((512 * 1024), f_stat.st_size);
-
-	memset(&bcast_msg, 0, sizeof(file_bcast_msg_t));
-	bcast_msg.fname		= params->dst_fname;
-	bcast_msg.block_no	= 1;
-	bcast_msg.force		= params->force;
-	bcast_msg.modes		= f_stat.st_mode;
-	bcast_msg.uid		= f_stat.st_uid;
-	bcast_msg.user_name	= uid_to_string(f_stat.st_uid);
-	bcast_msg.gid		= f_stat.st_gid;
-	bcast_msg.file_size	= f_stat.st_size;
-	bcast_msg.cred          = sbcast_cred->sbcast_cred;
-
-	if (params->preserve) {
-		bcast_msg.atime     = f_stat.st_atime;
-		bcast_msg.mtime     = f_stat.st_mtime;
-	}
-
 	if (!params->fanout)
 		params->fanout = MAX_THREADS;
 	slurm_set_tree_width(MIN(MAX_THREADS, params->fanout));
 
-	while (more) {
-		START_TIMER;
-		bcast_msg.block_len = _next_block(params, &buffer, &orig_len,
-						  &more);
-		END_TIMER;
-		time_compression += DELTA_TIMER;
-		size_uncompressed += orig_len;
-		size_compressed += bcast_msg.block_len;
-		debug("block %u, size %u", bcast_msg.block_no,
-		      bcast_msg.block_len);
-		bcast_msg.compress = params->compress;
-		bcast_msg.uncomp_len = orig_len;
-		bcast_msg.block = buffer;
-		if (!more)
-			bcast_msg.last_block = 1;
-
-		rc = _file_bcast(params, &bcast_msg, sbcast_cred);
-		if (rc != SLURM_SUCCESS)
-			break;
-		if (bcast_msg.last_block)
-			break;	/* end of file */
-		bcast_msg.block_no++;
-		bcast_msg.block_offset += orig_len;
+	switch (params->compress) {
+	case COMPRESS_OFF:
+		break;
+#if HAVE_LIBZ
+	case COMPRESS_ZLIB:
+		break;
+#endif
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+		break;
+#endif
+	default:
+		info("File compression type %u not supported, sending uncompressed file.",
+		     params->compress);
+		params->compress = COMPRESS_OFF;
 	}
-	xfree(bcast_msg.user_name);
-	xfree(buffer);
+
+	thread_cnt = params->parallel ? params->parallel : BCAST_PARALLEL;
+	thread_cnt = MAX(1, MIN(thread_cnt, MAX_PARALLEL));
+	file_cnt = list_count(pending_list);
+	/* blocks are only sent out of order or skipped if the nodes agree */
+	if ((thread_cnt > 1) || params->sparse)
+		bcast_flags |= FILE_BCAST_ANY_ORDER;
+
+	bcast_params = params;
+	active_max = thread_cnt;
+	cred_cached = false;
+	bcast_inflight = 0;
+	bcast_rc = SLURM_SUCCESS;
+	size_uncompressed = size_compressed = size_sparse = 0;
+	time_compression = 0;
+
+	node_lists = _node_lists(sbcast_cred->node_list, thread_cnt);
+	threads = xmalloc(sizeof(pthread_t) * thread_cnt);
+	START_TIMER;
+	for (i = 0; i < thread_cnt; i++)
+		slurm_thread_create(&threads[i], _bcast_thread, node_lists[i]);
+	for (i = 0; i < thread_cnt; i++)
+		pthread_join(threads[i], NULL);
+	END_TIMER;
+	elapsed = DELTA_TIMER;
+	for (i = 0; i < thread_cnt; i++)
+		xfree(node_lists[i]);
+	xfree(node_lists);
+	xfree(threads);
 
 	if (size_uncompressed && (params->compress != 0)) {
 		int64_t pct = (int64_t) size_uncompressed - size_compressed;
@@ -450,15 +695,20 @@ static int _bcast_file(struct bcast_parameters *params)
 		 */
 		pct = (pct>=0) ? pct * 100 / size_uncompressed
 			       : - (-pct * 100 / size_uncompressed);
-		verbose("File compressed from %"PRIu64" to %"PRIu64" (%d percent) in %u usec",
+		verbose("File compressed from %"PRIu64" to %"PRIu64" (%d percent) in %"PRIu64" usec",
 			size_uncompressed, size_compressed, (int) pct,
 			time_compression);
 	}
-
-	return rc;
+	if (size_sparse)
+		verbose("Skipped %"PRIu64" bytes of zeros", size_sparse);
+	verbose("Broadcast %d files, %"PRIu64" bytes in %"PRIu64" usec (%.1f MB/s) with %d blocks in flight",
+		file_cnt, size_uncompressed, elapsed,
+		elapsed ? ((double) size_uncompressed / elapsed) : 0.0,
+		thread_cnt);
+
+	return bcast_rc;
 }
 
-
 static int _decompress_data_zlib(file_bcast_msg_t *req)
 {
 #if HAVE_LIBZ
@@ -542,16 +792,63 @@ static int _decompress_data_lz4(file_bcast_msg_t *req)
 #endif
 }
 
+/* RET the last component of a path, xfree() the result */
+static char *_base_name(char *path)
+{
+	char *base = xstrdup(path), *sep;
+	int len = strlen(base);
+
+	while ((len > 1) && (base[len - 1] == '/'))
+		base[--len] = '\0';
+	if ((sep = strrchr(base, '/')) && sep[1]) {
+		sep = xstrdup(sep + 1);
+		xfree(base);
+		base = sep;
+	}
+	return base;
+}
+
 extern int bcast_file(struct bcast_parameters *params)
 {
-	int rc;
+	int rc = SLURM_SUCCESS, i;
+	char *base, *dst_fname;
+
+	pending_list = list_create(_free_file);
+	active_list = list_create(_free_file);
+
+	bcast_flags = FILE_BCAST_NONE;
+	if (params->force)
+		bcast_flags |= FILE_BCAST_FORCE;
+	if (params->update)
+		bcast_flags |= FILE_BCAST_UPDATE;
+	if (params->recursive || params->src_cnt)
+		bcast_flags |= FILE_BCAST_MKDIR;
+
+	if (!params->src_cnt) {
+		rc = _queue_path(params, params->src_fname, params->dst_fname);
+	} else {
+		/* each source goes into the destination directory */
+		for (i = 0; (i < params->src_cnt) && (rc == SLURM_SUCCESS);
+		     i++) {
+			base = _base_name(params->src_fnames[i]);
+			dst_fname = xstrdup_printf("%s/%s", params->dst_fname,
+						   base);
+			rc = _queue_path(params, params->src_fnames[i],
+					 dst_fname);
+			xfree(base);
+			xfree(dst_fname);
+		}
+	}
 
-	if ((rc = _file_state(params)) != SLURM_SUCCESS)
-		return rc;
-	if ((rc = _get_job_info(params)) != SLURM_SUCCESS)
-		return rc;
-	if ((rc = _bcast_file(params)) != SLURM_SUCCESS)
-		return rc;
+	if ((rc == SLURM_SUCCESS) && !list_count(pending_list))
+		verbose("No files to broadcast");
+	else if (rc == SLURM_SUCCESS)
+		rc = _get_job_info(params);
+	if ((rc == SLURM_SUCCESS) && list_count(pending_list))
+		rc = _bcast_files(params);
+
+	FREE_NULL_LIST(active_list);
+	FREE_NULL_LIST(pending_list);
 
 /*	slurm_free_sbcast_cred_msg(sbcast_cred); */
 	return rc;
@@ -48,16 +48,23 @@ struct bcast_parameters {
 	bool force;
 	uint32_t job_id;		/* Job ID or Pack Job ID */
 	uint32_t pack_job_offset;	/* Pack Job Offset or NO_VAL */
+	int parallel;			/* blocks sent at once, 0 for default */
 	bool preserve;
-	char *src_fname;
+	bool recursive;			/* copy directory trees */
+	bool sparse;			/* do not send blocks of zeros */
+	char *src_fname;		/* source copied to dst_fname */
+	int src_cnt;			/* if set, sources copied into the
+					 * dst_fname directory instead */
+	char **src_fnames;
 	uint32_t step_id;
 	int timeout;
+	bool update;			/* skip files current on the nodes */
 	int verbose;
 };
 
 typedef struct file_bcast_info {
 	void *data;		/* mmap of file data */
-	int fd;			/* file descriptor */
+	int fd;			/* file descriptor, -1 if already current */
 	uint64_t file_size;	/* file size */
 	char *fname;		/* filename */
 	gid_t gid;		/* gid of owner */
@@ -117,6 +117,9 @@ extern uint32_t g_user_assoc_count; /* Number of associations which are users */
 extern uint32_t g_tres_count; /* Number of TRES from the database
 			       * which also is the number of elements
 			       * in the assoc_mgr_tres_array */
+extern uint32_t g_assoc_write_gen; /* Bumped each time the assoc WRITE_LOCK
+				    * is taken, lets callers detect that
+				    * cached association data is stale */
 
 extern int assoc_mgr_init(void *db_conn, assoc_init_args_t *args,
 			  int db_conn_errno);
@@ -0,0 +1,691 @@
+/*****************************************************************************\
+ *  bb_stage.c - Burst buffer file staging, used by the generic
+ *	burst buffer plugin and by slurmd
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#define _GNU_SOURCE	/* For POLLRDHUP */
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/bb_stage.h"
+#include "src/common/fd.h"
+#include "src/common/group_cache.h"
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/track_script.h"
+#include "src/common/uid.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+/* size of each read and write, also the unit of bandwidth reservation */
+#define STAGE_CHUNK	(1024 * 1024)
+#define MAX_POLL_WAIT	500
+
+/*
+ * Transfer slots shared by the staging processes, which are forked children
+ * of slurmctld: each chunk reserves the interval from the end of the last
+ * reservation (or now, if later) for as long as it takes at the configured
+ * rate, then sleeps until the start of its interval.
+ */
+typedef struct {
+	uint64_t bytes_per_sec;	/* 0 if no limit */
+	uint64_t next_usec;	/* end of the last reserved interval */
+} stage_throttle_t;
+
+static stage_throttle_t *throttle = NULL;
+static int stage_shutdown = 0;
+static int child_proc_count = 0;
+static pthread_mutex_t proc_count_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t _now_usec(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/* Map the shared throttle state, before forking any staging process */
+static void _throttle_init(void)
+{
+	void *addr;
+
+	slurm_mutex_lock(&proc_count_mutex);
+	if (!throttle) {
+		addr = mmap(NULL, sizeof(stage_throttle_t),
+			    PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS,
+			    -1, 0);
+		if (addr == MAP_FAILED)
+			error("%s: mmap: %m", __func__);
+		else
+			throttle = addr;
+	}
+	slurm_mutex_unlock(&proc_count_mutex);
+}
+
+static void _throttle(uint64_t bytes)
+{
+	uint64_t bw, now, start, next;
+	struct timespec ts;
+
+	if (!throttle ||
+	    !(bw = __atomic_load_n(&throttle->bytes_per_sec, __ATOMIC_RELAXED)))
+		return;
+
+	now = _now_usec();
+	next = __atomic_load_n(&throttle->next_usec, __ATOMIC_ACQUIRE);
+	do {
+		start = MAX(next, now);
+	} while (!__atomic_compare_exchange_n(&throttle->next_usec, &next,
+					      start + (bytes * 1000000) / bw,
+					      false, __ATOMIC_ACQ_REL,
+					      __ATOMIC_ACQUIRE));
+	if (start > now) {
+		ts.tv_sec = (start - now) / 1000000;
+		ts.tv_nsec = ((start - now) % 1000000) * 1000;
+		while (nanosleep(&ts, &ts) && (errno == EINTR))
+			;
+	}
+}
+
+extern void bb_stage_set_bandwidth(uint64_t bytes_per_sec)
+{
+	_throttle_init();
+	if (throttle)
+		__atomic_store_n(&throttle->bytes_per_sec, bytes_per_sec,
+				 __ATOMIC_RELAXED);
+}
+
+/* True unless path is relative, non-empty and without ".." components */
+static bool _bad_rel_path(char *path)
+{
+	char *p = path;
+
+	if (!path || !path[0] || (path[0] == '/'))
+		return true;
+	while (p) {
+		if ((p[0] == '.') && (p[1] == '.') &&
+		    ((p[2] == '/') || (p[2] == '\0')))
+			return true;
+		if ((p = strchr(p, '/')))
+			p++;
+	}
+	return false;
+}
+
+static int _parse_size(char *str, uint64_t *size)
+{
+	char *end = NULL;
+	uint64_t mult;
+
+	*size = strtoull(str, &end, 10);
+	if ((end == str) || ((mult = suffix_mult(end)) == NO_VAL64) ||
+	    (*size == 0))
+		return SLURM_ERROR;
+	*size *= mult;
+	return SLURM_SUCCESS;
+}
+
+static void _add_path(bb_stage_path_t **paths, int *cnt, char *src, char *dst)
+{
+	xrealloc(*paths, sizeof(bb_stage_path_t) * (*cnt + 1));
+	(*paths)[*cnt].src = xstrdup(src);
+	(*paths)[*cnt].dst = xstrdup(dst);
+	(*cnt)++;
+}
+
+static int _parse_line(char *line, bb_stage_spec_t *spec, char **err_msg)
+{
+	char *save_ptr = NULL, *directive, *tok, *src = NULL, *dst = NULL;
+	char *base;
+
+	if (!(directive = strtok_r(line, " \t", &save_ptr)))
+		return SLURM_SUCCESS;
+
+	if (!xstrncmp(directive, "capacity=", 9)) {
+		if (spec->capacity ||
+		    _parse_size(directive + 9, &spec->capacity)) {
+			xstrfmtcat(*err_msg, "invalid %s", directive);
+			return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		}
+		return SLURM_SUCCESS;
+	}
+	if (xstrcmp(directive, "stage_in") && xstrcmp(directive, "stage_out")) {
+		xstrfmtcat(*err_msg, "unsupported directive %s", directive);
+		return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+	}
+
+	while ((tok = strtok_r(NULL, " \t", &save_ptr))) {
+		if (!xstrncmp(tok, "source=", 7)) {
+			src = tok + 7;
+		} else if (!xstrncmp(tok, "destination=", 12)) {
+			dst = tok + 12;
+		} else {
+			xstrfmtcat(*err_msg, "invalid %s option %s",
+				   directive, tok);
+			return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		}
+	}
+
+	if (!xstrcmp(directive, "stage_in")) {
+		if (!src || (src[0] != '/')) {
+			xstrfmtcat(*err_msg, "stage_in source must be an absolute path");
+			return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		}
+		if (!dst) {
+			base = strrchr(src, '/') + 1;
+			dst = base[0] ? base : NULL;
+		}
+		if (_bad_rel_path(dst)) {
+			xstrfmtcat(*err_msg, "stage_in destination must be a relative path within the buffer");
+			return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		}
+		_add_path(&spec->stage_in, &spec->stage_in_cnt, src, dst);
+	} else {
+		if (_bad_rel_path(src)) {
+			xstrfmtcat(*err_msg, "stage_out source must be a relative path within the buffer");
+			return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		}
+		if (!dst || (dst[0] != '/')) {
+			xstrfmtcat(*err_msg, "stage_out destination must be an absolute path");
+			return ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		}
+		_add_path(&spec->stage_out, &spec->stage_out_cnt, src, dst);
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern int bb_stage_parse(char *bb_str, bb_stage_spec_t **spec,
+			  char **err_msg)
+{
+	char *tmp, *line, *save_ptr = NULL;
+	int rc = SLURM_SUCCESS;
+
+	*spec = xmalloc(sizeof(bb_stage_spec_t));
+	tmp = xstrdup(bb_str);
+	line = strtok_r(tmp, "\n;", &save_ptr);
+	while (line && (rc == SLURM_SUCCESS)) {
+		while (isspace(line[0]))
+			line++;
+		if ((line[0] != '#') || !xstrncmp(line, "#BB", 3)) {
+			if (line[0] == '#')
+				line += 3;
+			rc = _parse_line(line, *spec, err_msg);
+		}
+		line = strtok_r(NULL, "\n;", &save_ptr);
+	}
+	xfree(tmp);
+
+	if ((rc == SLURM_SUCCESS) && !(*spec)->capacity) {
+		xstrfmtcat(*err_msg, "capacity=<size> is required");
+		rc = ESLURM_INVALID_BURST_BUFFER_REQUEST;
+	}
+	if (rc != SLURM_SUCCESS) {
+		bb_stage_spec_free(*spec);
+		*spec = NULL;
+	}
+
+	return rc;
+}
+
+extern void bb_stage_spec_free(bb_stage_spec_t *spec)
+{
+	int i;
+
+	if (!spec)
+		return;
+	for (i = 0; i < spec->stage_in_cnt; i++) {
+		xfree(spec->stage_in[i].src);
+		xfree(spec->stage_in[i].dst);
+	}
+	for (i = 0; i < spec->stage_out_cnt; i++) {
+		xfree(spec->stage_out[i].src);
+		xfree(spec->stage_out[i].dst);
+	}
+	xfree(spec->stage_in);
+	xfree(spec->stage_out);
+	xfree(spec);
+}
+
+/*
+ * The functions below run in the staging process. They report errors on
+ * stderr, which is the pipe read by bb_stage_run(), rather than through the
+ * log of slurmctld.
+ */
+static void _child_err(const char *fmt, ...)
+{
+	char msg[1024];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(msg, sizeof(msg) - 1, fmt, ap);
+	va_end(ap);
+	len = MIN(len, sizeof(msg) - 2);
+	msg[len++] = '\n';
+	if (write(STDERR_FILENO, msg, len) < 0)
+		;	/* nowhere else to report it */
+}
+
+static int _write_all(int fd, char *buf, ssize_t len)
+{
+	ssize_t n;
+
+	while (len > 0) {
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int _copy_file(char *src, char *dst, struct stat *st, char *buf)
+{
+	struct timespec times[2] = { st->st_atim, st->st_mtim };
+	ssize_t n;
+	int in, out, rc = 0;
+
+	if ((in = open(src, O_RDONLY)) < 0) {
+		_child_err("open(%s): %s", src, strerror(errno));
+		return -1;
+	}
+	if ((out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR))
+	    < 0) {
+		_child_err("open(%s): %s", dst, strerror(errno));
+		close(in);
+		return -1;
+	}
+	while ((n = read(in, buf, STAGE_CHUNK)) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			_child_err("read(%s): %s", src, strerror(errno));
+			rc = -1;
+			break;
+		}
+		_throttle(n);
+		if (_write_all(out, buf, n)) {
+			_child_err("write(%s): %s", dst, strerror(errno));
+			rc = -1;
+			break;
+		}
+	}
+	close(in);
+	if (!rc && (fchmod(out, st->st_mode & 07777) ||
+		    futimens(out, times))) {
+		_child_err("%s: %s", dst, strerror(errno));
+		rc = -1;
+	}
+	if (close(out) && !rc) {
+		_child_err("close(%s): %s", dst, strerror(errno));
+		rc = -1;
+	}
+	return rc;
+}
+
+/*
+ * Copy a file or directory tree, follow a symbolic link only if "follow"
+ * (i.e. the path was named in the request)
+ */
+static int _copy_tree(char *src, char *dst, bool follow, char *buf)
+{
+	struct timespec times[2];
+	struct dirent *ent;
+	struct stat st;
+	char *child_src, *child_dst;
+	DIR *dir;
+	ssize_t len;
+	int rc = 0;
+
+	if ((follow ? stat(src, &st) : lstat(src, &st)) < 0) {
+		_child_err("%s: %s", src, strerror(errno));
+		return -1;
+	}
+
+	if (S_ISREG(st.st_mode))
+		return _copy_file(src, dst, &st, buf);
+
+	times[0] = st.st_atim;
+	times[1] = st.st_mtim;
+	if (S_ISLNK(st.st_mode)) {
+		if ((len = readlink(src, buf, STAGE_CHUNK - 1)) < 0) {
+			_child_err("readlink(%s): %s", src, strerror(errno));
+			return -1;
+		}
+		buf[len] = '\0';
+		if (((unlink(dst) < 0) && (errno != ENOENT)) ||
+		    (symlink(buf, dst) < 0)) {
+			_child_err("symlink(%s): %s", dst, strerror(errno));
+			return -1;
+		}
+		(void) utimensat(AT_FDCWD, dst, times, AT_SYMLINK_NOFOLLOW);
+		return 0;
+	}
+	if (!S_ISDIR(st.st_mode))
+		return 0;	/* devices, pipes and sockets are not copied */
+
+	if ((mkdir(dst, S_IRWXU) < 0) && (errno != EEXIST)) {
+		_child_err("mkdir(%s): %s", dst, strerror(errno));
+		return -1;
+	}
+	if (!(dir = opendir(src))) {
+		_child_err("opendir(%s): %s", src, strerror(errno));
+		return -1;
+	}
+	while ((ent = readdir(dir))) {
+		if (!xstrcmp(ent->d_name, ".") || !xstrcmp(ent->d_name, ".."))
+			continue;
+		child_src = xstrdup_printf("%s/%s", src, ent->d_name);
+		child_dst = xstrdup_printf("%s/%s", dst, ent->d_name);
+		if (_copy_tree(child_src, child_dst, false, buf))
+			rc = -1;
+		xfree(child_src);
+		xfree(child_dst);
+	}
+	closedir(dir);
+	if (chmod(dst, (st.st_mode & 07777) | S_IRWXU) ||
+	    utimensat(AT_FDCWD, dst, times, 0)) {
+		_child_err("%s: %s", dst, strerror(errno));
+		rc = -1;
+	}
+	return rc;
+}
+
+/* Create the missing parent directories of a path */
+static int _mkdir_parents(char *path)
+{
+	char *tmp = xstrdup(path), *p = tmp;
+	int rc = 0;
+
+	while ((p = strchr(p + 1, '/'))) {
+		*p = '\0';
+		if ((mkdir(tmp, S_IRWXU | S_IRWXG | S_IRWXO) < 0) &&
+		    (errno != EEXIST)) {
+			_child_err("mkdir(%s): %s", tmp, strerror(errno));
+			rc = -1;
+			break;
+		}
+		*p = '/';
+	}
+	xfree(tmp);
+	return rc;
+}
+
+/* Remove a directory tree, or only its contents if keep_top */
+static int _remove_tree(char *path, bool keep_top)
+{
+	struct dirent *ent;
+	struct stat st;
+	char *child;
+	DIR *dir;
+	int rc = 0;
+
+	if (lstat(path, &st) < 0) {
+		if (errno == ENOENT)
+			return 0;
+		_child_err("%s: %s", path, strerror(errno));
+		return -1;
+	}
+	if (!S_ISDIR(st.st_mode)) {
+		if (unlink(path) < 0) {
+			_child_err("unlink(%s): %s", path, strerror(errno));
+			return -1;
+		}
+		return 0;
+	}
+
+	(void) chmod(path, (st.st_mode & 07777) | S_IRWXU);
+	if (!(dir = opendir(path))) {
+		_child_err("opendir(%s): %s", path, strerror(errno));
+		return -1;
+	}
+	while ((ent = readdir(dir))) {
+		if (!xstrcmp(ent->d_name, ".") || !xstrcmp(ent->d_name, ".."))
+			continue;
+		child = xstrdup_printf("%s/%s", path, ent->d_name);
+		if (_remove_tree(child, false))
+			rc = -1;
+		xfree(child);
+	}
+	closedir(dir);
+	if (!rc && !keep_top && (rmdir(path) < 0)) {
+		_child_err("rmdir(%s): %s", path, strerror(errno));
+		rc = -1;
+	}
+	return rc;
+}
+
+static char *_full_path(char *buf_dir, char *path)
+{
+	if (path[0] == '/')
+		return xstrdup(path);
+	return xstrdup_printf("%s/%s", buf_dir, path);
+}
+
+static int _stage(bb_stage_path_t *paths, int path_cnt, char *buf_dir)
+{
+	char *buf, *src, *dst;
+	int i, rc = 0;
+
+	if (!paths)
+		return _remove_tree(buf_dir, true);
+
+	buf = xmalloc(STAGE_CHUNK);
+	for (i = 0; i < path_cnt; i++) {
+		src = _full_path(buf_dir, paths[i].src);
+		dst = _full_path(buf_dir, paths[i].dst);
+		if (_mkdir_parents(dst) || _copy_tree(src, dst, true, buf))
+			rc = -1;
+		xfree(src);
+		xfree(dst);
+	}
+	xfree(buf);
+	return rc;
+}
+
+/* used to terminate any outstanding staging */
+extern void bb_stage_shutdown(void)
+{
+	stage_shutdown = 1;
+}
+
+/* Return count of staging processes */
+extern int bb_stage_count(void)
+{
+	int cnt;
+
+	slurm_mutex_lock(&proc_count_mutex);
+	cnt = child_proc_count;
+	slurm_mutex_unlock(&proc_count_mutex);
+
+	return cnt;
+}
+
+static int _tot_wait(struct timeval *start_time)
+{
+	struct timeval end_time;
+	int msec_delay;
+
+	gettimeofday(&end_time, NULL);
+	msec_delay =   (end_time.tv_sec  - start_time->tv_sec ) * 1000;
+	msec_delay += ((end_time.tv_usec - start_time->tv_usec + 500) / 1000);
+	return msec_delay;
+}
+
+extern char *bb_stage_run(char *op_name, bb_stage_path_t *paths, int path_cnt,
+			  char *buf_dir, uid_t uid, gid_t gid, int max_wait,
+			  pthread_t tid, int *status)
+{
+	int i, new_wait, ngids = 0, resp_size = 1024, resp_offset = 0;
+	int pfd[2] = { -1, -1 };
+	gid_t *gids = NULL;
+	bool set_user = false;
+	struct pollfd fds;
+	struct timeval tstart;
+	char *resp = NULL;
+	pid_t cpid;
+
+	if (geteuid() == 0) {
+		ngids = group_cache_lookup(uid, gid, NULL, &gids);
+		set_user = true;
+	} else if (uid != geteuid()) {
+		*status = 127;
+		return xstrdup_printf("%s: can not stage files of user %u as user %u",
+				      op_name, uid, geteuid());
+	}
+	_throttle_init();
+	if (pipe(pfd) != 0) {
+		error("%s: pipe(): %m", __func__);
+		xfree(gids);
+		*status = 127;
+		return xstrdup("System error");
+	}
+
+	slurm_mutex_lock(&proc_count_mutex);
+	child_proc_count++;
+	slurm_mutex_unlock(&proc_count_mutex);
+	if ((cpid = fork()) == 0) {
+		dup2(pfd[1], STDERR_FILENO);
+		dup2(pfd[1], STDOUT_FILENO);
+		close(STDIN_FILENO);
+		closeall(STDERR_FILENO + 1);
+		setpgid(0, 0);
+		if (set_user &&
+		    ((setgroups(ngids, gids) < 0) || (setgid(gid) < 0) ||
+		     (setuid(uid) < 0))) {
+			_child_err("%s: unable to set user %u: %s",
+				   op_name, uid, strerror(errno));
+			_exit(127);
+		}
+		umask(S_IWGRP | S_IWOTH);
+		_exit(_stage(paths, path_cnt, buf_dir) ? 1 : 0);
+	}
+	xfree(gids);
+	close(pfd[1]);
+	if (cpid < 0) {
+		error("%s: fork(): %m", __func__);
+		close(pfd[0]);
+		slurm_mutex_lock(&proc_count_mutex);
+		child_proc_count--;
+		slurm_mutex_unlock(&proc_count_mutex);
+		*status = 127;
+		return xstrdup("System error");
+	}
+
+	resp = xmalloc(resp_size);
+	gettimeofday(&tstart, NULL);
+	if (tid)
+		track_script_reset_cpid(tid, cpid);
+	while (1) {
+		if (stage_shutdown) {
+			error("%s: killing %s operation on shutdown",
+			      __func__, op_name);
+			break;
+		}
+		fds.fd = pfd[0];
+		fds.events = POLLIN | POLLHUP | POLLRDHUP;
+		fds.revents = 0;
+		if (max_wait <= 0) {
+			new_wait = MAX_POLL_WAIT;
+		} else {
+			new_wait = max_wait - _tot_wait(&tstart);
+			if (new_wait <= 0) {
+				error("%s: %s poll timeout @ %d msec",
+				      __func__, op_name, max_wait);
+				xstrfmtcat(resp, "%s: timeout after %d msec\n",
+					   op_name, max_wait);
+				break;
+			}
+			new_wait = MIN(new_wait, MAX_POLL_WAIT);
+		}
+		i = poll(&fds, 1, new_wait);
+		if (i == 0) {
+			continue;
+		} else if (i < 0) {
+			error("%s: %s poll:%m", __func__, op_name);
+			break;
+		}
+		if ((fds.revents & POLLIN) == 0)
+			break;
+		i = read(pfd[0], resp + resp_offset, resp_size - resp_offset);
+		if (i == 0) {
+			break;
+		} else if (i < 0) {
+			if ((errno == EAGAIN) || (errno == EINTR))
+				continue;
+			error("%s: %s read:%m", __func__, op_name);
+			break;
+		} else {
+			resp_offset += i;
+			if (resp_offset + 1024 >= resp_size) {
+				resp_size *= 2;
+				resp = xrealloc(resp, resp_size);
+			}
+		}
+	}
+	killpg(cpid, SIGTERM);
+	usleep(10000);
+	killpg(cpid, SIGKILL);
+	waitpid(cpid, status, 0);
+	close(pfd[0]);
+	slurm_mutex_lock(&proc_count_mutex);
+	child_proc_count--;
+	slurm_mutex_unlock(&proc_count_mutex);
+
+	if (!resp[0])
+		xfree(resp);
+	return resp;
+}
@@ -0,0 +1,112 @@
+/*****************************************************************************\
+ *  bb_stage.h - Burst buffer file staging, used by the generic
+ *	burst buffer plugin and by slurmd
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _BB_STAGE_H
+#define _BB_STAGE_H
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+/*
+ * A job's burst buffer request, one directive per line:
+ *
+ *   #BB capacity=<size>
+ *   #BB stage_in source=<absolute path> [destination=<relative path>]
+ *   #BB stage_out source=<relative path> destination=<absolute path>
+ *
+ * Relative paths are within the job's buffer directory, the stage_in
+ * destination defaults to the base name of its source. Lines starting with
+ * '#' but not "#BB" are ignored, the "#BB" prefix is optional otherwise.
+ * Lines may also be separated by ';' (e.g. from the --bb option).
+ */
+typedef struct {
+	char *src;
+	char *dst;
+} bb_stage_path_t;
+
+typedef struct {
+	uint64_t capacity;		/* bytes */
+	bb_stage_path_t *stage_in;
+	int stage_in_cnt;
+	bb_stage_path_t *stage_out;
+	int stage_out_cnt;
+} bb_stage_spec_t;
+
+/*
+ * Parse a job's burst buffer request
+ * IN bb_str - request, see above
+ * OUT spec - parsed request, release with bb_stage_spec_free()
+ * OUT err_msg - reason the request is invalid, must be xfreed
+ * RET SLURM_SUCCESS or ESLURM_INVALID_BURST_BUFFER_REQUEST
+ */
+extern int bb_stage_parse(char *bb_str, bb_stage_spec_t **spec,
+			  char **err_msg);
+
+extern void bb_stage_spec_free(bb_stage_spec_t *spec);
+
+/*
+ * Set the aggregate rate of all staging operations, shared by every
+ * operation running at the time including those already started
+ * IN bytes_per_sec - rate limit, 0 for none
+ */
+extern void bb_stage_set_bandwidth(uint64_t bytes_per_sec);
+
+/*
+ * Copy files in or out of a job's buffer directory, or empty it, in a child
+ * process running as the job's user. Symbolic links are copied as links,
+ * except for a source named explicitly. Missing parent directories of a
+ * destination are created.
+ * IN op_name - operation, for messages (e.g. "stage_in")
+ * IN paths - files or directory trees to copy, relative paths are within
+ *	      buf_dir. NULL to remove the contents of buf_dir instead.
+ * IN path_cnt - count of paths
+ * IN buf_dir - the job's buffer directory
+ * IN uid, gid - the job's user and group
+ * IN max_wait - maximum time to wait in milliseconds, 0 for no limit
+ * IN tid - thread we are called from, for track_script, 0 if none
+ * OUT status - exit status of the child process
+ * RET errors of the operation or NULL, must be xfreed
+ */
+extern char *bb_stage_run(char *op_name, bb_stage_path_t *paths, int path_cnt,
+			  char *buf_dir, uid_t uid, gid_t gid, int max_wait,
+			  pthread_t tid, int *status);
+
+/* Terminate outstanding staging operations */
+extern void bb_stage_shutdown(void);
+
+/* Return count of staging processes */
+extern int bb_stage_count(void);
+
+#endif	/* _BB_STAGE_H */
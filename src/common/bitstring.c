@@ -106,6 +106,175 @@
 #define	bit_decl(name, nbits) \
 	(name)[_bitstr_words(nbits)] = { BITSTR_MAGIC_STACK, (nbits) }
 
+#ifdef HAVE___BUILTIN_POPCOUNTLL
+#define hweight __builtin_popcountll
+#else
+/*
+ * Returns the hamming weight (i.e. the number of bits set) in a word.
+ * NOTE: This routine borrowed from Linux 4.9 <tools/lib/hweight.c>.
+ */
+static uint64_t
+hweight(uint64_t w)
+{
+        w -= (w >> 1) & 0x5555555555555555ul;
+        w =  (w & 0x3333333333333333ul) + ((w >> 2) & 0x3333333333333333ul);
+        w =  (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0ful;
+        return (w * 0x0101010101010101ul) >> 56;
+}
+#endif
+
+/*
+ * The word loops of the operations used most by node selection are built
+ * for several instruction sets, and the dynamic loader picks the best one
+ * for the CPU (GNU ifunc), so they run with AVX2/AVX-512 vectors and the
+ * popcnt instruction where available. GCC only vectorizes them at -O2 if
+ * asked to.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#  define _bit_vectorize optimize("tree-vectorize")
+#else
+#  define _bit_vectorize
+#endif
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#  if __has_attribute(target_clones)
+#    define _bit_kernel __attribute__((_bit_vectorize, target_clones( \
+		"arch=skylake-avx512", "arch=haswell", "popcnt", "default")))
+#  endif
+#endif
+#ifndef _bit_kernel
+#  define _bit_kernel
+#endif
+
+/* number of words holding bits in bitstring b */
+#define _bitstr_data_words(b) \
+	(_bitstr_words(_bitstr_bits(b)) - BITSTR_OVERHEAD)
+
+_bit_kernel
+static void _words_and(bitstr_t *w1, const bitstr_t *w2, int64_t cnt)
+{
+	int64_t i;
+
+	for (i = 0; i < cnt; i++)
+		w1[i] &= w2[i];
+}
+
+_bit_kernel
+static void _words_and_not(bitstr_t *w1, const bitstr_t *w2, int64_t cnt)
+{
+	int64_t i;
+
+	for (i = 0; i < cnt; i++)
+		w1[i] &= ~w2[i];
+}
+
+_bit_kernel
+static void _words_or(bitstr_t *w1, const bitstr_t *w2, int64_t cnt)
+{
+	int64_t i;
+
+	for (i = 0; i < cnt; i++)
+		w1[i] |= w2[i];
+}
+
+_bit_kernel
+static int64_t _words_count(const bitstr_t *w, int64_t cnt)
+{
+	int64_t count = 0, i;
+
+	for (i = 0; i < cnt; i++)
+		count += hweight(w[i]);
+	return count;
+}
+
+_bit_kernel
+static int64_t _words_and_count(const bitstr_t *w1, const bitstr_t *w2,
+				int64_t cnt)
+{
+	int64_t count = 0, i;
+
+	for (i = 0; i < cnt; i++)
+		count += hweight(w1[i] & w2[i]);
+	return count;
+}
+
+/* w1 &= w2, return the count of bits left set in w1 */
+_bit_kernel
+static int64_t _words_and_count_set(bitstr_t *w1, const bitstr_t *w2,
+				    int64_t cnt)
+{
+	int64_t count = 0, i;
+
+	for (i = 0; i < cnt; i++) {
+		w1[i] &= w2[i];
+		count += hweight(w1[i]);
+	}
+	return count;
+}
+
+/*
+ * The tests below look at blocks of 8 words so the compiler can vectorize
+ * them despite the early return.
+ */
+
+/* return true if w1 & ~w2 (or w1 & w2 if not negate_w2) has any bit set */
+_bit_kernel
+static bool _words_and_any(const bitstr_t *w1, const bitstr_t *w2,
+			   int64_t cnt, bool negate_w2)
+{
+	const bitstr_t mask = negate_w2 ? ~((bitstr_t) 0) : 0;
+	int64_t i = 0;
+	int j;
+
+	for ( ; (i + 8) <= cnt; i += 8) {
+		bitstr_t any = 0;
+		for (j = 0; j < 8; j++)
+			any |= w1[i + j] & (w2[i + j] ^ mask);
+		if (any)
+			return true;
+	}
+	for ( ; i < cnt; i++) {
+		if (w1[i] & (w2[i] ^ mask))
+			return true;
+	}
+	return false;
+}
+
+/* w1 &= ~w2, return true if any bit is left set in w1 */
+_bit_kernel
+static bool _words_and_not_any(bitstr_t *w1, const bitstr_t *w2,
+			       int64_t cnt)
+{
+	bitstr_t any = 0;
+	int64_t i;
+
+	for (i = 0; i < cnt; i++) {
+		w1[i] &= ~w2[i];
+		any |= w1[i];
+	}
+	return (any != 0);
+}
+
+/* return the index of the first word with a bit set, -1 if none */
+_bit_kernel
+static int64_t _words_first_set(const bitstr_t *w, int64_t cnt)
+{
+	int64_t i = 0;
+	int j;
+
+	for ( ; (i + 8) <= cnt; i += 8) {
+		bitstr_t any = 0;
+		for (j = 0; j < 8; j++)
+			any |= w[i + j];
+		if (any)
+			break;
+	}
+	for ( ; i < cnt; i++) {
+		if (w[i])
+			return i;
+	}
+	return -1;
+}
+
 /*
  * Define slurm-specific aliases for use by plugins, see slurm_xlator.h
  * for details.
@@ -120,10 +289,13 @@ strong_alias(bit_set_all,	slurm_bit_set_all);
 strong_alias(bit_clear_all,	slurm_bit_clear_all);
 strong_alias(bit_ffc,		slurm_bit_ffc);
 strong_alias(bit_ffs,		slurm_bit_ffs);
+strong_alias(bit_ffs_from_bit,	slurm_bit_ffs_from_bit);
 strong_alias(bit_free,		slurm_bit_free);
 strong_alias(bit_realloc,	slurm_bit_realloc);
 strong_alias(bit_size,		slurm_bit_size);
 strong_alias(bit_and,		slurm_bit_and);
+strong_alias(bit_and_count,	slurm_bit_and_count);
+strong_alias(bit_and_not_any,	slurm_bit_and_not_any);
 strong_alias(bit_not,		slurm_bit_not);
 strong_alias(bit_or,		slurm_bit_or);
 strong_alias(bit_set_count,	slurm_bit_set_count);
@@ -473,9 +645,15 @@ bitoff_t
 bit_ffs(bitstr_t *b)
 {
 	bitoff_t bit = 0, value = -1;
+	int64_t first;
 
 	_assert_bitstr_valid(b);
 
+	first = _words_first_set(&b[BITSTR_OVERHEAD], _bitstr_data_words(b));
+	if (first == -1)
+		return -1;
+	bit = first << BITSTR_SHIFT;
+
 	while (bit < _bitstr_bits(b) && value == -1) {
 		int32_t word = _bit_word(bit);
 
@@ -503,6 +681,51 @@ bit_ffs(bitstr_t *b)
 		return -1;
 }
 
+/*
+ * Find first bit set in b at or after a given bit.
+ *   b (IN)		bitstring to search
+ *   bit (IN)		first bit position to consider
+ *   RETURN 		resulting bit position (-1 if none found)
+ */
+bitoff_t
+bit_ffs_from_bit(bitstr_t *b, bitoff_t bit)
+{
+	int64_t word, first;
+
+	_assert_bitstr_valid(b);
+
+	if (bit < 0)
+		bit = 0;
+	/* test the partial first word */
+	while ((bit < _bitstr_bits(b)) && (bit & BITSTR_MAXPOS)) {
+		if (bit_test(b, bit))
+			return bit;
+		bit++;
+	}
+	if (bit >= _bitstr_bits(b))
+		return -1;
+
+	/* then whole words, bit_ffs() of the remainder */
+	word = _bit_word(bit);
+	first = _words_first_set(&b[word], _bitstr_words(_bitstr_bits(b)) -
+				 word);
+	if (first == -1)
+		return -1;
+	word += first;
+	bit = (word - BITSTR_OVERHEAD) << BITSTR_SHIFT;
+#if HAVE___BUILTIN_CLZLL && (defined SLURM_BIGENDIAN)
+	bit += __builtin_clzll(b[word]);
+#elif HAVE___BUILTIN_CTZLL && (!defined SLURM_BIGENDIAN)
+	bit += __builtin_ctzll(b[word]);
+#else
+	while (!bit_test(b, bit))
+		bit++;
+#endif
+	if (bit < _bitstr_bits(b))
+		return bit;
+	return -1;
+}
+
 /*
  * Find last bit set in b.
  *   b (IN)		bitstring to search
@@ -579,17 +802,13 @@ bit_fill_gaps(bitstr_t *b)
 int
 bit_super_set(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
-
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8) {
-		if (b1[_bit_word(bit)] != (b1[_bit_word(bit)] &
-		                           b2[_bit_word(bit)]))
-			return 0;
-	}
+	if (_words_and_any(&b1[BITSTR_OVERHEAD], &b2[BITSTR_OVERHEAD],
+			   _bitstr_data_words(b1), true))
+		return 0;
 
 	return 1;
 }
@@ -626,14 +845,12 @@ bit_equal(bitstr_t *b1, bitstr_t *b2)
 void
 bit_and(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
-
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= b2[_bit_word(bit)];
+	_words_and(&b1[BITSTR_OVERHEAD], &b2[BITSTR_OVERHEAD],
+		   _bitstr_data_words(b1));
 }
 
 /*
@@ -643,14 +860,74 @@ bit_and(bitstr_t *b1, bitstr_t *b2)
  */
 void bit_and_not(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	_words_and_not(&b1[BITSTR_OVERHEAD], &b2[BITSTR_OVERHEAD],
+		       _bitstr_data_words(b1));
+}
+
+/*
+ * b1 &= b2, fused with a count of the bits left set in b1
+ *   b1 (IN/OUT)	first bitmap
+ *   b2 (IN)		second bitmap
+ *   RETURN		count of set bits in the result
+ */
+int32_t
+bit_and_count(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit, bit_cnt;
+	int64_t full_words;
+	int32_t count;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] &= ~b2[_bit_word(bit)];
+	bit_cnt = _bitstr_bits(b1);
+	full_words = bit_cnt >> BITSTR_SHIFT;
+	count = _words_and_count_set(&b1[BITSTR_OVERHEAD],
+				     &b2[BITSTR_OVERHEAD], full_words);
+	for (bit = full_words << BITSTR_SHIFT; bit < bit_cnt; bit++) {
+		if (!bit_test(b2, bit))
+			bit_clear(b1, bit);
+		else if (bit_test(b1, bit))
+			count++;
+	}
+
+	return count;
+}
+
+/*
+ * b1 &= ~b2, fused with a test for any bit left set in b1
+ *   b1 (IN/OUT)	first bitmap
+ *   b2 (IN)		second bitmap
+ *   RETURN		1 if any bit is set in the result, 0 otherwise
+ */
+int
+bit_and_not_any(bitstr_t *b1, bitstr_t *b2)
+{
+	bitoff_t bit, bit_cnt;
+	int64_t full_words;
+	int any;
+
+	_assert_bitstr_valid(b1);
+	_assert_bitstr_valid(b2);
+	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
+
+	bit_cnt = _bitstr_bits(b1);
+	full_words = bit_cnt >> BITSTR_SHIFT;
+	any = _words_and_not_any(&b1[BITSTR_OVERHEAD], &b2[BITSTR_OVERHEAD],
+				 full_words);
+	for (bit = full_words << BITSTR_SHIFT; bit < bit_cnt; bit++) {
+		if (bit_test(b2, bit))
+			bit_clear(b1, bit);
+		else if (bit_test(b1, bit))
+			any = 1;
+	}
+
+	return any;
 }
 
 /*
@@ -676,14 +953,12 @@ bit_not(bitstr_t *b)
 void
 bit_or(bitstr_t *b1, bitstr_t *b2)
 {
-	bitoff_t bit;
-
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
-	for (bit = 0; bit < _bitstr_bits(b1); bit += sizeof(bitstr_t)*8)
-		b1[_bit_word(bit)] |= b2[_bit_word(bit)];
+	_words_or(&b1[BITSTR_OVERHEAD], &b2[BITSTR_OVERHEAD],
+		  _bitstr_data_words(b1));
 }
 
 /*
@@ -737,23 +1012,6 @@ bit_copybits(bitstr_t *dest, bitstr_t *src)
 	memcpy(&dest[BITSTR_OVERHEAD], &src[BITSTR_OVERHEAD], len);
 }
 
-#ifdef HAVE___BUILTIN_POPCOUNTLL
-#define hweight __builtin_popcountll
-#else
-/*
- * Returns the hamming weight (i.e. the number of bits set) in a word.
- * NOTE: This routine borrowed from Linux 4.9 <tools/lib/hweight.c>.
- */
-static uint64_t
-hweight(uint64_t w)
-{
-        w -= (w >> 1) & 0x5555555555555555ul;
-        w =  (w & 0x3333333333333333ul) + ((w >> 2) & 0x3333333333333333ul);
-        w =  (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0ful;
-        return (w * 0x0101010101010101ul) >> 56;
-}
-#endif
-
 /*
  * Count the number of bits set in bitstring.
  *   b (IN)		bitstring to check
@@ -764,15 +1022,14 @@ bit_set_count(bitstr_t *b)
 {
 	int32_t count = 0;
 	bitoff_t bit, bit_cnt;
-	int32_t word_size = sizeof(bitstr_t) * 8;
+	int64_t full_words;
 
 	_assert_bitstr_valid(b);
 
 	bit_cnt = _bitstr_bits(b);
-	for (bit = 0; (bit + word_size) <= bit_cnt; bit += word_size) {
-		count += hweight(b[_bit_word(bit)]);
-	}
-	for ( ; bit < bit_cnt; bit++) {
+	full_words = bit_cnt >> BITSTR_SHIFT;
+	count = _words_count(&b[BITSTR_OVERHEAD], full_words);
+	for (bit = full_words << BITSTR_SHIFT; bit < bit_cnt; bit++) {
 		if (bit_test(b, bit))
 			count++;
 	}
@@ -802,8 +1059,10 @@ bit_set_count_range(bitstr_t *b, int32_t start, int32_t end)
 		if (bit_test(b, bit))
 			count++;
 	}
-	for (; (bit + word_size) <= end ; bit += word_size) {
-		count += hweight(b[_bit_word(bit)]);
+	if ((bit + word_size) <= end) {
+		int64_t words = (end - bit) / word_size;
+		count += _words_count(&b[_bit_word(bit)], words);
+		bit += words * word_size;
 	}
 	for ( ; bit < end; bit++) {
 		if (bit_test(b, bit))
@@ -815,25 +1074,23 @@ bit_set_count_range(bitstr_t *b, int32_t start, int32_t end)
 
 static int32_t _bit_overlap_internal(bitstr_t *b1, bitstr_t *b2, bool count_it)
 {
-	int32_t count = 0, anded;
+	int32_t count = 0;
 	bitoff_t bit, bit_cnt;
-	int32_t word_size = sizeof(bitstr_t) * 8;
+	int64_t full_words;
 
 	_assert_bitstr_valid(b1);
 	_assert_bitstr_valid(b2);
 	xassert(_bitstr_bits(b1) == _bitstr_bits(b2));
 
 	bit_cnt = _bitstr_bits(b1);
-	for (bit = 0; bit < bit_cnt; bit += word_size) {
-		if ((bit + word_size - 1) >= bit_cnt)
-			break;
-		anded = b1[_bit_word(bit)] & b2[_bit_word(bit)];
-		if (count_it)
-			count += hweight(anded);
-		else if (anded)
-			return 1;
-	}
-	for ( ; bit < bit_cnt; bit++) {
+	full_words = bit_cnt >> BITSTR_SHIFT;
+	if (count_it)
+		count = _words_and_count(&b1[BITSTR_OVERHEAD],
+					 &b2[BITSTR_OVERHEAD], full_words);
+	else if (_words_and_any(&b1[BITSTR_OVERHEAD], &b2[BITSTR_OVERHEAD],
+				full_words, false))
+		return 1;
+	for (bit = full_words << BITSTR_SHIFT; bit < bit_cnt; bit++) {
 		if (bit_test(b1, bit) && bit_test(b2, bit)) {
 			if (count_it)
 				count++;
@@ -158,14 +158,6 @@ typedef struct slurm_gres_context {
 	uint64_t        total_cnt;		/* Total GRES across all nodes */
 } slurm_gres_context_t;
 
-/* Generic gres data structure for adding to a list. Depending upon the
- * context, gres_data points to gres_node_state_t, gres_job_state_t or
- * gres_step_state_t */
-typedef struct gres_state {
-	uint32_t	plugin_id;
-	void		*gres_data;
-} gres_state_t;
-
 typedef struct gres_search_key {
 	uint32_t plugin_id;
 	uint32_t type_id;
@@ -6364,6 +6356,100 @@ static void _validate_gres_node_cores(gres_node_state_t *node_gres_ptr,
 	}
 }
 
+/*
+ * Return the minimum count of GRES which the job needs on any one node
+ */
+static uint64_t _job_min_gres_node(gres_job_state_t *job_gres_ptr)
+{
+	uint64_t min_gres_node = 0;
+
+	if (job_gres_ptr->gres_per_job)
+		min_gres_node = 1;
+	min_gres_node = MAX(min_gres_node, job_gres_ptr->gres_per_node);
+	min_gres_node = MAX(min_gres_node, job_gres_ptr->gres_per_socket);
+	min_gres_node = MAX(min_gres_node, job_gres_ptr->gres_per_task);
+
+	return min_gres_node;
+}
+
+/*
+ * Test a job's GRES request against a node's flat GRES counters only.
+ * This is a necessary (not sufficient) condition for the topology based
+ * tests, so nodes lacking enough free GRES can be rejected with a few
+ * integer compares before any topology or core bitmap is examined.
+ * RET false if the node can not possibly satisfy the job's request
+ */
+static bool _node_gres_cnt_test(gres_job_state_t *job_gres_ptr,
+				gres_node_state_t *node_gres_ptr,
+				bool use_total_gres)
+{
+	uint64_t min_gres_node, gres_avail;
+	int i;
+
+	if (node_gres_ptr->no_consume)
+		use_total_gres = true;
+
+	min_gres_node = _job_min_gres_node(job_gres_ptr);
+	if (min_gres_node == 0)
+		return true;
+
+	gres_avail = node_gres_ptr->gres_cnt_avail;
+	if (!use_total_gres) {
+		if (node_gres_ptr->gres_cnt_alloc >= gres_avail)
+			gres_avail = 0;
+		else
+			gres_avail -= node_gres_ptr->gres_cnt_alloc;
+	}
+	if (min_gres_node > gres_avail)
+		return false;
+
+	if (!job_gres_ptr->type_name)
+		return true;
+	for (i = 0; i < node_gres_ptr->type_cnt; i++) {
+		if (!node_gres_ptr->type_name[i] ||
+		    (node_gres_ptr->type_id[i] != job_gres_ptr->type_id))
+			continue;
+		gres_avail = node_gres_ptr->type_cnt_avail[i];
+		if (!use_total_gres) {
+			if (node_gres_ptr->type_cnt_alloc[i] >= gres_avail)
+				gres_avail = 0;
+			else
+				gres_avail -= node_gres_ptr->type_cnt_alloc[i];
+		}
+		if (min_gres_node > gres_avail)
+			return false;
+		break;
+	}
+
+	return true;
+}
+
+/*
+ * Copy one node's cores out of a core_bitmap spanning many nodes so they
+ * can be compared against the node's topo_core_bitmap a word at a time
+ * IN core_bitmap - cores available to the job
+ * IN core_start_bit - index into core_bitmap for this node's first core
+ * IN core_cnt - count of cores on this node
+ * RET bitmap of size core_cnt, caller must free
+ */
+static bitstr_t *_node_core_bitmap(bitstr_t *core_bitmap, int core_start_bit,
+				   int core_cnt)
+{
+	bitstr_t *node_core_bitmap;
+	int i;
+
+	if ((core_start_bit == 0) && (bit_size(core_bitmap) == core_cnt))
+		return bit_copy(core_bitmap);
+
+	node_core_bitmap = bit_alloc(core_cnt);
+	for (i = 0; i < core_cnt; i++) {
+		if (bit_test(core_bitmap, core_start_bit + i))
+			bit_set(node_core_bitmap, i);
+	}
+
+	return node_core_bitmap;
+}
+
 static void	_job_core_filter(void *job_gres_data, void *node_gres_data,
 				 bool use_total_gres, bitstr_t *core_bitmap,
 				 int core_start_bit, int core_end_bit,
@@ -6427,7 +6513,7 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 			  uint32_t job_id, char *node_name, char *gres_name,
 			  uint32_t plugin_id)
 {
-	int i, j, core_size, core_ctld, top_inx = -1;
+	int i, j, core_ctld, top_inx = -1;
 	uint64_t gres_avail = 0, gres_max = 0, gres_total, gres_tmp;
 	uint64_t min_gres_node = 0;
 	gres_job_state_t  *job_gres_ptr  = (gres_job_state_t *)  job_gres_data;
@@ -6437,6 +6523,7 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 	uint32_t core_cnt = 0;
 	bitstr_t *alloc_core_bitmap = NULL;
 	bitstr_t *avail_core_bitmap = NULL;
+	bitstr_t *node_core_bitmap = NULL;
 	bool shared_gres = _shared_gres(plugin_id);
 	bool use_busy_dev = false;
 
@@ -6451,11 +6538,11 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 	}
 
 	/* Determine minimum GRES count needed on this node */
-	if (job_gres_ptr->gres_per_job)
-		min_gres_node = 1;
-	min_gres_node = MAX(min_gres_node, job_gres_ptr->gres_per_node);
-	min_gres_node = MAX(min_gres_node, job_gres_ptr->gres_per_socket);
-	min_gres_node = MAX(min_gres_node, job_gres_ptr->gres_per_task);
+	min_gres_node = _job_min_gres_node(job_gres_ptr);
+
+	if (min_gres_node && node_gres_ptr->topo_cnt &&
+	    !_node_gres_cnt_test(job_gres_ptr, node_gres_ptr, use_total_gres))
+		return (uint32_t) 0;	/* insufficient GRES avail */
 
 	if (min_gres_node && node_gres_ptr->topo_cnt && *topo_set) {
 		/*
@@ -6471,6 +6558,9 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 			}
 			_validate_gres_node_cores(node_gres_ptr, core_ctld,
 						  node_name);
+			node_core_bitmap = _node_core_bitmap(core_bitmap,
+							     core_start_bit,
+							     core_ctld);
 		}
 		for (i = 0; i < node_gres_ptr->topo_cnt; i++) {
 			if (job_gres_ptr->type_name &&
@@ -6482,36 +6572,25 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 			    (node_gres_ptr->topo_gres_cnt_alloc[i] == 0))
 				continue;
 			if (!node_gres_ptr->topo_core_bitmap[i]) {
-				gres_avail += node_gres_ptr->
-					      topo_gres_cnt_avail[i];
-				if (!use_total_gres) {
-					gres_avail -= node_gres_ptr->
-						      topo_gres_cnt_alloc[i];
-				}
-				if (shared_gres)
-					gres_max = MAX(gres_max, gres_avail);
-				continue;
-			}
-			core_ctld = bit_size(node_gres_ptr->
-					     topo_core_bitmap[i]);
-			for (j = 0; j < core_ctld; j++) {
-				if (core_bitmap &&
-				    !bit_test(core_bitmap, core_start_bit + j))
-					continue;
-				if (!bit_test(node_gres_ptr->
-					      topo_core_bitmap[i], j))
+				;	/* No core restriction */
+			} else if (node_core_bitmap) {
+				if (!bit_overlap_any(node_core_bitmap,
+						     node_gres_ptr->
+						     topo_core_bitmap[i]))
 					continue; /* not avail for this gres */
-				gres_avail += node_gres_ptr->
-					      topo_gres_cnt_avail[i];
-				if (!use_total_gres) {
-					gres_avail -= node_gres_ptr->
-						      topo_gres_cnt_alloc[i];
-				}
-				if (shared_gres)
-					gres_max = MAX(gres_max, gres_avail);
-				break;
+			} else if (bit_ffs(node_gres_ptr->
+					   topo_core_bitmap[i]) == -1) {
+				continue;	/* not avail for this gres */
+			}
+			gres_avail += node_gres_ptr->topo_gres_cnt_avail[i];
+			if (!use_total_gres) {
+				gres_avail -= node_gres_ptr->
+					      topo_gres_cnt_alloc[i];
 			}
+			if (shared_gres)
+				gres_max = MAX(gres_max, gres_avail);
 		}
+		FREE_NULL_BITMAP(node_core_bitmap);
 		if (shared_gres)
 			gres_avail = gres_max;
 		if (min_gres_node > gres_avail)
@@ -6544,13 +6623,12 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 			}
 		}
 
-		alloc_core_bitmap = bit_alloc(core_ctld);
 		if (core_bitmap) {
-			for (j = 0; j < core_ctld; j++) {
-				if (bit_test(core_bitmap, core_start_bit + j))
-					bit_set(alloc_core_bitmap, j);
-			}
+			alloc_core_bitmap = _node_core_bitmap(core_bitmap,
+							      core_start_bit,
+							      core_ctld);
 		} else {
+			alloc_core_bitmap = bit_alloc(core_ctld);
 			bit_nset(alloc_core_bitmap, 0, core_ctld - 1);
 		}
 
@@ -6579,15 +6657,13 @@ static uint32_t _job_test(void *job_gres_data, void *node_gres_data,
 						 core_start_bit + 1;
 				continue;
 			}
-			core_size = bit_size(node_gres_ptr->topo_core_bitmap[i]);
-			for (j = 0; j < core_size; j++) {
-				if (core_bitmap &&
-				    !bit_test(core_bitmap, core_start_bit + j))
-					continue;
-				if (bit_test(node_gres_ptr->
-					     topo_core_bitmap[i], j)) {
-					cores_avail[i]++;
-				}
+			if (core_bitmap) {
+				cores_avail[i] = bit_overlap(avail_core_bitmap,
+							     node_gres_ptr->
+							     topo_core_bitmap[i]);
+			} else {
+				cores_avail[i] = bit_set_count(node_gres_ptr->
+							       topo_core_bitmap[i]);
 			}
 		}
 
@@ -6743,7 +6819,7 @@ extern void gres_plugin_job_core_filter(List job_gres_list, List node_gres_list,
 					char *node_name)
 {
 	int i;
-	ListIterator  job_gres_iter, node_gres_iter;
+	ListIterator  job_gres_iter;
 	gres_state_t *job_gres_ptr, *node_gres_ptr;
 
 	if ((job_gres_list == NULL) || (core_bitmap == NULL))
@@ -6758,13 +6834,8 @@ extern void gres_plugin_job_core_filter(List job_gres_list, List node_gres_list,
 	slurm_mutex_lock(&gres_context_lock);
 	job_gres_iter = list_iterator_create(job_gres_list);
 	while ((job_gres_ptr = (gres_state_t *) list_next(job_gres_iter))) {
-		node_gres_iter = list_iterator_create(node_gres_list);
-		while ((node_gres_ptr = (gres_state_t *)
-				list_next(node_gres_iter))) {
-			if (job_gres_ptr->plugin_id == node_gres_ptr->plugin_id)
-				break;
-		}
-		list_iterator_destroy(node_gres_iter);
+		node_gres_ptr = list_find_first(node_gres_list, _gres_find_id,
+						&job_gres_ptr->plugin_id);
 		if (node_gres_ptr == NULL) {
 			/* node lack resources required by the job */
 			bit_nclear(core_bitmap, core_start_bit, core_end_bit);
@@ -6811,7 +6882,7 @@ extern uint32_t gres_plugin_job_test(List job_gres_list, List node_gres_list,
 {
 	int i;
 	uint32_t core_cnt, tmp_cnt;
-	ListIterator job_gres_iter,  node_gres_iter;
+	ListIterator job_gres_iter;
 	gres_state_t *job_gres_ptr, *node_gres_ptr;
 	bool topo_set = false;
 
@@ -6826,13 +6897,8 @@ extern uint32_t gres_plugin_job_test(List job_gres_list, List node_gres_list,
 	slurm_mutex_lock(&gres_context_lock);
 	job_gres_iter = list_iterator_create(job_gres_list);
 	while ((job_gres_ptr = (gres_state_t *) list_next(job_gres_iter))) {
-		node_gres_iter = list_iterator_create(node_gres_list);
-		while ((node_gres_ptr = (gres_state_t *)
-				list_next(node_gres_iter))) {
-			if (job_gres_ptr->plugin_id == node_gres_ptr->plugin_id)
-				break;
-		}
-		list_iterator_destroy(node_gres_iter);
+		node_gres_ptr = list_find_first(node_gres_list, _gres_find_id,
+						&job_gres_ptr->plugin_id);
 		if (node_gres_ptr == NULL) {
 			/* node lack resources required by the job */
 			core_cnt = 0;
@@ -7447,13 +7513,8 @@ extern List gres_plugin_job_test2(List job_gres_list, List node_gres_list,
 	job_gres_iter = list_iterator_create(job_gres_list);
 	while ((job_gres_ptr = (gres_state_t *) list_next(job_gres_iter))) {
 		sock_gres_t *sock_gres = NULL;
-		node_gres_iter = list_iterator_create(node_gres_list);
-		while ((node_gres_ptr = (gres_state_t *)
-				list_next(node_gres_iter))) {
-			if (job_gres_ptr->plugin_id == node_gres_ptr->plugin_id)
-				break;
-		}
-		list_iterator_destroy(node_gres_iter);
+		node_gres_ptr = list_find_first(node_gres_list, _gres_find_id,
+						&job_gres_ptr->plugin_id);
 		if (node_gres_ptr == NULL) {
 			/* node lack GRES of type required by the job */
 			FREE_NULL_LIST(sock_gres_list);
@@ -7469,6 +7530,9 @@ extern List gres_plugin_job_test2(List job_gres_list, List node_gres_list,
 			local_s_p_n = NO_VAL;	/* No need to optimize socket */
 		if (core_bitmap && (bit_set_count(core_bitmap) == 0)) {
 			sock_gres = NULL;	/* No cores available */
+		} else if (!_node_gres_cnt_test(job_data_ptr, node_data_ptr,
+						use_total_gres)) {
+			sock_gres = NULL;	/* Insufficient GRES available */
 		} else if (node_data_ptr->topo_cnt) {
 			uint32_t alt_plugin_id = 0;
 			gres_node_state_t *alt_node_data_ptr = NULL;
@@ -263,6 +263,14 @@ typedef struct gres_step_state {
 	bitstr_t **gres_bit_alloc;	/* Used with GRES files */
 } gres_step_state_t;
 
+/* Generic gres data structure for adding to a list. Depending upon the
+ * context, gres_data points to gres_node_state_t, gres_job_state_t or
+ * gres_step_state_t */
+typedef struct gres_state {
+	uint32_t	plugin_id;
+	void		*gres_data;
+} gres_state_t;
+
 /* Per-socket GRES availability information for scheduling purposes */
 typedef struct sock_gres {	/* GRES availability by socket */
 	bitstr_t *bits_any_sock;/* Per-socket GRES bitmap of this name & type */
@@ -144,6 +144,9 @@ do {						\
 /* max number of ranges that will be processed between brackets */
 #define MAX_RANGES   (256*1024)    /* 256K ranks */
 
+/* hostlists with more ranges than this are searched through an index */
+#define HOSTLIST_INDEX_MIN	4
+
 /* size of internal hostname buffer (+ some slop), hostnames will probably
  * be truncated if longer than MAXHOSTNAMELEN */
 #ifndef MAXHOSTNAMELEN
@@ -182,6 +185,26 @@ struct hostrange_components {
 
 typedef struct hostrange_components *hostrange_t;
 
+/* An entry of the sorted range index of a hostlist */
+struct hostlist_index_entry {
+	hostrange_t hr;
+	int pos;		/* position of hr in the hostlist */
+	int offset;		/* number of hosts in the ranges before hr */
+	unsigned long max_hi;	/* highest hi of the entries up to this one
+				 * with the same prefix */
+};
+
+/*
+ * The ranges of a hostlist sorted by prefix and lowest suffix, so a host can
+ * be found with a binary search. It is built by the second lookup after the
+ * hostlist changed and dropped on any change.
+ */
+struct hostlist_index {
+	int cnt;
+	bool digit_prefix;	/* a range prefix ends with a digit */
+	struct hostlist_index_entry *entry;
+};
+
 /* The hostlist type: An array based list of hostrange_t's */
 struct hostlist {
 #ifndef NDEBUG
@@ -205,6 +228,11 @@ struct hostlist {
 	/* list of iterators */
 	struct hostlist_iterator *ilist;
 
+	/* sorted range index, NULL until built */
+	struct hostlist_index *index;
+
+	/* number of lookups since the last change */
+	int lookups;
 };
 
 
@@ -291,6 +319,7 @@ static bool _test_box(int *start, int *end, int dims);
 /* ------[ static function prototypes ]------ */
 
 static char * _next_tok(char *, char **);
+static int    _num_width(unsigned long);
 static int    _zero_padded(unsigned long, int);
 static int    _width_equiv(unsigned long, int *, unsigned long, int *);
 
@@ -317,7 +346,8 @@ static char *        hostrange_pop(hostrange_t);
 static char *        hostrange_shift(hostrange_t, int);
 static int           hostrange_join(hostrange_t, hostrange_t);
 static hostrange_t   hostrange_intersect(hostrange_t, hostrange_t);
-static int           hostrange_hn_within(hostrange_t, hostname_t, int);
+static int           hostrange_hn_within(hostrange_t, hostname_t, int,
+					 unsigned long *);
 static size_t        hostrange_to_string(hostrange_t hr, size_t, char *,
 					 char *, int);
 static size_t        hostrange_numstr(hostrange_t, size_t, char *, int);
@@ -337,14 +367,13 @@ static void        hostlist_collapse(hostlist_t hl);
 static hostlist_t _hostlist_create(const char *, char *, char *, int);
 static void        hostlist_shift_iterators(hostlist_t, int, int, int);
 static int        _attempt_range_join(hostlist_t, int);
+static void       _hostlist_index_free(hostlist_t);
 static int        _is_bracket_needed(hostlist_t, int);
 
 static hostlist_iterator_t hostlist_iterator_new(void);
 static void               _iterator_advance(hostlist_iterator_t);
 static void               _iterator_advance_range(hostlist_iterator_t);
 
-static int hostset_find_host(hostset_t, const char *);
-
 /* ------[ macros ]------ */
 
 #define LOCK_HOSTLIST(_hl)				\
@@ -423,13 +452,22 @@ bracket: 	open_bracket = strchr(parse, '[');
 
 
 /*
- * return the number of zeros needed to pad "num" to "width"
+ * return the number of decimal digits of "num"
  */
-static int _zero_padded(unsigned long num, int width)
+static int _num_width(unsigned long num)
 {
 	int n = 1;
 	while (num /= 10L)
 		n++;
+	return n;
+}
+
+/*
+ * return the number of zeros needed to pad "num" to "width"
+ */
+static int _zero_padded(unsigned long num, int width)
+{
+	int n = _num_width(num);
 	return (width > n) ? (width - n) : 0;
 }
 
@@ -980,11 +1018,17 @@ static hostrange_t hostrange_intersect(hostrange_t h1, hostrange_t h2)
 	return new;
 }
 
-/* return 1 if hostname hn is within the hostrange hr
+/* return 1 if hostname hn is within the hostrange hr and set *num to its
+ *          numeric suffix as read for hr
  *        0 if not.
  */
-static int hostrange_hn_within(hostrange_t hr, hostname_t hn, int dims)
+static int hostrange_hn_within(hostrange_t hr, hostname_t hn, int dims,
+			       unsigned long *num)
 {
+	unsigned long n;
+	char *suffix, *p;
+	int width;
+
 	if (hr->singlehost) {
 		/*
 		 *  If the current hostrange [hr] is a `singlehost' (no valid
@@ -995,9 +1039,10 @@ static int hostrange_hn_within(hostrange_t hr, hostname_t hn, int dims)
 		 *   which case we return true. Otherwise, there is no
 		 *   possibility that [hn] matches [hr].
 		 */
-		if (strcmp (hn->hostname, hr->prefix) == 0)
+		if (strcmp (hn->hostname, hr->prefix) == 0) {
+			*num = hr->lo;
 			return 1;
-		else
+		} else
 			return 0;
 	}
 
@@ -1009,12 +1054,15 @@ static int hostrange_hn_within(hostrange_t hr, hostname_t hn, int dims)
 	if (!hostname_suffix_is_valid (hn))
 		return 0;
 
+	suffix = hn->suffix;
+	n = hn->num;
+
 	/*
 	 *  If hostrange and hostname prefixes don't match, then
 	 *   there is way the hostname falls within the range [hr].
 	 */
 	if (strcmp(hr->prefix, hn->prefix) != 0) {
-		int len1, len2, ldiff;
+		int len1;
 
 		if (!dims)
 			dims = slurmdb_setup_cluster_name_dims();
@@ -1032,55 +1080,37 @@ static int hostrange_hn_within(hostrange_t hr, hostname_t hn, int dims)
 		 * chance for comparison.
 		 */
 
-		/* First see if by taking some of the leading digits of the
-		 * suffix of hn and moving it to the end of the prefix if it
-		 * would be a match.
+		/* See if splitting the hostname where the prefix of hr ends
+		 * leaves that prefix and a suffix of digits. hn itself is
+		 * not changed, so every range sees the hostname as given.
 		 */
-		len1  = strlen(hr->prefix);
-		len2  = strlen(hn->prefix);
-
-		/* These are definitely different */
-		if (len1 == len2)
-			return 0;
-
-		ldiff = len1 - len2;
-
-		if (ldiff > 0 && (strlen(hn->suffix) >= ldiff)) {
-			/* Tack on ldiff of the hostname's suffix to
-			 * that of it's prefix */
-			hn->prefix = realloc(hn->prefix, len2+ldiff+1);
-			strncat(hn->prefix, hn->suffix, ldiff);
-		} else if (ldiff < 0) {
-			/* strip off the ldiff here */
-			hn->prefix[len2+ldiff] = '\0';
-		} else
+		len1 = strlen(hr->prefix);
+		if ((len1 >= strlen(hn->hostname)) ||
+		    strncmp(hr->prefix, hn->hostname, len1))
 			return 0;
+		suffix = hn->hostname + len1;
+		for (p = suffix; *p; p++) {
+			if (!isdigit((int) *p))
+				return 0;
+		}
 
-		/* Now adjust the suffix of the hostname object. */
-		hn->suffix += ldiff;
-		/* And the numeric representation just in case
-		 * whatever we just tacked on to the prefix
-		 * had something other than 0 in it.
-		 *
-		 * Since we are only going through this logic for
+		/* Since we are only going through this logic for
 		 * single dimension systems we will always use
 		 * the base 10.
 		 */
-		hn->num = strtoul(hn->suffix, NULL, 10);
-
-		/* Now compare them and see if they match */
-		if (strcmp(hr->prefix, hn->prefix) != 0)
-			return 0;
+		n = strtoul(suffix, NULL, 10);
 	}
 
 	/*
 	 *  Finally, check whether [hn], with a valid numeric suffix,
 	 *   falls within the range of [hr].
 	 */
-	if (hn->num <= hr->hi && hn->num >= hr->lo) {
-		int width = hostname_suffix_width(hn);
-		int num = hn->num;
-		return (_width_equiv(hr->lo, &hr->width, num, &width));
+	if (n <= hr->hi && n >= hr->lo) {
+		width = strlen(suffix);
+		if (_width_equiv(hr->lo, &hr->width, n, &width)) {
+			*num = n;
+			return 1;
+		}
 	}
 
 	return 0;
@@ -1231,6 +1261,8 @@ static hostlist_t hostlist_new(void)
 	new->nranges = 0;
 	new->nhosts = 0;
 	new->ilist = NULL;
+	new->index = NULL;
+	new->lookups = 0;
 	return new;
 
 fail2:
@@ -1287,6 +1319,7 @@ static int hostlist_push_range(hostlist_t hl, hostrange_t hr)
 
 	assert(hr != NULL);
 	LOCK_HOSTLIST(hl);
+	_hostlist_index_free(hl);
 
 	tail = (hl->nranges > 0) ? hl->hr[hl->nranges-1] : hl->hr[0];
 
@@ -1350,6 +1383,8 @@ static int hostlist_insert_range(hostlist_t hl, hostrange_t hr, int n)
 	if (hl->size == hl->nranges && !hostlist_expand(hl))
 		return 0;
 
+	_hostlist_index_free(hl);
+
 	/* copy new hostrange into slot "n" in array */
 	tmp = hl->hr[n];
 	hl->hr[n] = hostrange_copy(hr);
@@ -1383,6 +1418,7 @@ static void hostlist_delete_range(hostlist_t hl, int n)
 	assert(hl->magic == HOSTLIST_MAGIC);
 	assert((n < hl->nranges) && (n >= 0));
 
+	_hostlist_index_free(hl);
 	old = hl->hr[n];
 	for (i = n; i < hl->nranges - 1; i++)
 		hl->hr[i] = hl->hr[i + 1];
@@ -1917,6 +1953,7 @@ void hostlist_destroy(hostlist_t hl)
 	for (i = 0; i < hl->nranges; i++)
 		hostrange_destroy(hl->hr[i]);
 	free(hl->hr);
+	_hostlist_index_free(hl);
 	assert((hl->magic = 0x1));
 	UNLOCK_HOSTLIST(hl);
 	slurm_mutex_destroy(&hl->mutex);
@@ -2003,6 +2040,7 @@ char *hostlist_pop(hostlist_t hl)
 	LOCK_HOSTLIST(hl);
 	if (hl->nhosts > 0) {
 		hostrange_t hr = hl->hr[hl->nranges - 1];
+		_hostlist_index_free(hl);
 		host = hostrange_pop(hr);
 		hl->nhosts--;
 		if (hostrange_empty(hr)) {
@@ -2056,6 +2094,7 @@ char *hostlist_shift_dims(hostlist_t hl, int dims)
 	if (hl->nhosts > 0) {
 		hostrange_t hr = hl->hr[0];
 
+		_hostlist_index_free(hl);
 		host = hostrange_shift(hr, dims);
 		hl->nhosts--;
 
@@ -2091,6 +2130,7 @@ char *hostlist_pop_range(hostlist_t hl)
 		UNLOCK_HOSTLIST(hl);
 		return NULL;
 	}
+	_hostlist_index_free(hl);
 
 	i = hl->nranges - 2;
 	tail = hl->hr[hl->nranges - 1];
@@ -2132,6 +2172,7 @@ int hostlist_pop_range_values(
 	tail = hl->hr[i];
 
 	if (tail && i < hl->nranges) {
+		_hostlist_index_free(hl);
 		*lo = tail->lo;
 		*hi = tail->hi;
 		hl->nhosts -= hostrange_count(tail);
@@ -2145,6 +2186,30 @@ int hostlist_pop_range_values(
 	return 1;
 }
 
+char *hostlist_nth_range_values(hostlist_t hl, int n, unsigned long *lo,
+				unsigned long *hi, int *width)
+{
+	hostrange_t hr;
+	char *prefix = NULL;
+
+	if (!hl || !lo || !hi || !width)
+		return NULL;
+
+	LOCK_HOSTLIST(hl);
+	if ((n >= 0) && (n < hl->nranges)) {
+		hr = hl->hr[n];
+		prefix = strdup(hr->prefix);
+		if (!prefix)
+			out_of_memory("hostlist_nth_range_values");
+		*lo = hr->lo;
+		*hi = hr->hi;
+		*width = hr->singlehost ? -1 : hr->width;
+	}
+	UNLOCK_HOSTLIST(hl);
+
+	return prefix;
+}
+
 char *hostlist_shift_range(hostlist_t hl)
 {
 	int i;
@@ -2163,6 +2228,7 @@ char *hostlist_shift_range(hostlist_t hl)
 		UNLOCK_HOSTLIST(hl);
 		return NULL;
 	}
+	_hostlist_index_free(hl);
 
 	i = 0;
 	do {
@@ -2291,6 +2357,7 @@ int hostlist_delete_nth(hostlist_t hl, int n)
 		return -1;
 	LOCK_HOSTLIST(hl);
 	assert(n >= 0 && n <= hl->nhosts);
+	_hostlist_index_free(hl);
 
 	count = 0;
 
@@ -2334,9 +2401,170 @@ int hostlist_count(hostlist_t hl)
 	return retval;
 }
 
-int hostlist_find_dims(hostlist_t hl, const char *hostname, int dims)
+/* ----[ hostlist index functions ]---- */
+
+/* Drop the range index of hl, called whenever the ranges of hl change.
+ * Assumes that the hl lock is already held.
+ */
+static void _hostlist_index_free(hostlist_t hl)
+{
+	hl->lookups = 0;
+	if (!hl->index)
+		return;
+	free(hl->index->entry);
+	free(hl->index);
+	hl->index = NULL;
+}
+
+/* Order index entries by singlehost, prefix, lowest suffix and position */
+static int _index_entry_cmp(const void *a, const void *b)
+{
+	const struct hostlist_index_entry *e1 = a, *e2 = b;
+	int retval;
+
+	if (e1->hr->singlehost != e2->hr->singlehost)
+		return e1->hr->singlehost - e2->hr->singlehost;
+	if ((retval = strcmp(e1->hr->prefix, e2->hr->prefix)))
+		return retval;
+	if (e1->hr->lo != e2->hr->lo)
+		return (e1->hr->lo < e2->hr->lo) ? -1 : 1;
+	return e1->pos - e2->pos;
+}
+
+/* Return the range index of hl, building it if needed.
+ * Assumes that the hl lock is already held.
+ */
+static struct hostlist_index *_hostlist_index_get(hostlist_t hl)
+{
+	struct hostlist_index *index;
+	struct hostlist_index_entry *e;
+	int i, len, offset = 0;
+
+	if (hl->index)
+		return hl->index;
+
+	if (!(index = malloc(sizeof(*index))) ||
+	    !(index->entry = malloc(hl->nranges * sizeof(*index->entry))))
+		out_of_memory("hostlist index");
+	index->cnt = hl->nranges;
+	index->digit_prefix = false;
+
+	for (i = 0; i < hl->nranges; i++) {
+		e = &index->entry[i];
+		e->hr = hl->hr[i];
+		e->pos = i;
+		e->offset = offset;
+		offset += hostrange_count(e->hr);
+		if (!e->hr->singlehost && (len = strlen(e->hr->prefix)) &&
+		    isdigit((int)e->hr->prefix[len - 1]))
+			index->digit_prefix = true;
+	}
+	qsort(index->entry, index->cnt, sizeof(*index->entry),
+	      _index_entry_cmp);
+
+	for (i = 0; i < index->cnt; i++) {
+		e = &index->entry[i];
+		e->max_hi = e->hr->hi;
+		if (i && (e[-1].hr->singlehost == e->hr->singlehost) &&
+		    !strcmp(e[-1].hr->prefix, e->hr->prefix) &&
+		    (e[-1].max_hi > e->max_hi))
+			e->max_hi = e[-1].max_hi;
+	}
+
+	hl->index = index;
+	return index;
+}
+
+/* Find the host made of prefix and num, printed at the given width, through
+ * the range index of hl. If single is set, prefix is the whole hostname.
+ * Returns the position of the host within hl, or -1 if it is not found.
+ * Assumes that the hl lock is already held.
+ */
+static int _hostlist_index_find(hostlist_t hl, int single, const char *prefix,
+				unsigned long num, int width)
+{
+	struct hostlist_index *index = _hostlist_index_get(hl);
+	struct hostlist_index_entry *e, *found = NULL;
+	int lo = 0, hi = index->cnt, mid, cmp, wr, wn;
+
+	/* find the first entry sorting after (single, prefix, num) */
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		e = &index->entry[mid];
+		if (e->hr->singlehost != single)
+			cmp = e->hr->singlehost - single;
+		else if (!(cmp = strcmp(e->hr->prefix, prefix)) && !single)
+			cmp = (e->hr->lo > num) ? 1 : 0;
+		if (cmp > 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	/* every entry before it with the same prefix starts at or below num,
+	 * go back until none of them can reach up to num */
+	for (e = &index->entry[lo - 1]; e >= index->entry; e--) {
+		if ((e->hr->singlehost != single) ||
+		    strcmp(e->hr->prefix, prefix) || (e->max_hi < num))
+			break;
+		if (found && (found->pos < e->pos))
+			continue;
+		if (single) {
+			found = e;
+			continue;
+		}
+		wr = e->hr->width;
+		wn = width;
+		if ((num <= e->hr->hi) && _width_equiv(e->hr->lo, &wr, num, &wn))
+			found = e;
+	}
+
+	if (!found)
+		return -1;
+	if (single)
+		return found->offset;
+	return found->offset + num - found->hr->lo;
+}
+
+/* Return the position of hostname hn within hl, or -1 if it is not found.
+ * Assumes that the hl lock is already held.
+ */
+static int _hostlist_find_hn(hostlist_t hl, hostname_t hn, int dims)
 {
 	int i, count, ret = -1;
+	unsigned long num;
+
+	/*
+	 * The first lookup after a change scans the ranges, as many lists
+	 * are only searched once. Later ones go through the range index.
+	 * Range prefixes ending with leading zeros of the suffix
+	 * (i.e. nid0000[2-7]) can match a host in several ways, the first of
+	 * which in list order is only found by the linear scan.
+	 */
+	if ((hl->lookups++ > 0) && (hl->nranges > HOSTLIST_INDEX_MIN) &&
+	    ((dims != 1) || !_hostlist_index_get(hl)->digit_prefix)) {
+		if (hostname_suffix_is_valid(hn))
+			ret = _hostlist_index_find(hl, 0, hn->prefix, hn->num,
+						   hostname_suffix_width(hn));
+		if (ret == -1)
+			ret = _hostlist_index_find(hl, 1, hn->hostname, 0, 0);
+		return ret;
+	}
+
+	for (i = 0, count = 0; i < hl->nranges; i++) {
+		if (hostrange_hn_within(hl->hr[i], hn, dims, &num)) {
+			ret = count + num - hl->hr[i]->lo;
+			break;
+		} else
+			count += hostrange_count(hl->hr[i]);
+	}
+
+	return ret;
+}
+
+int hostlist_find_dims(hostlist_t hl, const char *hostname, int dims)
+{
+	int ret;
 	hostname_t hn;
 
 	if (!hostname || !hl)
@@ -2348,20 +2576,9 @@ int hostlist_find_dims(hostlist_t hl, const char *hostname, int dims)
 	hn = hostname_create_dims(hostname, dims);
 
 	LOCK_HOSTLIST(hl);
-
-	for (i = 0, count = 0; i < hl->nranges; i++) {
-		if (hostrange_hn_within(hl->hr[i], hn, dims)) {
-			if (hostname_suffix_is_valid(hn))
-				ret = count + hn->num - hl->hr[i]->lo;
-			else
-				ret = count;
-			goto done;
-		} else
-			count += hostrange_count(hl->hr[i]);
-	}
-
-done:
+	ret = _hostlist_find_hn(hl, hn, dims);
 	UNLOCK_HOSTLIST(hl);
+
 	hostname_destroy(hn);
 	return ret;
 }
@@ -2393,6 +2610,7 @@ void hostlist_sort(hostlist_t hl)
 		return;
 	}
 
+	_hostlist_index_free(hl);
 	qsort(hl->hr, hl->nranges, sizeof(hostrange_t), &_cmp);
 
 	/* reset all iterators */
@@ -2422,7 +2640,7 @@ static void hostlist_collapse(hostlist_t hl)
 		    hostrange_prefix_cmp(hprev, hnext) == 0 &&
 		    hostrange_width_combine(hprev, hnext)) {
 			hprev->hi = hnext->hi;
-			hostlist_delete_range(hl, i);
+			hostlist_delete_range(hl, i);	/* drops the index */
 		}
 	}
 	UNLOCK_HOSTLIST(hl);
@@ -2447,6 +2665,7 @@ static void hostlist_coalesce(hostlist_t hl)
 			hostrange_t hnext = hl->hr[i];
 			j = i;
 
+			_hostlist_index_free(hl);
 			if (new->hi < hprev->hi)
 				hnext->hi = hprev->hi;
 
@@ -2509,6 +2728,7 @@ void hostlist_uniq(hostlist_t hl)
 		UNLOCK_HOSTLIST(hl);
 		return;
 	}
+	_hostlist_index_free(hl);
 	qsort(hl->hr, hl->nranges, sizeof(hostrange_t), &_cmp);
 
 	while (i < hl->nranges) {
@@ -3429,6 +3649,7 @@ int hostlist_remove(hostlist_iterator_t i)
 	assert(i != NULL);
 	assert(i->magic == HOSTLIST_MAGIC);
 	LOCK_HOSTLIST(i->hl);
+	_hostlist_index_free(i->hl);
 	new = hostrange_delete_host(i->hr, i->hr->lo + i->depth);
 	if (new) {
 		hostlist_insert_range(i->hl, new, i->idx + 1);
@@ -3499,7 +3720,7 @@ void hostset_destroy(hostset_t set)
  */
 static int hostset_insert_range(hostset_t set, hostrange_t hr)
 {
-	int i = 0;
+	int i = 0, lo, hi, mid;
 	int inserted = 0;
 	int nhosts = 0;
 	int ndups = 0;
@@ -3510,9 +3731,25 @@ static int hostset_insert_range(hostset_t set, hostrange_t hr)
 	if (hl->size == hl->nranges && !hostlist_expand(hl))
 		return 0;
 
+	_hostlist_index_free(hl);
+
 	nhosts = hostrange_count(hr);
 
-	for (i = 0; i < hl->nranges; i++) {
+	/* the ranges of a hostset are sorted by prefix, skip the ones with a
+	 * lower prefix. hostrange_cmp() of ranges with the same prefix may
+	 * adjust their widths and is not a total order, so those are still
+	 * compared one by one from the first of them, as before. */
+	lo = 0;
+	hi = hl->nranges;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (hostrange_prefix_cmp(hr, hl->hr[mid]) <= 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	for (i = lo; i < hl->nranges; i++) {
 		if (hostrange_cmp(hr, hl->hr[i]) <= 0) {
 
 			if ((ndups = hostrange_join(hr, hl->hr[i])) >= 0)
@@ -3521,14 +3758,15 @@ static int hostset_insert_range(hostset_t set, hostrange_t hr)
 				ndups = 0;
 
 			hostlist_insert_range(hl, hr, i);
+			hl->nhosts += nhosts - ndups;
 
-			/* now attempt to join hr[i] and hr[i-1] */
+			/* now attempt to join hr[i] and hr[i-1],
+			 * _attempt_range_join() adjusts nhosts itself */
 			if (i > 0) {
 				int m;
 				if ((m = _attempt_range_join(hl, i)) > 0)
 					ndups += m;
 			}
-			hl->nhosts += nhosts - ndups;
 			inserted = 1;
 			break;
 		}
@@ -3566,48 +3804,83 @@ int hostset_insert(hostset_t set, const char *hosts)
 }
 
 
-/* linear search through N ranges for hostname "host"
- * */
-static int hostset_find_host(hostset_t set, const char *host)
+/* Count the hosts of hl found in set, stopping at the first one if any_only
+ * is set.
+ */
+static int _hostset_find_hostlist(hostset_t set, hostlist_t hl, int any_only)
 {
-	int i;
-	int retval = 0;
+	int i, j, len, width, nfound = 0;
+	int dims = slurmdb_setup_cluster_name_dims();
+	unsigned long num;
+	hostrange_t hr;
 	hostname_t hn;
+	char *hostname;
+
 	LOCK_HOSTLIST(set->hl);
-	hn = hostname_create(host);
-	for (i = 0; i < set->hl->nranges; i++) {
+	set->hl->lookups++;
+	if ((dims == 1) && (set->hl->nranges > HOSTLIST_INDEX_MIN) &&
+	    !_hostlist_index_get(set->hl)->digit_prefix) {
+		/* look the ranges of hl up without printing their hosts,
+		 * keeping only the others in hl */
+		LOCK_HOSTLIST(hl);
+		_hostlist_index_free(hl);
+		for (i = 0, j = 0; i < hl->nranges; i++) {
+			hr = hl->hr[i];
+			hl->hr[i] = NULL;
+			len = strlen(hr->prefix);
+			if ((any_only && nfound) || hr->singlehost || !len ||
+			    isdigit((int)hr->prefix[len - 1])) {
+				/* names that do not parse back into this
+				 * range are looked up one by one below */
+				hl->hr[j++] = hr;
+				continue;
+			}
+			for (num = hr->lo; num <= hr->hi; num++) {
+				/* width of the suffix as printed */
+				width = MAX(hr->width, _num_width(num));
+				if (_hostlist_index_find(set->hl, 0,
+							 hr->prefix, num,
+							 width) < 0)
+					continue;
+				nfound++;
+				if (any_only)
+					break;
+			}
+			hl->nhosts -= hostrange_count(hr);
+			hostrange_destroy(hr);
+		}
+		hl->nranges = j;
+		UNLOCK_HOSTLIST(hl);
+	}
+
+	while ((!any_only || !nfound) &&
+	       ((hostname = hostlist_pop(hl)) != NULL)) {
 		/*
 		 * FIXME: THIS WILL NOT ALWAYS WORK CORRECTLY IF CALLED FROM A
 		 * LOCATION THAT COULD HAVE DIFFERENT DIMENSIONS
 		 * (i.e. slurmdbd).
 		 */
-		if (hostrange_hn_within(set->hl->hr[i], hn, 0)) {
-			retval = 1;
-			goto done;
-		}
+		hn = hostname_create(hostname);
+		if (_hostlist_find_hn(set->hl, hn, dims) >= 0)
+			nfound++;
+		hostname_destroy(hn);
+		free(hostname);
 	}
-done:
 	UNLOCK_HOSTLIST(set->hl);
-	hostname_destroy(hn);
-	return retval;
+
+	return nfound;
 }
 
 int hostset_intersects(hostset_t set, const char *hosts)
 {
 	int retval = 0;
 	hostlist_t hl;
-	char *hostname;
 
 	assert(set->hl->magic == HOSTLIST_MAGIC);
 
-	hl = hostlist_create(hosts);
-	while ((hostname = hostlist_pop(hl)) != NULL) {
-		retval += hostset_find_host(set, hostname);
-		free(hostname);
-		if (retval)
-			break;
-	}
-
+	if (!(hl = hostlist_create(hosts)))
+		return (0);
+	retval = _hostset_find_hostlist(set, hl, 1);
 	hostlist_destroy(hl);
 
 	return retval;
@@ -3617,20 +3890,13 @@ int hostset_within(hostset_t set, const char *hosts)
 {
 	int nhosts, nfound;
 	hostlist_t hl;
-	char *hostname;
 
 	assert(set->hl->magic == HOSTLIST_MAGIC);
 
 	if (!(hl = hostlist_create(hosts)))
 		return (0);
 	nhosts = hostlist_count(hl);
-	nfound = 0;
-
-	while ((hostname = hostlist_pop(hl)) != NULL) {
-		nfound += hostset_find_host(set, hostname);
-		free(hostname);
-	}
-
+	nfound = _hostset_find_hostlist(set, hl, 0);
 	hostlist_destroy(hl);
 
 	return (nhosts == nfound);
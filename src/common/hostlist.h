@@ -244,6 +244,20 @@ char * hostlist_pop_range(hostlist_t hl);
 int hostlist_pop_range_values(
 	hostlist_t hl, unsigned long *lo, unsigned long *hi);
 
+/* hostlist_nth_range_values():
+ *
+ * Return the prefix of the range n of hostlist hl and fill in lo, hi and
+ * width with the values of the range, leaving hl unchanged. The hosts of
+ * the range are the prefix followed by lo through hi zero padded to width
+ * digits. width is set to -1 for a host without numeric suffix, in which
+ * case the prefix is the host name.
+ * Returns NULL if n is not a valid range index.
+ *
+ * Caller is responsible for freeing returned memory.
+ */
+char *hostlist_nth_range_values(hostlist_t hl, int n, unsigned long *lo,
+				unsigned long *hi, int *width);
+
 /* hostlist_shift_range():
  *
  * Shift the first bracketed hostlist (improperly: range) off the
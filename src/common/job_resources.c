@@ -231,6 +231,7 @@ extern int reset_node_bitmap(void *void_job_ptr)
 		return SLURM_SUCCESS;
 
 	FREE_NULL_BITMAP(job_resrcs_ptr->node_bitmap);
+	free_job_resources_index(job_resrcs_ptr);
 
 	if (job_resrcs_ptr->nodes &&
 	    (node_name2bitmap(job_resrcs_ptr->nodes, false,
@@ -420,6 +421,7 @@ extern void free_job_resources(job_resources_t **job_resrcs_pptr)
 		xfree(job_resrcs_ptr->nodes);
 		xfree(job_resrcs_ptr->sock_core_rep_count);
 		xfree(job_resrcs_ptr->sockets_per_node);
+		free_job_resources_index(job_resrcs_ptr);
 		xfree(job_resrcs_ptr->tasks_per_node);
 		xfree(job_resrcs_ptr);
 		*job_resrcs_pptr = NULL;
@@ -1154,6 +1156,7 @@ extern int job_resources_or(job_resources_t *job_resrcs1_ptr,
 	}
 
 	/* Update data structure fields as needed */
+	free_job_resources_index(job_resrcs1_ptr);
 	job_resrcs1_ptr->nhosts = node_inx + 1;
 	bit_free(job_resrcs1_ptr->core_bitmap);
 	job_resrcs1_ptr->core_bitmap = job_resrcs_new->core_bitmap;
@@ -1275,6 +1278,8 @@ extern int extract_job_resources_node(job_resources_t *job, uint32_t node_id)
 
 	xassert(job);
 
+	free_job_resources_index(job);
+
 	/* Modify core/socket counter arrays to remove this node */
 	host_cnt = job->nhosts;
 	for (i = 0; i < job->nhosts; i++) {
@@ -1485,6 +1490,95 @@ extern int get_job_resources_cpus(job_resources_t *job_resrcs_ptr,
 	return (int) job_resrcs_ptr->cpus[node_id];
 }
 
+extern job_resources_index_t *get_job_resources_index(
+	job_resources_t *job_resrcs_ptr)
+{
+	job_resources_index_t *index = job_resrcs_ptr->step_index;
+	uint32_t bit_inx = 0, node_id = 0, rep;
+	int i, n;
+
+	if (index && (index->nhosts == job_resrcs_ptr->nhosts))
+		return index;
+	free_job_resources_index(job_resrcs_ptr);
+
+	if (!job_resrcs_ptr->nhosts || !job_resrcs_ptr->cpus ||
+	    !job_resrcs_ptr->cpus_used || !job_resrcs_ptr->node_bitmap ||
+	    !job_resrcs_ptr->sock_core_rep_count ||
+	    !job_resrcs_ptr->sockets_per_node ||
+	    !job_resrcs_ptr->cores_per_socket)
+		return NULL;
+
+	index = xmalloc(sizeof(job_resources_index_t));
+	index->nhosts = job_resrcs_ptr->nhosts;
+	index->core_offset = xcalloc(index->nhosts, sizeof(uint32_t));
+	index->cores = xcalloc(index->nhosts, sizeof(uint16_t));
+	index->node_inx = xcalloc(index->nhosts, sizeof(uint32_t));
+	index->sockets = xcalloc(index->nhosts, sizeof(uint16_t));
+	index->node_free = bit_alloc(index->nhosts);
+	job_resrcs_ptr->step_index = index;
+
+	for (i = 0; node_id < index->nhosts; i++) {
+		if (job_resrcs_ptr->sock_core_rep_count[i] == 0) {
+			error("%s: sock_core_rep_count=0", __func__);
+			break;
+		}
+		for (rep = 0; (rep < job_resrcs_ptr->sock_core_rep_count[i]) &&
+			      (node_id < index->nhosts); rep++, node_id++) {
+			index->core_offset[node_id] = bit_inx;
+			index->cores[node_id] =
+				job_resrcs_ptr->cores_per_socket[i];
+			index->sockets[node_id] =
+				job_resrcs_ptr->sockets_per_node[i];
+			bit_inx += job_resrcs_ptr->cores_per_socket[i] *
+				   job_resrcs_ptr->sockets_per_node[i];
+		}
+	}
+	if (node_id < index->nhosts) {
+		free_job_resources_index(job_resrcs_ptr);
+		return NULL;
+	}
+
+	for (n = bit_ffs(job_resrcs_ptr->node_bitmap), node_id = 0;
+	     (n >= 0) && (node_id < index->nhosts);
+	     n = bit_ffs_from_bit(job_resrcs_ptr->node_bitmap, n + 1)) {
+		index->node_inx[node_id] = n;
+		if (job_resrcs_ptr->cpus_used[node_id] <
+		    job_resrcs_ptr->cpus[node_id])
+			bit_set(index->node_free, node_id);
+		node_id++;
+	}
+
+	return index;
+}
+
+extern void update_job_resources_index(job_resources_t *job_resrcs_ptr,
+				       uint32_t node_id)
+{
+	job_resources_index_t *index = job_resrcs_ptr->step_index;
+
+	if (!index || (node_id >= index->nhosts))
+		return;
+	if (job_resrcs_ptr->cpus_used[node_id] < job_resrcs_ptr->cpus[node_id])
+		bit_set(index->node_free, node_id);
+	else
+		bit_clear(index->node_free, node_id);
+}
+
+extern void free_job_resources_index(job_resources_t *job_resrcs_ptr)
+{
+	job_resources_index_t *index = job_resrcs_ptr->step_index;
+
+	if (!index)
+		return;
+	xfree(index->core_offset);
+	xfree(index->cores);
+	xfree(index->node_inx);
+	xfree(index->sockets);
+	FREE_NULL_BITMAP(index->node_free);
+	xfree(index);
+	job_resrcs_ptr->step_index = NULL;
+}
+
 /*
  * Test if job can fit into the given full-length core_bitmap
  * IN job_resrcs_ptr - resources allocated to a job
@@ -81,6 +81,8 @@
  * sockets_per_node	- Count of sockets on this node, build by
  *			  build_job_resources() and ensures consistent
  *			  interpretation of core_bitmap
+ * step_index		- Index of resources for placing job steps, built
+ *			  by get_job_resources_index(). Not packed or copied.
  * tasks_per_node	- Expected tasks to launch per node. Currently used only
  *			  by cons_tres for tres_per_task support at resource
  *			  allocation time. No need to save/restore or pack.
@@ -103,6 +105,29 @@
  * unchanged, but cpus, cpus_used, cpus_array_*, and memory_used will be 
  * updated (e.g. cpus and mem_used on that node cleared).
  */
+/*
+ * Per node view of a job's resources for placing job steps, so that a step
+ * on a few nodes of a large allocation costs about as much as on a small one.
+ * Built on first use and kept up to date by update_job_resources_index()
+ * as steps allocate and release CPUs. Arrays are indexed by the node's
+ * position in the job (node_id).
+ *
+ * core_offset	- Offset of the node's first core in core_bitmap
+ * cores	- Cores per socket of the node
+ * node_free	- Bitmap of nodes with cpus_used < cpus, nhosts bits
+ * node_inx	- Index of the node in the node table
+ * nhosts	- nhosts of the job_resources when built
+ * sockets	- Sockets of the node
+ */
+typedef struct job_resources_index {
+	uint32_t *core_offset;
+	uint16_t *cores;
+	bitstr_t *node_free;
+	uint32_t *node_inx;
+	uint32_t  nhosts;
+	uint16_t *sockets;
+} job_resources_index_t;
+
 struct job_resources {
 	bitstr_t *core_bitmap;
 	bitstr_t *core_bitmap_used;
@@ -121,6 +146,7 @@ struct job_resources {
 	uint32_t  ncpus;
 	uint32_t *sock_core_rep_count;
 	uint16_t *sockets_per_node;
+	job_resources_index_t *step_index;
 	uint16_t *tasks_per_node;
 	uint8_t   whole_node;
 };
@@ -280,6 +306,20 @@ extern int get_job_resources_cnt(job_resources_t *job_resrcs_ptr,
 extern int get_job_resources_cpus(job_resources_t *job_resrcs_ptr,
 				  uint32_t node_id);
 
+/*
+ * Return the step placement index of a job's resources, building it if
+ * needed. NULL if the job_resources lack the required arrays.
+ */
+extern job_resources_index_t *get_job_resources_index(
+	job_resources_t *job_resrcs_ptr);
+
+/* Record in the index, if any, a change of cpus_used for node_id */
+extern void update_job_resources_index(job_resources_t *job_resrcs_ptr,
+				       uint32_t node_id);
+
+/* Discard the index, to be rebuilt after the job's resources change shape */
+extern void free_job_resources_index(job_resources_t *job_resrcs_ptr);
+
 /*
  * Test if job can fit into the given full-length core_bitmap
  * IN job_resrcs_ptr - resources allocated to a job
@@ -70,6 +70,7 @@
 #include "src/common/fd.h"
 #include "src/common/log.h"
 #include "src/common/macros.h"
+#include "src/common/ring_queue.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_time.h"
 #include "src/common/xmalloc.h"
@@ -82,6 +83,9 @@
 
 #define NAMELEN 16
 
+/* Number of messages the asynchronous log writer can be behind */
+#define LOG_ASYNC_QUEUE_SIZE	16384
+
 #define LOG_MACRO(level, sched, fmt) {				\
 	if ((level <= highest_log_level) ||			\
 	    (sched && (level <= highest_sched_log_level))) {	\
@@ -104,6 +108,7 @@ strong_alias(log_fini,		slurm_log_fini);
 strong_alias(log_alter,		slurm_log_alter);
 strong_alias(log_alter_with_fp, slurm_log_alter_with_fp);
 strong_alias(log_set_fpfx,	slurm_log_set_fpfx);
+strong_alias(log_set_async,	slurm_log_set_async);
 strong_alias(log_fp,		slurm_log_fp);
 strong_alias(log_oom,		slurm_log_oom);
 strong_alias(log_has_data,	slurm_log_has_data);
@@ -135,6 +140,17 @@ typedef struct {
 	uint64_t debug_flags;
 }	log_t;
 
+/*
+** message queued for the asynchronous log writer
+*/
+typedef struct {
+	bool main;		/* write to the logfile */
+	bool sched;		/* write to the scheduler logfile */
+	char *pfx;		/* level prefix, a string constant */
+	char *stamp;		/* "[timestamp]" taken by the caller */
+	char *msg;
+}	log_async_rec_t;
+
 char *slurm_prog_name = NULL;
 
 /* static variables */
@@ -145,6 +161,15 @@ static log_t            *sched_log = NULL;
 static volatile log_level_t highest_log_level = LOG_LEVEL_END;
 static volatile log_level_t highest_sched_log_level = LOG_LEVEL_QUIET;
 
+/* asynchronous logging, see log_set_async() */
+static log_async_t      log_async = LOG_ASYNC_OFF;
+static ring_queue_t     *log_queue = NULL;
+static pthread_t        log_writer_tid;
+static bool             log_writer_running = false;
+static bool             log_writer_stop = false;
+static uint32_t         log_async_dropped = 0;
+static log_async_rec_t  log_stop_rec;	/* wakes the writer up to stop */
+
 #define LOG_INITIALIZED ((log != NULL) && (log->initialized))
 #define SCHED_LOG_INITIALIZED ((sched_log != NULL) && (sched_log->initialized))
 /* define a default argv0 */
@@ -163,7 +188,14 @@ extern char * program_invocation_name;
  */
 static void _atfork_prep()   { slurm_mutex_lock(&log_lock);   }
 static void _atfork_parent() { slurm_mutex_unlock(&log_lock); }
-static void _atfork_child()  { slurm_mutex_unlock(&log_lock); }
+static void _atfork_child()
+{
+	/* The writer thread is not forked, log synchronously */
+	log_async = LOG_ASYNC_OFF;
+	log_queue = NULL;
+	log_writer_running = false;
+	slurm_mutex_unlock(&log_lock);
+}
 static bool at_forked = false;
 #define atfork_install_handlers()					\
 	while (!at_forked) {						\
@@ -172,6 +204,7 @@ static bool at_forked = false;
 	}
 
 static void _log_flush(log_t *log);
+static void _log_async_drain(void);
 
 static log_level_t _highest_level(log_level_t a, log_level_t b, log_level_t c)
 {
@@ -509,6 +542,7 @@ void log_fini(void)
 	if (!log)
 		return;
 
+	log_set_async(LOG_ASYNC_OFF);
 	slurm_mutex_lock(&log_lock);
 	_log_flush(log);
 	xfree(log->argv0);
@@ -1131,6 +1165,166 @@ static void _log_printf(log_t *log, cbuf_t *cb, FILE *stream,
 
 }
 
+/* Return the prefix of messages logged at level and set their syslog
+ * priority */
+static char *_log_level_pfx(log_level_t level, bool sched, bool spank,
+			    int *priority)
+{
+	switch (level) {
+	case LOG_LEVEL_FATAL:
+		*priority = LOG_CRIT;
+		return "fatal: ";
+	case LOG_LEVEL_ERROR:
+		*priority = LOG_ERR;
+		if (spank)
+			return "";
+		return sched ? "error: sched: " : "error: ";
+	case LOG_LEVEL_INFO:
+	case LOG_LEVEL_VERBOSE:
+		*priority = LOG_INFO;
+		return sched ? "sched: " : "";
+	case LOG_LEVEL_DEBUG:
+		*priority = LOG_DEBUG;
+		return sched ? "debug:  sched: " : "debug:  ";
+	case LOG_LEVEL_DEBUG2:
+		*priority = LOG_DEBUG;
+		return sched ? "debug2: sched: " : "debug2: ";
+	case LOG_LEVEL_DEBUG3:
+		*priority = LOG_DEBUG;
+		return sched ? "debug3: sched: " : "debug3: ";
+	case LOG_LEVEL_DEBUG4:
+		*priority = LOG_DEBUG;
+		return "debug4: ";
+	case LOG_LEVEL_DEBUG5:
+		*priority = LOG_DEBUG;
+		return "debug5: ";
+	default:
+		*priority = LOG_ERR;
+		return "internal error: ";
+	}
+}
+
+/* Write a queued message, called with log_lock held */
+static void _log_async_write(log_async_rec_t *rec)
+{
+	if (rec->sched && SCHED_LOG_INITIALIZED)
+		_log_printf(sched_log, sched_log->fbuf, sched_log->logfp,
+			    "sched: %s %s%s\n", rec->stamp, sched_log->fpfx,
+			    rec->msg);
+	if (rec->main && LOG_INITIALIZED && log->logfp)
+		_log_printf(log, log->fbuf, log->logfp, "%s %s%s%s\n",
+			    rec->stamp, log->fpfx, rec->pfx, rec->msg);
+	xfree(rec->stamp);
+	xfree(rec->msg);
+	xfree(rec);
+}
+
+/* Write every queued message, called with log_lock held */
+static void _log_async_drain(void)
+{
+	log_async_rec_t *rec;
+	uint32_t dropped;
+	char *stamp = NULL;
+	bool written = false;
+
+	if (!log_queue)
+		return;
+
+	while ((rec = ring_queue_try_dequeue(log_queue))) {
+		if (rec == &log_stop_rec)
+			continue;
+		_log_async_write(rec);
+		written = true;
+	}
+
+	if ((dropped = __atomic_exchange_n(&log_async_dropped, 0,
+					   __ATOMIC_RELAXED)) &&
+	    LOG_INITIALIZED && log->logfp) {
+		xlogfmtcat(&stamp, "[%M]");
+		_log_printf(log, log->fbuf, log->logfp,
+			    "%s %serror: %u messages dropped, log queue full\n",
+			    stamp, log->fpfx, dropped);
+		xfree(stamp);
+		written = true;
+	}
+
+	if (!written)
+		return;
+	if (LOG_INITIALIZED && log->logfp)
+		fflush(log->logfp);
+	if (SCHED_LOG_INITIALIZED && sched_log->logfp)
+		fflush(sched_log->logfp);
+}
+
+static void *_log_writer(void *arg)
+{
+	log_async_rec_t *rec;
+
+#if HAVE_SYS_PRCTL_H
+	if (prctl(PR_SET_NAME, "log_writer", NULL, NULL, NULL) < 0)
+		error("%s: cannot set my name to %s %m", __func__, "log_writer");
+#endif
+
+	while (!__atomic_load_n(&log_writer_stop, __ATOMIC_ACQUIRE)) {
+		if (!(rec = ring_queue_dequeue(log_queue, 1000)))
+			continue;
+		slurm_mutex_lock(&log_lock);
+		if (rec != &log_stop_rec)
+			_log_async_write(rec);
+		/* write whatever else queued up meanwhile in one go */
+		_log_async_drain();
+		slurm_mutex_unlock(&log_lock);
+	}
+
+	return NULL;
+}
+
+/*
+ * Queue a message for the log writer thread if it only goes to logfiles.
+ * The message is formatted here, without holding log_lock.
+ * RET true if the message was handled, false to log it synchronously
+ */
+static bool _log_msg_async(log_level_t level, bool sched, bool spank,
+			   const char *fmt, va_list args)
+{
+	log_async_rec_t *rec;
+	bool main, sched_main;
+	int priority;
+
+	/*
+	 * Messages for stderr or syslog, fatal messages and the ones logged
+	 * before the logs are set up keep being logged synchronously.
+	 */
+	if (!log_queue || !LOG_INITIALIZED || spank ||
+	    (level <= LOG_LEVEL_FATAL) || (level <= log->opt.stderr_level) ||
+	    (level <= log->opt.syslog_level))
+		return false;
+
+	main = (level <= log->opt.logfile_level) && log->logfp;
+	sched_main = sched && SCHED_LOG_INITIALIZED &&
+		     (highest_sched_log_level > LOG_LEVEL_QUIET);
+	if (!main && !sched_main)
+		return true;
+
+	rec = xmalloc(sizeof(*rec));
+	rec->main = main;
+	rec->sched = sched_main;
+	rec->pfx = log->opt.prefix_level ?
+		   _log_level_pfx(level, sched, spank, &priority) : "";
+	xlogfmtcat(&rec->stamp, "[%M]");
+	rec->msg = vxstrfmt(fmt, args);
+
+	if (log_async == LOG_ASYNC_BLOCK) {
+		ring_queue_enqueue(log_queue, rec);
+	} else if (!ring_queue_try_enqueue(log_queue, rec)) {
+		__atomic_add_fetch(&log_async_dropped, 1, __ATOMIC_RELAXED);
+		xfree(rec->stamp);
+		xfree(rec->msg);
+		xfree(rec);
+	}
+	return true;
+}
+
 /*
  * log a message at the specified level to facilities that have been
  * configured to receive messages at that level
@@ -1142,8 +1336,16 @@ static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt,
 	char *msgbuf = NULL;
 	int priority = LOG_INFO;
 
+	if ((log_async != LOG_ASYNC_OFF) &&
+	    _log_msg_async(level, sched, spank, fmt, args))
+		return;
+
 	slurm_mutex_lock(&log_lock);
 
+	/* keep the logfile in order with messages still queued */
+	if (log_queue)
+		_log_async_drain();
+
 	if (!LOG_INITIALIZED) {
 		log_options_t opts = LOG_OPTS_STDERR_ONLY;
 		_log_init(NULL, opts, 0, NULL);
@@ -1165,57 +1367,8 @@ static void _log_msg(log_level_t level, bool sched, bool spank, const char *fmt,
 		return;
 	}
 
-	if (log->opt.prefix_level || (log->opt.syslog_level > level)) {
-		switch (level) {
-		case LOG_LEVEL_FATAL:
-			priority = LOG_CRIT;
-			pfx = "fatal: ";
-			break;
-
-		case LOG_LEVEL_ERROR:
-			priority = LOG_ERR;
-			pfx = sched? "error: sched: " : "error: ";
-			pfx = spank ? "" : pfx;
-			break;
-
-		case LOG_LEVEL_INFO:
-		case LOG_LEVEL_VERBOSE:
-			priority = LOG_INFO;
-			pfx = sched ? "sched: " : "";
-			break;
-
-		case LOG_LEVEL_DEBUG:
-			priority = LOG_DEBUG;
-			pfx = sched ? "debug:  sched: " : "debug:  ";
-			break;
-
-		case LOG_LEVEL_DEBUG2:
-			priority = LOG_DEBUG;
-			pfx = sched ? "debug2: sched: " : "debug2: ";
-			break;
-
-		case LOG_LEVEL_DEBUG3:
-			priority = LOG_DEBUG;
-			pfx = sched ? "debug3: sched: " : "debug3: ";
-			break;
-
-		case LOG_LEVEL_DEBUG4:
-			priority = LOG_DEBUG;
-			pfx = "debug4: ";
-			break;
-
-		case LOG_LEVEL_DEBUG5:
-			priority = LOG_DEBUG;
-			pfx = "debug5: ";
-			break;
-
-		default:
-			priority = LOG_ERR;
-			pfx = "internal error: ";
-			break;
-		}
-
-	}
+	if (log->opt.prefix_level || (log->opt.syslog_level > level))
+		pfx = _log_level_pfx(level, sched, spank, &priority);
 
 	if (!buf) {
 		/* format the basic message,
@@ -1294,10 +1447,46 @@ void
 log_flush()
 {
 	slurm_mutex_lock(&log_lock);
+	_log_async_drain();
 	_log_flush(log);
 	slurm_mutex_unlock(&log_lock);
 }
 
+void log_set_async(log_async_t mode)
+{
+	bool stop;
+
+	slurm_mutex_lock(&log_lock);
+	if (mode != LOG_ASYNC_OFF) {
+		if (!log_queue)
+			log_queue = ring_queue_create(LOG_ASYNC_QUEUE_SIZE,
+						      NULL);
+		if (!log_writer_running) {
+			log_writer_stop = false;
+			slurm_thread_create(&log_writer_tid, _log_writer,
+					    NULL);
+			log_writer_running = true;
+		}
+	}
+	log_async = mode;
+	stop = (mode == LOG_ASYNC_OFF) && log_writer_running;
+	slurm_mutex_unlock(&log_lock);
+
+	if (!stop)
+		return;
+
+	/* messages queued after this are written by the next message
+	 * logged synchronously */
+	__atomic_store_n(&log_writer_stop, true, __ATOMIC_RELEASE);
+	(void) ring_queue_try_enqueue(log_queue, &log_stop_rec);
+	pthread_join(log_writer_tid, NULL);
+
+	slurm_mutex_lock(&log_lock);
+	log_writer_running = false;
+	_log_async_drain();
+	slurm_mutex_unlock(&log_lock);
+}
+
 /*
  * attempt to log message and exit()
  */
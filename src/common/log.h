@@ -206,6 +206,22 @@ void log_oom(const char *file, int line, const char *func);
 /* Set the log timestamp format */
 void log_set_timefmt(unsigned);
 
+/*
+ * Asynchronous logging: messages that only go to the logfiles are formatted
+ * by the calling thread and written by a log writer thread, so callers do
+ * not wait on the file. Messages for stderr or syslog and fatal messages are
+ * still logged synchronously, after the queued ones.
+ */
+typedef enum {
+	LOG_ASYNC_OFF,		/* log synchronously */
+	LOG_ASYNC_BLOCK,	/* wait for the writer when it falls behind */
+	LOG_ASYNC_DROP,		/* drop messages when the writer falls behind */
+}	log_async_t;
+
+/* Set the asynchronous logging mode, starting or stopping the writer thread.
+ * The mode is reset to LOG_ASYNC_OFF in forked children. */
+void log_set_async(log_async_t mode);
+
 /*
  * Buffered log functions:
  *
@@ -327,6 +327,35 @@ extern void msg_aggr_sender_fini(void)
 	slurm_mutex_destroy(&msg_collection.mutex);
 }
 
+/*
+ * Send a msg straight to the controller when aggregation is not running,
+ * as callers do without aggregation, then free it
+ */
+static void _send_direct(slurm_msg_t *msg, bool wait,
+			 void (*resp_callback) (slurm_msg_t *msg))
+{
+	slurm_msg_t resp_msg;
+
+	if (wait) {
+		slurm_msg_t_init(&resp_msg);
+		if (slurm_send_recv_controller_msg(msg, &resp_msg,
+						   working_cluster_rec) < 0) {
+			error("%s: Unable to send %s: %m", __func__,
+			      rpc_num2string(msg->msg_type));
+		} else {
+			if (resp_callback &&
+			    (resp_msg.msg_type != RESPONSE_SLURM_RC))
+				(resp_callback)(&resp_msg);
+			slurm_free_msg_data(resp_msg.msg_type, resp_msg.data);
+		}
+	} else if (slurm_send_only_controller_msg(msg,
+						  working_cluster_rec) < 0) {
+		error("%s: Unable to send %s: %m", __func__,
+		      rpc_num2string(msg->msg_type));
+	}
+	slurm_free_comp_msg_list(msg);
+}
+
 extern void msg_aggr_add_msg(slurm_msg_t *msg, bool wait,
 			     void (*resp_callback) (slurm_msg_t *msg))
 {
@@ -334,8 +363,10 @@ extern void msg_aggr_add_msg(slurm_msg_t *msg, bool wait,
 	static uint16_t msg_index = 1;
 	static uint32_t wait_count = 0;
 
-	if (!msg_collection.running)
+	if (!msg_collection.running) {
+		_send_direct(msg, wait, resp_callback);
 		return;
+	}
 
 	slurm_mutex_lock(&msg_collection.mutex);
 	if (msg_collection.max_msgs == true) {
@@ -50,7 +50,8 @@ extern void msg_aggr_sender_reconfig(uint64_t window, uint64_t max_msg_cnt);
 extern void msg_aggr_sender_fini(void);
 
 /* add a message that needs to be sent.
- * IN: msg - message to be sent
+ * IN: msg - message to be sent, freed by this function. Sent directly to
+ *	     the controller if aggregation is not running.
  * IN: wait - whether or not we need to wait for a response
  * IN: resp_callback - function to process response
  */
@@ -3,7 +3,7 @@
  *                (see src/slurmctld/node_mgr.c for the set of functionalities
  *                 related to slurmctld usage of nodes)
  *	Note: there is a global node table (node_record_table_ptr), its
- *	hash table (node_hash_table), time stamp (last_node_update) and
+ *	name index (node_slot), time stamp (last_node_update) and
  *	configuration list (config_list)
  *****************************************************************************
  *  Copyright (C) 2002-2007 The Regents of the University of California.
@@ -68,22 +68,43 @@
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/common/slurm_ext_sensors.h"
 #include "src/common/slurm_topology.h"
+#include "src/common/working_cluster.h"
 #include "src/common/xassert.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
 
 #define _DEBUG 0
 
+/*
+ * The node records are indexed by name and by NodeHostName in an open
+ * addressed hash table. Slots hold the offset of the record rather than its
+ * address so that growing node_record_table_ptr does not invalidate them.
+ * A NodeHostName shared by several nodes is marked as such and still
+ * resolved through slurm_conf_get_nodename().
+ */
+#define NODE_SLOT_EMPTY	-1
+#define NODE_SLOT_MIN	64
+
+typedef struct {
+	uint32_t hash;		/* hash of the key, skips most xstrcmp() */
+	int inx;		/* offset in node_record_table_ptr */
+	bool hostname;		/* key is node_hostname rather than name */
+	bool shared;		/* node_hostname of more than one node */
+} node_slot_t;
+
 /* Global variables */
 List config_list  = NULL;	/* list of config_record entries */
 List front_end_list = NULL;	/* list of slurm_conf_frontend_t entries */
 time_t last_node_update = (time_t) 0;	/* time of last update */
 node_record_t *node_record_table_ptr = NULL;	/* node records */
-xhash_t* node_hash_table = NULL;
 int node_record_count = 0;		/* count in node_record_table_ptr */
 uint16_t *cr_node_num_cores = NULL;
 uint32_t *cr_node_cores_offset = NULL;
 
+static node_slot_t *node_slot = NULL;	/* name index, see node_slot_t */
+static uint32_t node_slot_cnt = 0;	/* slots, a power of two */
+static uint32_t node_slot_used = 0;	/* slots in use */
+
 /* Local function definitions */
 static int	_delete_config_record (void);
 #if _DEBUG
@@ -92,8 +113,10 @@ static void	_dump_hash (void);
 static node_record_t *_find_node_record(char *name, bool test_alias,
 					bool log_missing);
 static void	_list_delete_config (void *config_entry);
-static void _node_record_hash_identity (void* item, const char** key,
-					uint32_t* key_len);
+static void	_node_index_add(int inx, bool hostname);
+static void	_node_index_build(void);
+static node_slot_t *_node_index_find(const char *key, bool hostname);
+static void	_node_index_free(void);
 
 /*
  * _delete_config_record - delete all configuration records
@@ -112,30 +135,24 @@ static int _delete_config_record (void)
 
 #if _DEBUG
 /*
- * helper function used by _dump_hash to print the hash table elements
- */
-static void xhash_walk_helper_cbk (void* item, void* arg)
-{
-	static int i = 0; /* sequential walk, so just update a static i */
-	int inx;
-	node_record_t *node_ptr = (node_record_t *) item;
-
-	inx = node_ptr -  node_record_table_ptr;
-	debug3("node_hash[%d]:%d(%s)", i++, inx, node_ptr->name);
-}
-/*
- * _dump_hash - print the node_hash_table contents, used for debugging
+ * _dump_hash - print the node name index contents, used for debugging
  *	or analysis of hash technique
  * global: node_record_table_ptr - pointer to global node table
- *         node_hash_table - table of hash indexes
+ *         node_slot - node name index
  */
 static void _dump_hash (void)
 {
-	if (node_hash_table == NULL)
-		return;
-	debug2("node_hash: indexing %ld elements",
-	      xhash_count(node_hash_table));
-	xhash_walk(node_hash_table, xhash_walk_helper_cbk, NULL);
+	uint32_t i;
+
+	debug2("node_hash: indexing %u elements in %u slots",
+	       node_slot_used, node_slot_cnt);
+	for (i = 0; i < node_slot_cnt; i++) {
+		if (node_slot[i].inx == NODE_SLOT_EMPTY)
+			continue;
+		debug3("node_hash[%u]:%d(%s%s)", i, node_slot[i].inx,
+		       node_slot[i].hostname ? "NodeHostName of " : "",
+		       node_record_table_ptr[node_slot[i].inx].name);
+	}
 }
 #endif
 
@@ -157,16 +174,128 @@ static void _list_delete_config (void *config_entry)
 	xfree (config_ptr);
 }
 
+/* FNV-1a hash of a node name */
+static uint32_t _node_name_hash(const char *key)
+{
+	uint32_t hash = 2166136261U;
+
+	for ( ; *key; key++) {
+		hash ^= (unsigned char) *key;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static char *_node_slot_key(node_slot_t *slot)
+{
+	node_record_t *node_ptr = node_record_table_ptr + slot->inx;
+
+	return slot->hostname ? node_ptr->node_hostname : node_ptr->name;
+}
+
 /*
- * xhash helper function to index node_record per name field
- * in node_hash_table
+ * _node_index_find - find the index slot of a node name or NodeHostName
+ * IN key - name to look up
+ * IN hostname - look up a NodeHostName rather than a node name
+ * RET the slot or NULL if not found
  */
-static void _node_record_hash_identity (void* item, const char** key,
-					uint32_t* key_len)
+static node_slot_t *_node_index_find(const char *key, bool hostname)
+{
+	uint32_t hash, i, mask = node_slot_cnt - 1;
+	node_slot_t *slot;
+
+	if (!node_slot_cnt)
+		return NULL;
+
+	hash = _node_name_hash(key);
+	for (i = hash & mask; node_slot[i].inx != NODE_SLOT_EMPTY;
+	     i = (i + 1) & mask) {
+		slot = &node_slot[i];
+		/*
+		 * Records can be renamed or dropped without the index being
+		 * rebuilt, such slots never match.
+		 */
+		if ((slot->hash == hash) && (slot->hostname == hostname) &&
+		    (slot->inx < node_record_count) &&
+		    !xstrcmp(_node_slot_key(slot), key))
+			return slot;
+	}
+	return NULL;
+}
+
+/* Add a key of node record inx to the index, which must have a free slot */
+static void _node_index_insert(int inx, bool hostname)
 {
-	node_record_t *node_ptr = (node_record_t *) item;
-	*key = node_ptr->name;
-	*key_len = strlen(node_ptr->name);
+	node_record_t *node_ptr = node_record_table_ptr + inx;
+	char *key = hostname ? node_ptr->node_hostname : node_ptr->name;
+	uint32_t hash, i, mask = node_slot_cnt - 1;
+	node_slot_t *slot;
+
+	if (!key || (key[0] == '\0'))
+		return;		/* vestigial record or no NodeHostName */
+	if (hostname && !xstrcmp(key, node_ptr->name))
+		return;		/* found by name already */
+#ifdef HAVE_FRONT_END
+	/* NodeHostName of front end nodes resolves to the front end */
+	if (hostname)
+		return;
+#endif
+
+	if ((slot = _node_index_find(key, hostname))) {
+		if (slot->inx != inx)
+			slot->shared = true;
+		return;
+	}
+
+	hash = _node_name_hash(key);
+	for (i = hash & mask; node_slot[i].inx != NODE_SLOT_EMPTY;
+	     i = (i + 1) & mask)
+		;
+	slot = &node_slot[i];
+	slot->hash = hash;
+	slot->inx = inx;
+	slot->hostname = hostname;
+	slot->shared = false;
+	node_slot_used++;
+}
+
+/*
+ * _node_index_add - add the name or NodeHostName of node record inx to the
+ *	index, growing it to keep at least half of the slots free
+ */
+static void _node_index_add(int inx, bool hostname)
+{
+	if ((node_slot_used + 1) * 2 > node_slot_cnt)
+		_node_index_build();	/* adds this record's keys too */
+	else
+		_node_index_insert(inx, hostname);
+}
+
+/* Build the index of all node records, with room for as many again */
+static void _node_index_build(void)
+{
+	uint32_t slot;
+	int i;
+
+	_node_index_free();
+	node_slot_cnt = NODE_SLOT_MIN;
+	while (node_slot_cnt < (node_record_count * 4))
+		node_slot_cnt *= 2;
+	node_slot = xmalloc(sizeof(node_slot_t) * node_slot_cnt);
+	for (slot = 0; slot < node_slot_cnt; slot++)
+		node_slot[slot].inx = NODE_SLOT_EMPTY;
+
+	for (i = 0; i < node_record_count; i++) {
+		_node_index_insert(i, false);
+		_node_index_insert(i, true);
+	}
+}
+
+static void _node_index_free(void)
+{
+	xfree(node_slot);
+	node_slot_cnt = 0;
+	node_slot_used = 0;
 }
 
 /*
@@ -351,6 +480,7 @@ static void _check_callback(char *alias, char *hostname,
 	node_rec->comm_name = xstrdup(address);
 	node_rec->cpu_bind  = node_ptr->cpu_bind;
 	node_rec->node_hostname = xstrdup(hostname);
+	_node_index_add(node_rec - node_record_table_ptr, true);
 	node_rec->bcast_address = xstrdup(bcast_address);
 	node_rec->port      = port;
 	node_rec->weight    = node_ptr->weight;
@@ -654,19 +784,11 @@ extern node_record_t *create_node_record(config_record_t *config_ptr,
 		((int) ((new_buffer_size / BUF_SIZE) + 1)) * BUF_SIZE;
 	if (!node_record_table_ptr) {
 		node_record_table_ptr = xmalloc(new_buffer_size);
-	} else if (old_buffer_size != new_buffer_size) {
+	} else if (old_buffer_size != new_buffer_size)
 		xrealloc (node_record_table_ptr, new_buffer_size);
-		/*
-		 * You need to rehash the hash after we realloc or we will have
-		 * only bad memory references in the hash.
-		 */
-		rehash_node();
-	}
 	node_ptr = node_record_table_ptr + (node_record_count++);
 	node_ptr->name = xstrdup(node_name);
-	if (!node_hash_table)
-		node_hash_table = xhash_init(_node_record_hash_identity, NULL);
-	xhash_add(node_hash_table, node_ptr);
+	_node_index_add(node_record_count - 1, false);
 
 	node_ptr->config_ptr = config_ptr;
 	/* these values will be overwritten when the node actually registers */
@@ -739,6 +861,7 @@ static node_record_t *_find_node_record(char *name, bool test_alias,
 					bool log_missing)
 {
 	node_record_t *node_ptr;
+	node_slot_t *slot;
 
 	if ((name == NULL) || (name[0] == '\0')) {
 		info("%s: passed NULL node name", __func__);
@@ -746,11 +869,11 @@ static node_record_t *_find_node_record(char *name, bool test_alias,
 	}
 
 	/* nothing added yet */
-	if (!node_hash_table)
+	if (!node_slot_cnt)
 		return NULL;
 
-	/* try to find via hash table, if it exists */
-	if ((node_ptr = xhash_get_str(node_hash_table, name))) {
+	if ((slot = _node_index_find(name, false))) {
+		node_ptr = node_record_table_ptr + slot->inx;
 		xassert(node_ptr->magic == NODE_MAGIC);
 		return node_ptr;
 	}
@@ -764,13 +887,25 @@ static node_record_t *_find_node_record(char *name, bool test_alias,
 		      __func__, __LINE__, name);
 
 	if (test_alias) {
-		char *alias = slurm_conf_get_nodename(name);
+		char *alias;
+
 		/* look for the alias node record if the user put this in
 	 	 * instead of what slurm sees the node name as */
-		if (!alias)
+		if ((slot = _node_index_find(name, true)) && !slot->shared) {
+			node_ptr = node_record_table_ptr + slot->inx;
+			if (log_missing)
+				error("%s(%d): lookup failure for %s alias %s",
+				      __func__, __LINE__, name, node_ptr->name);
+			return node_ptr;
+		}
+
+		if (!(alias = slurm_conf_get_nodename(name)))
 			return NULL;
 
-		node_ptr = xhash_get_str(node_hash_table, alias);
+		if ((slot = _node_index_find(alias, false)))
+			node_ptr = node_record_table_ptr + slot->inx;
+		else
+			node_ptr = NULL;
 		if (log_missing)
 			error("%s(%d): lookup failure for %s alias %s",
 			      __func__, __LINE__, name, alias);
@@ -799,7 +934,7 @@ extern int init_node_conf (void)
 
 	node_record_count = 0;
 	xfree(node_record_table_ptr);
-	xhash_free(node_hash_table);
+	_node_index_free();
 
 	if (config_list)	/* delete defunct configuration entries */
 		(void) _delete_config_record ();
@@ -823,7 +958,7 @@ extern void node_fini2 (void)
 		FREE_NULL_LIST(front_end_list);
 	}
 
-	xhash_free(node_hash_table);
+	_node_index_free();
 	node_ptr = node_record_table_ptr;
 	for (i = 0; i < node_record_count; i++, node_ptr++)
 		purge_node_rec(node_ptr);
@@ -833,6 +968,112 @@ extern void node_fini2 (void)
 }
 
 
+/* Test if a node name is prefix followed by num zero padded to width digits */
+static bool _node_name_match(char *name, char *prefix, int prefix_len,
+			     int width, unsigned long num)
+{
+	char digits[32];
+	int i = sizeof(digits) - 1;
+
+	if (!name || strncmp(name, prefix, prefix_len))
+		return false;
+
+	digits[i] = '\0';
+	do {
+		digits[--i] = '0' + (num % 10);
+		num /= 10;
+	} while (num);
+	while ((i > 0) && ((sizeof(digits) - 1 - i) < width))
+		digits[--i] = '0';
+
+	return !strcmp(name + prefix_len, digits + i);
+}
+
+/*
+ * Set the bit of a node found by name
+ * RET the node's offset in node_record_table_ptr or -1 if not found, in which
+ *     case rc is set to EINVAL unless best_effort is set
+ */
+static int _set_node_bit(char *name, bool best_effort, bitstr_t *bitmap,
+			 const char *caller, int *rc)
+{
+	node_record_t *node_ptr;
+	int inx;
+
+	if (!(node_ptr = _find_node_record(name, best_effort, true))) {
+		error("%s: invalid node specified %s", caller, name);
+		if (!best_effort)
+			*rc = EINVAL;
+		return -1;
+	}
+
+	inx = node_ptr - node_record_table_ptr;
+	bit_set(bitmap, inx);
+	return inx;
+}
+
+/*
+ * _hostlist2bitmap - set the bits of the nodes of a hostlist in a bitmap
+ *	Node records are mostly ordered by name, so once a host of a range is
+ *	found the records following it are checked for the next hosts of the
+ *	range before hashing their names.
+ * IN hl          - hostlist
+ * IN best_effort - if set don't return an error on invalid node name entries
+ * IN/OUT bitmap  - bitmap of node_record_count bits to set
+ * IN caller      - function name for error messages
+ * RET 0 if no error, otherwise EINVAL
+ */
+static int _hostlist2bitmap(hostlist_t hl, bool best_effort, bitstr_t *bitmap,
+			    const char *caller)
+{
+	int rc = SLURM_SUCCESS, n, inx, width, prefix_len;
+	unsigned long lo, hi, num;
+	char *name, *prefix;
+	hostlist_iterator_t iter;
+
+	if (slurmdb_setup_cluster_name_dims() > 1) {
+		/* hosts of multi-dimensional ranges are not numbered */
+		iter = hostlist_iterator_create(hl);
+		while ((name = hostlist_next(iter))) {
+			(void) _set_node_bit(name, best_effort, bitmap, caller,
+					     &rc);
+			free(name);
+		}
+		hostlist_iterator_destroy(iter);
+		return rc;
+	}
+
+	for (n = 0; (prefix = hostlist_nth_range_values(hl, n, &lo, &hi,
+							&width)); n++) {
+		if (width < 0) {
+			(void) _set_node_bit(prefix, best_effort, bitmap,
+					     caller, &rc);
+			free(prefix);
+			continue;
+		}
+
+		prefix_len = strlen(prefix);
+		for (num = lo; num <= hi; num++) {
+			name = xstrdup_printf("%s%0*lu", prefix, width, num);
+			inx = _set_node_bit(name, best_effort, bitmap, caller,
+					    &rc);
+			xfree(name);
+			if (inx < 0)
+				continue;
+			while ((num < hi) && (++inx < node_record_count) &&
+			       _node_name_match(node_record_table_ptr[inx].name,
+						prefix, prefix_len, width,
+						num + 1)) {
+				bit_set(bitmap, inx);
+				num++;
+			}
+		}
+		free(prefix);
+	}
+
+	return rc;
+}
+
 /*
  * node_name2bitmap - given a node name regular expression, build a bitmap
  *	representation
@@ -846,7 +1087,6 @@ extern int node_name2bitmap (char *node_names, bool best_effort,
 			     bitstr_t **bitmap)
 {
 	int rc = SLURM_SUCCESS;
-	char *this_node_name;
 	bitstr_t *my_bitmap;
 	hostlist_t host_list;
 
@@ -866,20 +1106,7 @@ extern int node_name2bitmap (char *node_names, bool best_effort,
 		return rc;
 	}
 
-	while ( (this_node_name = hostlist_shift (host_list)) ) {
-		node_record_t *node_ptr;
-		node_ptr = _find_node_record(this_node_name, best_effort, true);
-		if (node_ptr) {
-			bit_set (my_bitmap, (bitoff_t) (node_ptr -
-							node_record_table_ptr));
-		} else {
-			error ("node_name2bitmap: invalid node specified %s",
-			       this_node_name);
-			if (!best_effort)
-				rc = EINVAL;
-		}
-		free (this_node_name);
-	}
+	rc = _hostlist2bitmap(host_list, best_effort, my_bitmap, __func__);
 	hostlist_destroy (host_list);
 
 	return rc;
@@ -894,34 +1121,13 @@ extern int node_name2bitmap (char *node_names, bool best_effort,
  */
 extern int hostlist2bitmap (hostlist_t hl, bool best_effort, bitstr_t **bitmap)
 {
-	int rc = SLURM_SUCCESS;
 	bitstr_t *my_bitmap;
-	char *name;
-	hostlist_iterator_t hi;
 
 	FREE_NULL_BITMAP(*bitmap);
 	my_bitmap = (bitstr_t *) bit_alloc (node_record_count);
 	*bitmap = my_bitmap;
 
-	hi = hostlist_iterator_create(hl);
-	while ((name = hostlist_next(hi))) {
-		node_record_t *node_ptr;
-		node_ptr = _find_node_record(name, best_effort, true);
-		if (node_ptr) {
-			bit_set (my_bitmap, (bitoff_t) (node_ptr -
-							node_record_table_ptr));
-		} else {
-			error ("hostlist2bitmap: invalid node specified %s",
-			       name);
-			if (!best_effort)
-				rc = EINVAL;
-		}
-		free (name);
-	}
-
-	hostlist_iterator_destroy(hi);
-	return rc;
-
+	return _hostlist2bitmap(hl, best_effort, my_bitmap, __func__);
 }
 
 /* Purge the contents of a node record */
@@ -951,22 +1157,12 @@ extern void purge_node_rec(node_record_t *node_ptr)
 }
 
 /*
- * rehash_node - build a hash table of the node_record entries.
- * NOTE: using xhash implementation
+ * rehash_node - build the index of the node_record entries by name and
+ *	NodeHostName, required once records are moved or renamed.
  */
 extern void rehash_node (void)
 {
-	int i;
-	node_record_t *node_ptr = node_record_table_ptr;
-
-	xhash_free (node_hash_table);
-	node_hash_table = xhash_init(_node_record_hash_identity, NULL);
-	for (i = 0; i < node_record_count; i++, node_ptr++) {
-		if ((node_ptr->name == NULL) ||
-		    (node_ptr->name[0] == '\0'))
-			continue;	/* vestigial record */
-		xhash_add(node_hash_table, node_ptr);
-	}
+	_node_index_build();
 
 #if _DEBUG
 	_dump_hash();
@@ -175,7 +175,6 @@ struct node_record {
 };
 extern node_record_t *node_record_table_ptr;  /* ptr to node records */
 extern int node_record_count;		/* count in node_record_table_ptr */
-extern xhash_t* node_hash_table;	/* hash table for node records */
 extern time_t last_node_update;		/* time of last node record update */
 
 extern uint16_t *cr_node_num_cores;
@@ -330,8 +329,8 @@ extern int node_name2bitmap (char *node_names, bool best_effort,
 extern void purge_node_rec(node_record_t *node_ptr);
 
 /*
- * rehash_node - build a hash table of the node_record entries.
- * NOTE: manages memory for node_hash_table
+ * rehash_node - build the index of the node_record entries by name and
+ *	NodeHostName, required once records are moved or renamed.
  */
 extern void rehash_node (void);
 
@@ -45,6 +45,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -66,6 +67,14 @@
 #define MAX_ARRAY_LEN_MEDIUM	1000000
 #define MAX_ARRAY_LEN_LARGE	100000000
 
+/* Buffers recycled by free_buf_pooled() for init_buf_pooled() */
+#define BUF_POOL_CNT		16
+#define BUF_POOL_MAX_SIZE	(1024 * 1024)
+
+static pthread_mutex_t buf_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static Buf buf_pool[BUF_POOL_CNT];
+static int buf_pool_cnt = 0;
+
 /*
  * Define slurm-specific aliases for use by plugins, see slurm_xlator.h
  * for details.
@@ -73,8 +82,11 @@
 strong_alias(create_buf,	slurm_create_buf);
 strong_alias(create_mmap_buf,	slurm_create_mmap_buf);
 strong_alias(free_buf,		slurm_free_buf);
+strong_alias(free_buf_pooled,	slurm_free_buf_pooled);
 strong_alias(grow_buf,		slurm_grow_buf);
 strong_alias(init_buf,		slurm_init_buf);
+strong_alias(init_buf_pooled,	slurm_init_buf_pooled);
+strong_alias(reserve_buf,	slurm_reserve_buf);
 strong_alias(xfer_buf_data,	slurm_xfer_buf_data);
 strong_alias(pack_time,		slurm_pack_time);
 strong_alias(unpack_time,	slurm_unpack_time);
@@ -110,6 +122,41 @@ strong_alias(unpackstr_array,	slurm_unpackstr_array);
 strong_alias(packmem_array,	slurm_packmem_array);
 strong_alias(unpackmem_array,	slurm_unpackmem_array);
 
+/*
+ * Grow a buffer to hold at least need bytes. The buffer grows by at least its
+ * current size, so packing a large message only costs a logarithmic number
+ * of reallocations and copies.
+ * RET SLURM_SUCCESS or SLURM_ERROR if MAX_BUF_SIZE would be exceeded
+ */
+static int _grow_buf_to(Buf buffer, uint64_t need, const char *caller)
+{
+	uint64_t new_size;
+
+	if (need > MAX_BUF_SIZE) {
+		error("%s: Buffer size limit exceeded (%"PRIu64" > %u)",
+		      caller, need, MAX_BUF_SIZE);
+		return SLURM_ERROR;
+	}
+	new_size = MAX((uint64_t) buffer->size * 2, need + BUF_SIZE);
+	buffer->size = MIN(new_size, MAX_BUF_SIZE);
+	xrealloc_nz(buffer->head, buffer->size);
+
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Make room for size more bytes at the buffer's offset
+ * RET SLURM_SUCCESS or SLURM_ERROR if MAX_BUF_SIZE would be exceeded
+ */
+static int _grow_buf_remaining(Buf buffer, uint32_t size, const char *caller)
+{
+	if (remaining_buf(buffer) >= size)
+		return SLURM_SUCCESS;
+
+	return _grow_buf_to(buffer, (uint64_t) buffer->processed + size,
+			    caller);
+}
+
 /* Basic buffer management routines */
 /* create_buf - create a buffer with the supplied contents, contents must
  * be xalloc'ed */
@@ -194,14 +241,19 @@ void grow_buf (Buf buffer, uint32_t size)
 {
 	if (buffer->mmaped)
 		fatal_abort("attempt to grow mmap()'d buffer not supported");
-	if ((buffer->size + size) > MAX_BUF_SIZE) {
-		error("%s: Buffer size limit exceeded (%u > %u)",
-		      __func__, (buffer->size + size), MAX_BUF_SIZE);
-		return;
-	}
 
-	buffer->size += size;
-	xrealloc_nz(buffer->head, buffer->size);
+	(void) _grow_buf_to(buffer, (uint64_t) buffer->size + size, __func__);
+}
+
+/*
+ * reserve_buf - make sure size more bytes can be packed into the buffer
+ *	without growing it, for callers that can estimate their message size
+ */
+void reserve_buf(Buf buffer, uint32_t size)
+{
+	if (remaining_buf(buffer) >= size)
+		return;
+	grow_buf(buffer, size - remaining_buf(buffer));
 }
 
 /* init_buf - create an empty buffer of the given size */
@@ -225,6 +277,49 @@ Buf init_buf(uint32_t size)
 	return my_buf;
 }
 
+/*
+ * init_buf_pooled - like init_buf(), but reuse a buffer released with
+ *	free_buf_pooled() if there is one. Its contents are not zeroed.
+ */
+Buf init_buf_pooled(uint32_t size)
+{
+	Buf my_buf = NULL;
+
+	slurm_mutex_lock(&buf_pool_lock);
+	if (buf_pool_cnt)
+		my_buf = buf_pool[--buf_pool_cnt];
+	slurm_mutex_unlock(&buf_pool_lock);
+
+	if (!my_buf)
+		return init_buf(size);
+
+	my_buf->processed = 0;
+	reserve_buf(my_buf, size);
+	return my_buf;
+}
+
+/*
+ * free_buf_pooled - release a buffer, keeping it for init_buf_pooled() if
+ *	it is not too large and the pool is not full
+ */
+void free_buf_pooled(Buf my_buf)
+{
+	if (!my_buf)
+		return;
+	assert(my_buf->magic == BUF_MAGIC);
+
+	if (!my_buf->mmaped && (my_buf->size <= BUF_POOL_MAX_SIZE)) {
+		slurm_mutex_lock(&buf_pool_lock);
+		if (buf_pool_cnt < BUF_POOL_CNT) {
+			buf_pool[buf_pool_cnt++] = my_buf;
+			my_buf = NULL;
+		}
+		slurm_mutex_unlock(&buf_pool_lock);
+	}
+
+	free_buf(my_buf);
+}
+
 /* xfer_buf_data - return a pointer to the buffer's data and release the
  * buffer's structure */
 void *xfer_buf_data(Buf my_buf)
@@ -249,16 +344,8 @@ void pack_time(time_t val, Buf buffer)
 {
 	int64_t n64 = HTON_int64((int64_t) val);
 
-	if (remaining_buf(buffer) < sizeof(n64)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(n64), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &n64, sizeof(n64));
 	buffer->processed += sizeof(n64);
@@ -298,16 +385,8 @@ void 	packdouble(double val, Buf buffer)
 	 */
 	uval.d =  (val * FLOAT_MULT);
 	nl =  HTON_uint64(uval.u);
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(nl), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -424,16 +503,8 @@ void pack64(uint64_t val, Buf buffer)
 {
 	uint64_t nl =  HTON_uint64(val);
 
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(nl), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -463,16 +534,8 @@ void pack32(uint32_t val, Buf buffer)
 {
 	uint32_t nl = htonl(val);
 
-	if (remaining_buf(buffer) < sizeof(nl)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(nl), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &nl, sizeof(nl));
 	buffer->processed += sizeof(nl);
@@ -710,16 +773,8 @@ void pack16(uint16_t val, Buf buffer)
 {
 	uint16_t ns = htons(val);
 
-	if (remaining_buf(buffer) < sizeof(ns)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(ns), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -748,16 +803,8 @@ int unpack16(uint16_t * valp, Buf buffer)
  */
 void pack8(uint8_t val, Buf buffer)
 {
-	if (remaining_buf(buffer) < sizeof(uint8_t)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(uint8_t), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &val, sizeof(uint8_t));
 	buffer->processed += sizeof(uint8_t);
@@ -820,16 +867,8 @@ void packmem(char *valp, uint32_t size_val, Buf buffer)
 		      __func__, size_val, MAX_PACK_MEM_LEN);
 		return;
 	}
-	if (remaining_buf(buffer) < (sizeof(ns) + size_val)) {
-		if ((buffer->size + size_val + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + size_val + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += (size_val + BUF_SIZE);
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(ns) + size_val, __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -1070,16 +1109,8 @@ void packstr_array(char **valp, uint32_t size_val, Buf buffer)
 	int i;
 	uint32_t ns = htonl(size_val);
 
-	if (remaining_buf(buffer) < sizeof(ns)) {
-		if ((buffer->size + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += BUF_SIZE;
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, sizeof(ns), __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], &ns, sizeof(ns));
 	buffer->processed += sizeof(ns);
@@ -1137,16 +1168,8 @@ int unpackstr_array(char ***valp, uint32_t * size_valp, Buf buffer)
  */
 void packmem_array(char *valp, uint32_t size_val, Buf buffer)
 {
-	if (remaining_buf(buffer) < size_val) {
-		if ((buffer->size + size_val + BUF_SIZE) > MAX_BUF_SIZE) {
-			error("%s: Buffer size limit exceeded (%u > %u)",
-			      __func__, (buffer->size + size_val + BUF_SIZE),
-			      MAX_BUF_SIZE);
-			return;
-		}
-		buffer->size += (size_val + BUF_SIZE);
-		xrealloc_nz(buffer->head, buffer->size);
-	}
+	if (_grow_buf_remaining(buffer, size_val, __func__))
+		return;
 
 	memcpy(&buffer->head[buffer->processed], valp, size_val);
 	buffer->processed += size_val;
@@ -79,8 +79,11 @@ typedef struct slurm_buf * Buf;
 Buf	create_buf (char *data, uint32_t size);
 Buf	create_mmap_buf(char *file);
 void	free_buf(Buf my_buf);
+void	free_buf_pooled(Buf my_buf);
 Buf	init_buf(uint32_t size);
+Buf	init_buf_pooled(uint32_t size);
 void    grow_buf (Buf my_buf, uint32_t size);
+void	reserve_buf(Buf my_buf, uint32_t size);
 void	*xfer_buf_data(Buf my_buf);
 
 void	pack_time(time_t val, Buf buffer);
@@ -0,0 +1,373 @@
+/*****************************************************************************\
+ *  ring_queue.c - bounded lock-free multi-producer multi-consumer queue
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+/*
+ * Each cell of the ring carries a sequence number telling which lap of the
+ * ring it is ready for. A producer claims the cell at the enqueue position by
+ * advancing that position with a compare-and-swap once the cell's sequence
+ * shows it is free, stores the item and publishes it by advancing the
+ * sequence. Consumers do the same at the dequeue position. Threads only ever
+ * retry when another thread made progress, and producers and consumers only
+ * share the cells they are handing over.
+ *
+ * The blocking calls spin through the lock-free path first and only then
+ * sleep on a condition variable. The other side takes the mutex to signal
+ * only when a waiter was counted, so uncontended hand offs stay lock-free.
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "src/common/log.h"
+#include "src/common/macros.h"
+#include "src/common/ring_queue.h"
+#include "src/common/xassert.h"
+#include "src/common/xmalloc.h"
+
+/*
+** Define slurm-specific aliases for use by plugins, see slurm_xlator.h
+** for details.
+*/
+strong_alias(ring_queue_create,		slurm_ring_queue_create);
+strong_alias(ring_queue_destroy,	slurm_ring_queue_destroy);
+strong_alias(ring_queue_try_enqueue,	slurm_ring_queue_try_enqueue);
+strong_alias(ring_queue_try_dequeue,	slurm_ring_queue_try_dequeue);
+strong_alias(ring_queue_enqueue,	slurm_ring_queue_enqueue);
+strong_alias(ring_queue_dequeue,	slurm_ring_queue_dequeue);
+strong_alias(ring_queue_shutdown,	slurm_ring_queue_shutdown);
+strong_alias(ring_queue_count,		slurm_ring_queue_count);
+
+#define RING_QUEUE_MAGIC	0x52e0a11c
+#define RING_QUEUE_MAX_SIZE	(1 << 30)
+
+/* Keep the positions written by producers and by consumers on separate
+ * cache lines */
+#define CACHE_LINE		64
+
+typedef struct {
+	uint64_t seq;
+	void *data;
+} ring_cell_t;
+
+struct ring_queue {
+	int magic;
+	uint64_t mask;
+	ring_cell_t *cells;
+	ListDelF del;
+	char pad1[CACHE_LINE];
+	uint64_t enq_pos;		/* next cell to enqueue into */
+	char pad2[CACHE_LINE - sizeof(uint64_t)];
+	uint64_t deq_pos;		/* next cell to dequeue from */
+	char pad3[CACHE_LINE - sizeof(uint64_t)];
+
+	/* only used by the blocking calls */
+	pthread_mutex_t mutex;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	uint32_t get_waiters;		/* threads waiting for an item */
+	uint32_t put_waiters;		/* threads waiting for room */
+	bool shutdown;
+};
+
+extern ring_queue_t *ring_queue_create(uint32_t size, ListDelF f)
+{
+	ring_queue_t *q = xmalloc(sizeof(*q));
+	uint64_t cnt = 2, i;
+
+	while ((cnt < size) && (cnt < RING_QUEUE_MAX_SIZE))
+		cnt <<= 1;
+
+	q->magic = RING_QUEUE_MAGIC;
+	q->mask = cnt - 1;
+	q->cells = xcalloc(cnt, sizeof(ring_cell_t));
+	for (i = 0; i < cnt; i++)
+		q->cells[i].seq = i;
+	q->del = f;
+	slurm_mutex_init(&q->mutex);
+	slurm_cond_init(&q->not_empty, NULL);
+	slurm_cond_init(&q->not_full, NULL);
+
+	return q;
+}
+
+static bool _enqueue(ring_queue_t *q, void *x)
+{
+	uint64_t pos = __atomic_load_n(&q->enq_pos, __ATOMIC_RELAXED), seq;
+	ring_cell_t *cell;
+	int64_t diff;
+
+	while (1) {
+		cell = &q->cells[pos & q->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		diff = (int64_t) (seq - pos);
+		if (diff == 0) {
+			/* free for this lap, claim it */
+			if (__atomic_compare_exchange_n(&q->enq_pos, &pos,
+							pos + 1, true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			/* still holds the item from the previous lap */
+			return false;
+		} else {
+			/* another producer claimed it first */
+			pos = __atomic_load_n(&q->enq_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	cell->data = x;
+	__atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+	return true;
+}
+
+static void *_dequeue(ring_queue_t *q)
+{
+	uint64_t pos = __atomic_load_n(&q->deq_pos, __ATOMIC_RELAXED), seq;
+	ring_cell_t *cell;
+	int64_t diff;
+	void *x;
+
+	while (1) {
+		cell = &q->cells[pos & q->mask];
+		seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+		diff = (int64_t) (seq - (pos + 1));
+		if (diff == 0) {
+			/* filled for this lap, claim it */
+			if (__atomic_compare_exchange_n(&q->deq_pos, &pos,
+							pos + 1, true,
+							__ATOMIC_RELAXED,
+							__ATOMIC_RELAXED))
+				break;
+		} else if (diff < 0) {
+			/* not filled yet */
+			return NULL;
+		} else {
+			/* another consumer claimed it first */
+			pos = __atomic_load_n(&q->deq_pos, __ATOMIC_RELAXED);
+		}
+	}
+
+	x = cell->data;
+	/* free the cell for the next lap */
+	__atomic_store_n(&cell->seq, pos + q->mask + 1, __ATOMIC_RELEASE);
+	return x;
+}
+
+/*
+ * Wake one thread waiting on cond, if any is counted in waiters. The fence
+ * pairs with the one in _wait_start(): either the waiter sees the cell just
+ * published or we see the waiter.
+ */
+static void _wake(ring_queue_t *q, uint32_t *waiters, pthread_cond_t *cond)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(waiters, __ATOMIC_RELAXED))
+		return;
+	slurm_mutex_lock(&q->mutex);
+	slurm_cond_signal(cond);
+	slurm_mutex_unlock(&q->mutex);
+}
+
+/*
+ * Wake the threads waiting for room once the queue is half empty, rather
+ * than one for each item taken, so that a full queue is not refilled one
+ * item per wake up.
+ */
+static void _wake_producers(ring_queue_t *q)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&q->put_waiters, __ATOMIC_RELAXED) ||
+	    (ring_queue_count(q) > ((q->mask + 1) / 2)))
+		return;
+	slurm_mutex_lock(&q->mutex);
+	slurm_cond_broadcast(&q->not_full);
+	slurm_mutex_unlock(&q->mutex);
+}
+
+/* Count a waiter, called with the mutex held before checking the queue */
+static void _wait_start(uint32_t *waiters)
+{
+	__atomic_add_fetch(waiters, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static void _wait_end(uint32_t *waiters)
+{
+	__atomic_sub_fetch(waiters, 1, __ATOMIC_RELAXED);
+}
+
+extern bool ring_queue_try_enqueue(ring_queue_t *q, void *x)
+{
+	xassert(q);
+	xassert(q->magic == RING_QUEUE_MAGIC);
+	xassert(x);
+
+	if (!_enqueue(q, x))
+		return false;
+	_wake(q, &q->get_waiters, &q->not_empty);
+	return true;
+}
+
+extern void *ring_queue_try_dequeue(ring_queue_t *q)
+{
+	void *x;
+
+	xassert(q);
+	xassert(q->magic == RING_QUEUE_MAGIC);
+
+	if ((x = _dequeue(q)))
+		_wake_producers(q);
+	return x;
+}
+
+extern bool ring_queue_enqueue(ring_queue_t *q, void *x)
+{
+	bool rc;
+
+	xassert(q);
+	xassert(q->magic == RING_QUEUE_MAGIC);
+	xassert(x);
+
+	if (!(rc = _enqueue(q, x))) {
+		slurm_mutex_lock(&q->mutex);
+		_wait_start(&q->put_waiters);
+		while (!q->shutdown && !(rc = _enqueue(q, x)))
+			slurm_cond_wait(&q->not_full, &q->mutex);
+		_wait_end(&q->put_waiters);
+		slurm_mutex_unlock(&q->mutex);
+	}
+
+	if (rc)
+		_wake(q, &q->get_waiters, &q->not_empty);
+	return rc;
+}
+
+extern void *ring_queue_dequeue(ring_queue_t *q, int timeout)
+{
+	struct timespec abstime;
+	struct timeval now;
+	void *x;
+
+	xassert(q);
+	xassert(q->magic == RING_QUEUE_MAGIC);
+
+	if (!(x = _dequeue(q)) && timeout) {
+		if (timeout > 0) {
+			gettimeofday(&now, NULL);
+			abstime.tv_sec = now.tv_sec + (timeout / 1000);
+			abstime.tv_nsec = (now.tv_usec * 1000) +
+					  ((timeout % 1000) * 1000000);
+			if (abstime.tv_nsec >= 1000000000) {
+				abstime.tv_sec++;
+				abstime.tv_nsec -= 1000000000;
+			}
+		}
+
+		slurm_mutex_lock(&q->mutex);
+		_wait_start(&q->get_waiters);
+		while (!q->shutdown && !(x = _dequeue(q))) {
+			if (timeout < 0) {
+				slurm_cond_wait(&q->not_empty, &q->mutex);
+				continue;
+			}
+			slurm_cond_timedwait(&q->not_empty, &q->mutex,
+					     &abstime);
+			gettimeofday(&now, NULL);
+			if ((now.tv_sec > abstime.tv_sec) ||
+			    ((now.tv_sec == abstime.tv_sec) &&
+			     ((now.tv_usec * 1000) >= abstime.tv_nsec))) {
+				x = _dequeue(q);
+				break;
+			}
+		}
+		_wait_end(&q->get_waiters);
+		/* drain what was queued before the shutdown */
+		if (!x && q->shutdown)
+			x = _dequeue(q);
+		slurm_mutex_unlock(&q->mutex);
+	}
+
+	if (x)
+		_wake_producers(q);
+	return x;
+}
+
+extern void ring_queue_shutdown(ring_queue_t *q)
+{
+	xassert(q);
+	xassert(q->magic == RING_QUEUE_MAGIC);
+
+	slurm_mutex_lock(&q->mutex);
+	q->shutdown = true;
+	slurm_cond_broadcast(&q->not_empty);
+	slurm_cond_broadcast(&q->not_full);
+	slurm_mutex_unlock(&q->mutex);
+}
+
+extern uint32_t ring_queue_count(ring_queue_t *q)
+{
+	uint64_t deq_pos, enq_pos;
+
+	xassert(q);
+	xassert(q->magic == RING_QUEUE_MAGIC);
+
+	deq_pos = __atomic_load_n(&q->deq_pos, __ATOMIC_RELAXED);
+	enq_pos = __atomic_load_n(&q->enq_pos, __ATOMIC_RELAXED);
+	if (enq_pos <= deq_pos)
+		return 0;
+	return (uint32_t) MIN(enq_pos - deq_pos, q->mask + 1);
+}
+
+extern void ring_queue_destroy(ring_queue_t *q)
+{
+	void *x;
+
+	if (!q)
+		return;
+	xassert(q->magic == RING_QUEUE_MAGIC);
+
+	while ((x = _dequeue(q))) {
+		if (q->del)
+			q->del(x);
+	}
+	slurm_mutex_destroy(&q->mutex);
+	slurm_cond_destroy(&q->not_empty);
+	slurm_cond_destroy(&q->not_full);
+	xfree(q->cells);
+	q->magic = ~RING_QUEUE_MAGIC;
+	xfree(q);
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************\
+ *  ring_queue.h - bounded lock-free multi-producer multi-consumer queue
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _RING_QUEUE_H
+#define _RING_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "src/common/list.h"
+
+/*
+ * A ring_queue is a fixed size FIFO of pointers for producer/consumer hand
+ * off between threads. Enqueue and dequeue never take a lock; only the
+ * blocking variants do, and only while they have to wait.
+ *
+ * Unlike a List it cannot be iterated, searched or grown, so it suits queues
+ * whose items are only ever appended and removed in order.
+ */
+typedef struct ring_queue ring_queue_t;
+
+/*
+ * Create a queue holding up to [size] items, rounded up to a power of two.
+ * The deletion function [f] is called for items left in the queue when it is
+ * destroyed, if not NULL.
+ */
+extern ring_queue_t *ring_queue_create(uint32_t size, ListDelF f);
+
+/*
+ * Destroy queue [q] and the items left in it. No thread may be using it.
+ */
+extern void ring_queue_destroy(ring_queue_t *q);
+
+/*
+ * Append [x] to queue [q] without waiting. [x] must not be NULL.
+ * RET true on success, false if the queue is full
+ */
+extern bool ring_queue_try_enqueue(ring_queue_t *q, void *x);
+
+/*
+ * Remove the oldest item from queue [q] without waiting.
+ * RET the item or NULL if the queue is empty
+ */
+extern void *ring_queue_try_dequeue(ring_queue_t *q);
+
+/*
+ * Append [x] to queue [q], waiting while it is full until it is half empty.
+ * [x] must not be NULL.
+ * RET true on success, false if the queue was shut down
+ */
+extern bool ring_queue_enqueue(ring_queue_t *q, void *x);
+
+/*
+ * Remove the oldest item from queue [q], waiting up to [timeout]
+ * milliseconds for one while it is empty, forever if [timeout] is negative.
+ * RET the item or NULL on timeout or once the queue was shut down and
+ *     drained
+ */
+extern void *ring_queue_dequeue(ring_queue_t *q, int timeout);
+
+/*
+ * Wake every thread waiting on queue [q] and make the blocking calls return
+ * without waiting from now on. Items still queued can be dequeued.
+ */
+extern void ring_queue_shutdown(ring_queue_t *q);
+
+/*
+ * Return the number of items in queue [q]. The value may be stale by the
+ * time it is used if other threads are using the queue.
+ */
+extern uint32_t ring_queue_count(ring_queue_t *q);
+
+#endif /* !_RING_QUEUE_H */
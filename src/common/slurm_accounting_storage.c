@@ -193,6 +193,9 @@ typedef struct slurm_acct_storage_ops {
 	int  (*job_suspend)        (void *db_conn, job_record_t *job_ptr);
 	List (*get_jobs_cond)      (void *db_conn, uint32_t uid,
 				    slurmdb_job_cond_t *job_cond);
+	List (*get_jobs_page)      (void *db_conn, uint32_t uid,
+				    slurmdb_job_cond_t *job_cond,
+				    slurmdb_job_cursor_t *cursor);
 	int (*archive_dump)        (void *db_conn,
 				    slurmdb_archive_cond_t *arch_cond);
 	int (*archive_load)        (void *db_conn,
@@ -277,6 +280,7 @@ static const char *syms[] = {
 	"jobacct_storage_p_step_complete",
 	"jobacct_storage_p_suspend",
 	"jobacct_storage_p_get_jobs_cond",
+	"jobacct_storage_p_get_jobs_page",
 	"jobacct_storage_p_archive",
 	"jobacct_storage_p_archive_load",
 	"acct_storage_p_update_shares_used",
@@ -974,6 +978,15 @@ extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 	return ret_list;
 }
 
+extern List jobacct_storage_g_get_jobs_page(void *db_conn, uint32_t uid,
+					    slurmdb_job_cond_t *job_cond,
+					    slurmdb_job_cursor_t *cursor)
+{
+	if (slurm_acct_storage_init(NULL) < 0)
+		return NULL;
+	return (*(ops.get_jobs_page))(db_conn, uid, job_cond, cursor);
+}
+
 /*
  * expire old info from the storage
  */
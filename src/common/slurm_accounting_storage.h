@@ -647,6 +647,16 @@ extern int jobacct_storage_g_job_suspend(void *db_conn,
 extern List jobacct_storage_g_get_jobs_cond(void *db_conn, uint32_t uid,
 					    slurmdb_job_cond_t *job_cond);
 
+/*
+ * get info from the storage a page at a time
+ * IN/OUT: cursor - position of the page, see slurmdb_jobs_get_page()
+ * returns List of jobacct_job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_g_get_jobs_page(void *db_conn, uint32_t uid,
+					    slurmdb_job_cond_t *job_cond,
+					    slurmdb_job_cursor_t *cursor);
+
 /*
  * expire old info from the storage
  */
@@ -53,12 +53,25 @@
 #include "src/common/xmalloc.h"
 #include "src/common/slurm_acct_gather.h"
 #include "src/common/slurm_jobacct_gather.h"
+#include "src/slurmd/slurmstepd/slurmstepd_job.h"
 
 extern int acct_gather_filesystem_init(void); /* load the plugin */
 extern int acct_gather_filesystem_fini(void); /* unload the plugin */
 extern int acct_gather_filesystem_startpoll(uint32_t);
 extern int acct_gather_filesystem_g_node_update(void);
 extern int acct_gather_filesystem_g_get_data(acct_gather_data_t *data);
+
+/*
+ * Called once per step on each node from slurmstepd, before launching tasks.
+ * Lets the plugin collect counters for this job rather than the whole node.
+ *
+ * Parameters
+ *	job -- structure defining a slurm job
+ *
+ * Returns -- SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int acct_gather_filesystem_g_node_step_start(stepd_step_rec_t *job);
+
 /*
  * Define plugin local conf for acct_gather.conf
  *
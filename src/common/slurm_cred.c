@@ -2345,12 +2345,43 @@ static void _sbcast_cache_del(void *x)
 	xfree(x);
 }
 
+/* Return true if an sbcast credential is in the cache, purging expired ones */
+static bool _sbcast_cache_find(sbcast_cred_t *sbcast_cred, time_t now)
+{
+	struct sbcast_cache *next_cache_rec;
+	ListIterator sbcast_iter;
+	uint32_t sig_num = 0;
+	bool cache_match_found = false;
+	int i;
+
+	for (i = 0; i < sbcast_cred->siglen; i += 2) {
+		sig_num += (sbcast_cred->signature[i] << 8) +
+			   sbcast_cred->signature[i+1];
+	}
+
+	sbcast_iter = list_iterator_create(sbcast_cache_list);
+	while ((next_cache_rec =
+		(struct sbcast_cache *) list_next(sbcast_iter))) {
+		if ((next_cache_rec->expire == sbcast_cred->expiration) &&
+		    (next_cache_rec->value  == sig_num)) {
+			cache_match_found = true;
+			break;
+		}
+		if (next_cache_rec->expire <= now)
+			list_delete_item(sbcast_iter);
+	}
+	list_iterator_destroy(sbcast_iter);
+
+	return cache_match_found;
+}
+
 /* Extract contents of an sbcast credential verifying the digital signature.
  * NOTE: We can only perform the full credential validation once with
  *	Munge without generating a credential replay error, so we only
  *	verify the credential for block one. All others must have a
  *	recent signature on file (in our cache) or the slurmd must have
- *	recently been restarted.
+ *	recently been restarted. The block one of further files sent with
+ *	the same credential is accepted as replayed if in our cache.
  * RET 0 on success, -1 on error */
 sbcast_cred_arg_t *extract_sbcast_cred(slurm_cred_ctx_t ctx,
 				       sbcast_cred_t *sbcast_cred,
@@ -2358,9 +2389,7 @@ sbcast_cred_arg_t *extract_sbcast_cred(slurm_cred_ctx_t ctx,
 				       uint16_t protocol_version)
 {
 	sbcast_cred_arg_t *arg;
-	struct sbcast_cache *next_cache_rec;
-	uint32_t sig_num = 0;
-	int i, rc;
+	int rc;
 	time_t now = time(NULL);
 	Buf buffer;
 
@@ -2373,6 +2402,8 @@ sbcast_cred_arg_t *extract_sbcast_cred(slurm_cred_ctx_t ctx,
 		return NULL;
 
 	if (block_no == 1) {
+		char *err_str = NULL;
+
 		buffer = init_buf(4096);
 		_pack_sbcast_cred(sbcast_cred, buffer, protocol_version);
 		/* NOTE: the verification checks that the credential was
@@ -2382,35 +2413,21 @@ sbcast_cred_arg_t *extract_sbcast_cred(slurm_cred_ctx_t ctx,
 			sbcast_cred->signature, sbcast_cred->siglen);
 		free_buf(buffer);
 
-		if (rc) {
-			error("sbcast_cred verify: %s",
-			      (*(ops.cred_str_error))(rc));
+		if (rc)
+			err_str = (char *)(*(ops.cred_str_error))(rc);
+		if (!rc) {
+			_sbast_cache_add(sbcast_cred);
+		} else if (xstrcmp(err_str, "Credential replayed") ||
+			   !_sbcast_cache_find(sbcast_cred, now)) {
+			error("sbcast_cred verify: %s", err_str);
 			return NULL;
 		}
-		_sbast_cache_add(sbcast_cred);
 
 	} else {
 		char *err_str = NULL;
-		bool cache_match_found = false;
-		ListIterator sbcast_iter;
-		for (i = 0; i < sbcast_cred->siglen; i += 2) {
-			sig_num += (sbcast_cred->signature[i] << 8) +
-				   sbcast_cred->signature[i+1];
-		}
-
-		sbcast_iter = list_iterator_create(sbcast_cache_list);
-		while ((next_cache_rec = 
-			(struct sbcast_cache *) list_next(sbcast_iter))) {
-			if ((next_cache_rec->expire == sbcast_cred->expiration) &&
-			    (next_cache_rec->value  == sig_num)) {
-				cache_match_found = true;
-				break;
-			}
-			if (next_cache_rec->expire <= now)
-				list_delete_item(sbcast_iter);
-		}
-		list_iterator_destroy(sbcast_iter);
+		bool cache_match_found;
 
+		cache_match_found = _sbcast_cache_find(sbcast_cred, now);
 		if (!cache_match_found) {
 			error("sbcast_cred verify: signature not in cache");
 			if (SLURM_DIFFTIME(now, cred_restart_time) > 60)
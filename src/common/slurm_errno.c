@@ -373,6 +373,8 @@ static slurm_errtab_t slurm_errtab[] = {
 	{ ESLURM_DEFER,
 	  "Immediate execution impossible. "
 	  "Individual job submission scheduling attempts deferred"},
+	{ ESLURM_JOB_LIST_TOO_LONG,
+	  "Too many jobs in one submission (see max_submit_job_list)" },
 
 	/* slurmd error codes */
 	{ ESLURMD_PIPE_ERROR_ON_TASK_SPAWN,
@@ -435,6 +437,12 @@ static slurm_errtab_t slurm_errtab[] = {
 	  "Job step is not currently suspended"                 },
 	{ ESLURMD_INVALID_SOCKET_NAME_LEN,
 	  "Unix socket name exceeded maximum length"		},
+	{ ESLURMD_FILE_BCAST_CURRENT,
+	  "Broadcast file already current on node"		},
+	{ ESLURMD_FILE_BCAST_ANY_ORDER,
+	  "Broadcast file blocks accepted in any order"		},
+	{ ESLURMD_BURST_BUFFER_STAGE_IN,
+	  "Burst buffer stage-in failed on node"		},
 
 	/* slurmd errors in user batch job */
 	{ ESCRIPT_CHDIR_FAILED,
@@ -4043,7 +4043,7 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 	/*
 	 * Pack header into buffer for transmission
 	 */
-	buffer = init_buf(BUF_SIZE);
+	buffer = init_buf_pooled(BUF_SIZE);
 	pack_header(&header, buffer);
 
 	/*
@@ -4053,7 +4053,7 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 	(void) g_slurm_auth_destroy(auth_cred);
 	if (rc) {
 		error("authentication: %m");
-		free_buf(buffer);
+		free_buf_pooled(buffer);
 		slurm_seterrno_ret(SLURM_PROTOCOL_AUTHENTICATION_ERROR);
 	}
 
@@ -4092,7 +4092,7 @@ int slurm_send_node_msg(int fd, slurm_msg_t * msg)
 			      msg->msg_type);
 	}
 
-	free_buf(buffer);
+	free_buf_pooled(buffer);
 	return rc;
 }
 
@@ -1017,6 +1017,8 @@ extern void slurm_free_prolog_launch_msg(prolog_launch_msg_t * msg)
 
 	if (msg) {
 		xfree(msg->alias_list);
+		xfree(msg->bb_dir);
+		xfree(msg->burst_buffer);
 		FREE_NULL_LIST(msg->job_gres_info);
 		xfree(msg->nodes);
 		xfree(msg->partition);
@@ -1372,6 +1374,8 @@ extern void slurm_free_kill_job_msg(kill_job_msg_t * msg)
 {
 	if (msg) {
 		int i;
+		xfree(msg->bb_dir);
+		xfree(msg->burst_buffer);
 		FREE_NULL_LIST(msg->job_gres_info);
 		xfree(msg->nodes);
 		select_g_select_jobinfo_free(msg->select_jobinfo);
@@ -2596,6 +2600,14 @@ extern void slurm_free_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg)
 	xfree(msg);
 }
 
+extern void slurm_free_node_heartbeat_msg(node_heartbeat_msg_t *msg)
+{
+	if (msg) {
+		xfree(msg->node_name);
+		xfree(msg);
+	}
+}
+
 /*
  * structured as a static lookup table, which allows this
  * to be thread safe while avoiding any heap allocation
@@ -4069,6 +4081,13 @@ extern void slurm_free_submit_response_response_msg(submit_response_msg_t * msg)
 	}
 }
 
+/* List destructor for RESPONSE_SUBMIT_BATCH_JOB_LIST elements */
+extern void slurm_destroy_submit_response_object(void *object)
+{
+	slurm_free_submit_response_response_msg(
+		(submit_response_msg_t *) object);
+}
+
 
 /*
  * slurm_free_ctl_conf - free slurm control information response message
@@ -5006,6 +5025,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 	case RESPONSE_PING_SLURMD:
 		slurm_free_ping_slurmd_resp(data);
 		break;
+	case MESSAGE_NODE_HEARTBEAT:
+		slurm_free_node_heartbeat_msg(data);
+		break;
 	case RESPONSE_JOB_ARRAY_ERRORS:
 		slurm_free_job_array_resp(data);
 		break;
@@ -5090,7 +5112,9 @@ extern int slurm_free_msg_data(slurm_msg_type_t type, void *data)
 		break;
 	case REQUEST_JOB_PACK_ALLOCATION:
 	case REQUEST_SUBMIT_BATCH_JOB_PACK:
+	case REQUEST_SUBMIT_BATCH_JOB_LIST:
 	case RESPONSE_JOB_PACK_ALLOCATION:
+	case RESPONSE_SUBMIT_BATCH_JOB_LIST:
 		FREE_NULL_LIST(data);
 		break;
 	case REQUEST_SET_FS_DAMPENING_FACTOR:
@@ -5271,6 +5295,8 @@ rpc_num2string(uint16_t opcode)
 		return "RESPONSE_LICENSE_INFO";
 	case REQUEST_SET_FS_DAMPENING_FACTOR:
 		return "REQUEST_SET_FS_DAMPENING_FACTOR,";
+	case MESSAGE_NODE_HEARTBEAT:
+		return "MESSAGE_NODE_HEARTBEAT";
 
 	case REQUEST_BUILD_INFO:				/* 2001 */
 		return "REQUEST_BUILD_INFO";
@@ -5453,6 +5479,10 @@ rpc_num2string(uint16_t opcode)
 		return "REQUEST_JOB_PACK_ALLOC_INFO";
 	case REQUEST_SUBMIT_BATCH_JOB_PACK:
 		return "REQUEST_SUBMIT_BATCH_JOB_PACK";
+	case REQUEST_SUBMIT_BATCH_JOB_LIST:
+		return "REQUEST_SUBMIT_BATCH_JOB_LIST";
+	case RESPONSE_SUBMIT_BATCH_JOB_LIST:
+		return "RESPONSE_SUBMIT_BATCH_JOB_LIST";
 
 	case REQUEST_JOB_STEP_CREATE:				/* 5001 */
 		return "REQUEST_JOB_STEP_CREATE";
@@ -5649,6 +5679,11 @@ slurm_bb_flags2str(uint32_t bb_flags)
 			strcat(bb_str, ",");
 		strcat(bb_str, "SetExecHost");
 	}
+	if (bb_flags & BB_FLAG_STAGE_ON_CONTROLLER) {
+		if (bb_str[0])
+			strcat(bb_str, ",");
+		strcat(bb_str, "StageOnController");
+	}
 	if (bb_flags & BB_FLAG_TEARDOWN_FAILURE) {
 		if (bb_str[0])
 			strcat(bb_str, ",");
@@ -5673,6 +5708,8 @@ slurm_bb_str2flags(char *bb_str)
 		bb_flags |= BB_FLAG_PRIVATE_DATA;
 	if (bb_str && strstr(bb_str, "SetExecHost"))
 		bb_flags |= BB_FLAG_SET_EXEC_HOST;
+	if (bb_str && strstr(bb_str, "StageOnController"))
+		bb_flags |= BB_FLAG_STAGE_ON_CONTROLLER;
 	if (bb_str && strstr(bb_str, "TeardownFailure"))
 		bb_flags |= BB_FLAG_TEARDOWN_FAILURE;
 
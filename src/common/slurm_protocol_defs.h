@@ -224,6 +224,7 @@ typedef enum {
 	RESPONSE_LICENSE_INFO,
 	REQUEST_SET_FS_DAMPENING_FACTOR,
 	RESPONSE_NODE_REGISTRATION,
+	MESSAGE_NODE_HEARTBEAT,
 
 	PERSIST_RC = 1433, /* To mirror the DBD_RC this is replacing */
 	/* Don't make any messages in this range as this is what the DBD uses
@@ -329,6 +330,8 @@ typedef enum {
 	RESPONSE_JOB_PACK_ALLOCATION,
 	REQUEST_JOB_PACK_ALLOC_INFO,
 	REQUEST_SUBMIT_BATCH_JOB_PACK,
+	REQUEST_SUBMIT_BATCH_JOB_LIST,
+	RESPONSE_SUBMIT_BATCH_JOB_LIST,	/* 4030 */
 
 	REQUEST_CTLD_MULT_MSG = 4500,
 	RESPONSE_CTLD_MULT_MSG,
@@ -965,6 +968,10 @@ typedef struct control_status_msg {
 #define SIG_NODE_FAIL	998	/* Dummy signal value to signify node failure */
 #define SIG_FAILURE	999	/* Dummy signal value to signify sys failure */
 typedef struct kill_job_msg {
+	uint64_t bb_bandwidth;	/* burst buffer drain bytes/sec, 0 = no limit */
+	char *bb_dir;		/* burst buffer dir to drain on node or NULL */
+	uint32_t bb_timeout;	/* burst buffer drain seconds, 0 = no limit */
+	char *burst_buffer;	/* burst buffer specification */
 	List job_gres_info;	/* Used to set Epilog environment variables */
 	uint32_t job_id;
 	uint32_t job_state;
@@ -1007,6 +1014,13 @@ typedef struct reattach_tasks_response_msg {
 
 typedef struct prolog_launch_msg {
 	char *alias_list;		/* node name/address/hostname aliases */
+	uint64_t bb_bandwidth;		/* burst buffer stage-in bytes/sec,
+					 * 0 = no limit */
+	char *bb_dir;			/* burst buffer dir to stage into on
+					 * node or NULL */
+	uint32_t bb_timeout;		/* burst buffer stage-in seconds,
+					 * 0 = no limit */
+	char *burst_buffer;		/* burst buffer specification */
 	slurm_cred_t *cred;
 	uint32_t gid;
 	List job_gres_info;		/* Used to set Prolog env vars */
@@ -1127,11 +1141,17 @@ enum compress_type {
 	COMPRESS_LZ4		/* lz4 compression */
 };
 
+#define FILE_BCAST_NONE		0x0000
+#define FILE_BCAST_FORCE	0x0001	/* replace existing file */
+#define FILE_BCAST_MKDIR	0x0002	/* create missing parent directories */
+#define FILE_BCAST_UPDATE	0x0004	/* keep file of same size and mtime */
+#define FILE_BCAST_ANY_ORDER	0x0008	/* blocks may arrive in any order */
+
 typedef struct file_bcast_msg {
 	char *fname;		/* name of the destination file */
 	uint32_t block_no;	/* block number of this data */
 	uint16_t last_block;	/* last block of bcast if set (flag) */
-	uint16_t force;		/* replace existing file if set (flag) */
+	uint16_t flags;		/* FILE_BCAST_* flags */
 	uint16_t compress;	/* compress file if set, use compress_type */
 	uint16_t modes;		/* access rights for destination file */
 	uint32_t uid;		/* owner for destination file */
@@ -1185,6 +1205,12 @@ typedef struct ping_slurmd_resp_msg {
 	uint64_t free_mem;	/* Free memory in MiB */
 } ping_slurmd_resp_msg_t;
 
+typedef struct node_heartbeat_msg {
+	uint32_t cpu_load;	/* CPU load * 100 */
+	uint64_t free_mem;	/* Free memory in MiB */
+	char *node_name;	/* name of the sending node */
+} node_heartbeat_msg_t;
+
 typedef struct license_info_request_msg {
 	time_t last_update;
 	uint16_t show_flags;
@@ -1366,6 +1392,7 @@ extern void slurm_free_forward_data_msg(forward_data_msg_t *msg);
 extern void slurm_free_comp_msg_list(void *x);
 extern void slurm_free_composite_msg(composite_msg_t *msg);
 extern void slurm_free_ping_slurmd_resp(ping_slurmd_resp_msg_t *msg);
+extern void slurm_free_node_heartbeat_msg(node_heartbeat_msg_t *msg);
 
 #define	slurm_free_timelimit_msg(msg) \
 	slurm_free_kill_job_msg(msg)
@@ -1454,6 +1481,7 @@ extern void slurm_free_job_step_create_response_msg(
 		job_step_create_response_msg_t * msg);
 extern void slurm_free_submit_response_response_msg(
 		submit_response_msg_t * msg);
+extern void slurm_destroy_submit_response_object(void *object);
 extern void slurm_free_ctl_conf(slurm_ctl_conf_info_msg_t * config_ptr);
 extern void slurm_free_job_info_msg(job_info_msg_t * job_buffer_ptr);
 extern void slurm_free_job_step_info_response_msg(
@@ -1588,6 +1588,56 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* _pack_submit_response_list_msg
+ * packs a list of submit_response_msg_t, one per job of a
+ * REQUEST_SUBMIT_BATCH_JOB_LIST
+ */
+static void _pack_submit_response_list_msg(List resp_list, Buf buffer,
+					   uint16_t protocol_version)
+{
+	submit_response_msg_t *resp;
+	ListIterator iter;
+	uint32_t cnt = 0;
+
+	if (resp_list)
+		cnt = list_count(resp_list);
+	pack32(cnt, buffer);
+	if (cnt == 0)
+		return;
+
+	iter = list_iterator_create(resp_list);
+	while ((resp = (submit_response_msg_t *) list_next(iter)))
+		_pack_submit_response_msg(resp, buffer, protocol_version);
+	list_iterator_destroy(iter);
+}
+
+static int _unpack_submit_response_list_msg(List *resp_list, Buf buffer,
+					    uint16_t protocol_version)
+{
+	submit_response_msg_t *resp;
+	uint32_t cnt = 0, i;
+
+	*resp_list = list_create(slurm_destroy_submit_response_object);
+
+	safe_unpack32(&cnt, buffer);
+	if (cnt > remaining_buf(buffer))
+		goto unpack_error;
+
+	for (i = 0; i < cnt; i++) {
+		resp = NULL;
+		if (_unpack_submit_response_msg(&resp, buffer,
+						protocol_version) !=
+		    SLURM_SUCCESS)
+			goto unpack_error;
+		list_append(*resp_list, resp);
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	FREE_NULL_LIST(*resp_list);
+	return SLURM_ERROR;
+}
+
 static int _unpack_node_info_msg(node_info_msg_t **msg, Buf buffer,
 				 uint16_t protocol_version)
 {
@@ -2417,6 +2467,11 @@ _pack_kill_job_msg(kill_job_msg_t * msg, Buf buffer, uint16_t protocol_version)
 		pack_time(msg->start_time, buffer);
 		pack32(msg->step_id,  buffer);
 		pack_time(msg->time, buffer);
+		/* Appended, an older slurmd ignores them */
+		packstr(msg->bb_dir, buffer);
+		packstr(msg->burst_buffer, buffer);
+		pack64(msg->bb_bandwidth, buffer);
+		pack32(msg->bb_timeout, buffer);
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32(msg->job_id,  buffer);
 		pack32(msg->pack_jobid,  buffer);
@@ -2466,6 +2521,15 @@ _unpack_kill_job_msg(kill_job_msg_t ** msg, Buf buffer,
 		safe_unpack_time(&(tmp_ptr->start_time), buffer);
 		safe_unpack32(&(tmp_ptr->step_id),  buffer);
 		safe_unpack_time(&(tmp_ptr->time), buffer);
+		/* An older slurmctld does not send the burst buffer */
+		if (remaining_buf(buffer) >= sizeof(uint32_t)) {
+			safe_unpackstr_xmalloc(&tmp_ptr->bb_dir,
+					       &uint32_tmp, buffer);
+			safe_unpackstr_xmalloc(&tmp_ptr->burst_buffer,
+					       &uint32_tmp, buffer);
+			safe_unpack64(&tmp_ptr->bb_bandwidth, buffer);
+			safe_unpack32(&tmp_ptr->bb_timeout, buffer);
+		}
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&(tmp_ptr->job_id),  buffer);
 		safe_unpack32(&(tmp_ptr->pack_jobid),  buffer);
@@ -7020,6 +7084,64 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+/* _pack_job_desc_list32_msg
+ * packs a list of job_desc structs of any length, as for
+ * REQUEST_SUBMIT_BATCH_JOB_LIST
+ * IN job_req_list - pointer to the job descriptors to pack
+ * IN/OUT buffer - destination of the pack, contains pointers that are
+ *			automatically updated
+ */
+static void
+_pack_job_desc_list32_msg(List job_req_list, Buf buffer,
+			  uint16_t protocol_version)
+{
+	job_desc_msg_t *req;
+	ListIterator iter;
+	uint32_t cnt = 0;
+
+	if (job_req_list)
+		cnt = list_count(job_req_list);
+	pack32(cnt, buffer);
+	if (cnt == 0)
+		return;
+
+	iter = list_iterator_create(job_req_list);
+	while ((req = (job_desc_msg_t *) list_next(iter))) {
+		_pack_job_desc_msg(req, buffer, protocol_version);
+	}
+	list_iterator_destroy(iter);
+}
+
+static int
+_unpack_job_desc_list32_msg(List *job_req_list, Buf buffer,
+			    uint16_t protocol_version)
+{
+	job_desc_msg_t *req;
+	uint32_t cnt = 0, i;
+
+	*job_req_list = NULL;
+
+	safe_unpack32(&cnt, buffer);
+	if (cnt == 0)
+		return SLURM_SUCCESS;
+	if (cnt > remaining_buf(buffer))
+		goto unpack_error;
+
+	*job_req_list = list_create(_free_job_desc_list);
+	for (i = 0; i < cnt; i++) {
+		req = NULL;
+		if (_unpack_job_desc_msg(&req, buffer, protocol_version) !=
+		    SLURM_SUCCESS)
+			goto unpack_error;
+		list_append(*job_req_list, req);
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	FREE_NULL_LIST(*job_req_list);
+	return SLURM_ERROR;
+}
+
 static void
 _pack_job_alloc_info_msg(job_alloc_info_msg_t *job_desc_ptr, Buf buffer,
 			 uint16_t protocol_version)
@@ -8467,6 +8589,11 @@ static void _pack_prolog_launch_msg(prolog_launch_msg_t *msg,
 			      buffer);
 		slurm_cred_pack(msg->cred, buffer, protocol_version);
 		packstr(msg->user_name, buffer);
+		/* Appended, an older slurmd ignores them */
+		packstr(msg->bb_dir, buffer);
+		packstr(msg->burst_buffer, buffer);
+		pack64(msg->bb_bandwidth, buffer);
+		pack32(msg->bb_timeout, buffer);
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		pack32(msg->job_id, buffer);
 		pack32(msg->pack_job_id, buffer);
@@ -8544,6 +8671,15 @@ static int _unpack_prolog_launch_msg(prolog_launch_msg_t **msg,
 
 		safe_unpackstr_xmalloc(&launch_msg_ptr->user_name, &uint32_tmp,
 				       buffer);
+		/* An older slurmctld does not send the burst buffer */
+		if (remaining_buf(buffer) >= sizeof(uint32_t)) {
+			safe_unpackstr_xmalloc(&launch_msg_ptr->bb_dir,
+					       &uint32_tmp, buffer);
+			safe_unpackstr_xmalloc(&launch_msg_ptr->burst_buffer,
+					       &uint32_tmp, buffer);
+			safe_unpack64(&launch_msg_ptr->bb_bandwidth, buffer);
+			safe_unpack32(&launch_msg_ptr->bb_timeout, buffer);
+		}
 	} else if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
 		safe_unpack32(&launch_msg_ptr->job_id, buffer);
 		safe_unpack32(&launch_msg_ptr->pack_job_id, buffer);
@@ -10186,6 +10322,42 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void _pack_node_heartbeat_msg(node_heartbeat_msg_t *msg,
+				     Buf buffer, uint16_t protocol_version)
+{
+	xassert(msg);
+
+	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		pack32(msg->cpu_load, buffer);
+		pack64(msg->free_mem, buffer);
+		packstr(msg->node_name, buffer);
+	}
+}
+
+static int _unpack_node_heartbeat_msg(node_heartbeat_msg_t **msg_ptr,
+				      Buf buffer, uint16_t protocol_version)
+{
+	node_heartbeat_msg_t *msg;
+	uint32_t uint32_tmp;
+
+	xassert(msg_ptr);
+	msg = xmalloc(sizeof(node_heartbeat_msg_t));
+	*msg_ptr = msg;
+
+	if (protocol_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		safe_unpack32(&msg->cpu_load, buffer);
+		safe_unpack64(&msg->free_mem, buffer);
+		safe_unpackstr_xmalloc(&msg->node_name, &uint32_tmp, buffer);
+	}
+
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurm_free_node_heartbeat_msg(msg);
+	*msg_ptr = NULL;
+	return SLURM_ERROR;
+}
+
 static void _pack_file_bcast(file_bcast_msg_t * msg , Buf buffer,
 			     uint16_t protocol_version)
 {
@@ -10197,7 +10369,8 @@ static void _pack_file_bcast(file_bcast_msg_t * msg , Buf buffer,
 		pack32(msg->block_no, buffer);
 		pack16(msg->compress, buffer);
 		pack16(msg->last_block, buffer);
-		pack16(msg->force, buffer);
+		/* Older slurmd treat any non-zero value here as force */
+		pack16((msg->flags & FILE_BCAST_FORCE) ? 1 : 0, buffer);
 		pack16(msg->modes, buffer);
 
 		pack32(msg->uid, buffer);
@@ -10214,12 +10387,18 @@ static void _pack_file_bcast(file_bcast_msg_t * msg , Buf buffer,
 		pack64(msg->file_size, buffer);
 		packmem (msg->block, msg->block_len, buffer);
 		pack_sbcast_cred(msg->cred, buffer, protocol_version);
+		/*
+		 * The full flags follow the credential, where an older slurmd
+		 * never looks for them.
+		 */
+		pack16(msg->flags, buffer);
 	}
 }
 
 static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
 			      uint16_t protocol_version)
 {
+	uint16_t uint16_tmp = 0;
 	uint32_t uint32_tmp = 0;
 	file_bcast_msg_t *msg ;
 
@@ -10232,7 +10411,7 @@ static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
 		safe_unpack32(&msg->block_no, buffer);
 		safe_unpack16(&msg->compress, buffer);
 		safe_unpack16(&msg->last_block, buffer);
-		safe_unpack16(&msg->force, buffer);
+		safe_unpack16(&uint16_tmp, buffer);
 		safe_unpack16(&msg->modes, buffer);
 
 		safe_unpack32(&msg->uid, buffer);
@@ -10254,6 +10433,12 @@ static int _unpack_file_bcast(file_bcast_msg_t ** msg_ptr , Buf buffer,
 		msg->cred = unpack_sbcast_cred(buffer, protocol_version);
 		if (msg->cred == NULL)
 			goto unpack_error;
+
+		/* An older sbcast only sends the force value */
+		if (remaining_buf(buffer) >= sizeof(uint16_t))
+			safe_unpack16(&msg->flags, buffer);
+		else if (uint16_tmp)
+			msg->flags = FILE_BCAST_FORCE;
 	}
 
 	return SLURM_SUCCESS;
@@ -11719,6 +11904,14 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		_pack_job_desc_list_msg((List) msg->data, buffer,
 					msg->protocol_version);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOB_LIST:
+		_pack_job_desc_list32_msg((List) msg->data, buffer,
+					  msg->protocol_version);
+		break;
+	case RESPONSE_SUBMIT_BATCH_JOB_LIST:
+		_pack_submit_response_list_msg((List) msg->data, buffer,
+					       msg->protocol_version);
+		break;
 	case RESPONSE_JOB_PACK_ALLOCATION:
 		_pack_job_info_list_msg((List) msg->data, buffer,
 					msg->protocol_version);
@@ -12205,6 +12398,10 @@ pack_msg(slurm_msg_t const *msg, Buf buffer)
 		_pack_ping_slurmd_resp((ping_slurmd_resp_msg_t *)msg->data,
 				       buffer, msg->protocol_version);
 		break;
+	case MESSAGE_NODE_HEARTBEAT:
+		_pack_node_heartbeat_msg((node_heartbeat_msg_t *)msg->data,
+					 buffer, msg->protocol_version);
+		break;
 	case REQUEST_LICENSE_INFO:
 		 _pack_license_info_request_msg((license_info_request_msg_t *)
 						msg->data,
@@ -12369,6 +12566,16 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 		rc = _unpack_job_desc_list_msg((List *) &(msg->data),
 					       buffer, msg->protocol_version);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOB_LIST:
+		rc = _unpack_job_desc_list32_msg((List *) &(msg->data),
+						 buffer,
+						 msg->protocol_version);
+		break;
+	case RESPONSE_SUBMIT_BATCH_JOB_LIST:
+		rc = _unpack_submit_response_list_msg((List *) &(msg->data),
+						      buffer,
+						      msg->protocol_version);
+		break;
 	case RESPONSE_JOB_PACK_ALLOCATION:
 		rc = _unpack_job_info_list_msg((List *) &(msg->data),
 					       buffer, msg->protocol_version);
@@ -12901,6 +13108,11 @@ unpack_msg(slurm_msg_t * msg, Buf buffer)
 					      &msg->data, buffer,
 					      msg->protocol_version);
 		break;
+	case MESSAGE_NODE_HEARTBEAT:
+		rc = _unpack_node_heartbeat_msg((node_heartbeat_msg_t **)
+						&msg->data, buffer,
+						msg->protocol_version);
+		break;
 	case RESPONSE_LICENSE_INFO:
 		rc = _unpack_license_info_msg((license_info_msg_t **)&(msg->data),
 					      buffer,
@@ -81,10 +81,13 @@
 #define	bit_clear_all		slurm_bit_clear_all
 #define	bit_ffc			slurm_bit_ffc
 #define	bit_ffs			slurm_bit_ffs
+#define	bit_ffs_from_bit	slurm_bit_ffs_from_bit
 #define	bit_free		slurm_bit_free
 #define	bit_realloc		slurm_bit_realloc
 #define	bit_size		slurm_bit_size
 #define	bit_and			slurm_bit_and
+#define	bit_and_count		slurm_bit_and_count
+#define	bit_and_not_any		slurm_bit_and_not_any
 #define	bit_not			slurm_bit_not
 #define	bit_or			slurm_bit_or
 #define	bit_set_count		slurm_bit_set_count
@@ -210,6 +213,7 @@
 #define	log_alter		slurm_log_alter
 #define	log_alter_with_fp	slurm_log_alter_with_fp
 #define	log_set_fpfx		slurm_log_set_fpfx
+#define	log_set_async		slurm_log_set_async
 #define	log_fp			slurm_log_fp
 #define	log_has_data		slurm_log_has_data
 #define	log_flush		slurm_log_flush
@@ -231,8 +235,11 @@
 /* pack.[ch] functions */
 #define	create_buf		slurm_create_buf
 #define	free_buf		slurm_free_buf
+#define	free_buf_pooled		slurm_free_buf_pooled
 #define grow_buf		slurm_grow_buf
 #define	init_buf		slurm_init_buf
+#define	init_buf_pooled		slurm_init_buf_pooled
+#define	reserve_buf		slurm_reserve_buf
 #define	xfer_buf_data		slurm_xfer_buf_data
 #define	pack_time		slurm_pack_time
 #define	unpack_time		slurm_unpack_time
@@ -289,6 +296,16 @@
 #define get_extra_conf_path	slurm_get_extra_conf_path
 #define sort_key_pairs		slurm_sort_key_pairs
 
+/* ring_queue.[ch] functions */
+#define ring_queue_create	slurm_ring_queue_create
+#define ring_queue_destroy	slurm_ring_queue_destroy
+#define ring_queue_try_enqueue	slurm_ring_queue_try_enqueue
+#define ring_queue_try_dequeue	slurm_ring_queue_try_dequeue
+#define ring_queue_enqueue	slurm_ring_queue_enqueue
+#define ring_queue_dequeue	slurm_ring_queue_dequeue
+#define ring_queue_shutdown	slurm_ring_queue_shutdown
+#define ring_queue_count	slurm_ring_queue_count
+
 /* run_in_daemon.[ch] functions */
 #define run_in_daemon           slurm_run_in_daemon
 #define running_in_slurmctld    slurm_running_in_slurmctld
@@ -918,6 +918,12 @@ extern void slurmdb_destroy_event_rec(void *object)
 	}
 }
 
+extern void slurmdb_free_job_cursor_members(slurmdb_job_cursor_t *cursor)
+{
+	if (cursor)
+		xfree(cursor->cluster);
+}
+
 extern void slurmdb_destroy_job_rec(void *object)
 {
 	slurmdb_job_rec_t *job = (slurmdb_job_rec_t *)object;
@@ -117,6 +117,8 @@ extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type)
 		return DBD_GOT_FEDERATIONS;
 	} else if (!xstrcasecmp(msg_type, "Got Jobs")) {
 		return DBD_GOT_JOBS;
+	} else if (!xstrcasecmp(msg_type, "Got Jobs Page")) {
+		return DBD_GOT_JOBS_PAGE;
 	} else if (!xstrcasecmp(msg_type, "Got List")) {
 		return DBD_GOT_LIST;
 	} else if (!xstrcasecmp(msg_type, "Got Problems")) {
@@ -179,6 +181,8 @@ extern slurmdbd_msg_type_t str_2_slurmdbd_msg_type(char *msg_type)
 		return DBD_STEP_START;
 	} else if (!xstrcasecmp(msg_type, "Get Jobs Conditional")) {
 		return DBD_GET_JOBS_COND;
+	} else if (!xstrcasecmp(msg_type, "Get Jobs Page")) {
+		return DBD_GET_JOBS_PAGE;
 	} else if (!xstrcasecmp(msg_type, "Get Transactions")) {
 		return DBD_GET_TXN;
 	} else if (!xstrcasecmp(msg_type, "Got Transactions")) {
@@ -432,6 +436,12 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Got Jobs";
 		break;
+	case DBD_GOT_JOBS_PAGE:
+		if (get_enum) {
+			return "DBD_GOT_JOBS_PAGE";
+		} else
+			return "Got Jobs Page";
+		break;
 	case DBD_GOT_LIST:
 		if (get_enum) {
 			return "DBD_GOT_LIST";
@@ -618,6 +628,12 @@ extern char *slurmdbd_msg_type_2_str(slurmdbd_msg_type_t msg_type, int get_enum)
 		} else
 			return "Get Jobs Conditional";
 		break;
+	case DBD_GET_JOBS_PAGE:
+		if (get_enum) {
+			return "DBD_GET_JOBS_PAGE";
+		} else
+			return "Get Jobs Page";
+		break;
 	case DBD_GET_TXN:
 		if (get_enum) {
 			return "DBD_GET_TXN";
@@ -913,6 +929,10 @@ extern void slurmdbd_free_msg(slurmdbd_msg_t *msg)
 	case DBD_JOB_SUSPEND:
 		slurmdbd_free_job_suspend_msg(msg->data);
 		break;
+	case DBD_GET_JOBS_PAGE:
+	case DBD_GOT_JOBS_PAGE:
+		slurmdbd_free_job_page_msg(msg->data);
+		break;
 	case DBD_MODIFY_ACCOUNTS:
 	case DBD_MODIFY_ASSOCS:
 	case DBD_MODIFY_CLUSTERS:
@@ -1101,6 +1121,16 @@ extern void slurmdbd_free_job_suspend_msg(dbd_job_suspend_msg_t *msg)
 	xfree(msg);
 }
 
+extern void slurmdbd_free_job_page_msg(dbd_job_page_msg_t *msg)
+{
+	if (msg) {
+		slurmdb_destroy_job_cond(msg->cond);
+		slurmdb_free_job_cursor_members(&msg->cursor);
+		FREE_NULL_LIST(msg->my_list);
+		xfree(msg);
+	}
+}
+
 extern void slurmdbd_free_list_msg(dbd_list_msg_t *msg)
 {
 	if (msg) {
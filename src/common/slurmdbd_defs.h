@@ -152,6 +152,8 @@ typedef enum {
 	DBD_GOT_FEDERATIONS,	/* Response to DBD_GET_FEDERATIONS 	*/
 	DBD_MODIFY_FEDERATIONS, /* Modify existing federation 		*/
 	DBD_REMOVE_FEDERATIONS, /* Removing existing federation 	*/
+	DBD_GET_JOBS_PAGE,	/* Get a page of job information	*/
+	DBD_GOT_JOBS_PAGE,	/* Response to DBD_GET_JOBS_PAGE	*/
 
 	SLURM_PERSIST_INIT = 6500, /* So we don't use the
 				    * REQUEST_PERSIST_INIT also used here.
@@ -295,6 +297,13 @@ typedef struct dbd_job_start_msg {
 	char    *work_dir;      /* work dir of job */
 } dbd_job_start_msg_t;
 
+typedef struct {
+	slurmdb_job_cond_t *cond; /* DBD_GET_JOBS_PAGE only */
+	slurmdb_job_cursor_t cursor; /* position of the page */
+	List my_list;		/* DBD_GOT_JOBS_PAGE only, list of
+				 * slurmdb_job_rec_t *'s */
+} dbd_job_page_msg_t;
+
 /* returns a uint32_t along with a return code */
 typedef struct dbd_id_rc_msg {
 	uint32_t job_id;
@@ -414,6 +423,7 @@ extern void slurmdbd_free_job_complete_msg(dbd_job_comp_msg_t *msg);
 extern void slurmdbd_free_job_start_msg(void *in);
 extern void slurmdbd_free_id_rc_msg(void *in);
 extern void slurmdbd_free_job_suspend_msg(dbd_job_suspend_msg_t *msg);
+extern void slurmdbd_free_job_page_msg(dbd_job_page_msg_t *msg);
 extern void slurmdbd_free_list_msg(dbd_list_msg_t *msg);
 extern void slurmdbd_free_modify_msg(dbd_modify_msg_t *msg,
 				     slurmdbd_msg_type_t type);
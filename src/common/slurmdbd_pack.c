@@ -890,6 +890,58 @@ unpack_error:
 	return SLURM_ERROR;
 }
 
+static void _pack_job_page_msg(dbd_job_page_msg_t *msg,
+			       uint16_t rpc_version,
+			       slurmdbd_msg_type_t type, Buf buffer)
+{
+	if (rpc_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		if (type == DBD_GET_JOBS_PAGE)
+			slurmdb_pack_job_cond(msg->cond, rpc_version, buffer);
+		else
+			slurm_pack_list(msg->my_list, slurmdb_pack_job_rec,
+					buffer, rpc_version);
+		packstr(msg->cursor.cluster, buffer);
+		pack16(msg->cursor.done, buffer);
+		pack32(msg->cursor.last_jobid, buffer);
+		pack32(msg->cursor.max_jobs, buffer);
+	}
+}
+
+static int _unpack_job_page_msg(dbd_job_page_msg_t **msg,
+				uint16_t rpc_version,
+				slurmdbd_msg_type_t type, Buf buffer)
+{
+	uint32_t uint32_tmp;
+	dbd_job_page_msg_t *msg_ptr = xmalloc(sizeof(dbd_job_page_msg_t));
+
+	*msg = msg_ptr;
+
+	if (rpc_version >= SLURM_MIN_PROTOCOL_VERSION) {
+		if (type == DBD_GET_JOBS_PAGE) {
+			if (slurmdb_unpack_job_cond((void **)&msg_ptr->cond,
+						    rpc_version, buffer) !=
+			    SLURM_SUCCESS)
+				goto unpack_error;
+		} else if (slurm_unpack_list(&msg_ptr->my_list,
+					     slurmdb_unpack_job_rec,
+					     slurmdb_destroy_job_rec,
+					     buffer, rpc_version) !=
+			   SLURM_SUCCESS)
+			goto unpack_error;
+		safe_unpackstr_xmalloc(&msg_ptr->cursor.cluster, &uint32_tmp,
+				       buffer);
+		safe_unpack16(&msg_ptr->cursor.done, buffer);
+		safe_unpack32(&msg_ptr->cursor.last_jobid, buffer);
+		safe_unpack32(&msg_ptr->cursor.max_jobs, buffer);
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	slurmdbd_free_job_page_msg(msg_ptr);
+	*msg = NULL;
+	return SLURM_ERROR;
+}
+
 static void _pack_step_complete_msg(dbd_step_comp_msg_t *msg,
 				    uint16_t rpc_version, Buf buffer)
 {
@@ -1538,6 +1590,11 @@ extern Buf pack_slurmdbd_msg(slurmdbd_msg_t *req, uint16_t rpc_version)
 				     rpc_version,
 				     buffer);
 		break;
+	case DBD_GET_JOBS_PAGE:
+	case DBD_GOT_JOBS_PAGE:
+		_pack_job_page_msg((dbd_job_page_msg_t *)req->data,
+				   rpc_version, req->msg_type, buffer);
+		break;
 	case DBD_ADD_RESV:
 	case DBD_REMOVE_RESV:
 	case DBD_MODIFY_RESV:
@@ -1744,6 +1801,12 @@ extern int unpack_slurmdbd_msg(slurmdbd_msg_t *resp,
 			(dbd_roll_usage_msg_t **)&resp->data, rpc_version,
 			buffer);
 		break;
+	case DBD_GET_JOBS_PAGE:
+	case DBD_GOT_JOBS_PAGE:
+		rc = _unpack_job_page_msg(
+			(dbd_job_page_msg_t **)&resp->data, rpc_version,
+			resp->msg_type, buffer);
+		break;
 	case DBD_ADD_RESV:
 	case DBD_REMOVE_RESV:
 	case DBD_MODIFY_RESV:
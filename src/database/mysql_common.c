@@ -48,6 +48,10 @@
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/read_config.h"
 
+/* Limits of a multi-row insert, well below max_allowed_packet */
+#define MAX_BATCH_ROWS 1000
+#define MAX_BATCH_SIZE (512 * 1024)
+
 static char *table_defs_table = "table_defs_table";
 
 typedef struct {
@@ -181,6 +185,83 @@ end_it:
 	return rc;
 }
 
+/* NOTE: Ensure that mysql_conn->lock is set on function entry */
+static void _clear_batch(mysql_conn_t *mysql_conn)
+{
+	if (mysql_conn->batch_rows)
+		list_flush(mysql_conn->batch_rows);
+	xfree(mysql_conn->batch_insert);
+	xfree(mysql_conn->batch_update);
+	mysql_conn->batch_size = 0;
+}
+
+/*
+ * Send the rows queued by mysql_db_insert_batch(), before any other query so
+ * it sees them.
+ * RET SLURM_SUCCESS or SLURM_ERROR if any of the rows failed, the others are
+ * still inserted
+ * NOTE: Ensure that mysql_conn->lock is set on function entry
+ */
+static int _flush_batch(mysql_conn_t *mysql_conn)
+{
+	int rc = SLURM_SUCCESS;
+	int insert_len, update_len, row_cnt, fail_cnt = 0;
+	char *query, *pos, *row;
+	ListIterator itr;
+
+	if (!mysql_conn->batch_rows ||
+	    !(row_cnt = list_count(mysql_conn->batch_rows)))
+		return rc;
+
+	insert_len = strlen(mysql_conn->batch_insert);
+	update_len = strlen(mysql_conn->batch_update);
+	pos = query = xmalloc(insert_len + mysql_conn->batch_size +
+			      (2 * row_cnt) + update_len + 1);
+	memcpy(pos, mysql_conn->batch_insert, insert_len);
+	pos += insert_len;
+	itr = list_iterator_create(mysql_conn->batch_rows);
+	while ((row = list_next(itr))) {
+		int len = strlen(row);
+
+		if (pos != query + insert_len) {
+			memcpy(pos, ", ", 2);
+			pos += 2;
+		}
+		memcpy(pos, row, len);
+		pos += len;
+	}
+	memcpy(pos, mysql_conn->batch_update, update_len + 1);
+
+	rc = _mysql_query_internal(mysql_conn->db_conn, query);
+	if ((rc != SLURM_SUCCESS) && (row_cnt > 1)) {
+		/* The whole statement was undone, find the bad rows */
+		list_iterator_reset(itr);
+		while ((row = list_next(itr))) {
+			xfree(query);
+			query = xstrdup_printf("%s%s%s",
+					       mysql_conn->batch_insert, row,
+					       mysql_conn->batch_update);
+			if (_mysql_query_internal(mysql_conn->db_conn, query)
+			    != SLURM_SUCCESS)
+				fail_cnt++;
+		}
+		if (!fail_cnt)
+			rc = SLURM_SUCCESS;
+	} else if (rc != SLURM_SUCCESS) {
+		fail_cnt = 1;
+	}
+	list_iterator_destroy(itr);
+	if (fail_cnt) {
+		error("%s: %d of %d batched rows could not be inserted",
+		      __func__, fail_cnt, row_cnt);
+		rc = SLURM_ERROR;
+	}
+	xfree(query);
+	_clear_batch(mysql_conn);
+
+	return rc;
+}
+
 /* NOTE: Ensure that mysql_conn->lock is NOT set on function entry */
 static int _mysql_make_table_current(mysql_conn_t *mysql_conn, char *table_name,
 				     storage_field_t *fields, char *ending)
@@ -644,6 +725,9 @@ extern int destroy_mysql_conn(mysql_conn_t *mysql_conn)
 		mysql_db_close_db_connection(mysql_conn);
 		xfree(mysql_conn->pre_commit_query);
 		xfree(mysql_conn->cluster_name);
+		FREE_NULL_LIST(mysql_conn->batch_rows);
+		xfree(mysql_conn->batch_insert);
+		xfree(mysql_conn->batch_update);
 		slurm_mutex_destroy(&mysql_conn->lock);
 		FREE_NULL_LIST(mysql_conn->update_list);
 		xfree(mysql_conn);
@@ -778,6 +862,8 @@ extern int mysql_db_get_db_connection(mysql_conn_t *mysql_conn, char *db_name,
 extern int mysql_db_close_db_connection(mysql_conn_t *mysql_conn)
 {
 	slurm_mutex_lock(&mysql_conn->lock);
+	/* Pending rows were not committed either */
+	_clear_batch(mysql_conn);
 	if (mysql_conn && mysql_conn->db_conn) {
 		if (mysql_thread_safe())
 			mysql_thread_end();
@@ -803,14 +889,17 @@ extern int mysql_db_cleanup()
 
 extern int mysql_db_query(mysql_conn_t *mysql_conn, char *query)
 {
-	int rc = SLURM_SUCCESS;
+	int rc = SLURM_SUCCESS, flush_rc;
 
 	if (!mysql_conn || !mysql_conn->db_conn) {
 		fatal("You haven't inited this storage yet.");
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
+	flush_rc = _flush_batch(mysql_conn);
 	rc = _mysql_query_internal(mysql_conn->db_conn, query);
+	if (flush_rc != SLURM_SUCCESS)
+		rc = flush_rc;
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
 }
@@ -828,6 +917,8 @@ extern int mysql_db_delete_affected_rows(mysql_conn_t *mysql_conn, char *query)
 		return 0;	/* For CLANG false positive */
 	}
 	slurm_mutex_lock(&mysql_conn->lock);
+	/* A failed batch is logged, it does not change the row count */
+	(void) _flush_batch(mysql_conn);
 	if (!(rc = _mysql_query_internal(mysql_conn->db_conn, query)))
 		rc = mysql_affected_rows(mysql_conn->db_conn);
 	slurm_mutex_unlock(&mysql_conn->lock);
@@ -863,9 +954,16 @@ extern int mysql_db_commit(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	rc = _flush_batch(mysql_conn);
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
-	if (mysql_commit(mysql_conn->db_conn)) {
+	if (rc != SLURM_SUCCESS) {
+		/* Undo the transaction so that it can be applied again */
+		if (mysql_rollback(mysql_conn->db_conn))
+			error("mysql_rollback failed: %d %s",
+			      mysql_errno(mysql_conn->db_conn),
+			      mysql_error(mysql_conn->db_conn));
+	} else if (mysql_commit(mysql_conn->db_conn)) {
 		error("mysql_commit failed: %d %s",
 		      mysql_errno(mysql_conn->db_conn),
 		      mysql_error(mysql_conn->db_conn));
@@ -884,6 +982,7 @@ extern int mysql_db_rollback(mysql_conn_t *mysql_conn)
 		return SLURM_ERROR;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	_clear_batch(mysql_conn);
 	/* clear out the old results so we don't get a 2014 error */
 	_clear_results(mysql_conn->db_conn);
 	if (mysql_rollback(mysql_conn->db_conn)) {
@@ -910,6 +1009,8 @@ extern MYSQL_RES *mysql_db_query_ret(mysql_conn_t *mysql_conn,
 	MYSQL_RES *result = NULL;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	/* A failed batch is logged, the query does not depend on it */
+	(void) _flush_batch(mysql_conn);
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		if (mysql_errno(mysql_conn->db_conn) == ER_NO_SUCH_TABLE)
 			goto fini;
@@ -936,12 +1037,15 @@ fini:
 
 extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query)
 {
-	int rc = SLURM_SUCCESS;
+	int rc = SLURM_SUCCESS, flush_rc;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	flush_rc = _flush_batch(mysql_conn);
 	if ((rc = _mysql_query_internal(
 		     mysql_conn->db_conn, query)) != SLURM_ERROR)
 		rc = _clear_results(mysql_conn->db_conn);
+	if (flush_rc != SLURM_SUCCESS)
+		rc = flush_rc;
 	slurm_mutex_unlock(&mysql_conn->lock);
 	return rc;
 }
@@ -951,6 +1055,8 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 	uint64_t new_id = 0;
 
 	slurm_mutex_lock(&mysql_conn->lock);
+	/* A failed batch is logged, it does not change the new id */
+	(void) _flush_batch(mysql_conn);
 	if (_mysql_query_internal(mysql_conn->db_conn, query) != SLURM_ERROR)  {
 		new_id = mysql_insert_id(mysql_conn->db_conn);
 		if (!new_id) {
@@ -964,6 +1070,42 @@ extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query)
 
 }
 
+extern int mysql_db_insert_batch(mysql_conn_t *mysql_conn, char *insert,
+				 char *row, char *update)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!mysql_conn->rollback) {
+		char *query = xstrdup_printf("%s%s%s", insert, row, update);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		return rc;
+	}
+
+	slurm_mutex_lock(&mysql_conn->lock);
+	if (mysql_conn->batch_size &&
+	    (xstrcmp(mysql_conn->batch_insert, insert) ||
+	     xstrcmp(mysql_conn->batch_update, update)))
+		rc = _flush_batch(mysql_conn);
+
+	if (!mysql_conn->batch_rows)
+		mysql_conn->batch_rows = list_create(slurm_destroy_char);
+	if (!mysql_conn->batch_size) {
+		mysql_conn->batch_insert = xstrdup(insert);
+		mysql_conn->batch_update = xstrdup(update);
+	}
+	list_append(mysql_conn->batch_rows, xstrdup(row));
+	mysql_conn->batch_size += strlen(row);
+
+	if (((list_count(mysql_conn->batch_rows) >= MAX_BATCH_ROWS) ||
+	     (mysql_conn->batch_size >= MAX_BATCH_SIZE)) &&
+	    (_flush_batch(mysql_conn) != SLURM_SUCCESS))
+		rc = SLURM_ERROR;
+	slurm_mutex_unlock(&mysql_conn->lock);
+
+	return rc;
+}
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending)
 {
@@ -65,6 +65,10 @@ typedef struct {
 	pthread_mutex_t lock;
 	char *pre_commit_query;
 	bool rollback;
+	char *batch_insert;	/* "insert into ... values " of batch_rows */
+	char *batch_update;	/* " on duplicate key update ..." of them */
+	List batch_rows;	/* pending rows of mysql_db_insert_batch() */
+	uint32_t batch_size;	/* length of batch_rows strings */
 	List update_list;
 	int conn;
 } mysql_conn_t;
@@ -104,6 +108,24 @@ extern int mysql_db_query_check_after(mysql_conn_t *mysql_conn, char *query);
 
 extern uint64_t mysql_db_insert_ret_id(mysql_conn_t *mysql_conn, char *query);
 
+/*
+ * Queue one row of a multi-row "insert ... values (...), (...) ..." query.
+ * Rows of consecutive calls with the same insert and update are sent in one
+ * query, before the next other query or commit on mysql_conn, so they are
+ * always visible to it. Connections not using transactions run the insert at
+ * once.
+ * insert IN - "insert into ... (...) values "
+ * row IN - "(...)"
+ * update IN - " on duplicate key update ..." using values(), or ""
+ * RET SLURM_SUCCESS or error from the batch this row flushed. If a batch
+ *     fails its rows are retried one by one so only the bad ones are lost.
+ *     Errors of a batch flushed later are logged, and returned by
+ *     mysql_db_query(), mysql_db_query_check_after() and mysql_db_commit().
+ *     mysql_db_commit() then rolls the whole transaction back.
+ */
+extern int mysql_db_insert_batch(mysql_conn_t *mysql_conn, char *insert,
+				 char *row, char *update);
+
 extern int mysql_db_create_table(mysql_conn_t *mysql_conn, char *table_name,
 				 storage_field_t *fields, char *ending);
 
@@ -1055,6 +1055,20 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return filetxt_jobacct_process_get_jobs(job_cond);
 }
 
+/*
+ * get info from the storage a page at a time, the whole file is parsed
+ * anyway so everything is returned in one page
+ * returns List of slurmdb_job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_page(void *db_conn, uid_t uid,
+					    slurmdb_job_cond_t *job_cond,
+					    slurmdb_job_cursor_t *cursor)
+{
+	cursor->done = 1;
+	return filetxt_jobacct_process_get_jobs(job_cond);
+}
+
 /*
  * expire old info from the storage
  */
@@ -2745,7 +2745,7 @@ extern int acct_storage_p_close_connection(mysql_conn_t **mysql_conn)
 
 extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 {
-	int rc = check_connection(mysql_conn);
+	int rc = check_connection(mysql_conn), commit_rc = SLURM_SUCCESS;
 
 	/* always reset this here */
 	if (mysql_conn)
@@ -2784,14 +2784,15 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 			if (rc != SLURM_SUCCESS) {
 				if (mysql_db_rollback(mysql_conn))
 					error("rollback failed");
-			} else {
-				if (mysql_db_commit(mysql_conn))
-					error("commit failed");
+				commit_rc = rc;
+			} else if ((commit_rc = mysql_db_commit(mysql_conn))) {
+				error("commit failed");
 			}
 		}
 	}
 
-	if (commit && list_count(mysql_conn->update_list)) {
+	if (commit && (commit_rc == SLURM_SUCCESS) &&
+	    list_count(mysql_conn->update_list)) {
 		char *query = NULL;
 		MYSQL_RES *result = NULL;
 		MYSQL_ROW row;
@@ -2854,7 +2855,7 @@ extern int acct_storage_p_commit(mysql_conn_t *mysql_conn, bool commit)
 	xfree(mysql_conn->pre_commit_query);
 	list_flush(mysql_conn->update_list);
 
-	return SLURM_SUCCESS;
+	return commit_rc;
 }
 
 extern int acct_storage_p_add_users(mysql_conn_t *mysql_conn, uint32_t uid,
@@ -3372,6 +3373,23 @@ extern List jobacct_storage_p_get_jobs_cond(mysql_conn_t *mysql_conn,
 	return job_list;
 }
 
+/*
+ * get info from the storage a page at a time
+ * returns List of job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_page(mysql_conn_t *mysql_conn,
+					    uid_t uid,
+					    slurmdb_job_cond_t *job_cond,
+					    slurmdb_job_cursor_t *cursor)
+{
+	if (check_connection(mysql_conn) != SLURM_SUCCESS)
+		return NULL;
+
+	return as_mysql_jobacct_process_get_jobs_page(mysql_conn, uid,
+						      job_cond, cursor);
+}
+
 /*
  * expire old info from the storage
  */
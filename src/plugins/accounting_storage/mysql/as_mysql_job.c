@@ -51,6 +51,17 @@
 
 #define BUFFER_SIZE 4096
 
+/* Applies to every row of a multi-row step start insert */
+static char *step_start_update =
+	" on duplicate key update "
+	"nodes_alloc=values(nodes_alloc), task_cnt=values(task_cnt), "
+	"time_end=0, state=values(state), nodelist=values(nodelist), "
+	"node_inx=values(node_inx), task_dist=values(task_dist), "
+	"req_cpufreq=values(req_cpufreq), "
+	"req_cpufreq_min=values(req_cpufreq_min), "
+	"req_cpufreq_gov=values(req_cpufreq_gov), "
+	"tres_alloc=values(tres_alloc);";
+
 typedef struct {
 	char *cluster;
 	uint32_t new;
@@ -1154,7 +1165,7 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 	char node_list[BUFFER_SIZE];
 	char *node_inx = NULL;
 	time_t start_time, submit_time;
-	char *query = NULL;
+	char *query = NULL, *row = NULL;
 
 	if (!step_ptr->job_ptr->db_index
 	    && ((!step_ptr->job_ptr->details
@@ -1258,36 +1269,44 @@ extern int as_mysql_step_start(mysql_conn_t *mysql_conn,
 		}
 	}
 
-	/* we want to print a -1 for the requid so leave it a
-	   %d */
-	/* The stepid could be -2 so use %d not %u */
+	/*
+	 * Step starts arriving together from the slurmctld are sent as one
+	 * multi-row insert, see mysql_db_insert_batch(). With CommitDelay
+	 * nothing is committed before the slurmdbd replies, so the row is
+	 * inserted at once and a failure is returned with the reply.
+	 */
 	query = xstrdup_printf(
 		"insert into \"%s_%s\" (job_db_inx, id_step, time_start, "
 		"step_name, state, tres_alloc, "
 		"nodes_alloc, task_cnt, nodelist, node_inx, "
 		"task_dist, req_cpufreq, req_cpufreq_min, req_cpufreq_gov) "
-		"values (%"PRIu64", %d, %d, '%s', %d, '%s', %d, %d, "
-		"'%s', '%s', %d, %u, %u, %u) "
-		"on duplicate key update "
-		"nodes_alloc=%d, task_cnt=%d, time_end=0, state=%d, "
-		"nodelist='%s', node_inx='%s', task_dist=%d, "
-		"req_cpufreq=%u, req_cpufreq_min=%u, req_cpufreq_gov=%u,"
-		"tres_alloc='%s';",
-		mysql_conn->cluster_name, step_table,
+		"values ",
+		mysql_conn->cluster_name, step_table);
+	/* we want to print a -1 for the requid so leave it a
+	   %d */
+	/* The stepid could be -2 so use %d not %u */
+	row = xstrdup_printf(
+		"(%"PRIu64", %d, %d, '%s', %d, '%s', %d, %d, "
+		"'%s', '%s', %d, %u, %u, %u)",
 		step_ptr->job_ptr->db_index,
 		step_ptr->step_id,
 		(int)start_time, step_ptr->name,
 		JOB_RUNNING, step_ptr->tres_alloc_str,
 		nodes, tasks, node_list, node_inx, task_dist,
 		step_ptr->cpu_freq_max, step_ptr->cpu_freq_min,
-		step_ptr->cpu_freq_gov, nodes, tasks, JOB_RUNNING,
-		node_list, node_inx, task_dist, step_ptr->cpu_freq_max,
-		step_ptr->cpu_freq_min, step_ptr->cpu_freq_gov,
-		step_ptr->tres_alloc_str);
+		step_ptr->cpu_freq_gov);
 	if (debug_flags & DEBUG_FLAG_DB_STEP)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	rc = mysql_db_query(mysql_conn, query);
+		DB_DEBUG(mysql_conn->conn, "query\n%s%s%s",
+			 query, row, step_start_update);
+	if (slurmdbd_conf && slurmdbd_conf->commit_delay) {
+		xstrfmtcat(query, "%s%s", row, step_start_update);
+		rc = mysql_db_query(mysql_conn, query);
+	} else {
+		rc = mysql_db_insert_batch(mysql_conn, query, row,
+					   step_start_update);
+	}
 	xfree(query);
+	xfree(row);
 
 	return rc;
 }
@@ -461,7 +461,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			     char *cluster_name,
 			     char *job_fields, char *step_fields,
 			     char *sent_extra,
-			     bool is_admin, int only_pending, List sent_list)
+			     bool is_admin, int only_pending, List sent_list,
+			     slurmdb_job_cursor_t *cursor, bool *cluster_done)
 {
 	char *query = NULL;
 	char *extra = xstrdup(sent_extra);
@@ -480,6 +481,11 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	int rc = SLURM_SUCCESS;
 	int last_id = -1, curr_id = -1;
 	local_cluster_t *curr_cluster = NULL;
+	char *page_query = NULL;
+	uint32_t limit = cursor ? cursor->max_jobs : 0;
+	int stop_id = -1;
+
+	*cluster_done = true;
 
 	/* This is here to make sure we are looking at only this user
 	 * if this flag is set.  We also include any accounts they may be
@@ -572,6 +578,15 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 			xstrcat(extra, " where (t1.time_end=0)");
 	}
 
+	if (cursor && cursor->last_jobid) {
+		if (extra)
+			xstrfmtcat(extra, " && (t1.id_job>%u)",
+				   cursor->last_jobid);
+		else
+			xstrfmtcat(extra, " where (t1.id_job>%u)",
+				   cursor->last_jobid);
+	}
+
 	if (extra) {
 		xstrcat(query, extra);
 		xfree(extra);
@@ -583,13 +598,41 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 	*/
 	xstrcat(query, " order by id_job, time_submit desc");
 
+page_again:
+	if (limit)
+		page_query = xstrdup_printf("%s limit %u", query, limit);
+	else
+		page_query = xstrdup(query);
 	if (debug_flags & DEBUG_FLAG_DB_JOB)
-		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-	if (!(result = mysql_db_query_ret(mysql_conn, query, 0))) {
+		DB_DEBUG(mysql_conn->conn, "query\n%s", page_query);
+	result = mysql_db_query_ret(mysql_conn, page_query, 0);
+	xfree(page_query);
+	if (!result) {
 		xfree(query);
 		rc = SLURM_ERROR;
 		goto end_it;
 	}
+
+	/*
+	 * A full page may end in the middle of the records of a job id, these
+	 * are left for the next page. If they fill the page ask for more.
+	 */
+	if (limit && (mysql_num_rows(result) >= limit)) {
+		mysql_data_seek(result, mysql_num_rows(result) - 1);
+		row = mysql_fetch_row(result);
+		stop_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		mysql_data_seek(result, 0);
+		row = mysql_fetch_row(result);
+		if (slurm_atoul(row[JOB_REQ_JOBID]) == stop_id) {
+			mysql_free_result(result);
+			limit *= 2;
+			stop_id = -1;
+			goto page_again;
+		}
+		mysql_data_seek(result, 0);
+		cursor->last_jobid = stop_id - 1;
+		*cluster_done = false;
+	}
 	xfree(query);
 
 
@@ -615,6 +658,8 @@ static int _cluster_get_jobs(mysql_conn_t *mysql_conn,
 		int start = slurm_atoul(row[JOB_REQ_START]);
 
 		curr_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		if (curr_id == stop_id)
+			break;
 
 		if (job_cond && !(job_cond->flags & JOBCOND_FLAG_DUP)
 		    && (curr_id == last_id)
@@ -1682,9 +1727,10 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 	return set;
 }
 
-extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
-					      uid_t uid,
-					      slurmdb_job_cond_t *job_cond)
+/* Get all the jobs if cursor is NULL, else the page it points at */
+static List _get_jobs(mysql_conn_t *mysql_conn, uid_t uid,
+		      slurmdb_job_cond_t *job_cond,
+		      slurmdb_job_cursor_t *cursor)
 {
 	char *extra = NULL;
 	char *tmp = NULL, *tmp2 = NULL;
@@ -1696,7 +1742,7 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 	slurmdb_user_rec_t user;
 	int only_pending = 0;
 	List use_cluster_list = as_mysql_cluster_list;
-	char *cluster_name;
+	char *cluster_name, *resume = NULL;
 	assoc_mgr_lock_t locks = { NO_LOCK, NO_LOCK, NO_LOCK, NO_LOCK,
 				   READ_LOCK, NO_LOCK, NO_LOCK };
 
@@ -1747,20 +1793,52 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	assoc_mgr_lock(&locks);
 
+	if (cursor) {
+		resume = cursor->cluster;
+		cursor->cluster = NULL;
+	}
+
 	job_list = list_create(slurmdb_destroy_job_rec);
 	itr = list_iterator_create(use_cluster_list);
 	while ((cluster_name = list_next(itr))) {
 		int rc;
+		bool cluster_done;
+
+		if (resume) {
+			if (xstrcmp(resume, cluster_name))
+				continue;
+			xfree(resume);
+		} else if (cursor && list_count(job_list)) {
+			/* Start the next page with this cluster */
+			cursor->cluster = xstrdup(cluster_name);
+			break;
+		}
+
 		_setup_job_cond_selected_steps(job_cond, cluster_name, &extra);
 		if ((rc = _cluster_get_jobs(mysql_conn, &user, job_cond,
 					    cluster_name, tmp, tmp2, extra,
-					    is_admin, only_pending, job_list))
+					    is_admin, only_pending, job_list,
+					    cursor, &cluster_done))
 		    != SLURM_SUCCESS)
 			error("Problem getting jobs for cluster %s",
 			      cluster_name);
+
+		if (!cursor)
+			continue;
+		if (!cluster_done) {
+			cursor->cluster = xstrdup(cluster_name);
+			break;
+		}
+		cursor->last_jobid = 0;
 	}
 	list_iterator_destroy(itr);
 
+	if (cursor && !cursor->cluster) {
+		cursor->done = 1;
+		cursor->last_jobid = 0;
+	}
+	xfree(resume);
+
 	assoc_mgr_unlock(&locks);
 
 	if (use_cluster_list == as_mysql_cluster_list)
@@ -1772,3 +1850,17 @@ extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
 
 	return job_list;
 }
+
+extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn,
+					      uid_t uid,
+					      slurmdb_job_cond_t *job_cond)
+{
+	return _get_jobs(mysql_conn, uid, job_cond, NULL);
+}
+
+extern List as_mysql_jobacct_process_get_jobs_page(
+	mysql_conn_t *mysql_conn, uid_t uid, slurmdb_job_cond_t *job_cond,
+	slurmdb_job_cursor_t *cursor)
+{
+	return _get_jobs(mysql_conn, uid, job_cond, cursor);
+}
@@ -61,4 +61,13 @@ extern int setup_job_cond_limits(slurmdb_job_cond_t *job_cond,
 extern List as_mysql_jobacct_process_get_jobs(mysql_conn_t *mysql_conn, uid_t uid,
 					   slurmdb_job_cond_t *job_cond);
 
+/*
+ * Get the jobs a page at a time, see slurmdb_jobs_get_page().
+ * A page is cut between two job ids with a LIMIT on the query, so only one
+ * page of rows is held at a time.
+ */
+extern List as_mysql_jobacct_process_get_jobs_page(
+	mysql_conn_t *mysql_conn, uid_t uid, slurmdb_job_cond_t *job_cond,
+	slurmdb_job_cursor_t *cursor);
+
 #endif
@@ -42,6 +42,7 @@
 #include "as_mysql_archive.h"
 #include "src/common/parse_time.h"
 #include "src/common/slurm_time.h"
+#include "src/common/xhash.h"
 
 enum {
 	TIME_ALLOC,
@@ -90,6 +91,106 @@ typedef struct {
 	double unused_wall;
 } local_resv_usage_t;
 
+/* Modes of _hour_rollup() */
+enum {
+	HOUR_ROLL_ALL,		/* usage and reservations unused wall */
+	HOUR_ROLL_USAGE,	/* usage only, hours can be done in any order */
+	HOUR_ROLL_RESV,		/* reservations unused wall only */
+};
+
+/* Hours to catch up per thread before rolling up hours in parallel */
+#define ROLLUP_THREAD_MIN_HOURS 2
+#define DEFAULT_ROLLUP_THREADS 4
+
+/* State of the hourly rollup of one cluster, reused from hour to hour */
+typedef struct {
+	List assoc_usage_list;
+	xhash_t *assoc_usage_hash;	/* assoc_usage_list by id */
+	char *cluster_name;
+	List cluster_down_list;
+	char *job_str;
+	int mode;
+	mysql_conn_t *mysql_conn;
+	time_t now;
+	char *resv_str;
+	List resv_usage_list;
+	char *suspend_str;
+	uint16_t track_wckey;
+	List wckey_usage_list;
+	xhash_t *wckey_usage_hash;	/* wckey_usage_list by id */
+} hour_rollup_t;
+
+/* Hours shared by the threads of _parallel_hour_rollup() */
+typedef struct {
+	char *cluster_name;
+	int conn;
+	time_t end;
+	pthread_mutex_t lock;
+	time_t next;
+	time_t now;
+	int rc;
+} hour_workers_t;
+
+static char *job_req_inx[] = {
+	"job.job_db_inx",
+//	"job.id_job",
+	"job.id_assoc",
+	"job.id_wckey",
+	"job.array_task_pending",
+	"job.time_eligible",
+	"job.time_start",
+	"job.time_end",
+	"job.time_suspended",
+	"job.cpus_req",
+	"job.id_resv",
+	"job.tres_alloc"
+};
+enum {
+	JOB_REQ_DB_INX,
+//	JOB_REQ_JOBID,
+	JOB_REQ_ASSOCID,
+	JOB_REQ_WCKEYID,
+	JOB_REQ_ARRAY_PENDING,
+	JOB_REQ_ELG,
+	JOB_REQ_START,
+	JOB_REQ_END,
+	JOB_REQ_SUSPENDED,
+	JOB_REQ_RCPU,
+	JOB_REQ_RESVID,
+	JOB_REQ_TRES,
+	JOB_REQ_COUNT
+};
+
+static char *suspend_req_inx[] = {
+	"time_start",
+	"time_end"
+};
+enum {
+	SUSPEND_REQ_START,
+	SUSPEND_REQ_END,
+	SUSPEND_REQ_COUNT
+};
+
+static char *resv_req_inx[] = {
+	"id_resv",
+	"assoclist",
+	"flags",
+	"tres",
+	"time_start",
+	"time_end",
+	"unused_wall"
+};
+enum {
+	RESV_REQ_ID,
+	RESV_REQ_ASSOCS,
+	RESV_REQ_FLAGS,
+	RESV_REQ_TRES,
+	RESV_REQ_START,
+	RESV_REQ_END,
+	RESV_REQ_UNUSED,
+	RESV_REQ_COUNT
+};
+
 static void _destroy_local_tres_usage(void *object)
 {
 	local_tres_usage_t *a_usage = (local_tres_usage_t *)object;
@@ -945,768 +1046,901 @@ static local_cluster_usage_t *_setup_cluster_usage(mysql_conn_t *mysql_conn,
 	return c_usage;
 }
 
-extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
-				  char *cluster_name,
-				  time_t start, time_t end,
-				  uint16_t archive_data)
+static void _id_usage_identify(void *item, const char **key,
+			       uint32_t *key_len)
+{
+	local_id_usage_t *usage = (local_id_usage_t *)item;
+
+	*key = (const char *)&usage->id;
+	*key_len = sizeof(usage->id);
+}
+
+/* Find the usage of id in list, indexed by hash, adding it if missing */
+static local_id_usage_t *_get_id_usage(List list, xhash_t *hash, int id,
+				       bool make_tres)
+{
+	local_id_usage_t *usage;
+
+	if (!(usage = xhash_get(hash, (const char *)&id, sizeof(id)))) {
+		usage = xmalloc(sizeof(local_id_usage_t));
+		usage->id = id;
+		list_append(list, usage);
+		xhash_add(hash, usage);
+	}
+	if (make_tres && !usage->loc_tres)
+		usage->loc_tres = list_create(_destroy_local_tres_usage);
+
+	return usage;
+}
+
+/* Number of hourly rollup workers, from Parameters=rollup_threads=# */
+static int _rollup_threads(void)
+{
+	char *tmp_ptr;
+	int threads = DEFAULT_ROLLUP_THREADS;
+
+	if (slurmdbd_conf &&
+	    (tmp_ptr = xstrcasestr(slurmdbd_conf->parameters,
+				   "rollup_threads=")))
+		threads = atoi(tmp_ptr + strlen("rollup_threads="));
+
+	return MAX(threads, 1);
+}
+
+static void _init_hour_rollup(hour_rollup_t *roll, mysql_conn_t *mysql_conn,
+			      char *cluster_name, time_t now, int mode)
+{
+	int i;
+
+	memset(roll, 0, sizeof(hour_rollup_t));
+	roll->mysql_conn = mysql_conn;
+	roll->cluster_name = cluster_name;
+	roll->now = now;
+	roll->mode = mode;
+	roll->track_wckey = slurm_get_track_wckey();
+
+	roll->assoc_usage_list = list_create(_destroy_local_id_usage);
+	roll->assoc_usage_hash = xhash_init(_id_usage_identify, NULL);
+	roll->cluster_down_list = list_create(_destroy_local_cluster_usage);
+	roll->wckey_usage_list = list_create(_destroy_local_id_usage);
+	roll->wckey_usage_hash = xhash_init(_id_usage_identify, NULL);
+	roll->resv_usage_list = list_create(_destroy_local_resv_usage);
+
+	xstrfmtcat(roll->job_str, "%s", job_req_inx[0]);
+	for (i = 1; i < JOB_REQ_COUNT; i++)
+		xstrfmtcat(roll->job_str, ", %s", job_req_inx[i]);
+
+	xstrfmtcat(roll->suspend_str, "%s", suspend_req_inx[0]);
+	for (i = 1; i < SUSPEND_REQ_COUNT; i++)
+		xstrfmtcat(roll->suspend_str, ", %s", suspend_req_inx[i]);
+
+	xstrfmtcat(roll->resv_str, "%s", resv_req_inx[0]);
+	for (i = 1; i < RESV_REQ_COUNT; i++)
+		xstrfmtcat(roll->resv_str, ", %s", resv_req_inx[i]);
+}
+
+static void _fini_hour_rollup(hour_rollup_t *roll)
+{
+	xhash_free(roll->assoc_usage_hash);
+	xhash_free(roll->wckey_usage_hash);
+	FREE_NULL_LIST(roll->assoc_usage_list);
+	FREE_NULL_LIST(roll->cluster_down_list);
+	FREE_NULL_LIST(roll->wckey_usage_list);
+	FREE_NULL_LIST(roll->resv_usage_list);
+	xfree(roll->job_str);
+	xfree(roll->suspend_str);
+	xfree(roll->resv_str);
+}
+
+/* Roll up the hour starting at curr_start, the caller commits it */
+static int _hour_rollup(hour_rollup_t *roll, time_t curr_start)
 {
 	int rc = SLURM_SUCCESS;
-	int add_sec = 3600;
-	int i=0;
-	time_t now = time(NULL);
-	time_t curr_start = start;
-	time_t curr_end = curr_start + add_sec;
+	mysql_conn_t *mysql_conn = roll->mysql_conn;
+	char *cluster_name = roll->cluster_name;
+	time_t curr_end = curr_start + 3600;
 	char *query = NULL;
 	MYSQL_RES *result = NULL;
 	MYSQL_ROW row;
-	ListIterator a_itr = NULL;
+	ListIterator itr = NULL;
 	ListIterator c_itr = NULL;
-	ListIterator w_itr = NULL;
 	ListIterator r_itr = NULL;
-	List assoc_usage_list = list_create(_destroy_local_id_usage);
-	List cluster_down_list = list_create(_destroy_local_cluster_usage);
-	List wckey_usage_list = list_create(_destroy_local_id_usage);
-	List resv_usage_list = list_create(_destroy_local_resv_usage);
-	uint16_t track_wckey = slurm_get_track_wckey();
 	local_cluster_usage_t *loc_c_usage = NULL;
 	local_cluster_usage_t *c_usage = NULL;
 	local_resv_usage_t *r_usage = NULL;
 	local_id_usage_t *a_usage = NULL;
 	local_id_usage_t *w_usage = NULL;
+	int last_id = -1;
+	int last_wckeyid = -1;
 	/* char start_char[20], end_char[20]; */
 
-	char *job_req_inx[] = {
-		"job.job_db_inx",
-//		"job.id_job",
-		"job.id_assoc",
-		"job.id_wckey",
-		"job.array_task_pending",
-		"job.time_eligible",
-		"job.time_start",
-		"job.time_end",
-		"job.time_suspended",
-		"job.cpus_req",
-		"job.id_resv",
-		"job.tres_alloc"
-	};
-	char *job_str = NULL;
-	enum {
-		JOB_REQ_DB_INX,
-//		JOB_REQ_JOBID,
-		JOB_REQ_ASSOCID,
-		JOB_REQ_WCKEYID,
-		JOB_REQ_ARRAY_PENDING,
-		JOB_REQ_ELG,
-		JOB_REQ_START,
-		JOB_REQ_END,
-		JOB_REQ_SUSPENDED,
-		JOB_REQ_RCPU,
-		JOB_REQ_RESVID,
-		JOB_REQ_TRES,
-		JOB_REQ_COUNT
-	};
+	if (debug_flags & DEBUG_FLAG_DB_USAGE)
+		DB_DEBUG(mysql_conn->conn,
+			 "%s curr hour is now %ld-%ld",
+			 cluster_name, curr_start, curr_end);
+/* 	info("start %s", slurm_ctime2(&curr_start)); */
+/* 	info("end %s", slurm_ctime2(&curr_end)); */
 
-	char *suspend_req_inx[] = {
-		"time_start",
-		"time_end"
-	};
-	char *suspend_str = NULL;
-	enum {
-		SUSPEND_REQ_START,
-		SUSPEND_REQ_END,
-		SUSPEND_REQ_COUNT
-	};
+	c_itr = list_iterator_create(roll->cluster_down_list);
+	r_itr = list_iterator_create(roll->resv_usage_list);
 
-	char *resv_req_inx[] = {
-		"id_resv",
-		"assoclist",
-		"flags",
-		"tres",
-		"time_start",
-		"time_end",
-		"unused_wall"
-	};
-	char *resv_str = NULL;
-	enum {
-		RESV_REQ_ID,
-		RESV_REQ_ASSOCS,
-		RESV_REQ_FLAGS,
-		RESV_REQ_TRES,
-		RESV_REQ_START,
-		RESV_REQ_END,
-		RESV_REQ_UNUSED,
-		RESV_REQ_COUNT
-	};
+	/* Reservations only need the jobs that ran in them */
+	if (roll->mode != HOUR_ROLL_RESV)
+		c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
+					       curr_start, curr_end,
+					       roll->cluster_down_list);
 
-	i=0;
-	xstrfmtcat(job_str, "%s", job_req_inx[i]);
-	for(i=1; i<JOB_REQ_COUNT; i++) {
-		xstrfmtcat(job_str, ", %s", job_req_inx[i]);
-	}
+	// now get the reservations during this time
+	query = xstrdup_printf("select %s from \"%s_%s\" where "
+			       "(time_start < %ld && time_end >= %ld) "
+			       "order by time_start",
+			       roll->resv_str, cluster_name, resv_table,
+			       curr_end, curr_start);
 
-	i=0;
-	xstrfmtcat(suspend_str, "%s", suspend_req_inx[i]);
-	for(i=1; i<SUSPEND_REQ_COUNT; i++) {
-		xstrfmtcat(suspend_str, ", %s", suspend_req_inx[i]);
+	if (debug_flags & DEBUG_FLAG_DB_USAGE)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	if (!(result = mysql_db_query_ret(
+		      mysql_conn, query, 0))) {
+		rc = SLURM_ERROR;
+		goto end_it;
 	}
+	xfree(query);
 
-	i=0;
-	xstrfmtcat(resv_str, "%s", resv_req_inx[i]);
-	for(i=1; i<RESV_REQ_COUNT; i++) {
-		xstrfmtcat(resv_str, ", %s", resv_req_inx[i]);
-	}
+	if (c_usage)
+		xassert(c_usage->loc_tres);
+
+	/* If a reservation overlaps another reservation we
+	   total up everything here as if they didn't but when
+	   calculating the total time for a cluster we will
+	   remove the extra time received.  This may result in
+	   unexpected results with association based reports
+	   since the association is given the total amount of
+	   time of each reservation, thus equaling more time
+	   than is available.  Job/Cluster/Reservation reports
+	   should be fine though since we really don't over
+	   allocate resources.  The issue with us not being
+	   able to handle overlapping reservations here is
+	   unless the reservation completely overlaps the
+	   other reservation we have no idea how many cpus
+	   should be removed since this could be a
+	   heterogeneous system.  This same problem exists
+	   when a reservation is created with the ignore_jobs
+	   option which will allow jobs to continue to run in the
+	   reservation that aren't suppose to.
+	*/
+	while ((row = mysql_fetch_row(result))) {
+		time_t row_start = slurm_atoul(row[RESV_REQ_START]);
+		time_t row_end = slurm_atoul(row[RESV_REQ_END]);
+		uint32_t row_flags = slurm_atoul(row[RESV_REQ_FLAGS]);
+		int unused;
+		int resv_seconds;
+		time_t orig_start = row_start;
+
+		if (row_start >= curr_start) {
+			/*
+			 * This is the first time we are seeing this
+			 * reservation, so set our unused to be 0.
+			 * This is mostly helpful when
+			 * rerolling set it back to 0.
+			 */
+			unused = 0;
+		} else
+			unused = slurm_atoul(row[RESV_REQ_UNUSED]);
 
-/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
-/* 	info("begin end %s", slurm_ctime2(&curr_end)); */
-	a_itr = list_iterator_create(assoc_usage_list);
-	c_itr = list_iterator_create(cluster_down_list);
-	w_itr = list_iterator_create(wckey_usage_list);
-	r_itr = list_iterator_create(resv_usage_list);
-	while (curr_start < end) {
-		int last_id = -1;
-		int last_wckeyid = -1;
+		if (row_start <= curr_start)
+			row_start = curr_start;
 
-		if (debug_flags & DEBUG_FLAG_DB_USAGE)
-			DB_DEBUG(mysql_conn->conn,
-				 "%s curr hour is now %ld-%ld",
-				 cluster_name, curr_start, curr_end);
-/* 		info("start %s", slurm_ctime2(&curr_start)); */
-/* 		info("end %s", slurm_ctime2(&curr_end)); */
+		if (!row_end || row_end > curr_end)
+			row_end = curr_end;
 
-		c_usage = _setup_cluster_usage(mysql_conn, cluster_name,
-					       curr_start, curr_end,
-					       cluster_down_list);
+		/* Don't worry about it if the time is less
+		 * than 1 second.
+		 */
+		if ((resv_seconds = (row_end - row_start)) < 1)
+			continue;
 
-		// now get the reservations during this time
-		query = xstrdup_printf("select %s from \"%s_%s\" where "
-				       "(time_start < %ld && time_end >= %ld) "
-				       "order by time_start",
-				       resv_str, cluster_name, resv_table,
-				       curr_end, curr_start);
+		r_usage = xmalloc(sizeof(local_resv_usage_t));
+		r_usage->id = slurm_atoul(row[RESV_REQ_ID]);
 
-		if (debug_flags & DEBUG_FLAG_DB_USAGE)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
-			rc = SLURM_ERROR;
-			goto end_it;
-		}
-		xfree(query);
+		r_usage->local_assocs = list_create(slurm_destroy_char);
+		slurm_addto_char_list(r_usage->local_assocs,
+				      row[RESV_REQ_ASSOCS]);
+		r_usage->loc_tres =
+			list_create(_destroy_local_tres_usage);
 
-		if (c_usage)
-			xassert(c_usage->loc_tres);
-
-		/* If a reservation overlaps another reservation we
-		   total up everything here as if they didn't but when
-		   calculating the total time for a cluster we will
-		   remove the extra time received.  This may result in
-		   unexpected results with association based reports
-		   since the association is given the total amount of
-		   time of each reservation, thus equaling more time
-		   than is available.  Job/Cluster/Reservation reports
-		   should be fine though since we really don't over
-		   allocate resources.  The issue with us not being
-		   able to handle overlapping reservations here is
-		   unless the reservation completely overlaps the
-		   other reservation we have no idea how many cpus
-		   should be removed since this could be a
-		   heterogeneous system.  This same problem exists
-		   when a reservation is created with the ignore_jobs
-		   option which will allow jobs to continue to run in the
-		   reservation that aren't suppose to.
+		_add_tres_2_list(r_usage->loc_tres,
+				 row[RESV_REQ_TRES], resv_seconds);
+
+		/*
+		 * Original start is needed when updating the
+		 * reservation's unused_wall later on.
+		 */
+		r_usage->orig_start = orig_start;
+		r_usage->start = row_start;
+		r_usage->end = row_end;
+		r_usage->unused_wall = unused + resv_seconds;
+		list_append(roll->resv_usage_list, r_usage);
+
+		/* Since this reservation was added to the
+		   cluster and only certain people could run
+		   there we will use this as allocated time on
+		   the system.  If the reservation was a
+		   maintenance then we add the time to planned
+		   down time.
 		*/
-		while ((row = mysql_fetch_row(result))) {
-			time_t row_start = slurm_atoul(row[RESV_REQ_START]);
-			time_t row_end = slurm_atoul(row[RESV_REQ_END]);
-			uint32_t row_flags = slurm_atoul(row[RESV_REQ_FLAGS]);
-			int unused;
-			int resv_seconds;
-			time_t orig_start = row_start;
-
-			if (row_start >= curr_start) {
-				/*
-				 * This is the first time we are seeing this
-				 * reservation, so set our unused to be 0.
-				 * This is mostly helpful when
-				 * rerolling set it back to 0.
-				 */
-				unused = 0;
-			} else
-				unused = slurm_atoul(row[RESV_REQ_UNUSED]);
 
-			if (row_start <= curr_start)
-				row_start = curr_start;
 
-			if (!row_end || row_end > curr_end)
-				row_end = curr_end;
+		/*
+		 * Only record time for the clusters that have
+		 * registered, or if a reservation has the IGNORE_JOBS
+		 * flag we don't have an easy way to distinguish the
+		 * cpus a job not running in the reservation, but on
+		 * it's cpus.
+		 * We still need them for figuring out unused wall time,
+		 * but for cluster utilization we will just ignore them.
+		 */
+		if (!c_usage || (row_flags & RESERVE_FLAG_IGN_JOBS))
+			continue;
 
-			/* Don't worry about it if the time is less
-			 * than 1 second.
-			 */
-			if ((resv_seconds = (row_end - row_start)) < 1)
-				continue;
+		_add_time_tres_list(c_usage->loc_tres,
+				    r_usage->loc_tres,
+				    (row_flags & RESERVE_FLAG_MAINT) ?
+				    TIME_PDOWN : TIME_ALLOC, 0, 0);
+
+		/* slurm_make_time_str(&r_usage->start, start_char, */
+		/* 		    sizeof(start_char)); */
+		/* slurm_make_time_str(&r_usage->end, end_char, */
+		/* 		    sizeof(end_char)); */
+		/* info("adding this much %lld to cluster %s " */
+		/*      "%d %d %s - %s", */
+		/*      r_usage->total_time, c_usage->name, */
+		/*      (row_flags & RESERVE_FLAG_MAINT),  */
+		/*      r_usage->id, start_char, end_char); */
+	}
+	mysql_free_result(result);
 
-			r_usage = xmalloc(sizeof(local_resv_usage_t));
-			r_usage->id = slurm_atoul(row[RESV_REQ_ID]);
+	/* now get the jobs during this time only  */
+	query = xstrdup_printf("select %s from \"%s_%s\" as job "
+			       "where (job.time_eligible && "
+			       "job.time_eligible < %ld && "
+			       "(job.time_end >= %ld || "
+			       "job.time_end = 0)%s) "
+			       "group by job.job_db_inx "
+			       "order by job.id_assoc, "
+			       "job.time_eligible",
+			       roll->job_str, cluster_name, job_table,
+			       curr_end, curr_start,
+			       (roll->mode == HOUR_ROLL_RESV) ?
+			       " && job.id_resv" : "");
 
-			r_usage->local_assocs = list_create(slurm_destroy_char);
-			slurm_addto_char_list(r_usage->local_assocs,
-					      row[RESV_REQ_ASSOCS]);
-			r_usage->loc_tres =
-				list_create(_destroy_local_tres_usage);
+	if (debug_flags & DEBUG_FLAG_DB_USAGE)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	if (!(result = mysql_db_query_ret(
+		      mysql_conn, query, 0))) {
+		rc = SLURM_ERROR;
+		goto end_it;
+	}
+	xfree(query);
 
-			_add_tres_2_list(r_usage->loc_tres,
-					 row[RESV_REQ_TRES], resv_seconds);
+	while ((row = mysql_fetch_row(result))) {
+		//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
+		uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
+		uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
+		uint32_t array_pending =
+			slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
+		uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
+		time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
+		time_t row_start = slurm_atoul(row[JOB_REQ_START]);
+		time_t row_end = slurm_atoul(row[JOB_REQ_END]);
+		uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
+		List loc_tres = NULL;
+		int loc_seconds = 0;
+		int seconds = 0, suspend_seconds = 0;
+
+		if (row_start && (row_start < curr_start))
+			row_start = curr_start;
 
-			/*
-			 * Original start is needed when updating the
-			 * reservation's unused_wall later on.
-			 */
-			r_usage->orig_start = orig_start;
-			r_usage->start = row_start;
-			r_usage->end = row_end;
-			r_usage->unused_wall = unused + resv_seconds;
-			list_append(resv_usage_list, r_usage);
-
-			/* Since this reservation was added to the
-			   cluster and only certain people could run
-			   there we will use this as allocated time on
-			   the system.  If the reservation was a
-			   maintenance then we add the time to planned
-			   down time.
-			*/
+		if (!row_start && row_end)
+			row_start = row_end;
 
+		if (!row_end || row_end > curr_end)
+			row_end = curr_end;
 
-			/*
-			 * Only record time for the clusters that have
-			 * registered, or if a reservation has the IGNORE_JOBS
-			 * flag we don't have an easy way to distinguish the
-			 * cpus a job not running in the reservation, but on
-			 * it's cpus.
-			 * We still need them for figuring out unused wall time,
-			 * but for cluster utilization we will just ignore them.
-			 */
-			if (!c_usage || (row_flags & RESERVE_FLAG_IGN_JOBS))
-				continue;
+		if (!row_start || ((row_end - row_start) < 1))
+			goto calc_cluster;
+
+		seconds = (row_end - row_start);
+
+		if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
+			MYSQL_RES *result2 = NULL;
+			MYSQL_ROW row2;
+			/* get the suspended time for this job */
+			query = xstrdup_printf(
+				"select %s from \"%s_%s\" where "
+				"(time_start < %ld && (time_end >= %ld "
+				"|| time_end = 0)) && job_db_inx=%s "
+				"order by time_start",
+				roll->suspend_str, cluster_name,
+				suspend_table,
+				curr_end, curr_start,
+				row[JOB_REQ_DB_INX]);
+
+			debug4("%d(%s:%d) query\n%s",
+			       mysql_conn->conn, THIS_FILE,
+			       __LINE__, query);
+			if (!(result2 = mysql_db_query_ret(
+				      mysql_conn,
+				      query, 0))) {
+				rc = SLURM_ERROR;
+				mysql_free_result(result);
+				goto end_it;
+			}
+			xfree(query);
+			while ((row2 = mysql_fetch_row(result2))) {
+				int tot_time = 0;
+				time_t local_start = slurm_atoul(
+					row2[SUSPEND_REQ_START]);
+				time_t local_end = slurm_atoul(
+					row2[SUSPEND_REQ_END]);
+
+				if (!local_start)
+					continue;
 
-			_add_time_tres_list(c_usage->loc_tres,
-					    r_usage->loc_tres,
-					    (row_flags & RESERVE_FLAG_MAINT) ?
-					    TIME_PDOWN : TIME_ALLOC, 0, 0);
-
-			/* slurm_make_time_str(&r_usage->start, start_char, */
-			/* 		    sizeof(start_char)); */
-			/* slurm_make_time_str(&r_usage->end, end_char, */
-			/* 		    sizeof(end_char)); */
-			/* info("adding this much %lld to cluster %s " */
-			/*      "%d %d %s - %s", */
-			/*      r_usage->total_time, c_usage->name, */
-			/*      (row_flags & RESERVE_FLAG_MAINT),  */
-			/*      r_usage->id, start_char, end_char); */
-		}
-		mysql_free_result(result);
-
-		/* now get the jobs during this time only  */
-		query = xstrdup_printf("select %s from \"%s_%s\" as job "
-				       "where (job.time_eligible && "
-				       "job.time_eligible < %ld && "
-				       "(job.time_end >= %ld || "
-				       "job.time_end = 0)) "
-				       "group by job.job_db_inx "
-				       "order by job.id_assoc, "
-				       "job.time_eligible",
-				       job_str, cluster_name, job_table,
-				       curr_end, curr_start);
+				if (row_start > local_start)
+					local_start = row_start;
+				if (!local_end || row_end < local_end)
+					local_end = row_end;
+				tot_time = (local_end - local_start);
 
-		if (debug_flags & DEBUG_FLAG_DB_USAGE)
-			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-		if (!(result = mysql_db_query_ret(
-			      mysql_conn, query, 0))) {
-			rc = SLURM_ERROR;
-			goto end_it;
+				if (tot_time > 0)
+					suspend_seconds += tot_time;
+			}
+			mysql_free_result(result2);
 		}
-		xfree(query);
-
-		while ((row = mysql_fetch_row(result))) {
-			//uint32_t job_id = slurm_atoul(row[JOB_REQ_JOBID]);
-			uint32_t assoc_id = slurm_atoul(row[JOB_REQ_ASSOCID]);
-			uint32_t wckey_id = slurm_atoul(row[JOB_REQ_WCKEYID]);
-			uint32_t array_pending =
-				slurm_atoul(row[JOB_REQ_ARRAY_PENDING]);
-			uint32_t resv_id = slurm_atoul(row[JOB_REQ_RESVID]);
-			time_t row_eligible = slurm_atoul(row[JOB_REQ_ELG]);
-			time_t row_start = slurm_atoul(row[JOB_REQ_START]);
-			time_t row_end = slurm_atoul(row[JOB_REQ_END]);
-			uint32_t row_rcpu = slurm_atoul(row[JOB_REQ_RCPU]);
-			List loc_tres = NULL;
-			int loc_seconds = 0;
-			int seconds = 0, suspend_seconds = 0;
-
-			if (row_start && (row_start < curr_start))
-				row_start = curr_start;
-
-			if (!row_start && row_end)
-				row_start = row_end;
-
-			if (!row_end || row_end > curr_end)
-				row_end = curr_end;
-
-			if (!row_start || ((row_end - row_start) < 1))
-				goto calc_cluster;
-
-			seconds = (row_end - row_start);
-
-			if (slurm_atoul(row[JOB_REQ_SUSPENDED])) {
-				MYSQL_RES *result2 = NULL;
-				MYSQL_ROW row2;
-				/* get the suspended time for this job */
-				query = xstrdup_printf(
-					"select %s from \"%s_%s\" where "
-					"(time_start < %ld && (time_end >= %ld "
-					"|| time_end = 0)) && job_db_inx=%s "
-					"order by time_start",
-					suspend_str, cluster_name,
-					suspend_table,
-					curr_end, curr_start,
-					row[JOB_REQ_DB_INX]);
-
-				debug4("%d(%s:%d) query\n%s",
-				       mysql_conn->conn, THIS_FILE,
-				       __LINE__, query);
-				if (!(result2 = mysql_db_query_ret(
-					      mysql_conn,
-					      query, 0))) {
-					rc = SLURM_ERROR;
-					mysql_free_result(result);
-					goto end_it;
-				}
-				xfree(query);
-				while ((row2 = mysql_fetch_row(result2))) {
-					int tot_time = 0;
-					time_t local_start = slurm_atoul(
-						row2[SUSPEND_REQ_START]);
-					time_t local_end = slurm_atoul(
-						row2[SUSPEND_REQ_END]);
-
-					if (!local_start)
-						continue;
-
-					if (row_start > local_start)
-						local_start = row_start;
-					if (!local_end || row_end < local_end)
-						local_end = row_end;
-					tot_time = (local_end - local_start);
 
-					if (tot_time > 0)
-						suspend_seconds += tot_time;
-				}
-				mysql_free_result(result2);
-			}
+		/* Nothing is charged to associations or wckeys */
+		if (roll->mode == HOUR_ROLL_RESV)
+			goto calc_cluster;
 
-			if (last_id != assoc_id) {
-				a_usage = xmalloc(sizeof(local_id_usage_t));
-				a_usage->id = assoc_id;
-				list_append(assoc_usage_list, a_usage);
-				last_id = assoc_id;
-				/* a_usage->loc_tres is made later,
-				   don't do it here.
-				*/
-			}
+		if (last_id != assoc_id) {
+			/* a_usage->loc_tres is made later,
+			   don't do it here.
+			*/
+			a_usage = _get_id_usage(roll->assoc_usage_list,
+						roll->assoc_usage_hash,
+						assoc_id, false);
+			last_id = assoc_id;
+		}
 
-			/* Short circuit this so so we don't get a pointer. */
-			if (!track_wckey)
-				last_wckeyid = wckey_id;
-
-			/* do the wckey calculation */
-			if (last_wckeyid != wckey_id) {
-				list_iterator_reset(w_itr);
-				while ((w_usage = list_next(w_itr)))
-					if (w_usage->id == wckey_id)
-						break;
-
-				if (!w_usage) {
-					w_usage = xmalloc(
-						sizeof(local_id_usage_t));
-					w_usage->id = wckey_id;
-					list_append(wckey_usage_list,
-						    w_usage);
-					w_usage->loc_tres = list_create(
-						_destroy_local_tres_usage);
-				}
-				last_wckeyid = wckey_id;
-			}
+		/* Short circuit this so so we don't get a pointer. */
+		if (!roll->track_wckey)
+			last_wckeyid = wckey_id;
 
-			/* do the cluster allocated calculation */
-		calc_cluster:
+		/* do the wckey calculation */
+		if (last_wckeyid != wckey_id) {
+			w_usage = _get_id_usage(roll->wckey_usage_list,
+						roll->wckey_usage_hash,
+						wckey_id, true);
+			last_wckeyid = wckey_id;
+		}
 
-			/*
-			 * We need to have this clean for each job
-			 * since we add the time to the cluster individually.
-			 */
-			loc_tres = list_create(_destroy_local_tres_usage);
+		/* do the cluster allocated calculation */
+	calc_cluster:
 
-			_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+		/*
+		 * We need to have this clean for each job
+		 * since we add the time to the cluster individually.
+		 */
+		loc_tres = list_create(_destroy_local_tres_usage);
+
+		_add_tres_time_2_list(loc_tres, row[JOB_REQ_TRES],
+				      TIME_ALLOC, seconds,
+				      suspend_seconds, 0);
+		if (w_usage)
+			_add_tres_time_2_list(w_usage->loc_tres,
+					      row[JOB_REQ_TRES],
 					      TIME_ALLOC, seconds,
 					      suspend_seconds, 0);
-			if (w_usage)
-				_add_tres_time_2_list(w_usage->loc_tres,
-						      row[JOB_REQ_TRES],
-						      TIME_ALLOC, seconds,
-						      suspend_seconds, 0);
-
-			/*
-			 * Now figure out there was a disconnected
-			 * slurmctld during this job.
-			 */
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				int temp_end = row_end;
-				int temp_start = row_start;
-				if (loc_c_usage->start > temp_start)
-					temp_start = loc_c_usage->start;
-				if (loc_c_usage->end < temp_end)
-					temp_end = loc_c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds < 1)
-					continue;
 
-				_remove_job_tres_time_from_cluster(
-					loc_c_usage->loc_tres,
-					loc_tres,
-					loc_seconds);
-				/* info("Job %u was running for " */
-				/*      "%d seconds while " */
-				/*      "cluster %s's slurmctld " */
-				/*      "wasn't responding", */
-				/*      job_id, loc_seconds, cluster_name); */
-			}
+		/*
+		 * Now figure out there was a disconnected
+		 * slurmctld during this job.
+		 */
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			int temp_end = row_end;
+			int temp_start = row_start;
+			if (loc_c_usage->start > temp_start)
+				temp_start = loc_c_usage->start;
+			if (loc_c_usage->end < temp_end)
+				temp_end = loc_c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds < 1)
+				continue;
 
-			/* first figure out the reservation */
-			if (resv_id) {
-				if (seconds <= 0) {
-					_transfer_loc_tres(&loc_tres, a_usage);
-					continue;
-				}
-				/*
-				 * Since we have already added the entire
-				 * reservation as used time on the cluster we
-				 * only need to calculate the used time for the
-				 * reservation and then divy up the unused time
-				 * over the associations able to run in the
-				 * reservation. Since the job was to run, or ran
-				 * a reservation we don't care about eligible
-				 * time since that could totally skew the
-				 * clusters reserved time since the job may be
-				 * able to run outside of the reservation.
-				 */
-				list_iterator_reset(r_itr);
-				while ((r_usage = list_next(r_itr))) {
-					int temp_end, temp_start;
-					/*
-					 * since the reservation could have
-					 * changed in some way, thus making a
-					 * new reservation record in the
-					 * database, we have to make sure all
-					 * of the reservations are checked to
-					 * see if such a thing has happened
-					 */
-					if (r_usage->id != resv_id)
-						continue;
-					temp_end = row_end;
-					temp_start = row_start;
-					if (r_usage->start > temp_start)
-						temp_start =
-							r_usage->start;
-					if (r_usage->end < temp_end)
-						temp_end = r_usage->end;
-
-					loc_seconds = (temp_end - temp_start);
-
-					if (loc_seconds > 0) {
-						_add_time_tres_list(
-							r_usage->loc_tres,
-							loc_tres, TIME_ALLOC,
-							loc_seconds, 1);
-						if ((rc = _update_unused_wall(
-							     r_usage,
-							     loc_tres,
-							     loc_seconds))
-						    != SLURM_SUCCESS)
-							goto end_it;
-					}
-				}
+			_remove_job_tres_time_from_cluster(
+				loc_c_usage->loc_tres,
+				loc_tres,
+				loc_seconds);
+			/* info("Job %u was running for " */
+			/*      "%d seconds while " */
+			/*      "cluster %s's slurmctld " */
+			/*      "wasn't responding", */
+			/*      job_id, loc_seconds, cluster_name); */
+		}
 
+		/* first figure out the reservation */
+		if (resv_id) {
+			if (seconds <= 0) {
 				_transfer_loc_tres(&loc_tres, a_usage);
 				continue;
 			}
-
 			/*
-			 * only record time for the clusters that have
-			 * registered.  This continue should rarely if
-			 * ever happen.
+			 * Since we have already added the entire
+			 * reservation as used time on the cluster we
+			 * only need to calculate the used time for the
+			 * reservation and then divy up the unused time
+			 * over the associations able to run in the
+			 * reservation. Since the job was to run, or ran
+			 * a reservation we don't care about eligible
+			 * time since that could totally skew the
+			 * clusters reserved time since the job may be
+			 * able to run outside of the reservation.
 			 */
-			if (!c_usage) {
-				_transfer_loc_tres(&loc_tres, a_usage);
-				continue;
-			}
+			list_iterator_reset(r_itr);
+			while ((r_usage = list_next(r_itr))) {
+				int temp_end, temp_start;
+				/*
+				 * since the reservation could have
+				 * changed in some way, thus making a
+				 * new reservation record in the
+				 * database, we have to make sure all
+				 * of the reservations are checked to
+				 * see if such a thing has happened
+				 */
+				if (r_usage->id != resv_id)
+					continue;
+				temp_end = row_end;
+				temp_start = row_start;
+				if (r_usage->start > temp_start)
+					temp_start =
+						r_usage->start;
+				if (r_usage->end < temp_end)
+					temp_end = r_usage->end;
 
-			if (row_start && (seconds > 0)) {
-				/* info("%d assoc %d adds " */
-				/*      "(%d)(%d-%d) * %d = %d " */
-				/*      "to %d", */
-				/*      job_id, */
-				/*      a_usage->id, */
-				/*      seconds, */
-				/*      row_end, row_start, */
-				/*      row_acpu, */
-				/*      seconds * row_acpu, */
-				/*      row_acpu); */
-
-				_add_job_alloc_time_to_cluster(
-					c_usage->loc_tres,
-					loc_tres);
+				loc_seconds = (temp_end - temp_start);
+
+				if (loc_seconds > 0) {
+					_add_time_tres_list(
+						r_usage->loc_tres,
+						loc_tres, TIME_ALLOC,
+						loc_seconds, 1);
+					if ((rc = _update_unused_wall(
+						     r_usage,
+						     loc_tres,
+						     loc_seconds))
+					    != SLURM_SUCCESS) {
+						FREE_NULL_LIST(loc_tres);
+						mysql_free_result(result);
+						goto end_it;
+					}
+				}
 			}
 
-			/*
-			 * The loc_tres isn't needed after this so transfer to
-			 * the association and go on our merry way.
-			 */
 			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
+		}
 
-			/* now reserved time */
-			if (!row_start || (row_start >= c_usage->start)) {
-				int temp_end = row_start;
-				int temp_start = row_eligible;
-				if (c_usage->start > temp_start)
-					temp_start = c_usage->start;
-				if (c_usage->end < temp_end)
-					temp_end = c_usage->end;
-				loc_seconds = (temp_end - temp_start);
-				if (loc_seconds > 0) {
-					/*
-					 * If we have pending jobs in an array
-					 * they haven't been inserted into the
-					 * database yet as proper job records,
-					 * so handle them here.
-					 */
-					if (array_pending)
-						loc_seconds *= array_pending;
-
-					/* info("%d assoc %d reserved " */
-					/*      "(%d)(%d-%d) * %d * %d = %d " */
-					/*      "to %d", */
-					/*      job_id, */
-					/*      assoc_id, */
-					/*      temp_end - temp_start, */
-					/*      temp_end, temp_start, */
-					/*      row_rcpu, */
-					/*      array_pending, */
-					/*      loc_seconds, */
-					/*      row_rcpu); */
-
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_RESV, TRES_CPU,
-						       loc_seconds *
-						       (uint64_t) row_rcpu,
-						       0);
-				}
+		/*
+		 * only record time for the clusters that have
+		 * registered.  This continue should rarely if
+		 * ever happen.
+		 */
+		if (!c_usage) {
+			_transfer_loc_tres(&loc_tres, a_usage);
+			continue;
+		}
+
+		if (row_start && (seconds > 0)) {
+			/* info("%d assoc %d adds " */
+			/*      "(%d)(%d-%d) * %d = %d " */
+			/*      "to %d", */
+			/*      job_id, */
+			/*      a_usage->id, */
+			/*      seconds, */
+			/*      row_end, row_start, */
+			/*      row_acpu, */
+			/*      seconds * row_acpu, */
+			/*      row_acpu); */
+
+			_add_job_alloc_time_to_cluster(
+				c_usage->loc_tres,
+				loc_tres);
+		}
+
+		/*
+		 * The loc_tres isn't needed after this so transfer to
+		 * the association and go on our merry way.
+		 */
+		_transfer_loc_tres(&loc_tres, a_usage);
+
+		/* now reserved time */
+		if (!row_start || (row_start >= c_usage->start)) {
+			int temp_end = row_start;
+			int temp_start = row_eligible;
+			if (c_usage->start > temp_start)
+				temp_start = c_usage->start;
+			if (c_usage->end < temp_end)
+				temp_end = c_usage->end;
+			loc_seconds = (temp_end - temp_start);
+			if (loc_seconds > 0) {
+				/*
+				 * If we have pending jobs in an array
+				 * they haven't been inserted into the
+				 * database yet as proper job records,
+				 * so handle them here.
+				 */
+				if (array_pending)
+					loc_seconds *= array_pending;
+
+				/* info("%d assoc %d reserved " */
+				/*      "(%d)(%d-%d) * %d * %d = %d " */
+				/*      "to %d", */
+				/*      job_id, */
+				/*      assoc_id, */
+				/*      temp_end - temp_start, */
+				/*      temp_end, temp_start, */
+				/*      row_rcpu, */
+				/*      array_pending, */
+				/*      loc_seconds, */
+				/*      row_rcpu); */
+
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_RESV, TRES_CPU,
+					       loc_seconds *
+					       (uint64_t) row_rcpu,
+					       0);
 			}
 		}
-		mysql_free_result(result);
+	}
+	mysql_free_result(result);
 
-		/* now figure out how much more to add to the
-		   associations that could had run in the reservation
-		*/
-		query = NULL;
-		list_iterator_reset(r_itr);
-		while ((r_usage = list_next(r_itr))) {
-			ListIterator t_itr;
-			local_tres_usage_t *loc_tres;
+	/* now figure out how much more to add to the
+	   associations that could had run in the reservation
+	*/
+	query = NULL;
+	list_iterator_reset(r_itr);
+	while ((r_usage = list_next(r_itr))) {
+		ListIterator t_itr;
+		local_tres_usage_t *loc_tres;
 
+		/*
+		 * unused_wall carries over from the previous hour, so it is
+		 * left to a pass in order when the hours run in parallel.
+		 */
+		if (roll->mode != HOUR_ROLL_USAGE)
 			xstrfmtcat(query, "update \"%s_%s\" set unused_wall=%f where id_resv=%u and time_start=%ld;",
 				   cluster_name, resv_table,
 				   r_usage->unused_wall, r_usage->id,
 				   r_usage->orig_start);
 
-			if (!r_usage->loc_tres ||
-			    !list_count(r_usage->loc_tres))
-				continue;
+		if ((roll->mode == HOUR_ROLL_RESV) ||
+		    !r_usage->loc_tres ||
+		    !list_count(r_usage->loc_tres))
+			continue;
 
-			t_itr = list_iterator_create(r_usage->loc_tres);
-			while ((loc_tres = list_next(t_itr))) {
-				int64_t idle = loc_tres->total_time -
-					loc_tres->time_alloc;
-				char *assoc = NULL;
-				ListIterator tmp_itr = NULL;
-				int assoc_cnt, resv_unused_secs;
-
-				if (idle <= 0)
-					break; /* since this will be
-						* the same for all TRES	*/
-
-				/* now divide that time by the number of
-				   associations in the reservation and add
-				   them to each association */
-				resv_unused_secs = idle;
-				assoc_cnt = list_count(r_usage->local_assocs);
-				if (assoc_cnt)
-					resv_unused_secs /= assoc_cnt;
-				/* info("resv %d got %d seconds for TRES %u " */
-				/*      "for %d assocs", */
-				/*      r_usage->id, resv_unused_secs, */
-				/*      loc_tres->id, */
-				/*      list_count(r_usage->local_assocs)); */
-				tmp_itr = list_iterator_create(
-					r_usage->local_assocs);
-				while ((assoc = list_next(tmp_itr))) {
-					uint32_t associd = slurm_atoul(assoc);
-					if ((last_id != associd) &&
-					    !(a_usage = list_find_first(
-						      assoc_usage_list,
-						      _find_id_usage,
-						      &associd))) {
-						a_usage = xmalloc(
-							sizeof(local_id_usage_t));
-						a_usage->id = associd;
-						list_append(assoc_usage_list,
-							    a_usage);
-						last_id = associd;
-						a_usage->loc_tres = list_create(
-							_destroy_local_tres_usage);
-					}
+		t_itr = list_iterator_create(r_usage->loc_tres);
+		while ((loc_tres = list_next(t_itr))) {
+			int64_t idle = loc_tres->total_time -
+				loc_tres->time_alloc;
+			char *assoc = NULL;
+			ListIterator tmp_itr = NULL;
+			int assoc_cnt, resv_unused_secs;
+
+			if (idle <= 0)
+				break; /* since this will be
+					* the same for all TRES	*/
+
+			/* now divide that time by the number of
+			   associations in the reservation and add
+			   them to each association */
+			resv_unused_secs = idle;
+			assoc_cnt = list_count(r_usage->local_assocs);
+			if (assoc_cnt)
+				resv_unused_secs /= assoc_cnt;
+			/* info("resv %d got %d seconds for TRES %u " */
+			/*      "for %d assocs", */
+			/*      r_usage->id, resv_unused_secs, */
+			/*      loc_tres->id, */
+			/*      list_count(r_usage->local_assocs)); */
+			tmp_itr = list_iterator_create(
+				r_usage->local_assocs);
+			while ((assoc = list_next(tmp_itr))) {
+				uint32_t associd = slurm_atoul(assoc);
+				if ((last_id != associd) || !a_usage) {
+					a_usage = _get_id_usage(
+						roll->assoc_usage_list,
+						roll->assoc_usage_hash,
+						associd, true);
+					last_id = associd;
+				} else if (!a_usage->loc_tres)
+					a_usage->loc_tres = list_create(
+						_destroy_local_tres_usage);
 
-					_add_time_tres(a_usage->loc_tres,
-						       TIME_ALLOC, loc_tres->id,
-						       resv_unused_secs, 0);
-				}
-				list_iterator_destroy(tmp_itr);
+				_add_time_tres(a_usage->loc_tres,
+					       TIME_ALLOC, loc_tres->id,
+					       resv_unused_secs, 0);
 			}
-			list_iterator_destroy(t_itr);
+			list_iterator_destroy(tmp_itr);
 		}
+		list_iterator_destroy(t_itr);
+	}
 
-		if (query) {
-			if (debug_flags & DEBUG_FLAG_DB_USAGE)
-				DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("couldn't update reservations with unused time");
-				goto end_it;
-			}
+	if (query) {
+		if (debug_flags & DEBUG_FLAG_DB_USAGE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("couldn't update reservations with unused time");
+			goto end_it;
 		}
+	}
 
-		/* now apply the down time from the slurmctld disconnects */
-		if (c_usage) {
-			list_iterator_reset(c_itr);
-			while ((loc_c_usage = list_next(c_itr))) {
-				local_tres_usage_t *loc_tres;
-				ListIterator tmp_itr = list_iterator_create(
-					loc_c_usage->loc_tres);
-				while ((loc_tres = list_next(tmp_itr)))
-					_add_time_tres(c_usage->loc_tres,
-						       TIME_DOWN,
-						       loc_tres->id,
-						       loc_tres->total_time,
-						       0);
-				list_iterator_destroy(tmp_itr);
-			}
+	if (roll->mode == HOUR_ROLL_RESV)
+		goto end_it;
 
-			if ((rc = _process_cluster_usage(
-				     mysql_conn, cluster_name, curr_start,
-				     curr_end, now, c_usage))
-			    != SLURM_SUCCESS) {
-				goto end_it;
-			}
+	/* now apply the down time from the slurmctld disconnects */
+	if (c_usage) {
+		list_iterator_reset(c_itr);
+		while ((loc_c_usage = list_next(c_itr))) {
+			local_tres_usage_t *loc_tres;
+			ListIterator tmp_itr = list_iterator_create(
+				loc_c_usage->loc_tres);
+			while ((loc_tres = list_next(tmp_itr)))
+				_add_time_tres(c_usage->loc_tres,
+					       TIME_DOWN,
+					       loc_tres->id,
+					       loc_tres->total_time,
+					       0);
+			list_iterator_destroy(tmp_itr);
 		}
 
-		list_iterator_reset(a_itr);
-		while ((a_usage = list_next(a_itr)))
-			_create_id_usage_insert(cluster_name, ASSOC_TABLES,
-						curr_start, now,
-						a_usage, &query);
-		if (query) {
-			if (debug_flags & DEBUG_FLAG_DB_USAGE)
-				DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add assoc hour rollup");
-				goto end_it;
-			}
+		if ((rc = _process_cluster_usage(
+			     mysql_conn, cluster_name, curr_start,
+			     curr_end, roll->now, c_usage))
+		    != SLURM_SUCCESS) {
+			goto end_it;
 		}
+	}
 
-		if (!track_wckey)
-			goto end_loop;
-
-		list_iterator_reset(w_itr);
-		while ((w_usage = list_next(w_itr)))
-			_create_id_usage_insert(cluster_name, WCKEY_TABLES,
-						curr_start, now,
-						w_usage, &query);
-		if (query) {
-			if (debug_flags & DEBUG_FLAG_DB_USAGE)
-				DB_DEBUG(mysql_conn->conn, "query\n%s", query);
-			rc = mysql_db_query(mysql_conn, query);
-			xfree(query);
-			if (rc != SLURM_SUCCESS) {
-				error("Couldn't add wckey hour rollup");
-				goto end_it;
-			}
+	itr = list_iterator_create(roll->assoc_usage_list);
+	while ((a_usage = list_next(itr)))
+		_create_id_usage_insert(cluster_name, ASSOC_TABLES,
+					curr_start, roll->now,
+					a_usage, &query);
+	list_iterator_destroy(itr);
+	if (query) {
+		if (debug_flags & DEBUG_FLAG_DB_USAGE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add assoc hour rollup");
+			goto end_it;
 		}
+	}
 
-	end_loop:
-		_destroy_local_cluster_usage(c_usage);
-
-		c_usage     = NULL;
-		r_usage     = NULL;
-		a_usage     = NULL;
-		w_usage     = NULL;
+	if (!roll->track_wckey)
+		goto end_it;
 
-		list_flush(assoc_usage_list);
-		list_flush(cluster_down_list);
-		list_flush(wckey_usage_list);
-		list_flush(resv_usage_list);
-		curr_start = curr_end;
-		curr_end = curr_start + add_sec;
+	itr = list_iterator_create(roll->wckey_usage_list);
+	while ((w_usage = list_next(itr)))
+		_create_id_usage_insert(cluster_name, WCKEY_TABLES,
+					curr_start, roll->now,
+					w_usage, &query);
+	list_iterator_destroy(itr);
+	if (query) {
+		if (debug_flags & DEBUG_FLAG_DB_USAGE)
+			DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+		rc = mysql_db_query(mysql_conn, query);
+		xfree(query);
+		if (rc != SLURM_SUCCESS) {
+			error("Couldn't add wckey hour rollup");
+			goto end_it;
+		}
 	}
+
 end_it:
 	xfree(query);
-	xfree(suspend_str);
-	xfree(job_str);
-	xfree(resv_str);
 	_destroy_local_cluster_usage(c_usage);
-
-	if (a_itr)
-		list_iterator_destroy(a_itr);
 	if (c_itr)
 		list_iterator_destroy(c_itr);
-	if (w_itr)
-		list_iterator_destroy(w_itr);
 	if (r_itr)
 		list_iterator_destroy(r_itr);
 
-	FREE_NULL_LIST(assoc_usage_list);
-	FREE_NULL_LIST(cluster_down_list);
-	FREE_NULL_LIST(wckey_usage_list);
-	FREE_NULL_LIST(resv_usage_list);
+	xhash_clear(roll->assoc_usage_hash);
+	xhash_clear(roll->wckey_usage_hash);
+	list_flush(roll->assoc_usage_list);
+	list_flush(roll->cluster_down_list);
+	list_flush(roll->wckey_usage_list);
+	list_flush(roll->resv_usage_list);
 
-/* 	info("stop start %s", slurm_ctime2(&curr_start)); */
-/* 	info("stop end %s", slurm_ctime2(&curr_end)); */
+	return rc;
+}
 
-	/* go check to see if we archive and purge */
+/*
+ * Record the hour as rolled up, so a long catch up that is interrupted
+ * resumes after it, unless a late job record has asked for an earlier hour
+ * to be rolled up again in the meantime.
+ */
+static int _checkpoint_hour(mysql_conn_t *mysql_conn, char *cluster_name,
+			    time_t curr_start)
+{
+	int rc;
+	char *query = xstrdup_printf("update \"%s_%s\" set hourly_rollup=%ld "
+				     "where hourly_rollup>=%ld",
+				     cluster_name, last_ran_table,
+				     curr_start + 3600, curr_start);
+
+	if (debug_flags & DEBUG_FLAG_DB_USAGE)
+		DB_DEBUG(mysql_conn->conn, "query\n%s", query);
+	rc = mysql_db_query(mysql_conn, query);
+	xfree(query);
+
+	return rc;
+}
+
+static void *_hour_worker(void *arg)
+{
+	hour_workers_t *workers = (hour_workers_t *)arg;
+	mysql_conn_t mysql_conn;
+	hour_rollup_t roll;
+	time_t curr_start;
+	int rc;
+
+	memset(&mysql_conn, 0, sizeof(mysql_conn_t));
+	mysql_conn.rollback = 1;
+	mysql_conn.conn = workers->conn;
+	slurm_mutex_init(&mysql_conn.lock);
+
+	/* Each thread needs it's own connection */
+	if ((rc = check_connection(&mysql_conn)) != SLURM_SUCCESS)
+		goto end_it;
+
+	_init_hour_rollup(&roll, &mysql_conn, workers->cluster_name,
+			  workers->now, HOUR_ROLL_USAGE);
+	while (1) {
+		slurm_mutex_lock(&workers->lock);
+		if ((workers->rc != SLURM_SUCCESS) ||
+		    (workers->next >= workers->end)) {
+			slurm_mutex_unlock(&workers->lock);
+			break;
+		}
+		curr_start = workers->next;
+		workers->next += 3600;
+		slurm_mutex_unlock(&workers->lock);
+
+		if ((rc = _hour_rollup(&roll, curr_start)) != SLURM_SUCCESS)
+			break;
+		if (mysql_db_commit(&mysql_conn)) {
+			char start_char[25];
+			error("Couldn't commit cluster (%s) hour rollup for %s",
+			      workers->cluster_name,
+			      slurm_ctime2_r(&curr_start, start_char));
+			rc = SLURM_ERROR;
+			break;
+		}
+	}
+	_fini_hour_rollup(&roll);
+
+end_it:
+	if (rc != SLURM_SUCCESS) {
+		if (mysql_conn.db_conn && mysql_db_rollback(&mysql_conn))
+			error("rollback failed");
+		slurm_mutex_lock(&workers->lock);
+		if (workers->rc == SLURM_SUCCESS)
+			workers->rc = rc;
+		slurm_mutex_unlock(&workers->lock);
+	}
+	mysql_db_close_db_connection(&mysql_conn);
+	slurm_mutex_destroy(&mysql_conn.lock);
+
+	return NULL;
+}
+
+/*
+ * Roll up the usage of the hours from start to end with threads workers,
+ * each on its own connection and taking the next hour not done yet. The
+ * reservations unused wall is not updated.
+ */
+static int _parallel_hour_rollup(mysql_conn_t *mysql_conn, char *cluster_name,
+				 time_t start, time_t end, time_t now,
+				 int threads)
+{
+	hour_workers_t workers;
+	pthread_t *thread_ids = xcalloc(threads, sizeof(pthread_t));
+	int i;
+
+	memset(&workers, 0, sizeof(hour_workers_t));
+	workers.cluster_name = cluster_name;
+	workers.conn = mysql_conn->conn;
+	workers.end = end;
+	workers.next = start;
+	workers.now = now;
+	workers.rc = SLURM_SUCCESS;
+	slurm_mutex_init(&workers.lock);
+
+	debug("%s: rolling up %ld hours of cluster %s with %d threads",
+	      __func__, (long) ((end - start) / 3600), cluster_name, threads);
+	for (i = 0; i < threads; i++)
+		slurm_thread_create(&thread_ids[i], _hour_worker, &workers);
+	for (i = 0; i < threads; i++)
+		pthread_join(thread_ids[i], NULL);
+
+	slurm_mutex_destroy(&workers.lock);
+	xfree(thread_ids);
+
+	return workers.rc;
+}
+
+extern int as_mysql_hourly_rollup(mysql_conn_t *mysql_conn,
+				  char *cluster_name,
+				  time_t start, time_t end,
+				  uint16_t archive_data,
+				  bool checkpoint)
+{
+	int rc = SLURM_SUCCESS;
+	int threads = _rollup_threads();
+	int mode = HOUR_ROLL_ALL;
+	time_t now = time(NULL);
+	time_t curr_start = start;
+	hour_rollup_t roll;
+
+	/*
+	 * When catching up, hours are rolled up in parallel. Only the unused
+	 * wall of reservations, which carries over from one hour to the next,
+	 * is left to do in order below.
+	 */
+	if ((threads > 1) &&
+	    (((end - start) / 3600) >= (threads * ROLLUP_THREAD_MIN_HOURS))) {
+		if ((rc = _parallel_hour_rollup(mysql_conn, cluster_name,
+						start, end, now, threads))
+		    != SLURM_SUCCESS)
+			return rc;
+		mode = HOUR_ROLL_RESV;
+	}
+
+/* 	info("begin start %s", slurm_ctime2(&curr_start)); */
+	_init_hour_rollup(&roll, mysql_conn, cluster_name, now, mode);
+	while (curr_start < end) {
+		if ((rc = _hour_rollup(&roll, curr_start)) != SLURM_SUCCESS)
+			break;
+
+		if (checkpoint &&
+		    ((rc = _checkpoint_hour(mysql_conn, cluster_name,
+					    curr_start)) != SLURM_SUCCESS))
+			break;
 
-	if (rc == SLURM_SUCCESS) {
+		/* Commit each hour so the work done so far is kept */
 		if (mysql_db_commit(mysql_conn)) {
-			char start[25], end[25];
+			char start_char[25];
 			error("Couldn't commit cluster (%s) "
-			      "hour rollup for %s - %s",
-			      cluster_name, slurm_ctime2_r(&curr_start, start),
-			      slurm_ctime2_r(&curr_end, end));
+			      "hour rollup for %s", cluster_name,
+			      slurm_ctime2_r(&curr_start, start_char));
 			rc = SLURM_ERROR;
-		} else
-			rc = _process_purge(mysql_conn, cluster_name,
-					    archive_data, SLURMDB_PURGE_HOURS);
+			break;
+		}
+		curr_start += 3600;
 	}
+	_fini_hour_rollup(&roll);
+/* 	info("stop start %s", slurm_ctime2(&curr_start)); */
+
+	/* go check to see if we archive and purge */
+
+	if (rc == SLURM_SUCCESS)
+		rc = _process_purge(mysql_conn, cluster_name,
+				    archive_data, SLURMDB_PURGE_HOURS);
 
 	return rc;
 }
@@ -499,6 +499,18 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return NULL;
 }
 
+/*
+ * get info from the storage a page at a time
+ * returns List of slurmdb_job_rec_t *
+ * note List needs to be freed when called
+ */
+extern List jobacct_storage_p_get_jobs_page(void *db_conn, uid_t uid,
+					    void *job_cond,
+					    slurmdb_job_cursor_t *cursor)
+{
+	return NULL;
+}
+
 /*
  * expire old info from the storage
  */
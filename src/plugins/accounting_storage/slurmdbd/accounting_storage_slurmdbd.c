@@ -2903,6 +2903,99 @@ extern List jobacct_storage_p_get_jobs_cond(void *db_conn, uid_t uid,
 	return my_job_list;
 }
 
+/*
+ * get info from the storage a page at a time
+ * returns List of job_rec_t *
+ * note List needs to be freed when called
+ */
+/*
+ * Get all jobs matching job_cond with one DBD_GET_JOBS_COND, for a slurmdbd
+ * which predates DBD_GET_JOBS_PAGE.
+ */
+static List _get_jobs_unpaged(void *db_conn, uid_t uid,
+			      slurmdb_job_cond_t *job_cond,
+			      slurmdb_job_cursor_t *cursor)
+{
+	List my_job_list;
+
+	if ((my_job_list = jobacct_storage_p_get_jobs_cond(db_conn, uid,
+							   job_cond)))
+		cursor->done = 1;
+
+	return my_job_list;
+}
+
+extern List jobacct_storage_p_get_jobs_page(void *db_conn, uid_t uid,
+					    slurmdb_job_cond_t *job_cond,
+					    slurmdb_job_cursor_t *cursor)
+{
+	slurmdbd_msg_t req, resp;
+	dbd_job_page_msg_t get_msg;
+	dbd_job_page_msg_t *got_msg;
+	uint16_t dbd_version = slurmdbd_conn_version();
+	int rc;
+	List my_job_list = NULL;
+
+	/* DBD_GET_JOBS_PAGE was added in 20.02 */
+	if (dbd_version && (dbd_version < SLURM_20_02_PROTOCOL_VERSION) &&
+	    !cursor->cluster) {
+		debug("slurmdbd: protocol version %hu predates DBD_GET_JOBS_PAGE, getting all jobs at once",
+		      dbd_version);
+		return _get_jobs_unpaged(db_conn, uid, job_cond, cursor);
+	}
+
+	memset(&get_msg, 0, sizeof(dbd_job_page_msg_t));
+
+	get_msg.cond = job_cond;
+	get_msg.cursor = *cursor;
+
+	req.msg_type = DBD_GET_JOBS_PAGE;
+	req.data = &get_msg;
+	rc = send_recv_slurmdbd_msg(SLURM_PROTOCOL_VERSION, &req, &resp);
+
+	if (rc != SLURM_SUCCESS)
+		error("slurmdbd: DBD_GET_JOBS_PAGE failure: %s",
+		      slurm_strerror(rc));
+	else if (resp.msg_type == PERSIST_RC) {
+		persist_rc_msg_t *msg = resp.data;
+		/*
+		 * A slurmdbd which does not know DBD_GET_JOBS_PAGE either
+		 * fails to unpack it, answering SLURM_ERROR for this message
+		 * type, or rejects it as an invalid RPC with EINVAL.
+		 */
+		if (!cursor->cluster &&
+		    (((msg->rc == SLURM_ERROR) &&
+		      (msg->ret_info == DBD_GET_JOBS_PAGE)) ||
+		     ((msg->rc == EINVAL) && !msg->ret_info))) {
+			debug("slurmdbd: %s, getting all jobs at once",
+			      msg->comment);
+			my_job_list = _get_jobs_unpaged(db_conn, uid, job_cond,
+							cursor);
+		} else if (msg->rc == SLURM_SUCCESS) {
+			info("slurmdbd: %s", msg->comment);
+			my_job_list = list_create(NULL);
+			cursor->done = 1;
+		} else {
+			slurm_seterrno(msg->rc);
+			error("slurmdbd: %s", msg->comment);
+		}
+		slurm_persist_free_rc_msg(msg);
+	} else if (resp.msg_type != DBD_GOT_JOBS_PAGE) {
+		error("slurmdbd: response type not DBD_GOT_JOBS_PAGE: %u",
+		      resp.msg_type);
+	} else {
+		got_msg = (dbd_job_page_msg_t *) resp.data;
+		my_job_list = got_msg->my_list;
+		got_msg->my_list = NULL;
+		slurmdb_free_job_cursor_members(cursor);
+		*cursor = got_msg->cursor;
+		got_msg->cursor.cluster = NULL;
+		slurmdbd_free_job_page_msg(got_msg);
+	}
+
+	return my_job_list;
+}
+
 /*
  * Expire old info from the storage
  * Not applicable for any database
@@ -45,6 +45,7 @@
 #include "src/common/xstring.h"
 
 #include "slurmdbd_agent.h"
+#include "slurmdbd_spool.h"
 
 enum {
 	MAX_DBD_ACTION_DISCARD,
@@ -54,6 +55,14 @@ enum {
 #define DBD_MAGIC		0xDEAD3219
 #define SLURMDBD_TIMEOUT	900	/* Seconds SlurmDBD for response */
 #define DEBUG_PRINT_MAX_MSG_TYPES 10
+
+/*
+ * Limits of one DBD_SEND_MULT_MSG. The SlurmDBD applies it in one transaction,
+ * so the more messages per round trip the better as long as a resend after a
+ * failure stays cheap.
+ */
+#define MAX_MULT_MSG_CNT  5000
+#define MAX_MULT_MSG_SIZE (1024 * 1024)
 #define MAX_DBD_DEFAULT_ACTION MAX_DBD_ACTION_DISCARD
 
 static pthread_mutex_t agent_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -70,6 +79,8 @@ static pthread_mutex_t slurmdbd_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t  slurmdbd_cond = PTHREAD_COND_INITIALIZER;
 
 static int max_dbd_msg_action = MAX_DBD_DEFAULT_ACTION;
+static bool dbd_spool_conf = false;	/* SlurmctldParameters=dbd_spool */
+static bool dbd_spool = false;		/* agent queue is in the spool */
 
 static int _send_fini_msg(void)
 {
@@ -214,6 +225,8 @@ static int _handle_mult_rc_ret(void)
 
 				if ((b = list_dequeue(agent_list))) {
 					free_buf(b);
+					if (dbd_spool)
+						dbd_spool_ack(1);
 				} else {
 					error("slurmdbd: DBD_GOT_MULT_MSG "
 					      "unpack message error");
@@ -268,6 +281,60 @@ unpack_error:
 /****************************************************************************
  * Functions for agent to manage queue of pending message for the Slurm DBD
  ****************************************************************************/
+
+/*
+ * With dbd_spool every pending message is appended to the spool, and the
+ * agent_list only holds the oldest of them, up to MaxDBDMsgs. Messages
+ * queued while older ones wait on disk are only written to the spool.
+ */
+static void _open_dbd_spool(void)
+{
+	char *dir = slurm_get_state_save_location();
+
+	xstrcat(dir, "/dbd.spool");
+	if (dbd_spool_open(dir) != SLURM_SUCCESS) {
+		error("slurmdbd: unable to open spool %s, queueing messages in memory",
+		      dir);
+		dbd_spool = false;
+	}
+	xfree(dir);
+}
+
+static int _spool_enqueue(Buf buffer)
+{
+	bool in_mem = !dbd_spool_unread() &&
+		(list_count(agent_list) < slurmctld_conf.max_dbd_msgs);
+
+	if (dbd_spool_append(buffer, in_mem) != SLURM_SUCCESS) {
+		free_buf(buffer);
+		return SLURM_ERROR;
+	}
+
+	if (in_mem) {
+		if (!list_enqueue(agent_list, buffer))
+			fatal("slurmdbd: list_enqueue, no memory");
+	} else
+		free_buf(buffer);
+
+	return SLURM_SUCCESS;
+}
+
+/* Load messages waiting in the spool once half of agent_list was sent */
+static void _spool_refill(void)
+{
+	uint32_t cnt = list_count(agent_list);
+	Buf buffer;
+
+	if (!dbd_spool_unread() || (cnt > (slurmctld_conf.max_dbd_msgs / 2)))
+		return;
+
+	while ((cnt < slurmctld_conf.max_dbd_msgs) &&
+	       (buffer = dbd_spool_read())) {
+		if (!list_enqueue(agent_list, buffer))
+			fatal("slurmdbd: list_enqueue, no memory");
+		cnt++;
+	}
+}
 static Buf _load_dbd_rec(int fd)
 {
 	ssize_t size, rd_size;
@@ -386,7 +453,10 @@ static void _load_dbd_state(void)
 				error("no buffer given");
 				continue;
 			}
-			if (!list_enqueue(agent_list, buffer))
+			if (dbd_spool) {
+				if (_spool_enqueue(buffer) != SLURM_SUCCESS)
+					error("slurmdbd: unable to spool recovered RPC");
+			} else if (!list_enqueue(agent_list, buffer))
 				fatal("slurmdbd: list_enqueue, no memory");
 			recovered++;
 			buffer = NULL;
@@ -395,6 +465,9 @@ static void _load_dbd_state(void)
 	end_it:
 		verbose("slurmdbd: recovered %d pending RPCs", recovered);
 		(void) close(fd);
+		/* The spool now holds them, dbd.messages is not written */
+		if (dbd_spool)
+			(void) unlink(dbd_fname);
 	}
 	xfree(dbd_fname);
 }
@@ -445,6 +518,14 @@ static void _save_dbd_state(void)
 	uint16_t msg_type;
 	uint32_t offset;
 
+	if (dbd_spool) {
+		/* The spool already holds every pending message */
+		verbose("slurmdbd: %u pending RPCs left in spool",
+			list_count(agent_list) + dbd_spool_unread());
+		dbd_spool_close();
+		return;
+	}
+
 	dbd_fname = slurm_get_state_save_location();
 	xstrcat(dbd_fname, "/dbd.messages");
 	(void) unlink(dbd_fname);	/* clear save state */
@@ -557,6 +638,10 @@ static int _purge_job_start_req(void)
 
 static void _max_dbd_msg_action(uint32_t *msg_cnt)
 {
+	/* Only the file system limits the spool */
+	if (dbd_spool)
+		return;
+
 	if (max_dbd_msg_action == MAX_DBD_ACTION_EXIT) {
 		if (*msg_cnt < slurmctld_conf.max_dbd_msgs)
 			return;
@@ -770,6 +855,8 @@ static void *_agent(void *x)
 		}
 
 		slurm_mutex_lock(&agent_lock);
+		if (dbd_spool)
+			_spool_refill();
 		cnt = list_count(agent_list);
 		if ((cnt == 0) || (slurmdbd_conn->fd < 0) ||
 		    (fail_time && (difftime(time(NULL), fail_time) < 10))) {
@@ -790,25 +877,24 @@ static void *_agent(void *x)
 			info("slurmdbd: agent_count:%d", cnt);
 		/* Leave item on the queue until processing complete */
 		if (agent_list) {
-			int handle_agent_count = 1000;
-			if (cnt > handle_agent_count) {
+			if (cnt > 1) {
 				int agent_count = 0;
+				uint32_t agent_size = 0;
 				ListIterator agent_itr =
 					list_iterator_create(agent_list);
 				list_msg.my_list = list_create(NULL);
 				while ((buffer = list_next(agent_itr))) {
+					agent_size += size_buf(buffer);
+					if (agent_count &&
+					    (agent_size > MAX_MULT_MSG_SIZE))
+						break;
 					list_enqueue(list_msg.my_list, buffer);
-					agent_count++;
-					if (agent_count > handle_agent_count)
+					if (++agent_count >= MAX_MULT_MSG_CNT)
 						break;
 				}
 				list_iterator_destroy(agent_itr);
 				buffer = pack_slurmdbd_msg(
 					&list_req, SLURM_PROTOCOL_VERSION);
-			} else if (cnt > 1) {
-				list_msg.my_list = agent_list;
-				buffer = pack_slurmdbd_msg(
-					&list_req, SLURM_PROTOCOL_VERSION);
 			} else
 				buffer = (Buf) list_peek(agent_list);
 		} else
@@ -865,20 +951,19 @@ static void *_agent(void *x)
 			 * as NULL as that is the sign we sent a mult_msg.
 			 */
 			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
-			} else
+				FREE_NULL_LIST(list_msg.my_list);
+			} else {
 				buffer = (Buf) list_dequeue(agent_list);
+				if (dbd_spool)
+					dbd_spool_ack(1);
+			}
 
 			free_buf(buffer);
 			fail_time = 0;
 		} else {
 			/* We need to free a mult_msg even on failure */
 			if (list_msg.my_list) {
-				if (list_msg.my_list != agent_list)
-					FREE_NULL_LIST(list_msg.my_list);
-				list_msg.my_list = NULL;
+				FREE_NULL_LIST(list_msg.my_list);
 				free_buf(buffer);
 			}
 
@@ -890,6 +975,8 @@ static void *_agent(void *x)
 				_print_agent_list_msg_types();
 			}
 		}
+		if (dbd_spool)
+			dbd_spool_checkpoint();
 		slurm_mutex_unlock(&agent_lock);
 		END_TIMER2("slurmdbd agent: full loop");
 	}
@@ -914,6 +1001,8 @@ static void _create_agent(void)
 
 	if (agent_list == NULL) {
 		agent_list = list_create(slurmdbd_free_buffer);
+		if ((dbd_spool = dbd_spool_conf))
+			_open_dbd_spool();
 		_load_dbd_state();
 	}
 
@@ -1198,6 +1287,8 @@ extern int send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 		}
 	}
 	cnt = list_count(agent_list);
+	if (dbd_spool)
+		cnt += dbd_spool_unread();
 	if ((cnt >= (slurmctld_conf.max_dbd_msgs / 2)) &&
 	    (difftime(time(NULL), syslog_time) > 120)) {
 		/* Record critical error every 120 seconds */
@@ -1212,7 +1303,16 @@ extern int send_slurmdbd_msg(uint16_t rpc_version, slurmdbd_msg_t *req)
 	/* Handle action */
 	_max_dbd_msg_action(&cnt);
 
-	if (cnt < slurmctld_conf.max_dbd_msgs) {
+	if (dbd_spool) {
+		if (_spool_enqueue(buffer) != SLURM_SUCCESS) {
+			error("slurmdbd: unable to spool, discarding %s:%u request",
+			      slurmdbd_msg_type_2_str(req->msg_type, 1),
+			      req->msg_type);
+			if (slurmdbd_conn->trigger_callbacks.acct_full)
+				(slurmdbd_conn->trigger_callbacks.acct_full)();
+			rc = SLURM_ERROR;
+		}
+	} else if (cnt < slurmctld_conf.max_dbd_msgs) {
 		if (list_enqueue(agent_list, buffer) == NULL)
 			fatal("list_enqueue: memory allocation failure");
 	} else {
@@ -1240,8 +1340,23 @@ extern bool slurmdbd_conn_active(void)
 	return true;
 }
 
+extern uint16_t slurmdbd_conn_version(void)
+{
+	uint16_t version = 0;
+
+	slurm_mutex_lock(&slurmdbd_lock);
+	if (slurmdbd_conn && (slurmdbd_conn->fd >= 0))
+		version = slurmdbd_conn->version;
+	slurm_mutex_unlock(&slurmdbd_lock);
+
+	return version;
+}
+
 extern int slurmdbd_agent_queue_count(void)
 {
+	if (dbd_spool)
+		return list_count(agent_list) + dbd_spool_unread();
+
 	return list_count(agent_list);
 }
 
@@ -1274,4 +1389,10 @@ extern void slurmdbd_agent_config_setup(void)
 		xfree(tmp_ptr);
 	} else
 		max_dbd_msg_action = MAX_DBD_DEFAULT_ACTION;
+
+	/* Only read when the agent starts, the queue can not switch after */
+	if (xstrcasestr(slurmctld_conf.slurmctld_params, "dbd_spool"))
+		dbd_spool_conf = true;
+	else
+		dbd_spool_conf = false;
 }
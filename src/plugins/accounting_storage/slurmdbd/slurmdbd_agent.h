@@ -75,6 +75,9 @@ extern int send_slurmdbd_recv_rc_msg(uint16_t rpc_version,
 /* Return true if connection to slurmdbd is active, false otherwise. */
 extern bool slurmdbd_conn_active(void);
 
+/* Return the protocol version of the slurmdbd connection, 0 if not open */
+extern uint16_t slurmdbd_conn_version(void);
+
 /* Return the number of messages waiting to be sent to the DBD */
 extern int slurmdbd_agent_queue_count(void);
 
@@ -0,0 +1,495 @@
+/****************************************************************************\
+ *  slurmdbd_spool.c - on-disk queue of messages pending for the SlurmDBD
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/common/slurm_xlator.h"
+
+#include "src/common/fd.h"
+#include "src/common/slurmdbd_pack.h"
+#include "src/common/xstring.h"
+
+#include "slurmdbd_spool.h"
+
+/*
+ * Segment layout: a header of SEG_HDR_SIZE bytes (SPOOL_MAGIC, rpc version
+ * the messages were packed with) followed by records of
+ * <uint32_t size><size bytes of message><uint32_t REC_MAGIC>. Segments are
+ * allocated zero filled, so a zero size marks the end of the records. The
+ * size is written last, so a record is either complete or absent.
+ */
+#define SPOOL_MAGIC	0x53504f4c
+#define REC_MAGIC	0xDEAD3219
+#define SEG_SIZE	(8 * 1024 * 1024)
+#define SEG_HDR_SIZE	8
+#define REC_OVERHEAD	(2 * sizeof(uint32_t))
+#define CURSOR_FILE	"cursor"
+
+typedef struct {
+	uint32_t seq;
+	uint32_t off;
+} spool_pos_t;
+
+typedef struct {
+	uint32_t seq;
+	int fd;
+	char *map;
+	size_t size;
+	uint32_t off;		/* end of the records, tail only */
+	uint16_t rpc_version;
+} spool_seg_t;
+
+static char *spool_dir = NULL;
+static int cursor_fd = -1;
+static spool_seg_t tail = { .fd = -1 };	/* segment appended to */
+static spool_seg_t head = { .fd = -1 };	/* older segment being read */
+static uint32_t first_seq = 0;		/* oldest segment on disk */
+static spool_pos_t ack_pos;		/* oldest message not acknowledged */
+static spool_pos_t read_pos;		/* oldest unread message */
+static spool_pos_t recover_end;		/* end of the previous runs messages */
+static uint32_t unread_cnt = 0;
+
+/* Ring of the end positions of the loaded messages, oldest first */
+static spool_pos_t *loaded = NULL;
+static uint32_t loaded_first = 0, loaded_cnt = 0, loaded_size = 0;
+
+static bool _pos_before(spool_pos_t *a, spool_pos_t *b)
+{
+	return ((a->seq < b->seq) || ((a->seq == b->seq) && (a->off < b->off)));
+}
+
+static char *_seg_path(uint32_t seq)
+{
+	return xstrdup_printf("%s/%010u.seg", spool_dir, seq);
+}
+
+static void _seg_unmap(spool_seg_t *seg, bool sync)
+{
+	if (seg->map) {
+		if (sync && msync(seg->map, seg->size, MS_SYNC))
+			error("slurmdbd: spool msync: %m");
+		munmap(seg->map, seg->size);
+		seg->map = NULL;
+	}
+	if (seg->fd >= 0) {
+		close(seg->fd);
+		seg->fd = -1;
+	}
+}
+
+/* Map existing segment seq, or create it size bytes long */
+static int _seg_map(spool_seg_t *seg, uint32_t seq, size_t size)
+{
+	struct stat st;
+	char *path = _seg_path(seq);
+	int rc;
+
+	seg->seq = seq;
+	seg->off = SEG_HDR_SIZE;
+	if (size) {
+		seg->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+			       0600);
+		/* Allocate the blocks now, rather than SIGBUS on ENOSPC */
+		if ((seg->fd >= 0) &&
+		    (rc = posix_fallocate(seg->fd, 0, size))) {
+			errno = rc;
+			error("slurmdbd: spool allocate %s: %m", path);
+			close(seg->fd);
+			seg->fd = -1;
+			(void) unlink(path);
+			xfree(path);
+			return SLURM_ERROR;
+		}
+		seg->size = size;
+	} else {
+		seg->fd = open(path, O_RDWR | O_CLOEXEC);
+		if ((seg->fd >= 0) && !fstat(seg->fd, &st))
+			seg->size = st.st_size;
+		else
+			seg->size = 0;
+	}
+	if (seg->fd < 0) {
+		if (size || (errno != ENOENT))
+			error("slurmdbd: spool open %s: %m", path);
+		xfree(path);
+		return SLURM_ERROR;
+	}
+
+	if ((seg->size < SEG_HDR_SIZE) ||
+	    ((seg->map = mmap(NULL, seg->size, PROT_READ | PROT_WRITE,
+			      MAP_SHARED, seg->fd, 0)) == MAP_FAILED)) {
+		error("slurmdbd: spool mmap %s: %m", path);
+		seg->map = NULL;
+		_seg_unmap(seg, false);
+		xfree(path);
+		return SLURM_ERROR;
+	}
+	xfree(path);
+
+	if (size) {
+		*(uint32_t *) seg->map = SPOOL_MAGIC;
+		*(uint16_t *) (seg->map + 4) = SLURM_PROTOCOL_VERSION;
+	} else if (*(uint32_t *) seg->map != SPOOL_MAGIC) {
+		error("slurmdbd: spool segment %u is corrupted", seq);
+		_seg_unmap(seg, false);
+		return SLURM_ERROR;
+	}
+	seg->rpc_version = *(uint16_t *) (seg->map + 4);
+
+	return SLURM_SUCCESS;
+}
+
+/* Return the mapped segment seq, or NULL if it can not be read */
+static spool_seg_t *_seg_get(uint32_t seq)
+{
+	if (seq == tail.seq)
+		return &tail;
+	if (head.map && (head.seq == seq))
+		return &head;
+	_seg_unmap(&head, false);
+	if (_seg_map(&head, seq, 0) != SLURM_SUCCESS)
+		return NULL;
+	return &head;
+}
+
+/* Return the message at offset off of seg, NULL at the end of the records */
+static char *_rec_at(spool_seg_t *seg, uint32_t off, uint32_t *len)
+{
+	uint32_t magic;
+
+	if ((off + REC_OVERHEAD) > seg->size)
+		return NULL;
+	memcpy(len, seg->map + off, sizeof(uint32_t));
+	if (!*len || (*len > (seg->size - off - REC_OVERHEAD)))
+		return NULL;
+	memcpy(&magic, seg->map + off + sizeof(uint32_t) + *len,
+	       sizeof(uint32_t));
+	if (magic != REC_MAGIC)
+		return NULL;
+
+	return seg->map + off + sizeof(uint32_t);
+}
+
+/* Count the records of a previous run from pos on */
+static uint32_t _count_recs(spool_pos_t pos, uint32_t last_seq)
+{
+	spool_seg_t *seg;
+	uint32_t cnt = 0, len;
+
+	for ( ; pos.seq <= last_seq; pos.seq++, pos.off = SEG_HDR_SIZE) {
+		if (!(seg = _seg_get(pos.seq)))
+			continue;
+		while (_rec_at(seg, pos.off, &len)) {
+			pos.off += len + REC_OVERHEAD;
+			cnt++;
+		}
+	}
+	_seg_unmap(&head, false);
+
+	return cnt;
+}
+
+static void _loaded_push(spool_pos_t pos)
+{
+	if (loaded_cnt == loaded_size) {
+		uint32_t i, new_size = loaded_size ? (loaded_size * 2) : 1024;
+		spool_pos_t *ring = xcalloc(new_size, sizeof(spool_pos_t));
+
+		for (i = 0; i < loaded_cnt; i++)
+			ring[i] = loaded[(loaded_first + i) % loaded_size];
+		xfree(loaded);
+		loaded = ring;
+		loaded_first = 0;
+		loaded_size = new_size;
+	}
+	loaded[(loaded_first + loaded_cnt) % loaded_size] = pos;
+	loaded_cnt++;
+}
+
+/*
+ * Messages recovered from a previous run may be registrations with a bogus
+ * cluster name, which the SlurmDBD would refuse forever. Skip them, as
+ * _save_dbd_state() does.
+ */
+static bool _skip_rec(char *data, uint32_t len)
+{
+	uint16_t msg_type;
+
+	if (len < sizeof(msg_type))
+		return true;
+	memcpy(&msg_type, data, sizeof(msg_type));
+
+	return (ntohs(msg_type) == DBD_REGISTER_CTLD);
+}
+
+extern int dbd_spool_open(const char *dir)
+{
+	DIR *dp;
+	struct dirent *de;
+	uint32_t seq, last_seq = 0, cursor[3];
+	char *path, *end;
+
+	xassert(!spool_dir);
+
+	if ((mkdir(dir, 0700) < 0) && (errno != EEXIST)) {
+		error("slurmdbd: spool mkdir(%s): %m", dir);
+		return SLURM_ERROR;
+	}
+	if (!(dp = opendir(dir))) {
+		error("slurmdbd: spool opendir(%s): %m", dir);
+		return SLURM_ERROR;
+	}
+	spool_dir = xstrdup(dir);
+
+	first_seq = 0;
+	while ((de = readdir(dp))) {
+		seq = strtoul(de->d_name, &end, 10);
+		if (!seq || xstrcmp(end, ".seg"))
+			continue;
+		if (!first_seq || (seq < first_seq))
+			first_seq = seq;
+		last_seq = MAX(last_seq, seq);
+	}
+	closedir(dp);
+
+	path = xstrdup_printf("%s/%s", spool_dir, CURSOR_FILE);
+	cursor_fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (cursor_fd < 0) {
+		error("slurmdbd: spool open %s: %m", path);
+		xfree(path);
+		xfree(spool_dir);
+		return SLURM_ERROR;
+	}
+	xfree(path);
+
+	ack_pos.seq = first_seq;
+	ack_pos.off = SEG_HDR_SIZE;
+	if ((pread(cursor_fd, cursor, sizeof(cursor), 0) == sizeof(cursor)) &&
+	    (cursor[0] == SPOOL_MAGIC) && first_seq &&
+	    (cursor[1] >= first_seq) && (cursor[1] <= last_seq)) {
+		ack_pos.seq = cursor[1];
+		ack_pos.off = cursor[2];
+	}
+
+	/* Never append to the segments of a previous run */
+	if (first_seq)
+		unread_cnt = _count_recs(ack_pos, last_seq);
+	if (_seg_map(&tail, last_seq + 1, SEG_SIZE) != SLURM_SUCCESS) {
+		dbd_spool_close();
+		return SLURM_ERROR;
+	}
+	if (!first_seq) {
+		first_seq = tail.seq;
+		ack_pos.seq = tail.seq;
+		ack_pos.off = SEG_HDR_SIZE;
+	}
+	read_pos = ack_pos;
+	recover_end.seq = tail.seq;
+	recover_end.off = SEG_HDR_SIZE;
+	dbd_spool_checkpoint();
+
+	verbose("slurmdbd: spool %s holds %u pending RPCs", spool_dir,
+		unread_cnt);
+
+	return SLURM_SUCCESS;
+}
+
+extern void dbd_spool_close(void)
+{
+	if (!spool_dir)
+		return;
+
+	if (tail.map)
+		dbd_spool_checkpoint();
+	_seg_unmap(&head, false);
+	_seg_unmap(&tail, true);
+	head.seq = tail.seq = 0;
+	if (cursor_fd >= 0) {
+		fsync_and_close(cursor_fd, "dbd spool cursor");
+		cursor_fd = -1;
+	}
+	xfree(loaded);
+	loaded_first = loaded_cnt = loaded_size = 0;
+	unread_cnt = 0;
+	xfree(spool_dir);
+}
+
+extern int dbd_spool_append(Buf buffer, bool loaded_msg)
+{
+	uint32_t len = get_buf_offset(buffer), magic = REC_MAGIC;
+	size_t need = len + REC_OVERHEAD;
+	char *rec;
+
+	xassert(tail.map);
+	xassert(!loaded_msg || !unread_cnt);
+
+	if (!len)
+		return SLURM_ERROR;
+
+	if ((tail.off + need) > tail.size) {
+		spool_seg_t next = { .fd = -1 };
+
+		if (_seg_map(&next, tail.seq + 1,
+			     MAX(SEG_SIZE, need + SEG_HDR_SIZE)) !=
+		    SLURM_SUCCESS)
+			return SLURM_ERROR;
+		/* Let the kernel write back the full segment */
+		msync(tail.map, tail.size, MS_ASYNC);
+		_seg_unmap(&tail, false);
+		tail = next;
+	}
+
+	rec = tail.map + tail.off;
+	memcpy(rec + sizeof(uint32_t), get_buf_data(buffer), len);
+	memcpy(rec + sizeof(uint32_t) + len, &magic, sizeof(magic));
+	memcpy(rec, &len, sizeof(len));
+	tail.off += need;
+
+	if (loaded_msg) {
+		read_pos.seq = tail.seq;
+		read_pos.off = tail.off;
+		_loaded_push(read_pos);
+	} else
+		unread_cnt++;
+
+	return SLURM_SUCCESS;
+}
+
+extern Buf dbd_spool_read(void)
+{
+	spool_seg_t *seg;
+	spool_pos_t rec_pos;
+	uint32_t len;
+	char *data;
+	Buf buffer;
+
+	while (unread_cnt) {
+		if (!(seg = _seg_get(read_pos.seq)) ||
+		    !(data = _rec_at(seg, read_pos.off, &len))) {
+			if (read_pos.seq >= tail.seq) {
+				error("slurmdbd: spool lost %u RPCs",
+				      unread_cnt);
+				unread_cnt = 0;
+				break;
+			}
+			read_pos.seq++;
+			read_pos.off = SEG_HDR_SIZE;
+			continue;
+		}
+		rec_pos = read_pos;
+		read_pos.off += len + REC_OVERHEAD;
+		unread_cnt--;
+
+		if (_pos_before(&rec_pos, &recover_end) &&
+		    _skip_rec(data, len))
+			continue;
+
+		buffer = init_buf(len);
+		memcpy(get_buf_data(buffer), data, len);
+		set_buf_offset(buffer, len);
+
+		if (seg->rpc_version != SLURM_PROTOCOL_VERSION) {
+			/*
+			 * unpack and repack with new PROTOCOL_VERSION just so
+			 * we keep things up to date.
+			 */
+			slurmdbd_msg_t msg;
+			int rc;
+
+			set_buf_offset(buffer, 0);
+			rc = unpack_slurmdbd_msg(&msg, seg->rpc_version,
+						 buffer);
+			free_buf(buffer);
+			if (rc != SLURM_SUCCESS) {
+				error("slurmdbd: spool unpack error");
+				continue;
+			}
+			buffer = pack_slurmdbd_msg(&msg,
+						   SLURM_PROTOCOL_VERSION);
+			slurmdbd_free_msg(&msg);
+			if (!buffer)
+				continue;
+		}
+
+		if (!unread_cnt)
+			_seg_unmap(&head, false);
+		_loaded_push(read_pos);
+		return buffer;
+	}
+
+	return NULL;
+}
+
+extern void dbd_spool_ack(int cnt)
+{
+	xassert(cnt <= loaded_cnt);
+
+	while ((cnt-- > 0) && loaded_cnt) {
+		ack_pos = loaded[loaded_first];
+		loaded_first = (loaded_first + 1) % loaded_size;
+		loaded_cnt--;
+	}
+	/* Everything read is acknowledged, including skipped messages */
+	if (!loaded_cnt)
+		ack_pos = read_pos;
+}
+
+extern void dbd_spool_checkpoint(void)
+{
+	uint32_t cursor[3] = { SPOOL_MAGIC, ack_pos.seq, ack_pos.off };
+	char *path;
+
+	if (cursor_fd < 0)
+		return;
+
+	if (pwrite(cursor_fd, cursor, sizeof(cursor), 0) != sizeof(cursor))
+		error("slurmdbd: spool cursor write: %m");
+
+	/* The cursor is written before any message it skips is removed */
+	for ( ; first_seq < ack_pos.seq; first_seq++) {
+		path = _seg_path(first_seq);
+		if ((unlink(path) < 0) && (errno != ENOENT))
+			error("slurmdbd: spool unlink %s: %m", path);
+		xfree(path);
+	}
+}
+
+extern uint32_t dbd_spool_unread(void)
+{
+	return unread_cnt;
+}
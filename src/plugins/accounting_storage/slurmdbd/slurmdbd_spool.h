@@ -0,0 +1,84 @@
+/****************************************************************************\
+ *  slurmdbd_spool.h - on-disk queue of messages pending for the SlurmDBD
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _SLURMDBD_SPOOL_H
+#define _SLURMDBD_SPOOL_H
+
+#include "src/common/pack.h"
+
+/*
+ * The spool is an append-only log of packed messages split in memory mapped
+ * segment files, plus a cursor file holding the position of the oldest
+ * message not acknowledged by the SlurmDBD. Every queued message is appended
+ * as it is queued, so nothing has to be saved at shutdown and a crash loses
+ * nothing. Messages are "loaded" when the agent holds them in memory, and
+ * "unread" while they only exist on disk.
+ *
+ * None of these functions are thread safe, the caller must hold agent_lock.
+ */
+
+/*
+ * Open the spool in directory dir, creating it if needed, and recover the
+ * messages a previous run did not get acknowledged. They are all unread.
+ * Returns SLURM_SUCCESS or SLURM_ERROR
+ */
+extern int dbd_spool_open(const char *dir);
+
+/* Checkpoint the cursor and release the spool */
+extern void dbd_spool_close(void);
+
+/*
+ * Append a packed message to the spool.
+ * loaded IN - the caller keeps the message in memory, only allowed when
+ *	       there are no unread messages
+ * Returns SLURM_SUCCESS or SLURM_ERROR (e.g. the file system is full)
+ */
+extern int dbd_spool_append(Buf buffer, bool loaded);
+
+/*
+ * Load the oldest unread message, repacked with SLURM_PROTOCOL_VERSION if
+ * needed. Controller registrations recovered from a previous run are skipped.
+ * Returns the message to free with free_buf() or NULL if there is none.
+ */
+extern Buf dbd_spool_read(void);
+
+/* Acknowledge the cnt oldest loaded messages */
+extern void dbd_spool_ack(int cnt);
+
+/* Write the cursor and remove the segments that are fully acknowledged */
+extern void dbd_spool_checkpoint(void);
+
+/* Return the number of unread messages */
+extern uint32_t dbd_spool_unread(void);
+
+#endif
@@ -40,16 +40,21 @@
 #include <dirent.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <glob.h>
 #include <limits.h>
+#include <netdb.h>
 #include <netinet/in.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #include "src/common/slurm_xlator.h"
 #include "src/common/assoc_mgr.h"
+#include "src/common/env.h"
+#include "src/common/fd.h"
 #include "src/common/slurm_acct_gather_filesystem.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/slurm_protocol_defs.h"
@@ -66,6 +71,7 @@
 #define _DEBUG 1
 #define _DEBUG_FILESYSTEM 1
 #define FILESYSTEM_DEFAULT_PORT 1
+#define LUSTRE_JOBID_ENV "SLURM_LUSTRE_JOBID"	/* Lustre jobid_var */
 
 /*
  * These variables are required by the generic plugin interface.  If they
@@ -107,11 +113,20 @@ typedef struct {
 
 static lustre_stats_t lstats = {0,0,0,0,0};
 static lustre_stats_t lstats_prev = {0,0,0,0,0};
+static lustre_stats_t lstats_stream = {0,0,0,0,0};
 
 static uint64_t debug_flags = 0;
 static pthread_mutex_t lustre_lock = PTHREAD_MUTEX_INITIALIZER;
 static int tres_pos = -1;
 
+static char *job_stats_path = NULL;	/* LustreJobStats */
+static char *job_stream = NULL;		/* LustreJobStream */
+static int stream_fd = -1;
+static uint32_t job_id = 0;
+static uint32_t step_id = NO_VAL;
+static char *node_name = NULL;
+static char *job_tag = NULL;	/* job_stats job_id of this step and node */
+
 
 /*
  * _llite_path()
@@ -214,6 +229,10 @@ static int _read_lustre_counters(void)
 		return SLURM_ERROR;
 	}
 
+	/* The stats files hold totals, sum them afresh on each read */
+	lstats.write_bytes = lstats.read_bytes = 0;
+	lstats.write_samples = lstats.read_samples = 0;
+
 	while ((entry = readdir(proc_dir))) {
 		char *path_stats = NULL;
 		bool bread;
@@ -284,6 +303,217 @@ static int _read_lustre_counters(void)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * _parse_job_stats_line()
+ *
+ * Parse one operation line of a Lustre job_stats entry:
+ *
+ *   read_bytes:  { samples: 17, unit: bytes, min: 4096, max: 4194304, sum: 30994606 }
+ */
+static void _parse_job_stats_line(char *line, uint64_t *samples,
+				  uint64_t *bytes)
+{
+	char *ptr;
+
+	if ((ptr = strstr(line, "samples:")))
+		*samples += strtoull(ptr + 8, NULL, 10);
+	if ((ptr = strstr(line, "sum:")))
+		*bytes += strtoull(ptr + 4, NULL, 10);
+}
+
+/* _read_job_counters()
+ *
+ * Read this step's counters on this node from the Lustre job_stats files
+ * matching LustreJobStats. The Lustre clients must be configured with
+ * jobid_var=SLURM_LUSTRE_JOBID and jobid_name=%j.%H, so that every RPC is
+ * tagged with <job_id>.<step_id>.<short hostname> (see _set_job_tag()).
+ * Each entry is:
+ *
+ * - job_id:          1234.0.node01
+ *   snapshot_time:   1409243311
+ *   read_bytes:      { samples: 1, unit: bytes, min: 4096, max: 4096, sum: 4096 }
+ *   write_bytes:     { samples: 1, unit: bytes, min: 4096, max: 4096, sum: 4096 }
+ *
+ * Counters of all matching files (e.g. one per OST) are summed. Entries
+ * only exist once the step did I/O and expire when it stops, no entry counts
+ * as no I/O.
+ */
+static int _read_job_counters(void)
+{
+	glob_t gl;
+	char buffer[BUFSIZ];
+	size_t i;
+	static bool first = true, no_files = false;
+	int rc;
+
+	lstats.write_bytes = lstats.read_bytes = 0;
+	lstats.write_samples = lstats.read_samples = 0;
+	lstats.update_time = time(NULL);
+
+	if ((rc = glob(job_stats_path, 0, NULL, &gl))) {
+		if (rc != GLOB_NOMATCH)
+			return SLURM_ERROR;
+		/* job_stats are only found on Lustre servers */
+		if (!no_files)
+			info("%s: LustreJobStats=%s matches no files, no Lustre I/O is recorded",
+			     plugin_name, job_stats_path);
+		no_files = true;
+		gl.gl_pathc = 0;
+	}
+
+	for (i = 0; i < gl.gl_pathc; i++) {
+		FILE *fff;
+		bool match = false;
+
+		if (!(fff = fopen(gl.gl_pathv[i], "r"))) {
+			error("%s: Cannot open %s %m", __func__,
+			      gl.gl_pathv[i]);
+			continue;
+		}
+		while (fgets(buffer, BUFSIZ, fff)) {
+			char *ptr;
+
+			if ((ptr = strstr(buffer, "job_id:"))) {
+				ptr += 7;
+				while (*ptr == ' ')
+					ptr++;
+				ptr[strcspn(ptr, " \n")] = '\0';
+				match = !xstrcmp(ptr, job_tag);
+			} else if (!match) {
+				continue;
+			} else if (strstr(buffer, "read_bytes:")) {
+				_parse_job_stats_line(buffer,
+						      &lstats.read_samples,
+						      &lstats.read_bytes);
+			} else if (strstr(buffer, "write_bytes:")) {
+				_parse_job_stats_line(buffer,
+						      &lstats.write_samples,
+						      &lstats.write_bytes);
+			}
+		}
+		fclose(fff);
+	}
+	if (gl.gl_pathc)
+		globfree(&gl);
+
+	debug3("%s: %s write_bytes %"PRIu64" read_bytes %"PRIu64,
+	       __func__, job_tag, lstats.write_bytes, lstats.read_bytes);
+
+	if (first) {
+		memcpy(&lstats_prev, &lstats, sizeof(lustre_stats_t));
+		memcpy(&lstats_stream, &lstats, sizeof(lustre_stats_t));
+		first = false;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+/* Counter difference, job_stats entries are reset when they expire */
+static uint64_t _delta(uint64_t cur, uint64_t prev)
+{
+	return (cur >= prev) ? (cur - prev) : cur;
+}
+
+/*
+ * _open_stream()
+ *
+ * Open the UDP socket given by LustreJobStream=host:port
+ */
+static void _open_stream(void)
+{
+	struct addrinfo hints, *result = NULL;
+	char *host, *port;
+	int rc;
+
+	host = xstrdup(job_stream);
+	if (!(port = strrchr(host, ':'))) {
+		error("%s: invalid LustreJobStream %s", __func__, job_stream);
+		xfree(host);
+		return;
+	}
+	*port++ = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if ((rc = getaddrinfo(host, port, &hints, &result))) {
+		error("%s: getaddrinfo(%s): %s", __func__, job_stream,
+		      gai_strerror(rc));
+		xfree(host);
+		return;
+	}
+
+	stream_fd = socket(result->ai_family, result->ai_socktype,
+			   result->ai_protocol);
+	if (stream_fd < 0) {
+		error("%s: socket: %m", __func__);
+	} else if (connect(stream_fd, result->ai_addr,
+			   result->ai_addrlen) < 0) {
+		error("%s: connect(%s): %m", __func__, job_stream);
+		close(stream_fd);
+		stream_fd = -1;
+	} else {
+		fd_set_close_on_exec(stream_fd);
+		fd_set_nonblocking(stream_fd);
+	}
+	freeaddrinfo(result);
+	xfree(host);
+}
+
+/*
+ * _send_stream()
+ *
+ * Send this step's counter deltas on this node since the previous record to
+ * LustreJobStream as one line of JSON, see acct_gather.conf(5)
+ */
+static void _send_stream(void)
+{
+	char buf[512];
+	uint64_t reads, writes, read_bytes, write_bytes;
+	int len;
+
+	if (stream_fd < 0)
+		return;
+
+	reads = _delta(lstats.read_samples, lstats_stream.read_samples);
+	writes = _delta(lstats.write_samples, lstats_stream.write_samples);
+	read_bytes = _delta(lstats.read_bytes, lstats_stream.read_bytes);
+	write_bytes = _delta(lstats.write_bytes, lstats_stream.write_bytes);
+	if (!reads && !writes)
+		return;
+
+	len = snprintf(buf, sizeof(buf),
+		       "{\"type\":\"job_io\",\"job_id\":%u,\"step_id\":%u,"
+		       "\"node\":\"%s\",\"time\":%ld,\"interval\":%ld,"
+		       "\"lustre\":{\"reads\":%"PRIu64",\"read_bytes\":%"PRIu64","
+		       "\"writes\":%"PRIu64",\"write_bytes\":%"PRIu64"}}\n",
+		       job_id, step_id, node_name, (long) lstats.update_time,
+		       (long) (lstats.update_time - lstats_stream.update_time),
+		       reads, read_bytes, writes, write_bytes);
+	if (send(stream_fd, buf, len, 0) < 0)
+		debug("%s: send to %s: %m", __func__, job_stream);
+
+	memcpy(&lstats_stream, &lstats, sizeof(lustre_stats_t));
+}
+
+/*
+ * _read_counters()
+ *
+ * Read this step's counters on this node if LustreJobStats is configured,
+ * otherwise the node-wide llite counters
+ */
+static int _read_counters(void)
+{
+	if (job_stats_path && job_tag) {
+		if (_read_job_counters() != SLURM_SUCCESS)
+			return SLURM_ERROR;
+		_send_stream();
+		return SLURM_SUCCESS;
+	}
+
+	return _read_lustre_counters();
+}
+
 /*
  *_update_node_filesystem()
  *
@@ -319,7 +549,7 @@ static int _update_node_filesystem(void)
 
 	slurm_mutex_lock(&lustre_lock);
 
-	if (_read_lustre_counters() != SLURM_SUCCESS) {
+	if (_read_counters() != SLURM_SUCCESS) {
 		error("%s: Cannot read lustre counters", __func__);
 		slurm_mutex_unlock(&lustre_lock);
 		return SLURM_ERROR;
@@ -344,14 +574,14 @@ static int _update_node_filesystem(void)
 
 	/* Compute the current values read from all lustre-xxxx directories */
 	data[FIELD_READ].u64 =
-		lstats.read_samples - lstats_prev.read_samples;
+		_delta(lstats.read_samples, lstats_prev.read_samples);
 	data[FIELD_READMB].d =
-		(double)(lstats.read_bytes - lstats_prev.read_bytes) /
+		(double)_delta(lstats.read_bytes, lstats_prev.read_bytes) /
 		(1 << 20);
 	data[FIELD_WRITE].u64 =
-		lstats.write_samples - lstats_prev.write_samples;
+		_delta(lstats.write_samples, lstats_prev.write_samples);
 	data[FIELD_WRITEMB].d =
-		(double)(lstats.write_bytes - lstats_prev.write_bytes) /
+		(double)_delta(lstats.write_bytes, lstats_prev.write_bytes) /
 		(1 << 20);
 
 	/* record sample */
@@ -395,6 +625,15 @@ extern int init(void)
 
 extern int fini(void)
 {
+	if (stream_fd >= 0) {
+		close(stream_fd);
+		stream_fd = -1;
+	}
+	xfree(job_stats_path);
+	xfree(job_stream);
+	xfree(node_name);
+	xfree(job_tag);
+
 	if (!running_in_slurmstepd())
 		return SLURM_SUCCESS;
 
@@ -415,6 +654,13 @@ extern int acct_gather_filesystem_p_node_update(void)
 
 extern void acct_gather_filesystem_p_conf_set(s_p_hashtbl_t *tbl)
 {
+	xfree(job_stats_path);
+	xfree(job_stream);
+	if (tbl) {
+		s_p_get_string(&job_stats_path, "LustreJobStats", tbl);
+		s_p_get_string(&job_stream, "LustreJobStream", tbl);
+	}
+
 	if (!running_in_slurmstepd())
 		return;
 
@@ -424,15 +670,86 @@ extern void acct_gather_filesystem_p_conf_set(s_p_hashtbl_t *tbl)
 extern void acct_gather_filesystem_p_conf_options(s_p_options_t **full_options,
 						  int *full_options_cnt)
 {
+	s_p_options_t options[] = {
+		{"LustreJobStats", S_P_STRING},
+		{"LustreJobStream", S_P_STRING},
+		{NULL} };
+
+	transfer_s_p_options(full_options, options, full_options_cnt);
 
 	return;
 }
 
 extern void acct_gather_filesystem_p_conf_values(List *data)
 {
+	config_key_pair_t *key_pair;
+
+	xassert(*data);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("LustreJobStats");
+	key_pair->value = xstrdup(job_stats_path);
+	list_append(*data, key_pair);
+
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("LustreJobStream");
+	key_pair->value = xstrdup(job_stream);
+	list_append(*data, key_pair);
+
 	return;
 }
 
+/*
+ * _set_job_tag()
+ *
+ * Export the Lustre job ID of the step's tasks, <job_id>.<step_id>, and
+ * build the job_stats job_id of the step on this node, to which Lustre adds
+ * the short hostname through jobid_name=%j.%H. Each node and step of a job
+ * thus has its own job_stats entry and counts only its own I/O.
+ */
+static void _set_job_tag(stepd_step_rec_t *job)
+{
+	char host[HOST_NAME_MAX + 1], *step_str = NULL, *jobid = NULL;
+
+	if (job->stepid == SLURM_BATCH_SCRIPT)
+		step_str = xstrdup("batch");
+	else if (job->stepid == SLURM_EXTERN_CONT)
+		step_str = xstrdup("extern");
+	else
+		step_str = xstrdup_printf("%u", job->stepid);
+	xstrfmtcat(jobid, "%u.%s", job->jobid, step_str);
+	env_array_overwrite(&job->env, LUSTRE_JOBID_ENV, jobid);
+
+	if (gethostname(host, sizeof(host)) < 0) {
+		error("%s: gethostname: %m", __func__);
+		strlcpy(host, job->node_name, sizeof(host));
+	}
+	host[sizeof(host) - 1] = '\0';
+	host[strcspn(host, ".")] = '\0';
+	xfree(job_tag);
+	job_tag = xstrdup_printf("%s.%s", jobid, host);
+
+	xfree(jobid);
+	xfree(step_str);
+}
+
+extern int acct_gather_filesystem_p_node_step_start(stepd_step_rec_t *job)
+{
+	slurm_mutex_lock(&lustre_lock);
+	job_id = job->jobid;
+	step_id = job->stepid;
+	xfree(node_name);
+	node_name = xstrdup(job->node_name);
+	if (job_stats_path) {
+		_set_job_tag(job);
+		if (job_stream && (stream_fd < 0))
+			_open_stream();
+	}
+	slurm_mutex_unlock(&lustre_lock);
+
+	return SLURM_SUCCESS;
+}
+
 extern int acct_gather_filesystem_p_get_data(acct_gather_data_t *data)
 {
 	int retval = SLURM_SUCCESS;
@@ -444,7 +761,7 @@ extern int acct_gather_filesystem_p_get_data(acct_gather_data_t *data)
 
 	slurm_mutex_lock(&lustre_lock);
 
-	if (_read_lustre_counters() != SLURM_SUCCESS) {
+	if (_read_counters() != SLURM_SUCCESS) {
 		error("%s: Cannot read lustre counters", __func__);
 		slurm_mutex_unlock(&lustre_lock);
 		return SLURM_ERROR;
@@ -452,14 +769,14 @@ extern int acct_gather_filesystem_p_get_data(acct_gather_data_t *data)
 
 	/* Obtain the current values read from all lustre-xxxx directories */
 	data[tres_pos].num_reads =
-		lstats.read_samples - lstats_prev.read_samples;
+		_delta(lstats.read_samples, lstats_prev.read_samples);
 	data[tres_pos].num_writes =
-		lstats.write_samples - lstats_prev.write_samples;
+		_delta(lstats.write_samples, lstats_prev.write_samples);
 	data[tres_pos].size_read =
-		(double)(lstats.read_bytes - lstats_prev.read_bytes) /
+		(double)_delta(lstats.read_bytes, lstats_prev.read_bytes) /
 		(1 << 20);
 	data[tres_pos].size_write =
-		(double)(lstats.write_bytes - lstats_prev.write_bytes) /
+		(double)_delta(lstats.write_bytes, lstats_prev.write_bytes) /
 		(1 << 20);
 
 	memcpy(&lstats_prev, &lstats, sizeof(lustre_stats_t));
@@ -124,3 +124,8 @@ extern int acct_gather_filesystem_p_get_data(acct_gather_data_t *data)
 {
 	return SLURM_SUCCESS;
 }
+
+extern int acct_gather_filesystem_p_node_step_start(stepd_step_rec_t *job)
+{
+	return SLURM_SUCCESS;
+}
@@ -64,12 +64,16 @@
 #include "src/slurmd/common/proctrack.h"
 #include "hdf5_api.h"
 
-#define HDF5_CHUNK_SIZE 10
-/* Compression level, a value of 0 through 9. Level 0 is faster but offers the
- * least compression; level 9 is slower but offers maximum compression.
- * A setting of -1 indicates that no compression is desired. */
-/* TODO: Make this configurable with a parameter */
-#define HDF5_COMPRESS 0
+/*
+ * Records per chunk of each table. Samples are kept in memory until a whole
+ * chunk is collected so every append writes (and compresses) exactly one
+ * chunk, and sh5util copies a few large chunks instead of many tiny ones.
+ */
+#define HDF5_CHUNK_SIZE 256
+/* Default compression level, a value of 0 through 9. Level 1 is faster but
+ * offers the least compression; level 9 is slower but offers maximum
+ * compression. Level 0 disables compression. */
+#define DEFAULT_HDF5_COMPRESS 1
 
 /*
  * These variables are required by the generic plugin interface.  If they
@@ -103,11 +107,14 @@ const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 typedef struct {
 	char *dir;
 	uint32_t def;
+	uint16_t compress;
 } slurm_hdf5_conf_t;
 
 typedef struct {
 	hid_t  table_id;
 	size_t type_size;
+	uint8_t *batch;		/* records not appended to the table yet */
+	size_t batch_cnt;
 } table_t;
 
 // Global HDF5 Variables
@@ -137,6 +144,33 @@ static void _reset_slurm_profile_conf(void)
 {
 	xfree(hdf5_conf.dir);
 	hdf5_conf.def = ACCT_GATHER_PROFILE_NONE;
+	hdf5_conf.compress = DEFAULT_HDF5_COMPRESS;
+}
+
+/* Append the records collected for a table in one write */
+static int _flush_table(table_t *ds)
+{
+	int rc = SLURM_SUCCESS;
+
+	if (!ds->batch_cnt)
+		return rc;
+
+	if (H5PTappend(ds->table_id, ds->batch_cnt, ds->batch) < 0) {
+		error("PROFILE: Impossible to add %zu records to a table",
+		      ds->batch_cnt);
+		rc = SLURM_ERROR;
+	}
+	ds->batch_cnt = 0;
+
+	return rc;
+}
+
+static void _flush_tables(void)
+{
+	size_t i;
+
+	for (i = 0; i < tables_cur_len; ++i)
+		_flush_table(&tables[i]);
 }
 
 static uint32_t _determine_profile(void)
@@ -220,6 +254,10 @@ extern int init(void)
 
 extern int fini(void)
 {
+	size_t i;
+
+	for (i = 0; i < tables_cur_len; ++i)
+		xfree(tables[i].batch);
 	xfree(tables);
 	xfree(groups);
 	xfree(hdf5_conf.dir);
@@ -232,6 +270,7 @@ extern void acct_gather_profile_p_conf_options(s_p_options_t **full_options,
 	s_p_options_t options[] = {
 		{"ProfileHDF5Dir", S_P_STRING},
 		{"ProfileHDF5Default", S_P_STRING},
+		{"ProfileHDF5Compress", S_P_UINT16},
 		{NULL} };
 
 	transfer_s_p_options(full_options, options, full_options_cnt);
@@ -254,6 +293,10 @@ extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
 			}
 			xfree(tmp);
 		}
+
+		if (s_p_get_uint16(&hdf5_conf.compress, "ProfileHDF5Compress",
+				   tbl) && (hdf5_conf.compress > 9))
+			fatal("ProfileHDF5Compress must be between 0 and 9");
 	}
 
 	if (!hdf5_conf.dir)
@@ -411,6 +454,7 @@ extern int acct_gather_profile_p_node_step_end(void)
 
 	/* close tables */
 	for (i = 0; i < tables_cur_len; ++i) {
+		_flush_table(&tables[i]);
 		H5PTclose(tables[i].table_id);
 	}
 	/* close groups */
@@ -456,6 +500,11 @@ extern int acct_gather_profile_p_task_end(pid_t taskpid)
 {
 	if (debug_flags & DEBUG_FLAG_PROFILE)
 		info("PROFILE: task_end");
+
+	/* Do not hold the samples of a finished task until the step ends */
+	if (file_id > 0)
+		_flush_tables();
+
 	return SLURM_SUCCESS;
 }
 
@@ -550,7 +599,7 @@ extern int acct_gather_profile_p_create_dataset(
 	if (parent < 0)
 		parent = gid_node; /* default parent is the node group */
 	table_id = H5PTcreate_fl(parent, name, dtype_id, HDF5_CHUNK_SIZE,
-	                         HDF5_COMPRESS);
+				 hdf5_conf.compress ? hdf5_conf.compress : -1);
 	if (table_id < 0) {
 		error("PROFILE: Impossible to create the table %s", name);
 		H5Tclose(dtype_id);
@@ -569,6 +618,8 @@ extern int acct_gather_profile_p_create_dataset(
 	/* reserve a new table */
 	tables[tables_cur_len].table_id  = table_id;
 	tables[tables_cur_len].type_size = type_size;
+	tables[tables_cur_len].batch = xmalloc(type_size * HDF5_CHUNK_SIZE);
+	tables[tables_cur_len].batch_cnt = 0;
 	++tables_cur_len;
 
 	return tables_cur_len - 1;
@@ -577,8 +628,8 @@ extern int acct_gather_profile_p_create_dataset(
 extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 						 time_t sample_time)
 {
-	table_t *ds = &tables[table_id];
-	uint8_t send_data[ds->type_size];
+	table_t *ds;
+	uint8_t *send_data;
 	int header_size = 0;
 	debug("acct_gather_profile_p_add_sample_data %d", table_id);
 
@@ -592,6 +643,7 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 		      table_id);
 		return SLURM_ERROR;
 	}
+	ds = &tables[table_id];
 
 	/* ensure that we have to record something */
 	xassert(running_in_slurmstepd());
@@ -601,6 +653,8 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 	if (g_profile_running <= ACCT_GATHER_PROFILE_NONE)
 		return SLURM_ERROR;
 
+	send_data = ds->batch + (ds->batch_cnt * ds->type_size);
+
 	/* prepend timestampe and relative time */
 	((uint64_t *)send_data)[0] = difftime(sample_time, step_start_time);
 	header_size += sizeof(uint64_t);
@@ -609,12 +663,9 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 
 	memcpy(send_data + header_size, data, ds->type_size - header_size);
 
-	/* append the record to the table */
-	if (H5PTappend(ds->table_id, 1, send_data) < 0) {
-		error("PROFILE: Impossible to add data to the table %d; "
-		      "maybe the table has not been created?", table_id);
-		return SLURM_ERROR;
-	}
+	/* append the records to the table once a chunk is complete */
+	if (++ds->batch_cnt == HDF5_CHUNK_SIZE)
+		return _flush_table(ds);
 
 	return SLURM_SUCCESS;
 }
@@ -635,6 +686,11 @@ extern void acct_gather_profile_p_conf_values(List *data)
 	key_pair->value = xstrdup(acct_gather_profile_to_string(hdf5_conf.def));
 	list_append(*data, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileHDF5Compress");
+	key_pair->value = xstrdup_printf("%u", hdf5_conf.compress);
+	list_append(*data, key_pair);
+
 	return;
 
 }
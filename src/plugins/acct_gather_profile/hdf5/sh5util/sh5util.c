@@ -120,8 +120,21 @@
 #define H5free_memory free
 #endif
 
+/* Records read from a table at once */
+#define READ_BATCH 1024
+
 sh5util_opts_t params;
 
+/* Read the records of a table a batch at a time */
+typedef struct {
+	hid_t table_id;
+	size_t rec_size;
+	hsize_t left;		/* records not read from the table yet */
+	uint8_t *buf;
+	size_t cnt;		/* records in buf */
+	size_t pos;		/* next record of buf to return */
+} series_reader_t;
+
 typedef struct table {
 	const char *step;
 	const char *node;
@@ -184,6 +197,8 @@ static void _help_msg(void)
 	       "                      Default for extract is ./extract_$jobid.csv\n"
 	       " -p, --profiledir     Profile directory location where node-step files exist\n"
 	       "		               default is what is set in acct_gather.conf\n"
+	       " -k, --link           Merge by linking to the node-step files instead of\n"
+	       "                      copying them (implies --savefiles)\n"
 	       " -S, --savefiles      Don't remove node-step files after merging them \n"
 	       " --user               User who profiled job. (Handy for root user, defaults to \n"
 	       "		               user running this command.)\n"
@@ -346,6 +361,7 @@ static int _set_options(const int argc, char **argv)
 		{"help", no_argument, 0, 'h'},
 		{"jobs", required_argument, 0, 'j'},
 		{"input", required_argument, 0, 'i'},
+		{"link", no_argument, 0, 'k'},
 		{"level", required_argument, 0, 'l'},
 		{"list", no_argument, 0, 'L'},
 		{"node", required_argument, 0, 'N'},
@@ -372,7 +388,7 @@ static int _set_options(const int argc, char **argv)
 
 	_init_opts();
 
-	while ((cc = getopt_long(argc, argv, "d:Ehi:Ij:l:LN:o:p:s:Su:UvV",
+	while ((cc = getopt_long(argc, argv, "d:Ehi:Ij:kl:LN:o:p:s:Su:UvV",
 	                         long_options, &option_index)) != EOF) {
 		switch (cc) {
 		case 'd':
@@ -402,6 +418,10 @@ static int _set_options(const int argc, char **argv)
 				params.step_id =
 					strtol(next_str + 1, NULL, 10);
 			break;
+		case 'k':
+			params.link = true;
+			params.keepfiles = 1;
+			break;
 		case 'l':
 			params.level = xstrdup(optarg);
 			break;
@@ -529,7 +549,7 @@ _check_params(void)
 
 /*
  * Copy the group "/{NodeName}" of the hdf5 file file_name into the location
- * jgid_nodes
+ * jgid_nodes, or with --link only point to it from there
  */
 static int _merge_node_step_data(char* file_name, hid_t jgid_nodes,
 				 sh5util_file_t *sh5util_file)
@@ -538,6 +558,19 @@ static int _merge_node_step_data(char* file_name, hid_t jgid_nodes,
 	char *group_name = NULL;
 	int rc = SLURM_SUCCESS;
 
+	if (params.link) {
+		group_name = xstrdup_printf("/%s", sh5util_file->node_name);
+		if (H5Lcreate_external(file_name, group_name, jgid_nodes,
+				       sh5util_file->node_name, H5P_DEFAULT,
+				       H5P_DEFAULT) < 0) {
+			error("Failed to link node step data of %s into the "
+			      "job file", sh5util_file->node_name);
+			rc = SLURM_ERROR;
+		}
+		xfree(group_name);
+		return rc;
+	}
+
 	fid_nodestep = H5Fopen(file_name, H5F_ACC_RDONLY, H5P_DEFAULT);
 	if (fid_nodestep < 0) {
 		error("Failed to open %s",file_name);
@@ -761,6 +794,41 @@ endit:
  * ============================================================================
  * ========================================================================= */
 
+static void _reader_init(series_reader_t *reader, hid_t table_id,
+			 size_t rec_size)
+{
+	memset(reader, 0, sizeof(series_reader_t));
+	reader->table_id = table_id;
+	reader->rec_size = rec_size;
+	H5PTget_num_packets(table_id, &reader->left);
+	reader->buf = xmalloc(rec_size * MIN(reader->left + 1, READ_BATCH));
+}
+
+/* Return the next record of the table or NULL when all have been read */
+static uint8_t *_reader_next(series_reader_t *reader)
+{
+	if (reader->pos == reader->cnt) {
+		if (!reader->left)
+			return NULL;
+		reader->cnt = MIN(reader->left, READ_BATCH);
+		if (H5PTget_next(reader->table_id, reader->cnt,
+				 reader->buf) < 0) {
+			error("Failed to read %zu records", reader->cnt);
+			reader->left = reader->cnt = 0;
+			return NULL;
+		}
+		reader->left -= reader->cnt;
+		reader->pos = 0;
+	}
+
+	return reader->buf + (reader->pos++ * reader->rec_size);
+}
+
+static void _reader_fini(series_reader_t *reader)
+{
+	xfree(reader->buf);
+}
+
 static void _table_free(void *table)
 {
 	table_t *t = (table_t *)table;
@@ -916,13 +984,15 @@ static int _tables_list(hid_t fid_job, List tables)
  * @param node_name Name of the node containing this table
  * @param output    output file
  */
-static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
+static void _extract_totals(size_t nb_fields, size_t *offsets,
+                            acct_gather_profile_field_type_t *types,
                             hsize_t type_size, hid_t table_id,
                             table_t *table, FILE *output)
 {
+	series_reader_t reader;
 	hsize_t nrecords;
 	size_t i, j;
-	uint8_t *data;
+	uint8_t *data, *rec;
 
 	/* allocate space for aggregate values: 4 values (min, max,
 	 * sum, avg) on 8 bytes (uint64_t/double) for each field */
@@ -932,13 +1002,14 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 	data = xmalloc(type_size);
 	agg_i = xmalloc(nb_fields * 4 * sizeof(uint64_t));
 	agg_d = (double *)agg_i;
-	H5PTget_num_packets(table_id, &nrecords);
+	_reader_init(&reader, table_id, type_size);
+	nrecords = reader.left;
 
 	/* compute min/max/sum */
-	for (i = 0; i < nrecords; ++i) {
-		H5PTget_next(table_id, 1, data);
+	for (i = 0; (rec = _reader_next(&reader)); ++i) {
+		memcpy(data, rec, type_size);
 		for (j = 0; j < nb_fields; ++j) {
-			if (H5Tequal(types[j], H5T_NATIVE_UINT64)) {
+			if (types[j] == PROFILE_FIELD_UINT64) {
 				uint64_t v = *(uint64_t *)(data + offsets[j]);
 				uint64_t *a = agg_i + j * 4;
 				if (i == 0 || v < a[0]) /* min */
@@ -946,7 +1017,7 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 				if (v > a[1]) /* max */
 					a[1] = v;
 				a[2] += v; /* sum */
-			} else if (H5Tequal(types[j], H5T_NATIVE_DOUBLE)) {
+			} else if (types[j] == PROFILE_FIELD_DOUBLE) {
 				double v = *(double *)(data + offsets[j]);
 				double *a = agg_d + j * 4;
 				if (i == 0 || v < a[0]) /* min */
@@ -961,9 +1032,9 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 	/* compute avg */
 	if (nrecords) {
 		for (j = 0; j < nb_fields; ++j) {
-			if (H5Tequal(types[j], H5T_NATIVE_UINT64)) {
+			if (types[j] == PROFILE_FIELD_UINT64) {
 				agg_d[j*4+3] = (double)agg_i[j*4+2] / nrecords;
-			} else if (H5Tequal(types[j], H5T_NATIVE_DOUBLE)) {
+			} else if (types[j] == PROFILE_FIELD_DOUBLE) {
 				agg_d[j*4+3] = (double)agg_d[j*4+2] / nrecords;
 			}
 		}
@@ -980,13 +1051,13 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 
 	/* aggregate values */
 	for (j = 0; j < nb_fields; ++j) {
-		if (H5Tequal(types[j], H5T_NATIVE_UINT64)) {
+		if (types[j] == PROFILE_FIELD_UINT64) {
 			fprintf(output, ",%"PRIu64",%"PRIu64",%"PRIu64",%lf",
 			        agg_i[j * 4 + 0],
 			        agg_i[j * 4 + 1],
 			        agg_i[j * 4 + 2],
 			        agg_d[j * 4 + 3]);
-		} else if (H5Tequal(types[j], H5T_NATIVE_DOUBLE)) {
+		} else if (types[j] == PROFILE_FIELD_DOUBLE) {
 			fprintf(output, ",%lf,%lf,%lf,%lf",
 			        agg_d[j * 4 + 0],
 			        agg_d[j * 4 + 1],
@@ -995,6 +1066,7 @@ static void _extract_totals(size_t nb_fields, size_t *offsets, hid_t *types,
 		}
 	}
 	fputc('\n', output);
+	_reader_fini(&reader);
 	xfree(agg_i);
 	xfree(data);
 }
@@ -1013,7 +1085,7 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 	size_t max_fields = list_count(fields);
 	size_t nb_fields = 0;
 	size_t offsets[max_fields];
-	hid_t types[max_fields];
+	acct_gather_profile_field_type_t types[max_fields];
 
 	hid_t did = -1;    /* dataset id */
 	hid_t tid = -1;    /* file type ID */
@@ -1023,7 +1095,8 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 	hid_t table_id = -1;
 	hsize_t nmembers;
 	hsize_t type_size;
-	hsize_t nrecords;
+	series_reader_t reader;
+	uint8_t *data;
 	char *m_name;
 
 	_table_path(table, path);
@@ -1063,12 +1136,20 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 		if ((nm_tid = H5Tget_native_type(m_tid, H5T_DIR_DEFAULT)) < 0)
 			goto error;
 
-		types[nb_fields] = nm_tid;
+		/* resolve the type once rather than for every record */
+		if (H5Tequal(nm_tid, H5T_NATIVE_UINT64) > 0)
+			types[nb_fields] = PROFILE_FIELD_UINT64;
+		else if (H5Tequal(nm_tid, H5T_NATIVE_DOUBLE) > 0)
+			types[nb_fields] = PROFILE_FIELD_DOUBLE;
+		else
+			types[nb_fields] = PROFILE_FIELD_NOT_SET;
 		offsets[nb_fields] = H5Tget_member_offset(n_tid, (unsigned)i);
 		++nb_fields;
 
-		/*H5Tclose(nm_tid);*/
+		H5Tclose(nm_tid);
+		nm_tid = -1;
 		H5Tclose(m_tid);
+		m_tid = -1;
 	}
 
 	H5Tclose(n_tid);
@@ -1086,31 +1167,30 @@ static int _extract_series_table(hid_t fid_job, table_t *table, List fields,
 		                table_id, table, output);
 	} else {
 		/* Timeseries level */
-		H5PTget_num_packets(table_id, &nrecords);
-		uint8_t data[type_size];
+		_reader_init(&reader, table_id, type_size);
 
 		/* print the expected fields of all the records */
-		for (i = 0; i < nrecords; ++i) {
-			H5PTget_next(table_id, 1, data);
+		while ((data = _reader_next(&reader))) {
 			fprintf(output, "%s,%s", table->step, table->node);
 			if (group_mode)
 				fprintf(output, ",%s", table->name);
 
 			for (j = 0; j < nb_fields; ++j) {
-				if (H5Tequal(types[j], H5T_NATIVE_UINT64)) {
+				if (types[j] == PROFILE_FIELD_UINT64) {
 					fprintf(output, ",%"PRIu64,
 					        *(uint64_t *)(data+offsets[j]));
-				} else if (H5Tequal(types[j],
-				                    H5T_NATIVE_DOUBLE)) {
+				} else if (types[j] == PROFILE_FIELD_DOUBLE) {
 					fprintf(output, ",%lf",
 					        *(double *)(data + offsets[j]));
 				} else {
 					error("Unknown type");
+					_reader_fini(&reader);
 					goto error;
 				}
 			}
 			fputc('\n', output);
 		}
+		_reader_fini(&reader);
 	}
 
 	H5PTclose(table_id);
@@ -1231,17 +1311,15 @@ error:
  * tables.
  *
  * @param nb_tables  Number of table to analyze
- * @param tables     IDs of all the tables to analyze
+ * @param readers    Readers of all the tables to analyze
  * @param nb_records Number of records in each table
- * @param buf_size   Size of the largest record of the tables
  * @param offsets    Offset of the item analyzed in each table
  * @param names      Names of the tables
  * @param nodes      Name of the node for each table
  * @param step_name  Name of the current step
  */
-static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
-				hsize_t *nb_records, size_t buf_size,
-				size_t *offsets,
+static void _item_analysis_uint(hsize_t nb_tables, series_reader_t *readers,
+				hsize_t *nb_records, size_t *offsets,
 				const char *names[], const char *nodes[],
 				const char *step_name)
 {
@@ -1258,7 +1336,6 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
 	uint8_t  *buffer;
 	uint64_t et = 0, et_max = 0;
 
-	buffer = xmalloc(buf_size);
 	for (;;) {
 		min_val = UINT64_MAX;
 		max_val = 0;
@@ -1272,7 +1349,11 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
 			--nb_records[i];
 			++nb_series_in_smp;
 			/* read the value of the item in the series i */
-			H5PTget_next(tables[i], 1, (void *)buffer);
+			if (!(buffer = _reader_next(&readers[i]))) {
+				nb_records[i] = 0;
+				--nb_series_in_smp;
+				continue;
+			}
 			v = *(uint64_t *)(buffer + offsets[i]);
 			values[i] = v;
 			/* compute the sum, min and max */
@@ -1328,7 +1409,6 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
 		}
 		fputc('\n', output_file);
 	}
-	xfree(buffer);
 
 	printf("    Step %s Maximum accumulated %s Value (%"PRIu64") occurred "
 	       "at Time=%"PRIu64", Ave Node %lf\n",
@@ -1340,9 +1420,9 @@ static void _item_analysis_uint(hsize_t nb_tables, hid_t *tables,
  * tables.
  * See _item_analysis_uint for parameters description.
  */
-static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
-				  hsize_t *nb_records, size_t buf_size,
-				  size_t *offsets,
+static void _item_analysis_double(hsize_t nb_tables,
+				  series_reader_t *readers,
+				  hsize_t *nb_records, size_t *offsets,
 				  const char *names[], const char *nodes[],
 				  const char *step_name)
 {
@@ -1359,7 +1439,6 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 	uint8_t  *buffer;
 	uint64_t et = 0, et_max = 0;
 
-	buffer = xmalloc(buf_size);
 	for (;;) {
 		min_val = UINT64_MAX;
 		max_val = 0;
@@ -1373,7 +1452,11 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 			--nb_records[i];
 			++nb_series_in_smp;
 			/* read the value of the item in the series i */
-			H5PTget_next(tables[i], 1, (void *)buffer);
+			if (!(buffer = _reader_next(&readers[i]))) {
+				nb_records[i] = 0;
+				--nb_series_in_smp;
+				continue;
+			}
 			v = *(double *)(buffer + offsets[i]);
 			values[i] = v;
 			/* compute the sum, min and max */
@@ -1417,7 +1500,6 @@ static void _item_analysis_double(hsize_t nb_tables, hid_t *tables,
 		}
 		fputc('\n', output_file);
 	}
-	xfree(buffer);
 
 	printf("    Step %s Maximum accumulated %s Value (%lf) occurred "
 	       "at Time=%"PRIu64", Ave Node %lf\n",
@@ -1433,7 +1515,6 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 	char path[MAX_PROFILE_PATH];
 
 	size_t i, j;
-	size_t buf_size = 0;
 	char *m_name;
 
 	hid_t fid_job = *((hid_t *)op_data);
@@ -1445,6 +1526,7 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 	hsize_t nmembers;
 	hid_t item_type = -1;
 	herr_t err;
+	series_reader_t *readers;
 
 	List tables = NULL;
 	ListIterator it = NULL;
@@ -1473,6 +1555,7 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 	hid_t tables_id[nb_tables];
 	size_t offsets[nb_tables];
 	hsize_t nb_records[nb_tables];
+	size_t rec_sizes[nb_tables];
 	const char *names[nb_tables];
 	const char *nodes[nb_tables];
 
@@ -1500,7 +1583,7 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 		if ((n_tid = H5Tget_native_type(tid, H5T_DIR_DEFAULT)) < 0)
 			goto error;
 
-		buf_size = MAX(buf_size, H5Tget_size(n_tid));
+		rec_sizes[i] = H5Tget_size(n_tid);
 
 		/* get the number of members */
 		if ((nmembers = H5Tget_nmembers(tid)) == 0)
@@ -1532,8 +1615,8 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 			goto error;
 
 		if (item_type == -1) {
-			item_type = nm_tid;
-		} else if (nm_tid != item_type) {
+			item_type = H5Tcopy(nm_tid);
+		} else if (H5Tequal(nm_tid, item_type) <= 0) {
 			error("Malformed file: fields with the same name in "
 			      "tables with the same name must have the same "
 			      "types");
@@ -1541,11 +1624,16 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 		}
 
 		H5Tclose(nm_tid);
+		nm_tid = -1;
 		H5Tclose(m_tid);
+		m_tid = -1;
 
 		H5Tclose(n_tid);
+		n_tid = -1;
 		H5Tclose(tid);
+		tid = -1;
 		H5Dclose(did);
+		did = -1;
 
 		/* open the table */
 		if ((tables_id[i] = H5PTopen(fid_job, path)) < 0) {
@@ -1573,18 +1661,29 @@ static herr_t _extract_item_step(hid_t g_id, const char *step_name,
 
 	list_iterator_destroy(it);
 
+	if (!H5Tequal(item_type, H5T_NATIVE_UINT64) &&
+	    !H5Tequal(item_type, H5T_NATIVE_DOUBLE)) {
+		error("Unknown type");
+		goto error;
+	}
+
+	readers = xcalloc(nb_tables, sizeof(series_reader_t));
+	for (i = 0; i < nb_tables; ++i)
+		_reader_init(&readers[i], tables_id[i], rec_sizes[i]);
+
 	if (H5Tequal(item_type, H5T_NATIVE_UINT64)) {
-		_item_analysis_uint(nb_tables, tables_id, nb_records, buf_size,
+		_item_analysis_uint(nb_tables, readers, nb_records,
 		                    offsets, names, nodes, step_name);
-	} else if (H5Tequal(item_type, H5T_NATIVE_DOUBLE)) {
-		_item_analysis_double(nb_tables, tables_id,
-				      nb_records, buf_size,
-		                      offsets, names, nodes, step_name);
 	} else {
-		error("Unknown type");
-		goto error;
+		_item_analysis_double(nb_tables, readers, nb_records,
+		                      offsets, names, nodes, step_name);
 	}
 
+	for (i = 0; i < nb_tables; ++i)
+		_reader_fini(&readers[i]);
+	xfree(readers);
+	H5Tclose(item_type);
+
 	/* clean up */
 	for (i = 0; i < nb_tables; ++i) {
 		H5PTclose(tables_id[i]);
@@ -1599,6 +1698,7 @@ error:
 	if (n_tid >= 0) H5Tclose(n_tid);
 	if (m_tid >= 0) H5Tclose(m_tid);
 	if (nm_tid >= 0) H5Tclose(nm_tid);
+	if (item_type >= 0) H5Tclose(item_type);
 	FREE_NULL_LIST(tables);
 	for (i = 0; i < nb_tables; ++i) {
 		if (tables_id[i] >= 0)
@@ -55,6 +55,7 @@ typedef struct {
 	int job_id;
 	bool keepfiles;
 	char *level;
+	bool link;
 	sh5util_mode_t mode;
 	char *node;
 	char *output;
@@ -45,6 +45,8 @@
  *  Copyright (C) 2002 The Regents of the University of California.
  \*****************************************************************************/
 
+#include "config.h"
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -55,8 +57,13 @@
 #include <inttypes.h>
 #include <unistd.h>
 #include <math.h>
+#include <pthread.h>
 #include <curl/curl.h>
 
+#if HAVE_LIBZ
+#  include <zlib.h>
+#endif
+
 #include "src/common/slurm_xlator.h"
 #include "src/common/fd.h"
 #include "src/common/slurm_acct_gather_profile.h"
@@ -96,15 +103,26 @@ const char plugin_name[] = "AcctGatherProfile influxdb plugin";
 const char plugin_type[] = "acct_gather_profile/influxdb";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
+#define DEFAULT_INFLUXDB_BUFFERS 64
+#define DEFAULT_INFLUXDB_FLUSH 10
+
 typedef struct {
 	char *host;
 	char *database;
 	uint32_t def;
+	uint32_t buffers;	/* ring slots of BUF_SIZE bytes */
+	uint32_t flush;		/* seconds between flushes of a partial slot */
 	char *password;
 	char *rt_policy;
 	char *username;
 } slurm_influxdb_conf_t;
 
+/* One batch of line protocol, sent in a single HTTP request */
+typedef struct {
+	char *data;
+	size_t len;
+} batch_t;
+
 typedef struct {
 	char ** names;
 	uint32_t *types;
@@ -127,8 +145,23 @@ static slurm_influxdb_conf_t influxdb_conf;
 static uint32_t g_profile_running = ACCT_GATHER_PROFILE_NOT_SET;
 static stepd_step_rec_t *g_job = NULL;
 
-static char *datastr = NULL;
-static int datastrlen = 0;
+/*
+ * Samples are appended to a ring of batches, which a background thread
+ * sends to influxdb over one long lived connection, so the sampling path
+ * never waits for the network. A batch is sent once it is full, and any
+ * partial batch every "flush" seconds. When all the batches are waiting to
+ * be sent, new samples are dropped and counted.
+ */
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t send_thread = 0;
+static batch_t *ring = NULL;
+static uint32_t ring_head = 0;	/* oldest batch */
+static uint32_t ring_used = 0;	/* batches with data, the last is partial */
+static bool flush_now = false;
+static bool send_shutdown = false;
+static uint64_t drop_cnt = 0;	/* samples dropped, ring full */
+static uint64_t fail_cnt = 0;	/* samples lost in failed requests */
 
 static table_t *tables = NULL;
 static size_t tables_max_len = 0;
@@ -186,68 +219,49 @@ static size_t _write_callback(void *contents, size_t size, size_t nmemb,
 	return realsize;
 }
 
-/* Try to send data to influxdb */
-static int _send_data(const char *data)
+#if HAVE_LIBZ
+/* Compress data into a gzip body, RET: compressed length or 0 on failure */
+static size_t _gzip(z_stream *strm, const char *data, size_t len,
+		    char **out, size_t *out_size)
+{
+	size_t need = deflateBound(strm, len);
+
+	if (*out_size < need) {
+		*out_size = need;
+		*out = xrealloc_nz(*out, *out_size);
+	}
+	if (deflateReset(strm) != Z_OK)
+		return 0;
+	strm->next_in = (Bytef *) data;
+	strm->avail_in = len;
+	strm->next_out = (Bytef *) *out;
+	strm->avail_out = *out_size;
+	if (deflate(strm, Z_FINISH) != Z_STREAM_END)
+		return 0;
+
+	return *out_size - strm->avail_out;
+}
+#endif
+
+/* Try to send one batch to influxdb, RET: SLURM_SUCCESS or SLURM_ERROR */
+static int _send_data(CURL *curl_handle, const char *data, size_t len)
 {
-	CURL *curl_handle = NULL;
 	CURLcode res;
 	struct http_response chunk;
 	int rc = SLURM_SUCCESS;
 	long response_code;
 	static int error_cnt = 0;
-	char *url = NULL;
-	size_t length;
 
 	debug3("%s %s called", plugin_type, __func__);
 
-	/*
-	 * Every compute node which is sampling data will try to establish a
-	 * different connection to the influxdb server. In order to reduce the
-	 * number of connections, every time a new sampled data comes in, it
-	 * is saved in the 'datastr' buffer. Once this buffer is full, then we
-	 * try to open the connection and send this buffer, instead of opening
-	 * one per sample.
-	 */
-	if (data && ((datastrlen + strlen(data)) <= BUF_SIZE)) {
-		xstrcat(datastr, data);
-		length = strlen(data);
-		datastrlen += length;
-		if (slurm_get_debug_flags() & DEBUG_FLAG_PROFILE)
-			info("%s %s: %zu bytes of data added to buffer. New buffer size: %d",
-			     plugin_type, __func__, length, datastrlen);
-		return rc;
-	}
-
 	DEF_TIMERS;
 	START_TIMER;
 
-	if (curl_global_init(CURL_GLOBAL_ALL) != 0) {
-		error("%s %s: curl_global_init: %m", plugin_type, __func__);
-		rc = SLURM_ERROR;
-		goto cleanup_global_init;
-	} else if ((curl_handle = curl_easy_init()) == NULL) {
-		error("%s %s: curl_easy_init: %m", plugin_type, __func__);
-		rc = SLURM_ERROR;
-		goto cleanup_easy_init;
-	}
-
-	xstrfmtcat(url, "%s/write?db=%s&rp=%s&precision=s", influxdb_conf.host,
-		   influxdb_conf.database, influxdb_conf.rt_policy);
-
 	chunk.message = xmalloc(1);
 	chunk.size = 0;
 
-	curl_easy_setopt(curl_handle, CURLOPT_URL, url);
-	if (influxdb_conf.password)
-		curl_easy_setopt(curl_handle, CURLOPT_PASSWORD,
-				 influxdb_conf.password);
-	curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
-	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, datastr);
-	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, strlen(datastr));
-	if (influxdb_conf.username)
-		curl_easy_setopt(curl_handle, CURLOPT_USERNAME,
-				 influxdb_conf.username);
-	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, _write_callback);
+	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
+	curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDSIZE, (long) len);
 	curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &chunk);
 
 	if ((res = curl_easy_perform(curl_handle)) != CURLE_OK) {
@@ -282,8 +296,9 @@ static int _send_data(const char *data)
 		       plugin_type, __func__, response_code);
 		if (slurm_get_debug_flags() & DEBUG_FLAG_PROFILE) {
 			/* Strip any trailing newlines. */
-			while (chunk.message[strlen(chunk.message) - 1] == '\n')
-				chunk.message[strlen(chunk.message) - 1] = '\0';
+			while (chunk.size &&
+			       (chunk.message[chunk.size - 1] == '\n'))
+				chunk.message[--chunk.size] = '\0';
 			info("%s %s: JSON response body: %s", plugin_type,
 			     __func__, chunk.message);
 		}
@@ -291,26 +306,259 @@ static int _send_data(const char *data)
 
 cleanup:
 	xfree(chunk.message);
-	xfree(url);
-cleanup_easy_init:
-	curl_easy_cleanup(curl_handle);
-cleanup_global_init:
-	curl_global_cleanup();
 
 	END_TIMER;
 	if (slurm_get_debug_flags() & DEBUG_FLAG_PROFILE)
-		debug("%s %s: took %s to send data", plugin_type, __func__,
-		      TIME_STR);
+		debug("%s %s: took %s to send %zu bytes", plugin_type,
+		      __func__, TIME_STR, len);
+
+	return rc;
+}
+
+/* Count the samples (lines) of a batch */
+static uint64_t _line_cnt(const char *data, size_t len)
+{
+	uint64_t cnt = 0;
+	const char *end = data + len;
+
+	while ((data = memchr(data, '\n', end - data))) {
+		cnt++;
+		data++;
+	}
+
+	return cnt;
+}
 
-	if (data) {
-		datastr = xstrdup(data);
-		datastrlen = strlen(data);
+/*
+ * _send_agent() - Send the batches of the ring, full ones as they come and
+ * partial ones every influxdb_conf.flush seconds, until send_shutdown is set
+ * and the ring is empty.
+ */
+static void *_send_agent(void *arg)
+{
+	CURL *curl_handle;
+	struct curl_slist *headers = NULL;
+	char *url = NULL, *body = NULL, *send_buf = xmalloc(BUF_SIZE);
+	size_t body_size = 0, len;
+	struct timespec ts = {0, 0};
+	batch_t *batch;
+	char *tmp;
+#if HAVE_LIBZ
+	z_stream strm;
+	bool gzip = false;
+
+	memset(&strm, 0, sizeof(strm));
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16,
+			 8, Z_DEFAULT_STRATEGY) == Z_OK)
+		gzip = true;
+	else
+		error("%s %s: deflateInit2 failed, sending uncompressed data",
+		      plugin_type, __func__);
+#endif
+
+	if (!(curl_handle = curl_easy_init())) {
+		error("%s %s: curl_easy_init: %m", plugin_type, __func__);
+		/* Keep draining the ring so sampling is not affected */
 	} else {
-		datastr[0] = '\0';
-		datastrlen = 0;
+		xstrfmtcat(url, "%s/write?db=%s&rp=%s&precision=s",
+			   influxdb_conf.host, influxdb_conf.database,
+			   influxdb_conf.rt_policy);
+		curl_easy_setopt(curl_handle, CURLOPT_URL, url);
+		if (influxdb_conf.password)
+			curl_easy_setopt(curl_handle, CURLOPT_PASSWORD,
+					 influxdb_conf.password);
+		if (influxdb_conf.username)
+			curl_easy_setopt(curl_handle, CURLOPT_USERNAME,
+					 influxdb_conf.username);
+		curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+		curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION,
+				 _write_callback);
+#if HAVE_LIBZ
+		if (gzip) {
+			headers = curl_slist_append(headers,
+						    "Content-Encoding: gzip");
+			curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER,
+					 headers);
+		}
+#endif
 	}
 
-	return rc;
+	slurm_mutex_lock(&ring_lock);
+	while (1) {
+		/* Wait for a full batch, a flush or the flush interval */
+		if ((ring_used <= 1) && !flush_now && !send_shutdown) {
+			if (!ts.tv_sec)
+				ts.tv_sec = time(NULL) + influxdb_conf.flush;
+			if (pthread_cond_timedwait(&ring_cond, &ring_lock,
+						   &ts) != ETIMEDOUT)
+				continue;
+		}
+
+		batch = &ring[ring_head];
+		if (!ring_used || !batch->len) {
+			flush_now = false;
+			ts.tv_sec = 0;
+			if (send_shutdown)
+				break;
+			continue;
+		}
+
+		/* Take the oldest batch, swapping in an empty buffer */
+		tmp = batch->data;
+		batch->data = send_buf;
+		send_buf = tmp;
+		len = batch->len;
+		batch->len = 0;
+		if (ring_used > 1) {
+			ring_head = (ring_head + 1) % influxdb_conf.buffers;
+			ring_used--;
+		} else {
+			/* The partial batch, nothing is left to send */
+			ring_used = 0;
+			flush_now = false;
+			ts.tv_sec = 0;
+		}
+		slurm_mutex_unlock(&ring_lock);
+
+		if (curl_handle) {
+			const char *data = send_buf;
+			size_t data_len = len;
+#if HAVE_LIBZ
+			size_t zlen;
+
+			if (gzip &&
+			    (zlen = _gzip(&strm, send_buf, len, &body,
+					  &body_size))) {
+				data = body;
+				data_len = zlen;
+			}
+#endif
+			if (_send_data(curl_handle, data, data_len) !=
+			    SLURM_SUCCESS) {
+				slurm_mutex_lock(&ring_lock);
+				fail_cnt += _line_cnt(send_buf, len);
+				slurm_mutex_unlock(&ring_lock);
+			}
+		} else {
+			slurm_mutex_lock(&ring_lock);
+			fail_cnt += _line_cnt(send_buf, len);
+			slurm_mutex_unlock(&ring_lock);
+		}
+
+		slurm_mutex_lock(&ring_lock);
+	}
+	slurm_mutex_unlock(&ring_lock);
+
+	if (drop_cnt || fail_cnt)
+		info("%s: %"PRIu64" samples dropped (buffers full), %"PRIu64" lost in failed requests",
+		     plugin_type, drop_cnt, fail_cnt);
+
+	if (curl_handle)
+		curl_easy_cleanup(curl_handle);
+	curl_slist_free_all(headers);
+#if HAVE_LIBZ
+	if (gzip)
+		deflateEnd(&strm);
+#endif
+	xfree(body);
+	xfree(send_buf);
+	xfree(url);
+
+	return NULL;
+}
+
+/*
+ * _queue_data() - Append samples to the ring, never blocking on the network
+ *
+ * IN data - line protocol, one sample per line
+ */
+static void _queue_data(const char *data)
+{
+	size_t len = strlen(data);
+	batch_t *batch;
+
+	if (!len)
+		return;
+
+	slurm_mutex_lock(&ring_lock);
+	if (!ring || (len > BUF_SIZE)) {
+		drop_cnt += _line_cnt(data, len);
+		slurm_mutex_unlock(&ring_lock);
+		return;
+	}
+
+	if (!ring_used)
+		ring_used = 1;
+	batch = &ring[(ring_head + ring_used - 1) % influxdb_conf.buffers];
+	if ((batch->len + len) > BUF_SIZE) {
+		if (ring_used == influxdb_conf.buffers) {
+			if (!drop_cnt)
+				error("%s %s: all %u buffers are waiting to be sent, dropping samples",
+				      plugin_type, __func__,
+				      influxdb_conf.buffers);
+			drop_cnt += _line_cnt(data, len);
+			slurm_mutex_unlock(&ring_lock);
+			return;
+		}
+		ring_used++;
+		batch = &ring[(ring_head + ring_used - 1) %
+			      influxdb_conf.buffers];
+		/* A full batch is ready */
+		slurm_cond_signal(&ring_cond);
+	}
+	memcpy(batch->data + batch->len, data, len);
+	batch->len += len;
+	slurm_mutex_unlock(&ring_lock);
+
+	if (slurm_get_debug_flags() & DEBUG_FLAG_PROFILE)
+		info("%s %s: %zu bytes of data added to buffer",
+		     plugin_type, __func__, len);
+}
+
+/* Start the agent thread and allocate the ring */
+static void _start_send_agent(void)
+{
+	int i;
+
+	slurm_mutex_lock(&ring_lock);
+	if (ring) {
+		slurm_mutex_unlock(&ring_lock);
+		return;
+	}
+	ring = xcalloc(influxdb_conf.buffers, sizeof(batch_t));
+	for (i = 0; i < influxdb_conf.buffers; i++)
+		ring[i].data = xmalloc(BUF_SIZE);
+	ring_head = ring_used = 0;
+	send_shutdown = false;
+	slurm_mutex_unlock(&ring_lock);
+
+	slurm_thread_create(&send_thread, _send_agent, NULL);
+}
+
+/* Send what is left in the ring and stop the agent thread */
+static void _stop_send_agent(void)
+{
+	int i;
+
+	slurm_mutex_lock(&ring_lock);
+	if (!send_thread) {
+		slurm_mutex_unlock(&ring_lock);
+		return;
+	}
+	send_shutdown = true;
+	slurm_cond_signal(&ring_cond);
+	slurm_mutex_unlock(&ring_lock);
+
+	pthread_join(send_thread, NULL);
+	send_thread = 0;
+
+	slurm_mutex_lock(&ring_lock);
+	for (i = 0; i < influxdb_conf.buffers; i++)
+		xfree(ring[i].data);
+	xfree(ring);
+	slurm_mutex_unlock(&ring_lock);
 }
 
 /*
@@ -324,7 +572,10 @@ extern int init(void)
 	if (!running_in_slurmstepd())
 		return SLURM_SUCCESS;
 
-	datastr = xmalloc(BUF_SIZE);
+	if (curl_global_init(CURL_GLOBAL_ALL) != 0) {
+		error("%s %s: curl_global_init: %m", plugin_type, __func__);
+		return SLURM_ERROR;
+	}
 	return SLURM_SUCCESS;
 }
 
@@ -332,8 +583,12 @@ extern int fini(void)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
+	if (running_in_slurmstepd()) {
+		_stop_send_agent();
+		curl_global_cleanup();
+	}
+
 	_free_tables();
-	xfree(datastr);
 	xfree(influxdb_conf.host);
 	xfree(influxdb_conf.database);
 	xfree(influxdb_conf.password);
@@ -349,8 +604,10 @@ extern void acct_gather_profile_p_conf_options(s_p_options_t **full_options,
 
 	s_p_options_t options[] = {
 		{"ProfileInfluxDBHost", S_P_STRING},
+		{"ProfileInfluxDBBuffers", S_P_UINT32},
 		{"ProfileInfluxDBDatabase", S_P_STRING},
 		{"ProfileInfluxDBDefault", S_P_STRING},
+		{"ProfileInfluxDBFlush", S_P_UINT32},
 		{"ProfileInfluxDBPass", S_P_STRING},
 		{"ProfileInfluxDBRTPolicy", S_P_STRING},
 		{"ProfileInfluxDBUser", S_P_STRING},
@@ -367,8 +624,14 @@ extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
 	debug3("%s %s called", plugin_type, __func__);
 
 	influxdb_conf.def = ACCT_GATHER_PROFILE_ALL;
+	influxdb_conf.buffers = DEFAULT_INFLUXDB_BUFFERS;
+	influxdb_conf.flush = DEFAULT_INFLUXDB_FLUSH;
 	if (tbl) {
 		s_p_get_string(&influxdb_conf.host, "ProfileInfluxDBHost", tbl);
+		s_p_get_uint32(&influxdb_conf.buffers,
+			       "ProfileInfluxDBBuffers", tbl);
+		s_p_get_uint32(&influxdb_conf.flush,
+			       "ProfileInfluxDBFlush", tbl);
 		if (s_p_get_string(&tmp, "ProfileInfluxDBDefault", tbl)) {
 			influxdb_conf.def =
 				acct_gather_profile_from_string(tmp);
@@ -403,6 +666,13 @@ extern void acct_gather_profile_p_conf_set(s_p_hashtbl_t *tbl)
 		fatal("No ProfileInfluxDBRTPolicy in your acct_gather.conf file. This is required to use the %s plugin",
 		      plugin_type);
 
+	/* A second buffer lets samples be queued while one is sent */
+	if (influxdb_conf.buffers < 2)
+		fatal("ProfileInfluxDBBuffers must be at least 2");
+
+	if (!influxdb_conf.flush)
+		fatal("ProfileInfluxDBFlush must be at least 1 second");
+
 	debug("%s loaded", plugin_name);
 }
 
@@ -444,6 +714,8 @@ extern int acct_gather_profile_p_node_step_start(stepd_step_rec_t* job)
 	debug2("%s %s: option --profile=%s", plugin_type, __func__,
 	       profile_str);
 	g_profile_running = _determine_profile();
+	if (g_profile_running > ACCT_GATHER_PROFILE_NONE)
+		_start_send_agent();
 	return rc;
 }
 
@@ -460,6 +732,7 @@ extern int acct_gather_profile_p_node_step_end(void)
 
 	xassert(running_in_slurmstepd());
 
+	_stop_send_agent();
 	return rc;
 }
 
@@ -485,7 +758,11 @@ extern int acct_gather_profile_p_task_end(pid_t taskpid)
 {
 	debug3("%s %s called", plugin_type, __func__);
 
-	_send_data(NULL);
+	/* Have the agent send the partial batch now */
+	slurm_mutex_lock(&ring_lock);
+	flush_now = true;
+	slurm_cond_signal(&ring_cond);
+	slurm_mutex_unlock(&ring_lock);
 	return SLURM_SUCCESS;
 }
 
@@ -580,7 +857,8 @@ extern int acct_gather_profile_p_add_sample_data(int table_id, void *data,
 		}
 	}
 
-	_send_data(str);
+	if (str)
+		_queue_data(str);
 	xfree(str);
 
 	return SLURM_SUCCESS;
@@ -599,6 +877,11 @@ extern void acct_gather_profile_p_conf_values(List *data)
 	key_pair->value = xstrdup(influxdb_conf.host);
 	list_append(*data, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileInfluxDBBuffers");
+	key_pair->value = xstrdup_printf("%u", influxdb_conf.buffers);
+	list_append(*data, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("ProfileInfluxDBDatabase");
 	key_pair->value = xstrdup(influxdb_conf.database);
@@ -610,6 +893,11 @@ extern void acct_gather_profile_p_conf_values(List *data)
 		xstrdup(acct_gather_profile_to_string(influxdb_conf.def));
 	list_append(*data, key_pair);
 
+	key_pair = xmalloc(sizeof(config_key_pair_t));
+	key_pair->name = xstrdup("ProfileInfluxDBFlush");
+	key_pair->value = xstrdup_printf("%u sec", influxdb_conf.flush);
+	list_append(*data, key_pair);
+
 	key_pair = xmalloc(sizeof(config_key_pair_t));
 	key_pair->name = xstrdup("ProfileInfluxDBPass");
 	key_pair->value = xstrdup(influxdb_conf.password);
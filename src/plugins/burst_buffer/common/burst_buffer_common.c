@@ -214,6 +214,7 @@ extern void bb_clear_config(bb_config_t *config_ptr, bool fini)
 	xfree(config_ptr->deny_users);
 	xfree(config_ptr->deny_users_str);
 	xfree(config_ptr->destroy_buffer);
+	xfree(config_ptr->directory);
 	xfree(config_ptr->get_sys_state);
 	xfree(config_ptr->get_sys_status);
 	config_ptr->granularity = 1;
@@ -227,6 +228,7 @@ extern void bb_clear_config(bb_config_t *config_ptr, bool fini)
 			config_ptr->pool_ptr[i].total_space = 0;
 	}
 	config_ptr->other_timeout = 0;
+	config_ptr->stage_bandwidth = 0;
 	config_ptr->stage_in_timeout = 0;
 	config_ptr->stage_out_timeout = 0;
 	xfree(config_ptr->start_stage_in);
@@ -504,11 +506,13 @@ extern void bb_load_config(bb_state_t *state_ptr, char *plugin_type)
 		{"DefaultPool", S_P_STRING},
 		{"DenyUsers", S_P_STRING},
 		{"DestroyBuffer", S_P_STRING},
+		{"Directory", S_P_STRING},
 		{"Flags", S_P_STRING},
 		{"GetSysState", S_P_STRING},
 		{"GetSysStatus", S_P_STRING},
 		{"Granularity", S_P_STRING},
 		{"OtherTimeout", S_P_UINT32},
+		{"StageBandwidth", S_P_STRING},
 		{"StageInTimeout", S_P_UINT32},
 		{"StageOutTimeout", S_P_UINT32},
 		{"StartStageIn", S_P_STRING},
@@ -583,6 +587,8 @@ extern void bb_load_config(bb_state_t *state_ptr, char *plugin_type)
 	}
 	s_p_get_string(&state_ptr->bb_config.destroy_buffer, "DestroyBuffer",
 		       bb_hashtbl);
+	s_p_get_string(&state_ptr->bb_config.directory, "Directory",
+		       bb_hashtbl);
 
 	if (s_p_get_string(&tmp, "Flags", bb_hashtbl)) {
 		state_ptr->bb_config.flags = slurm_bb_str2flags(tmp);
@@ -633,6 +639,10 @@ extern void bb_load_config(bb_state_t *state_ptr, char *plugin_type)
 
 	(void) s_p_get_uint32(&state_ptr->bb_config.other_timeout,
 			     "OtherTimeout", bb_hashtbl);
+	if (s_p_get_string(&tmp, "StageBandwidth", bb_hashtbl)) {
+		state_ptr->bb_config.stage_bandwidth = bb_get_size_num(tmp, 1);
+		xfree(tmp);
+	}
 	(void) s_p_get_uint32(&state_ptr->bb_config.stage_in_timeout,
 			    "StageInTimeout", bb_hashtbl);
 	(void) s_p_get_uint32(&state_ptr->bb_config.stage_out_timeout,
@@ -664,6 +674,8 @@ extern void bb_load_config(bb_state_t *state_ptr, char *plugin_type)
 		xfree(value);
 		info("%s: DestroyBuffer:%s",  __func__,
 		     state_ptr->bb_config.destroy_buffer);
+		info("%s: Directory:%s",  __func__,
+		     state_ptr->bb_config.directory);
 		info("%s: GetSysState:%s",  __func__,
 		     state_ptr->bb_config.get_sys_state);
 		info("%s: GetSysStatus:%s",  __func__,
@@ -677,6 +689,8 @@ extern void bb_load_config(bb_state_t *state_ptr, char *plugin_type)
 		}
 		info("%s: OtherTimeout:%u", __func__,
 		     state_ptr->bb_config.other_timeout);
+		info("%s: StageBandwidth:%"PRIu64"", __func__,
+		     state_ptr->bb_config.stage_bandwidth);
 		info("%s: StageInTimeout:%u", __func__,
 		     state_ptr->bb_config.stage_in_timeout);
 		info("%s: StageOutTimeout:%u", __func__,
@@ -71,6 +71,7 @@ typedef struct bb_config {
 	uid_t   *deny_users;
 	char    *deny_users_str;
 	char    *destroy_buffer;
+	char    *directory;		/* buffer file system, generic plugin */
 	uint32_t flags;			/* See BB_FLAG_* in slurm.h */
 	char    *get_sys_state;
 	char    *get_sys_status;
@@ -79,6 +80,8 @@ typedef struct bb_config {
 	uint32_t pool_cnt;		/* Count of records in pool_ptr */
 	burst_buffer_pool_t *pool_ptr;	/* Type is defined in slurm.h */
 	uint32_t other_timeout;
+	uint64_t stage_bandwidth;	/* aggregate staging rate limit,
+					 * units are bytes/sec, 0 if none */
 	uint32_t stage_in_timeout;
 	uint32_t stage_out_timeout;
 	char    *start_stage_in;
@@ -5691,3 +5691,18 @@ extern char *bb_p_xlate_bb_2_tres_str(char *burst_buffer)
 
 	return result;
 }
+
+/*
+ * Return the directory in which the slurmd daemons stage a job's files in
+ * and out, NULL if its burst buffer is not staged on the compute nodes
+ * IN stage_in - true for the stage-in limits, false for the stage-out ones
+ * OUT bandwidth - per node staging rate in bytes per second, 0 for no limit
+ * OUT timeout - staging time limit in seconds, 0 for no limit
+ * Caller must xfree the return value
+ */
+extern char *bb_p_job_get_node_dir(job_record_t *job_ptr, bool stage_in,
+				   uint64_t *bandwidth, uint32_t *timeout)
+{
+	/* DataWarp stages through dw_wlm_cli on the controller */
+	return NULL;
+}
@@ -34,23 +34,36 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
 \*****************************************************************************/
 
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <poll.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "slurm/slurm.h"
 
+#include "src/common/bb_stage.h"
 #include "src/common/list.h"
 #include "src/common/pack.h"
 #include "src/common/parse_config.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/timers.h"
+#include "src/common/track_script.h"
 #include "src/common/uid.h"
 #include "src/common/xmalloc.h"
 #include "src/common/xstring.h"
+#include "src/slurmctld/agent.h"
 #include "src/slurmctld/locks.h"
 #include "src/slurmctld/reservation.h"
 #include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/trigger_mgr.h"
 #include "src/plugins/burst_buffer/common/burst_buffer_common.h"
 
 /*
@@ -82,20 +95,918 @@ const char plugin_name[]        = "burst_buffer generic plugin";
 const char plugin_type[]        = "burst_buffer/generic";
 const uint32_t plugin_version   = SLURM_VERSION_NUMBER;
 
+/*
+ * Each job's buffer is the directory <Directory>/<job_id>, owned by the job's
+ * user.
+ *
+ * By default Directory is local to each compute node. The slurmd daemons
+ * create the job's buffer and stage its files in once the job is allocated
+ * (PrologFlags=Alloc), and stage them out and remove the buffer after the job
+ * ends, see src/slurmd/slurmd/req.c. slurmctld only tracks the job.
+ *
+ * With the StageOnController flag Directory is a file system shared with the
+ * compute nodes, which slurmctld stages to and from itself. The state of each
+ * buffer is then recorded in <Directory>/STATE_DIR/<job_id> so that it can be
+ * recovered when slurmctld restarts. Directory and STATE_DIR must be owned by
+ * user root and not writable by others, so that users can not substitute
+ * their own files or links for those of the plugin.
+ */
+#define AGENT_INTERVAL	30	/* Seconds between state refresh */
+#define STAGE_OUT_RETRY	3	/* Stage-out attempts after the first */
+#define STATE_DIR	".slurm_jobs"
+
+typedef struct {
+	uint32_t job_id;
+	uint32_t user_id;
+	uint32_t group_id;
+	bb_stage_spec_t *spec;		/* NULL for teardown */
+} stage_args_t;
+
+static bb_state_t bb_state;
+
+static void _queue_stage_out(job_record_t *job_ptr, bb_job_t *bb_job);
+static void _queue_teardown(uint32_t job_id, uint32_t user_id,
+			    uint32_t group_id);
+
+/* Return true if the slurmd daemons stage the buffers on the compute nodes */
+static bool _stage_on_nodes(void)
+{
+	return !(bb_state.bb_config.flags & BB_FLAG_STAGE_ON_CONTROLLER);
+}
+
+static void _free_stage_args(stage_args_t *stage_args)
+{
+	bb_stage_spec_free(stage_args->spec);
+	xfree(stage_args);
+}
+
+static char *_job_dir(uint32_t job_id)
+{
+	return xstrdup_printf("%s/%u", bb_state.bb_config.directory, job_id);
+}
+
+static char *_state_dir(void)
+{
+	return xstrdup_printf("%s/%s", bb_state.bb_config.directory,
+			      STATE_DIR);
+}
+
+static char *_state_file(uint32_t job_id)
+{
+	return xstrdup_printf("%s/%s/%u", bb_state.bb_config.directory,
+			      STATE_DIR, job_id);
+}
+
+/* Record a buffer's state on its file system, in the format of the example
+ * scripts. A state of BB_STATE_COMPLETE removes the record. */
+static void _write_job_state(uint32_t job_id, uint32_t user_id,
+			     uint32_t group_id, uint16_t state, uint64_t size)
+{
+	char *state_file, *new_file = NULL, *data = NULL;
+	int fd, len;
+
+	state_file = _state_file(job_id);
+	if (state == BB_STATE_COMPLETE) {
+		if ((unlink(state_file) < 0) && (errno != ENOENT))
+			error("%s: %s: unlink(%s): %m",
+			      plugin_type, __func__, state_file);
+		xfree(state_file);
+		return;
+	}
+
+	xstrfmtcat(data, "UserID=%u GroupID=%u JobID=%u State=%s Size=%"PRIu64"\n",
+		   user_id, group_id, job_id, bb_state_string(state), size);
+	xstrfmtcat(new_file, "%s.new", state_file);
+	fd = open(new_file, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+	if (fd < 0) {
+		error("%s: %s: open(%s): %m", plugin_type, __func__, new_file);
+	} else {
+		len = strlen(data);
+		if (write(fd, data, len) != len) {
+			error("%s: %s: write(%s): %m",
+			      plugin_type, __func__, new_file);
+		} else if (rename(new_file, state_file) < 0) {
+			error("%s: %s: rename(%s): %m",
+			      plugin_type, __func__, new_file);
+		}
+		close(fd);
+	}
+	xfree(data);
+	xfree(new_file);
+	xfree(state_file);
+}
+
+/* Identify job's buffer directory in its environment */
+static void _set_job_env(job_record_t *job_ptr)
+{
+	struct job_details *details = job_ptr->details;
+	char *env = NULL, *job_dir;
+	int i;
+
+	if (!details)
+		return;
+	job_dir = _job_dir(job_ptr->job_id);
+	xstrfmtcat(env, "BB_JOB_DIR=%s", job_dir);
+	xfree(job_dir);
+	for (i = 0; i < details->env_cnt; i++) {
+		if (!xstrncmp(details->env_sup[i], "BB_JOB_DIR=", 11)) {
+			xfree(details->env_sup[i]);
+			details->env_sup[i] = env;
+			return;
+		}
+	}
+	xrealloc(details->env_sup, sizeof(char *) * (details->env_cnt + 1));
+	details->env_sup[details->env_cnt++] = env;
+}
+
+/* Return the burst buffer record of a job, creating it if needed */
+static bb_job_t *_get_bb_job(job_record_t *job_ptr)
+{
+	bb_stage_spec_t *spec = NULL;
+	char *err_msg = NULL;
+	bb_job_t *bb_job;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return NULL;
+
+	if ((bb_job = bb_job_find(&bb_state, job_ptr->job_id)))
+		return bb_job;	/* Cached data */
+
+	if (bb_stage_parse(job_ptr->burst_buffer, &spec, &err_msg)) {
+		error("%s: %s: Invalid burst buffer spec for %pJ: %s",
+		      plugin_type, __func__, job_ptr, err_msg);
+		xfree(err_msg);
+		return NULL;
+	}
+
+	bb_job = bb_job_alloc(&bb_state, job_ptr->job_id);
+	bb_job->account = xstrdup(job_ptr->account);
+	if (job_ptr->part_ptr)
+		bb_job->partition = xstrdup(job_ptr->part_ptr->name);
+	if (job_ptr->qos_ptr)
+		bb_job->qos = xstrdup(job_ptr->qos_ptr->name);
+	bb_job->state = BB_STATE_PENDING;
+	bb_job->user_id = job_ptr->user_id;
+	bb_job->req_size = spec->capacity;
+	bb_job->total_size = bb_granularity(spec->capacity,
+					    bb_state.bb_config.granularity);
+	bb_job->use_job_buf = true;
+	bb_stage_spec_free(spec);
+	if (bb_state.bb_config.debug_flag)
+		bb_job_log(&bb_state, bb_job);
+
+	return bb_job;
+}
+
+/* Test if a job's buffer fits in the file system now
+ * RET 0: Job can be started now
+ *     1: Job exceeds the size of the file system, continue testing with
+ *	  next job
+ *     2: Job needs more space than currently available, skip all remaining
+ *	  jobs */
+static int _test_size_limit(bb_job_t *bb_job)
+{
+	uint64_t unfree_space;
+
+	/* Space on the compute nodes is checked by slurmd at stage-in */
+	if (_stage_on_nodes())
+		return 0;
+	if (bb_job->total_size > bb_state.total_space)
+		return 1;
+	unfree_space = MAX(bb_state.used_space, bb_state.unfree_space);
+	if (unfree_space + bb_job->total_size <= bb_state.total_space)
+		return 0;
+	return 2;
+}
+
+/* Update the size of the buffer file system */
+static void _load_state(bool init_config)
+{
+	struct statvfs fs;
+
+	if (!bb_state.bb_config.directory)
+		return;
+	if (_stage_on_nodes()) {
+		slurm_mutex_lock(&bb_state.bb_mutex);
+		bb_state.total_space = 0;
+		bb_state.last_load_time = time(NULL);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return;
+	}
+	if (statvfs(bb_state.bb_config.directory, &fs) < 0) {
+		error("%s: %s: statvfs(%s): %m", plugin_type, __func__,
+		      bb_state.bb_config.directory);
+		return;
+	}
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	bb_state.total_space = (uint64_t) fs.f_blocks * fs.f_frsize;
+	bb_state.last_load_time = time(NULL);
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+}
+
+/*
+ * Restore the buffers recorded on the file system, resuming their work based
+ * upon the state of their jobs.
+ * Executed with job write lock and bb_mutex
+ */
+static void _recover_bb_state(void)
+{
+	char *state_dir, *state_file, *end_ptr = NULL, state_str[32];
+	uint32_t job_id, user_id, group_id, saved_job_id;
+	time_t defer_time = time(NULL) + 60;
+	job_record_t *job_ptr;
+	bb_alloc_t *bb_alloc;
+	bb_job_t *bb_job;
+	struct dirent *ent;
+	uint16_t state;
+	uint64_t size;
+	DIR *dir;
+	FILE *fp;
+	int rc;
+
+	state_dir = _state_dir();
+	if (!(dir = opendir(state_dir))) {
+		error("%s: %s: opendir(%s): %m",
+		      plugin_type, __func__, state_dir);
+		xfree(state_dir);
+		return;
+	}
+	while ((ent = readdir(dir))) {
+		job_id = strtoul(ent->d_name, &end_ptr, 10);
+		if ((job_id == 0) || (end_ptr[0] != '\0'))
+			continue;
+		state_file = xstrdup_printf("%s/%s", state_dir, ent->d_name);
+		if (!(fp = fopen(state_file, "r"))) {
+			error("%s: %s: fopen(%s): %m",
+			      plugin_type, __func__, state_file);
+			xfree(state_file);
+			continue;
+		}
+		rc = fscanf(fp, "UserID=%u GroupID=%u JobID=%u State=%31s Size=%"SCNu64,
+			    &user_id, &group_id, &saved_job_id, state_str,
+			    &size);
+		fclose(fp);
+		if ((rc != 5) || (saved_job_id != job_id)) {
+			error("%s: %s: invalid state file %s",
+			      plugin_type, __func__, state_file);
+			xfree(state_file);
+			continue;
+		}
+		xfree(state_file);
+		state = bb_state_num(state_str);
+
+		job_ptr = find_job_record(job_id);
+		bb_job = job_ptr ? _get_bb_job(job_ptr) : NULL;
+		if (!bb_job) {
+			info("%s: Purging vestigial buffer for JobId=%u",
+			     plugin_type, job_id);
+			_queue_teardown(job_id, user_id, group_id);
+			continue;
+		}
+
+		bb_alloc = bb_alloc_job(&bb_state, job_ptr, bb_job);
+		bb_alloc->state = state;
+		bb_limit_add(job_ptr->user_id, bb_alloc->size, NULL, &bb_state,
+			     true);
+		if (!IS_JOB_STARTED(job_ptr) || (state >= BB_STATE_TEARDOWN)) {
+			/* We do not know the state of file staging, so
+			 * teardown the buffer and stage-in again later */
+			debug("%s: Purging buffer for %pJ",
+			      plugin_type, job_ptr);
+			bb_job->state = BB_STATE_TEARDOWN;
+			bb_alloc->state = BB_STATE_TEARDOWN;
+			_queue_teardown(job_id, user_id, group_id);
+			if (IS_JOB_PENDING(job_ptr) && job_ptr->details &&
+			    (job_ptr->details->begin_time < defer_time))
+				job_ptr->details->begin_time = defer_time;
+		} else if (IS_JOB_RUNNING(job_ptr) ||
+			   IS_JOB_SUSPENDED(job_ptr)) {
+			bb_job->state = BB_STATE_RUNNING;
+		} else {
+			/* Job ended, stage-out incomplete */
+			info("%s: Restarting stage-out of %pJ",
+			     plugin_type, job_ptr);
+			bb_job->state = BB_STATE_POST_RUN;
+			job_ptr->job_state |= JOB_STAGE_OUT;
+			_queue_stage_out(job_ptr, bb_job);
+		}
+	}
+	closedir(dir);
+	xfree(state_dir);
+}
+
+/* Retry the teardown of buffers which failed.
+ * Executed with job write lock and bb_mutex */
+static void _retry_teardown(void)
+{
+	bb_alloc_t *bb_alloc;
+	job_record_t *job_ptr;
+	uint32_t group_id;
+	int i;
+
+	for (i = 0; i < BB_HASH_SIZE; i++) {
+		for (bb_alloc = bb_state.bb_ahash[i]; bb_alloc;
+		     bb_alloc = bb_alloc->next) {
+			if (bb_alloc->state != BB_STATE_TEARDOWN_FAIL)
+				continue;
+			if ((job_ptr = find_job_record(bb_alloc->job_id)))
+				group_id = job_ptr->group_id;
+			else
+				group_id = gid_from_uid(bb_alloc->user_id);
+			bb_alloc->state = BB_STATE_TEARDOWN;
+			bb_alloc->state_time = time(NULL);
+			_queue_teardown(bb_alloc->job_id, bb_alloc->user_id,
+					group_id);
+		}
+	}
+}
+
+/* Perform periodic background activities */
+static void *_bb_agent(void *args)
+{
+	/* Locks: write job */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+
+	while (!bb_state.term_flag) {
+		bb_sleep(&bb_state, AGENT_INTERVAL);
+		if (!bb_state.term_flag) {
+			_load_state(false);	/* Has own locking */
+			lock_slurmctld(job_write_lock);
+			slurm_mutex_lock(&bb_state.bb_mutex);
+			_retry_teardown();
+			slurm_mutex_unlock(&bb_state.bb_mutex);
+			unlock_slurmctld(job_write_lock);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Test that a directory is owned by user root and not writable by others
+ * IN path - directory to test
+ * IN follow - if set path may be a symbolic link to the directory
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+static int _test_root_dir(char *path, bool follow)
+{
+	struct stat st;
+
+	if ((follow ? stat(path, &st) : lstat(path, &st)) < 0) {
+		error("%s: %s: stat(%s): %m", plugin_type, __func__, path);
+		return SLURM_ERROR;
+	}
+	if (!S_ISDIR(st.st_mode) || (st.st_uid != 0) ||
+	    (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		error("%s: %s is not a directory owned by root and only writable by it",
+		      plugin_type, path);
+		return SLURM_ERROR;
+	}
+	return SLURM_SUCCESS;
+}
+
+/*
+ * Validate the Directory option and create its state directory
+ * RET SLURM_SUCCESS or SLURM_ERROR if Directory is unsafe to use
+ */
+static int _test_config(void)
+{
+	char *state_dir;
+	int rc = SLURM_SUCCESS;
+
+	if (!bb_state.bb_config.directory) {
+		error("%s: Directory is not configured, burst buffer disabled",
+		      plugin_type);
+	} else if (bb_state.bb_config.directory[0] != '/') {
+		error("%s: Directory %s is not an absolute path, burst buffer disabled",
+		      plugin_type, bb_state.bb_config.directory);
+		xfree(bb_state.bb_config.directory);
+	} else if (_stage_on_nodes()) {
+		/* Directory is on the compute nodes, tested by slurmd */
+		if (!(slurmctld_conf.prolog_flags & PROLOG_FLAG_ALLOC))
+			error("%s: Staging on the compute nodes requires PrologFlags=Alloc, burst buffer jobs will be rejected",
+			      plugin_type);
+	} else {
+		state_dir = _state_dir();
+		if ((mkdir(state_dir, 0700) < 0) && (errno != EEXIST))
+			error("%s: %s: mkdir(%s): %m",
+			      plugin_type, __func__, state_dir);
+		if (_test_root_dir(bb_state.bb_config.directory, true) ||
+		    _test_root_dir(state_dir, false)) {
+			error("%s: Directory %s is unsafe, burst buffer disabled",
+			      plugin_type, bb_state.bb_config.directory);
+			xfree(bb_state.bb_config.directory);
+			rc = SLURM_ERROR;
+		}
+		xfree(state_dir);
+	}
+	bb_stage_set_bandwidth(bb_state.bb_config.stage_bandwidth);
+
+	return rc;
+}
+
+/*
+ * Create a job's buffer directory, or reuse the one left by an earlier
+ * stage-in or a failed teardown, and give it to the job's user
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+static int _make_job_dir(job_record_t *job_ptr, char *job_dir)
+{
+	struct stat st;
+	int fd, rc = SLURM_ERROR;
+
+	if ((mkdir(job_dir, 0700) < 0) && (errno != EEXIST)) {
+		error("%s: %s: mkdir(%s) for %pJ: %m",
+		      plugin_type, __func__, job_dir, job_ptr);
+		return SLURM_ERROR;
+	}
+	/* never follow a link, the directory is checked through its fd */
+	if ((fd = open(job_dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW)) < 0) {
+		error("%s: %s: open(%s) for %pJ: %m",
+		      plugin_type, __func__, job_dir, job_ptr);
+		return SLURM_ERROR;
+	}
+	if (fstat(fd, &st) < 0) {
+		error("%s: %s: fstat(%s) for %pJ: %m",
+		      plugin_type, __func__, job_dir, job_ptr);
+	} else if ((st.st_uid != 0) && (st.st_uid != job_ptr->user_id)) {
+		error("%s: %s: %s for %pJ is owned by user %u",
+		      plugin_type, __func__, job_dir, job_ptr,
+		      (uint32_t) st.st_uid);
+	} else if (fchown(fd, job_ptr->user_id, job_ptr->group_id) < 0) {
+		error("%s: %s: fchown(%s) for %pJ: %m",
+		      plugin_type, __func__, job_dir, job_ptr);
+	} else {
+		rc = SLURM_SUCCESS;
+	}
+	close(fd);
+
+	return rc;
+}
+
+static void *_start_stage_in(void *x)
+{
+	stage_args_t *stage_args = (stage_args_t *) x;
+	char *job_dir, *resp_msg = NULL;
+	int status = 0, timeout;
+	slurmctld_lock_t job_write_lock =
+		{ NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	job_record_t *job_ptr;
+	bb_alloc_t *bb_alloc = NULL;
+	bb_job_t *bb_job;
+	DEF_TIMERS;
+	track_script_rec_add(stage_args->job_id, 0, pthread_self());
+
+	job_dir = _job_dir(stage_args->job_id);
+	timeout = bb_state.bb_config.stage_in_timeout * 1000;
+	if (stage_args->spec->stage_in_cnt) {
+		START_TIMER;
+		resp_msg = bb_stage_run("stage_in", stage_args->spec->stage_in,
+					stage_args->spec->stage_in_cnt,
+					job_dir, stage_args->user_id,
+					stage_args->group_id, timeout,
+					pthread_self(), &status);
+		END_TIMER;
+		info("%s: %s: stage_in for JobId=%u ran for %s",
+		     plugin_type, __func__, stage_args->job_id, TIME_STR);
+	}
+	xfree(job_dir);
+
+	if (track_script_broadcast(pthread_self(), status)) {
+		/* I was killed by slurmtrack, bail out right now */
+		info("%s: %s: stage_in for JobId=%u terminated by slurmctld",
+		     plugin_type, __func__, stage_args->job_id);
+		xfree(resp_msg);
+		_free_stage_args(stage_args);
+		track_script_remove(pthread_self());
+		return NULL;
+	}
+	track_script_reset_cpid(pthread_self(), 0);
+
+	lock_slurmctld(job_write_lock);
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	job_ptr = find_job_record(stage_args->job_id);
+	bb_job = bb_job_find(&bb_state, stage_args->job_id);
+	if (job_ptr)
+		bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr);
+	if (!job_ptr || !bb_job || (bb_job->state != BB_STATE_STAGING_IN)) {
+		/* Job cancelled or purged, its teardown is queued */
+		debug("%s: %s: JobId=%u no longer staging in",
+		      plugin_type, __func__, stage_args->job_id);
+	} else if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+		trigger_burst_buffer();
+		error("%s: %s: stage_in for %pJ status:%u response:%s",
+		      plugin_type, __func__, job_ptr, status, resp_msg);
+		xfree(job_ptr->state_desc);
+		job_ptr->state_reason = FAIL_BURST_BUFFER_OP;
+		xstrfmtcat(job_ptr->state_desc, "%s: stage_in: %s",
+			   plugin_type, resp_msg);
+		job_ptr->priority = 0;	/* Hold job */
+		bb_job->state = BB_STATE_TEARDOWN;
+		if (bb_alloc) {
+			bb_alloc->state = BB_STATE_TEARDOWN;
+			bb_alloc->state_time = time(NULL);
+		}
+		bb_state.last_update_time = time(NULL);
+		_queue_teardown(stage_args->job_id, stage_args->user_id,
+				stage_args->group_id);
+	} else {
+		bb_job->state = BB_STATE_STAGED_IN;
+		if (bb_alloc) {
+			bb_alloc->state = BB_STATE_STAGED_IN;
+			bb_alloc->state_time = time(NULL);
+		}
+		_write_job_state(stage_args->job_id, stage_args->user_id,
+				 stage_args->group_id, BB_STATE_STAGED_IN,
+				 bb_job->total_size);
+		if (bb_state.bb_config.debug_flag) {
+			info("%s: %s: Stage-in complete for %pJ",
+			     plugin_type, __func__, job_ptr);
+		}
+		queue_job_scheduler();
+		bb_state.last_update_time = time(NULL);
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+	unlock_slurmctld(job_write_lock);
+
+	xfree(resp_msg);
+	_free_stage_args(stage_args);
+
+	track_script_remove(pthread_self());
+
+	return NULL;
+}
+
+/* Allocate a buffer to a job and begin its stage-in.
+ * Executed with job write lock and bb_mutex */
+static int _queue_stage_in(job_record_t *job_ptr, bb_job_t *bb_job)
+{
+	stage_args_t *stage_args;
+	bb_stage_spec_t *spec = NULL;
+	bb_alloc_t *bb_alloc;
+	char *job_dir, *err_msg = NULL;
+	pthread_t tid;
+
+	if (bb_stage_parse(job_ptr->burst_buffer, &spec, &err_msg)) {
+		error("%s: %s: Invalid burst buffer spec for %pJ: %s",
+		      plugin_type, __func__, job_ptr, err_msg);
+		xfree(err_msg);
+		return SLURM_ERROR;
+	}
+	job_dir = _job_dir(job_ptr->job_id);
+	if (_make_job_dir(job_ptr, job_dir) != SLURM_SUCCESS) {
+		xfree(job_dir);
+		bb_stage_spec_free(spec);
+		return SLURM_ERROR;
+	}
+	xfree(job_dir);
+
+	bb_job->state = BB_STATE_STAGING_IN;
+	if (!(bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr))) {
+		bb_alloc = bb_alloc_job(&bb_state, job_ptr, bb_job);
+		bb_limit_add(job_ptr->user_id, bb_job->total_size, NULL,
+			     &bb_state, true);
+	}
+	bb_alloc->state = BB_STATE_STAGING_IN;
+	bb_alloc->state_time = time(NULL);
+	bb_alloc->create_time = time(NULL);
+	_write_job_state(job_ptr->job_id, job_ptr->user_id, job_ptr->group_id,
+			 BB_STATE_STAGING_IN, bb_job->total_size);
+
+	stage_args = xmalloc(sizeof(stage_args_t));
+	stage_args->job_id   = job_ptr->job_id;
+	stage_args->user_id  = job_ptr->user_id;
+	stage_args->group_id = job_ptr->group_id;
+	stage_args->spec     = spec;
+
+	slurm_thread_create(&tid, _start_stage_in, stage_args);
+
+	return SLURM_SUCCESS;
+}
+
+static void *_start_stage_out(void *x)
+{
+	stage_args_t *stage_args = (stage_args_t *) x;
+	char *job_dir, *resp_msg = NULL;
+	int i, status = 0, timeout;
+	slurmctld_lock_t job_write_lock =
+		{ NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	job_record_t *job_ptr;
+	bb_alloc_t *bb_alloc = NULL;
+	bb_job_t *bb_job;
+	bool success;
+	DEF_TIMERS;
+	track_script_rec_add(stage_args->job_id, 0, pthread_self());
+
+	job_dir = _job_dir(stage_args->job_id);
+	timeout = bb_state.bb_config.stage_out_timeout * 1000;
+	for (i = 0; (i <= STAGE_OUT_RETRY) &&
+		    stage_args->spec->stage_out_cnt; i++) {
+		if (i)
+			sleep(AGENT_INTERVAL);
+		xfree(resp_msg);
+		START_TIMER;
+		resp_msg = bb_stage_run("stage_out",
+					stage_args->spec->stage_out,
+					stage_args->spec->stage_out_cnt,
+					job_dir, stage_args->user_id,
+					stage_args->group_id, timeout,
+					pthread_self(), &status);
+		END_TIMER;
+		info("%s: %s: stage_out for JobId=%u ran for %s",
+		     plugin_type, __func__, stage_args->job_id, TIME_STR);
+
+		if (track_script_broadcast(pthread_self(), status)) {
+			/* I was killed by slurmtrack, bail out right now */
+			info("%s: %s: stage_out for JobId=%u terminated by slurmctld",
+			     plugin_type, __func__, stage_args->job_id);
+			xfree(job_dir);
+			xfree(resp_msg);
+			_free_stage_args(stage_args);
+			track_script_remove(pthread_self());
+			return NULL;
+		}
+		track_script_reset_cpid(pthread_self(), 0);
+		if (WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+			break;
+		error("%s: %s: stage_out for JobId=%u status:%u response:%s",
+		      plugin_type, __func__, stage_args->job_id, status,
+		      resp_msg);
+	}
+	success = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+	if (!success)
+		trigger_burst_buffer();
+
+	lock_slurmctld(job_write_lock);
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	job_ptr = find_job_record(stage_args->job_id);
+	bb_job = bb_job_find(&bb_state, stage_args->job_id);
+	if (job_ptr) {
+		bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr);
+		if (success) {
+			xfree(job_ptr->state_desc);
+		} else {
+			job_ptr->state_reason = FAIL_BURST_BUFFER_OP;
+			xfree(job_ptr->state_desc);
+			xstrfmtcat(job_ptr->state_desc, "%s: stage_out: %s",
+				   plugin_type, resp_msg);
+		}
+	}
+	if (success || (bb_state.bb_config.flags & BB_FLAG_TEARDOWN_FAILURE)) {
+		if (bb_job)
+			bb_job->state = BB_STATE_TEARDOWN;
+		if (bb_alloc) {
+			bb_alloc->state = BB_STATE_TEARDOWN;
+			bb_alloc->state_time = time(NULL);
+		}
+		_queue_teardown(stage_args->job_id, stage_args->user_id,
+				stage_args->group_id);
+	} else {
+		/* Leave the files for recovery by the administrator */
+		error("%s: %s: stage_out for JobId=%u failed, files left in %s",
+		      plugin_type, __func__, stage_args->job_id, job_dir);
+		if (bb_alloc) {
+			bb_limit_rem(bb_alloc->user_id, bb_alloc->size,
+				     bb_alloc->pool, &bb_state);
+			(void) bb_free_alloc_rec(&bb_state, bb_alloc);
+		}
+		if (bb_job)
+			bb_job->state = BB_STATE_COMPLETE;
+		if (job_ptr) {
+			job_ptr->job_state &= (~JOB_STAGE_OUT);
+			last_job_update = time(NULL);
+		}
+		_write_job_state(stage_args->job_id, 0, 0, BB_STATE_COMPLETE,
+				 0);
+	}
+	bb_state.last_update_time = time(NULL);
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+	unlock_slurmctld(job_write_lock);
+
+	xfree(job_dir);
+	xfree(resp_msg);
+	_free_stage_args(stage_args);
+
+	track_script_remove(pthread_self());
+
+	return NULL;
+}
+
+/* Begin the stage-out of a job's buffer.
+ * Executed with job write lock and bb_mutex */
+static void _queue_stage_out(job_record_t *job_ptr, bb_job_t *bb_job)
+{
+	stage_args_t *stage_args;
+	bb_stage_spec_t *spec = NULL;
+	bb_alloc_t *bb_alloc;
+	char *err_msg = NULL;
+	pthread_t tid;
+
+	if (bb_stage_parse(job_ptr->burst_buffer, &spec, &err_msg)) {
+		/* Validated at submit time, not expected */
+		error("%s: %s: Invalid burst buffer spec for %pJ: %s",
+		      plugin_type, __func__, job_ptr, err_msg);
+		xfree(err_msg);
+		spec = xmalloc(sizeof(bb_stage_spec_t));
+	}
+
+	bb_job->state = BB_STATE_STAGING_OUT;
+	if ((bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr))) {
+		bb_alloc->state = BB_STATE_STAGING_OUT;
+		bb_alloc->state_time = time(NULL);
+	}
+	_write_job_state(job_ptr->job_id, job_ptr->user_id, job_ptr->group_id,
+			 BB_STATE_STAGING_OUT, bb_job->total_size);
+	bb_state.last_update_time = time(NULL);
+
+	stage_args = xmalloc(sizeof(stage_args_t));
+	stage_args->job_id   = job_ptr->job_id;
+	stage_args->user_id  = job_ptr->user_id;
+	stage_args->group_id = job_ptr->group_id;
+	stage_args->spec     = spec;
+
+	slurm_thread_create(&tid, _start_stage_out, stage_args);
+}
+
+static void *_start_teardown(void *x)
+{
+	stage_args_t *teardown_args = (stage_args_t *) x;
+	char *job_dir, *resp_msg = NULL;
+	int status = 0, timeout;
+	job_record_t *job_ptr;
+	bb_alloc_t *bb_alloc = NULL;
+	bb_job_t *bb_job = NULL;
+	/* Locks: write job */
+	slurmctld_lock_t job_write_lock = {
+		NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK, NO_LOCK };
+	DEF_TIMERS;
+	track_script_rec_add(teardown_args->job_id, 0, pthread_self());
+
+	job_dir = _job_dir(teardown_args->job_id);
+	START_TIMER;
+	timeout = bb_state.bb_config.other_timeout * 1000;
+	resp_msg = bb_stage_run("teardown", NULL, 0, job_dir,
+				teardown_args->user_id,
+				teardown_args->group_id, timeout,
+				pthread_self(), &status);
+	END_TIMER;
+	info("%s: %s: teardown for JobId=%u ran for %s",
+	     plugin_type, __func__, teardown_args->job_id, TIME_STR);
+
+	if (track_script_broadcast(pthread_self(), status)) {
+		/* I was killed by slurmtrack, bail out right now */
+		info("%s: %s: teardown for JobId=%u terminated by slurmctld",
+		     plugin_type, __func__, teardown_args->job_id);
+		xfree(job_dir);
+		xfree(resp_msg);
+		_free_stage_args(teardown_args);
+		track_script_remove(pthread_self());
+		return NULL;
+	}
+
+	if (WIFEXITED(status) && (WEXITSTATUS(status) == 0) &&
+	    (rmdir(job_dir) < 0) && (errno != ENOENT)) {
+		xstrfmtcat(resp_msg, "rmdir(%s): %m", job_dir);
+		status = 1;
+	}
+
+	lock_slurmctld(job_write_lock);
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	job_ptr = find_job_record(teardown_args->job_id);
+	if (job_ptr) {
+		bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr);
+	} else {
+		char buf_name[32];
+		snprintf(buf_name, sizeof(buf_name), "%u",
+			 teardown_args->job_id);
+		bb_alloc = bb_find_name_rec(buf_name, teardown_args->user_id,
+					    &bb_state);
+	}
+	if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+		trigger_burst_buffer();
+		error("%s: %s: teardown for JobId=%u status:%u response:%s",
+		      plugin_type, __func__, teardown_args->job_id, status,
+		      resp_msg);
+		/* Retried by _bb_agent() */
+		if (bb_alloc)
+			bb_alloc->state = BB_STATE_TEARDOWN_FAIL;
+		if (job_ptr) {
+			job_ptr->state_reason = FAIL_BURST_BUFFER_OP;
+			xfree(job_ptr->state_desc);
+			xstrfmtcat(job_ptr->state_desc, "%s: teardown: %s",
+				   plugin_type, resp_msg);
+		}
+	} else {
+		_write_job_state(teardown_args->job_id, 0, 0,
+				 BB_STATE_COMPLETE, 0);
+		if (bb_alloc) {
+			bb_limit_rem(bb_alloc->user_id, bb_alloc->size,
+				     bb_alloc->pool, &bb_state);
+			(void) bb_free_alloc_rec(&bb_state, bb_alloc);
+		}
+		if (job_ptr) {
+			if ((bb_job = bb_job_find(&bb_state, job_ptr->job_id)))
+				bb_job->state = BB_STATE_COMPLETE;
+			job_ptr->job_state &= (~JOB_STAGE_OUT);
+			last_job_update = time(NULL);
+			if (!IS_JOB_PENDING(job_ptr) &&	/* No email if requeue */
+			    (job_ptr->mail_type & MAIL_JOB_STAGE_OUT)) {
+				mail_job_info(job_ptr, MAIL_JOB_STAGE_OUT);
+				job_ptr->mail_type &= (~MAIL_JOB_STAGE_OUT);
+			}
+		}
+	}
+	bb_state.last_update_time = time(NULL);
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+	unlock_slurmctld(job_write_lock);
+
+	xfree(job_dir);
+	xfree(resp_msg);
+	_free_stage_args(teardown_args);
+
+	track_script_remove(pthread_self());
+
+	return NULL;
+}
+
+/* Remove the contents of a job's buffer and release its space */
+static void _queue_teardown(uint32_t job_id, uint32_t user_id,
+			    uint32_t group_id)
+{
+	stage_args_t *teardown_args;
+	pthread_t tid;
+
+	teardown_args = xmalloc(sizeof(stage_args_t));
+	teardown_args->job_id   = job_id;
+	teardown_args->user_id  = user_id;
+	teardown_args->group_id = group_id;
+
+	slurm_thread_create(&tid, _start_teardown, teardown_args);
+}
+
 /*
  * init() is called when the plugin is loaded, before any other functions
  * are called.  Put global initialization here.
  */
 extern int init(void)
 {
+	slurm_mutex_init(&bb_state.bb_mutex);
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	bb_load_config(&bb_state, (char *)plugin_type); /* Removes "const" */
+	if (_test_config() != SLURM_SUCCESS) {
+		bb_clear_config(&bb_state.bb_config, true);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return SLURM_ERROR;
+	}
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s", plugin_type,  __func__);
+	bb_alloc_cache(&bb_state);
+	slurm_thread_create(&bb_state.bb_thread, _bb_agent, NULL);
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
 /*
- * fini() is called when the plugin is unloaded. Free all memory.
+ * fini() is called when the plugin is unloaded. Free all memory and shutdown
+ * threads.
  */
 extern int fini(void)
 {
+	int pc, last_pc = 0;
+
+	bb_stage_shutdown();
+	while ((pc = bb_stage_count()) > 0) {
+		if ((last_pc != 0) && (last_pc != pc)) {
+			info("%s: waiting for %d running processes",
+			     plugin_type, pc);
+		}
+		last_pc = pc;
+		usleep(100000);
+	}
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s", plugin_type,  __func__);
+
+	slurm_mutex_lock(&bb_state.term_mutex);
+	bb_state.term_flag = true;
+	slurm_cond_signal(&bb_state.term_cond);
+	slurm_mutex_unlock(&bb_state.term_mutex);
+
+	if (bb_state.bb_thread) {
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		pthread_join(bb_state.bb_thread, NULL);
+		slurm_mutex_lock(&bb_state.bb_mutex);
+		bb_state.bb_thread = 0;
+	}
+	bb_clear_config(&bb_state.bb_config, true);
+	bb_clear_cache(&bb_state);
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
@@ -105,6 +1016,10 @@ extern int fini(void)
 extern uint64_t bb_p_get_system_size(void)
 {
 	uint64_t size = 0;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	size = bb_state.total_space / (1024 * 1024);	/* bytes to MB */
+	slurm_mutex_unlock(&bb_state.bb_mutex);
 	return size;
 }
 
@@ -119,6 +1034,19 @@ extern uint64_t bb_p_get_system_size(void)
  */
 extern int bb_p_load_state(bool init_config)
 {
+	if (!init_config)
+		return SLURM_SUCCESS;
+
+	/* The file system size is refreshed periodically by _bb_agent() */
+	if (bb_state.bb_config.debug_flag)
+		debug("%s: %s", plugin_type,  __func__);
+	_load_state(init_config);	/* Has own locking */
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	bb_set_tres_pos(&bb_state);
+	if (bb_state.last_load_time && !_stage_on_nodes())
+		_recover_bb_state();
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
@@ -130,7 +1058,32 @@ extern int bb_p_load_state(bool init_config)
  */
 extern char *bb_p_get_status(uint32_t argc, char **argv)
 {
-	return NULL;
+	char *status_resp = NULL;
+	bb_alloc_t *bb_alloc;
+	int i;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	xstrfmtcat(status_resp, "Directory=%s",
+		   bb_state.bb_config.directory);
+	xstrfmtcat(status_resp, " TotalSpace=%s",
+		   bb_get_size_str(bb_state.total_space));
+	xstrfmtcat(status_resp, " UsedSpace=%s",
+		   bb_get_size_str(bb_state.used_space));
+	xstrfmtcat(status_resp, " StageBandwidth=%s/s\n",
+		   bb_get_size_str(bb_state.bb_config.stage_bandwidth));
+	for (i = 0; i < BB_HASH_SIZE; i++) {
+		for (bb_alloc = bb_state.bb_ahash[i]; bb_alloc;
+		     bb_alloc = bb_alloc->next) {
+			xstrfmtcat(status_resp, "  JobID=%u UserID=%u State=%s",
+				   bb_alloc->job_id, bb_alloc->user_id,
+				   bb_state_string(bb_alloc->state));
+			xstrfmtcat(status_resp, " Size=%s\n",
+				   bb_get_size_str(bb_alloc->size));
+		}
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return status_resp;
 }
 
 /*
@@ -140,6 +1093,13 @@ extern char *bb_p_get_status(uint32_t argc, char **argv)
  */
 extern int bb_p_reconfig(void)
 {
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s", plugin_type,  __func__);
+	bb_load_config(&bb_state, (char *)plugin_type); /* Remove "const" */
+	_test_config();
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
@@ -151,9 +1111,63 @@ extern int bb_p_reconfig(void)
  */
 extern int bb_p_state_pack(uid_t uid, Buf buffer, uint16_t protocol_version)
 {
+	uint32_t rec_count = 0;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	packstr(bb_state.name, buffer);
+	bb_pack_state(&bb_state, buffer, protocol_version);
+
+	if (((bb_state.bb_config.flags & BB_FLAG_PRIVATE_DATA) == 0) ||
+	    validate_operator(uid))
+		uid = 0;	/* User can see all data */
+	rec_count = bb_pack_bufs(uid, &bb_state, buffer, protocol_version);
+	(void) bb_pack_usage(uid, &bb_state, buffer, protocol_version);
+	if (bb_state.bb_config.debug_flag) {
+		debug("%s: %s: record_count:%u",
+		      plugin_type, __func__, rec_count);
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
+/* Gather the "#BB" lines of the --bb option and of the leading comments of
+ * the batch script into the job's burst_buffer */
+static void _xlate_bb_opts(job_desc_msg_t *job_desc)
+{
+	char *bb_str = NULL, *tmp, *tok, *save_ptr = NULL;
+
+	if (job_desc->burst_buffer) {
+		tmp = xstrdup(job_desc->burst_buffer);
+		for (tok = strtok_r(tmp, ";\n", &save_ptr); tok;
+		     tok = strtok_r(NULL, ";\n", &save_ptr)) {
+			while (isspace(tok[0]))
+				tok++;
+			if (tok[0] == '\0')
+				continue;
+			xstrfmtcat(bb_str, "%s%s%s\n",
+				   (tok[0] == '#') ? "" : "#BB",
+				   (tok[0] == '#') ? "" : " ", tok);
+		}
+		xfree(tmp);
+	}
+
+	if (job_desc->script) {
+		tmp = xstrdup(job_desc->script);
+		for (tok = strtok_r(tmp, "\n", &save_ptr); tok;
+		     tok = strtok_r(NULL, "\n", &save_ptr)) {
+			if (tok[0] != '#')
+				break;	/* Quit at first non-comment */
+			if (!xstrncmp(tok, "#BB", 3))
+				xstrfmtcat(bb_str, "%s\n", tok);
+		}
+		xfree(tmp);
+	}
+
+	xfree(job_desc->burst_buffer);
+	job_desc->burst_buffer = bb_str;
+}
+
 /*
  * Preliminary validation of a job submit request with respect to burst buffer
  * options. Performed after setting default account + qos, but prior to
@@ -163,7 +1177,91 @@ extern int bb_p_state_pack(uid_t uid, Buf buffer, uint16_t protocol_version)
  */
 extern int bb_p_job_validate(job_desc_msg_t *job_desc, uid_t submit_uid)
 {
-	return SLURM_SUCCESS;
+	bb_stage_spec_t *spec = NULL;
+	char *err_msg = NULL;
+	uint64_t bb_size;
+	int i, rc;
+
+	xassert(job_desc);
+	xassert(job_desc->tres_req_cnt);
+
+	_xlate_bb_opts(job_desc);
+	if ((job_desc->burst_buffer == NULL) ||
+	    (job_desc->burst_buffer[0] == '\0'))
+		return SLURM_SUCCESS;
+
+	if (bb_state.bb_config.debug_flag) {
+		info("%s: %s: job_user_id:%u, submit_uid:%d",
+		     plugin_type, __func__, job_desc->user_id, submit_uid);
+		info("%s: %s: burst_buffer:%s",
+		     plugin_type,__func__, job_desc->burst_buffer);
+	}
+
+	if ((rc = bb_stage_parse(job_desc->burst_buffer, &spec, &err_msg))) {
+		info("%s: %s: Invalid burst buffer spec: %s",
+		     plugin_type, __func__, err_msg);
+		xfree(err_msg);
+		return rc;
+	}
+	bb_size = spec->capacity;
+	bb_stage_spec_free(spec);
+
+	if (job_desc->user_id == 0) {
+		info("%s: %s: User root can not allocate burst buffers",
+		     plugin_type, __func__);
+		return ESLURM_BURST_BUFFER_PERMISSION;
+	}
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	/* slurmd creates and stages the buffer when the job is allocated */
+	if (_stage_on_nodes() &&
+	    !(slurmctld_conf.prolog_flags & PROLOG_FLAG_ALLOC)) {
+		info("%s: %s: Burst buffers on the compute nodes require PrologFlags=Alloc",
+		     plugin_type, __func__);
+		rc = ESLURM_INVALID_BURST_BUFFER_REQUEST;
+		goto fini;
+	}
+
+	if (bb_state.bb_config.allow_users) {
+		bool found_user = false;
+		for (i = 0; bb_state.bb_config.allow_users[i]; i++) {
+			if (job_desc->user_id ==
+			    bb_state.bb_config.allow_users[i]) {
+				found_user = true;
+				break;
+			}
+		}
+		if (!found_user) {
+			rc = ESLURM_BURST_BUFFER_PERMISSION;
+			goto fini;
+		}
+	}
+
+	if (bb_state.bb_config.deny_users) {
+		bool found_user = false;
+		for (i = 0; bb_state.bb_config.deny_users[i]; i++) {
+			if (job_desc->user_id ==
+			    bb_state.bb_config.deny_users[i]) {
+				found_user = true;
+				break;
+			}
+		}
+		if (found_user) {
+			rc = ESLURM_BURST_BUFFER_PERMISSION;
+			goto fini;
+		}
+	}
+
+	if (bb_state.tres_pos > 0) {
+		bb_size = bb_granularity(bb_size,
+					 bb_state.bb_config.granularity);
+		job_desc->tres_req_cnt[bb_state.tres_pos] =
+			bb_size / (1024 * 1024);
+	}
+
+fini:	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return rc;
 }
 
 /*
@@ -187,6 +1285,25 @@ extern int bb_p_job_validate2(job_record_t *job_ptr, char **err_msg)
 extern void bb_p_job_set_tres_cnt(job_record_t *job_ptr, uint64_t *tres_cnt,
 				  bool locked)
 {
+	bb_job_t *bb_job;
+
+	if (!tres_cnt) {
+		error("%s: %s: No tres_cnt given when looking at %pJ",
+		      plugin_type, __func__, job_ptr);
+		return;
+	}
+
+	if (bb_state.tres_pos < 0) {
+		/* BB not defined in AccountingStorageTRES */
+		return;
+	}
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if ((bb_job = _get_bb_job(job_ptr))) {
+		tres_cnt[bb_state.tres_pos] =
+			bb_job->total_size / (1024 * 1024);
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
 }
 
 /*
@@ -195,6 +1312,49 @@ extern void bb_p_job_set_tres_cnt(job_record_t *job_ptr, uint64_t *tres_cnt,
 extern time_t bb_p_job_get_est_start(job_record_t *job_ptr)
 {
 	time_t est_start = time(NULL);
+	bb_job_t *bb_job;
+	int rc;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return est_start;
+
+	if (job_ptr->array_recs &&
+	    ((job_ptr->array_task_id == NO_VAL) ||
+	     (job_ptr->array_task_id == INFINITE))) {
+		est_start += 300;	/* 5 minutes, guess... */
+		return est_start;	/* Can't operate on job array struct */
+	}
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.last_load_time == 0) {
+		est_start += 3600;	/* 1 hour, guess... */
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return est_start;
+	}
+
+	if ((bb_job = _get_bb_job(job_ptr)) == NULL) {
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return est_start;
+	}
+
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: %pJ", plugin_type, __func__, job_ptr);
+
+	if (bb_job->state == BB_STATE_PENDING) {
+		rc = _test_size_limit(bb_job);
+		if (rc == 0) {		/* Could start now */
+			;
+		} else if (rc == 1) {	/* Exceeds configured limits */
+			est_start += 365 * 24 * 60 * 60;
+		} else {		/* No space currently available */
+			est_start = MAX(est_start, bb_state.next_end_time);
+		}
+	} else {	/* Allocation or staging in progress */
+		est_start++;
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return est_start;
 }
 
@@ -203,6 +1363,74 @@ extern time_t bb_p_job_get_est_start(job_record_t *job_ptr)
  */
 extern int bb_p_job_try_stage_in(List job_queue)
 {
+	bb_job_queue_rec_t *job_rec;
+	List job_candidates;
+	ListIterator job_iter;
+	job_record_t *job_ptr;
+	bb_job_t *bb_job;
+	int rc;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: Mutex locked", plugin_type,  __func__);
+
+	if ((bb_state.last_load_time == 0) || _stage_on_nodes()) {
+		/* slurmd stages in once the job is allocated */
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return SLURM_SUCCESS;
+	}
+
+	/* Identify candidates to be allocated burst buffers */
+	job_candidates = list_create(bb_job_queue_del);
+	job_iter = list_iterator_create(job_queue);
+	while ((job_ptr = list_next(job_iter))) {
+		if (!IS_JOB_PENDING(job_ptr) ||
+		    (job_ptr->start_time == 0) ||
+		    (job_ptr->burst_buffer == NULL) ||
+		    (job_ptr->burst_buffer[0] == '\0'))
+			continue;
+		if (job_ptr->array_recs &&
+		    ((job_ptr->array_task_id == NO_VAL) ||
+		     (job_ptr->array_task_id == INFINITE)))
+			continue;	/* Can't operate on job array struct */
+		bb_job = _get_bb_job(job_ptr);
+		if (bb_job == NULL)
+			continue;
+		if (bb_job->state == BB_STATE_COMPLETE)
+			bb_job->state = BB_STATE_PENDING;     /* job requeued */
+		else if (bb_job->state >= BB_STATE_POST_RUN)
+			continue;	/* Requeued job still staging out */
+		job_rec = xmalloc(sizeof(bb_job_queue_rec_t));
+		job_rec->job_ptr = job_ptr;
+		job_rec->bb_job = bb_job;
+		job_rec->bb_size = bb_job->total_size;
+		list_push(job_candidates, job_rec);
+	}
+	list_iterator_destroy(job_iter);
+
+	/* Sort in order of expected start time */
+	list_sort(job_candidates, bb_job_queue_sort);
+
+	bb_set_use_time(&bb_state);
+	job_iter = list_iterator_create(job_candidates);
+	while ((job_rec = list_next(job_iter))) {
+		job_ptr = job_rec->job_ptr;
+		bb_job = job_rec->bb_job;
+		if (bb_job->state >= BB_STATE_STAGING_IN)
+			continue;	/* Job was already allocated a buffer */
+
+		rc = _test_size_limit(bb_job);
+		if (rc == 0)		/* Could start now */
+			(void) _queue_stage_in(job_ptr, bb_job);
+		else if (rc == 1)	/* Exceeds configured limits */
+			continue;
+		else			/* No space currently available */
+			break;
+	}
+	list_iterator_destroy(job_iter);
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+	FREE_NULL_LIST(job_candidates);
+
 	return SLURM_SUCCESS;
 }
 
@@ -217,7 +1445,53 @@ extern int bb_p_job_try_stage_in(List job_queue)
  */
 extern int bb_p_job_test_stage_in(job_record_t *job_ptr, bool test_only)
 {
-	return 1;
+	bb_job_t *bb_job = NULL;
+	int rc = 1;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return 1;
+
+	if (job_ptr->array_recs &&
+	    ((job_ptr->array_task_id == NO_VAL) ||
+	     (job_ptr->array_task_id == INFINITE)))
+		return -1;	/* Can't operate on job array structure */
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag) {
+		info("%s: %s: %pJ test_only:%d",
+		     plugin_type, __func__, job_ptr, (int) test_only);
+	}
+	if (bb_state.last_load_time != 0)
+		bb_job = _get_bb_job(job_ptr);
+	if (bb_job && (bb_job->state == BB_STATE_COMPLETE))
+		bb_job->state = BB_STATE_PENDING;	/* job requeued */
+	if (bb_job == NULL) {
+		rc = -1;
+	} else if (_stage_on_nodes()) {
+		/* slurmd stages in once the job is allocated */
+		if (bb_job->state < BB_STATE_STAGED_IN)
+			bb_job->state = BB_STATE_STAGED_IN;
+		rc = (bb_job->state == BB_STATE_STAGED_IN) ? 1 : -1;
+	} else if (bb_job->state < BB_STATE_STAGING_IN) {
+		/* Job buffer not allocated, create now if space available */
+		rc = -1;
+		if ((test_only == false) &&
+		    (_test_size_limit(bb_job) == 0) &&
+		    (_queue_stage_in(job_ptr, bb_job) == SLURM_SUCCESS)) {
+			rc = 0;	/* Stage-in in progress */
+		}
+	} else if (bb_job->state == BB_STATE_STAGING_IN) {
+		rc = 0;
+	} else if (bb_job->state == BB_STATE_STAGED_IN) {
+		rc = 1;
+	} else {
+		rc = -1;	/* Requeued job still staging in */
+	}
+
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return rc;
 }
 
 /* Attempt to claim burst buffer resources.
@@ -228,7 +1502,53 @@ extern int bb_p_job_test_stage_in(job_record_t *job_ptr, bool test_only)
  */
 extern int bb_p_job_begin(job_record_t *job_ptr)
 {
-	return SLURM_SUCCESS;
+	bb_alloc_t *bb_alloc;
+	bb_job_t *bb_job;
+	int rc = SLURM_SUCCESS;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return SLURM_SUCCESS;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: %pJ", plugin_type, __func__, job_ptr);
+
+	if (bb_state.last_load_time == 0) {
+		info("%s: %s: Burst buffer down, can not start %pJ",
+		      plugin_type, __func__, job_ptr);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return SLURM_ERROR;
+	}
+	bb_job = _get_bb_job(job_ptr);
+	if (!bb_job) {
+		error("%s: %s: no job record buffer for %pJ",
+		      plugin_type, __func__, job_ptr);
+		xfree(job_ptr->state_desc);
+		job_ptr->state_desc =
+			xstrdup("Could not find burst buffer record");
+		job_ptr->state_reason = FAIL_BURST_BUFFER_OP;
+		if (!_stage_on_nodes()) {
+			_queue_teardown(job_ptr->job_id, job_ptr->user_id,
+					job_ptr->group_id);
+		}
+		rc = SLURM_ERROR;
+	} else {
+		bb_job->state = BB_STATE_RUNNING;
+		if ((bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr))) {
+			bb_alloc->state = BB_STATE_RUNNING;
+			bb_alloc->state_time = time(NULL);
+		}
+		if (!_stage_on_nodes()) {
+			_write_job_state(job_ptr->job_id, job_ptr->user_id,
+					 job_ptr->group_id, BB_STATE_RUNNING,
+					 bb_job->total_size);
+		}
+		_set_job_env(job_ptr);
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return rc;
 }
 
 /* Revoke allocation, but do not release resources.
@@ -239,7 +1559,21 @@ extern int bb_p_job_begin(job_record_t *job_ptr)
  */
 extern int bb_p_job_revoke_alloc(job_record_t *job_ptr)
 {
-	return SLURM_SUCCESS;
+	bb_job_t *bb_job = NULL;
+	int rc = SLURM_SUCCESS;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (job_ptr)
+		bb_job = _get_bb_job(job_ptr);
+	if (bb_job) {
+		if (bb_job->state == BB_STATE_RUNNING)
+			bb_job->state = BB_STATE_STAGED_IN;
+	} else {
+		rc = SLURM_ERROR;
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return rc;
 }
 
 /*
@@ -249,6 +1583,46 @@ extern int bb_p_job_revoke_alloc(job_record_t *job_ptr)
  */
 extern int bb_p_job_start_stage_out(job_record_t *job_ptr)
 {
+	bb_job_t *bb_job;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return SLURM_SUCCESS;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: %pJ", plugin_type, __func__, job_ptr);
+
+	if (bb_state.last_load_time == 0) {
+		info("%s: %s: Burst buffer down, can not stage out %pJ",
+		      plugin_type, __func__, job_ptr);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return SLURM_ERROR;
+	}
+	bb_job = _get_bb_job(job_ptr);
+	if (!bb_job) {
+		verbose("%s: %s: %pJ bb job record not found",
+			plugin_type, __func__, job_ptr);
+	} else if (_stage_on_nodes()) {
+		/* slurmd stages out in the background after the epilog */
+		bb_job->state = BB_STATE_COMPLETE;
+	} else if (bb_job->state < BB_STATE_RUNNING) {
+		/* Job never started. Just teardown the buffer */
+		if (bb_job->state > BB_STATE_PENDING) {
+			bb_job->state = BB_STATE_TEARDOWN;
+			track_script_flush_job(job_ptr->job_id);
+			_queue_teardown(job_ptr->job_id, job_ptr->user_id,
+					job_ptr->group_id);
+		}
+	} else if (bb_job->state <= BB_STATE_POST_RUN) {
+		job_ptr->job_state |= JOB_STAGE_OUT;
+		xfree(job_ptr->state_desc);
+		xstrfmtcat(job_ptr->state_desc, "%s: Stage-out in progress",
+			   plugin_type);
+		_queue_stage_out(job_ptr, bb_job);
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
@@ -261,7 +1635,39 @@ extern int bb_p_job_start_stage_out(job_record_t *job_ptr)
  */
 extern int bb_p_job_test_post_run(job_record_t *job_ptr)
 {
-	return 1;
+	bb_job_t *bb_job;
+	int rc = -1;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return 1;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: %pJ", plugin_type, __func__, job_ptr);
+
+	if (bb_state.last_load_time == 0) {
+		info("%s: %s: Burst buffer down, can not post_run %pJ",
+		      plugin_type, __func__, job_ptr);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return -1;
+	}
+	bb_job = bb_job_find(&bb_state, job_ptr->job_id);
+	if (!bb_job) {
+		verbose("%s: %s: %pJ bb job record not found",
+			plugin_type, __func__, job_ptr);
+		rc =  1;
+	} else {
+		/* There is no post_run operation, stage-out follows */
+		if (bb_job->state < BB_STATE_POST_RUN) {
+			rc = -1;
+		} else {
+			rc =  1;
+		}
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return rc;
 }
 
 /*
@@ -273,7 +1679,47 @@ extern int bb_p_job_test_post_run(job_record_t *job_ptr)
  */
 extern int bb_p_job_test_stage_out(job_record_t *job_ptr)
 {
-	return 1;
+	bb_job_t *bb_job;
+	int rc = -1;
+
+	if ((job_ptr->burst_buffer == NULL) ||
+	    (job_ptr->burst_buffer[0] == '\0'))
+		return 1;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: %pJ", plugin_type, __func__, job_ptr);
+
+	if (bb_state.last_load_time == 0) {
+		info("%s: %s: Burst buffer down, can not stage-out %pJ",
+		      plugin_type, __func__, job_ptr);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return -1;
+	}
+	bb_job = bb_job_find(&bb_state, job_ptr->job_id);
+	if (!bb_job) {
+		verbose("%s: %s: %pJ bb job record not found",
+			plugin_type, __func__, job_ptr);
+		rc =  1;
+	} else {
+		if (bb_job->state == BB_STATE_PENDING) {
+			/*
+			 * No job BB work not started before job was killed.
+			 * Alternately slurmctld daemon restarted after the
+			 * job's BB work was completed.
+			 */
+			rc =  1;
+		} else if (bb_job->state < BB_STATE_POST_RUN) {
+			rc = -1;
+		} else if (bb_job->state > BB_STATE_STAGING_OUT) {
+			rc =  1;
+		} else {
+			rc =  0;
+		}
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return rc;
 }
 
 /*
@@ -283,14 +1729,110 @@ extern int bb_p_job_test_stage_out(job_record_t *job_ptr)
  */
 extern int bb_p_job_cancel(job_record_t *job_ptr)
 {
+	bb_job_t *bb_job;
+	bb_alloc_t *bb_alloc;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (bb_state.bb_config.debug_flag)
+		info("%s: %s: %pJ", plugin_type, __func__, job_ptr);
+
+	if (bb_state.last_load_time == 0) {
+		info("%s: %s: Burst buffer down, can not cancel %pJ",
+		      plugin_type, __func__, job_ptr);
+		slurm_mutex_unlock(&bb_state.bb_mutex);
+		return SLURM_ERROR;
+	}
+
+	bb_job = _get_bb_job(job_ptr);
+	if (!bb_job) {
+		/* Nothing ever allocated, nothing to clean up */
+	} else if (_stage_on_nodes()) {
+		/* slurmd drains the buffer when the job is terminated */
+		bb_job->state = BB_STATE_COMPLETE;
+	} else if (bb_job->state == BB_STATE_PENDING) {
+		bb_job->state = BB_STATE_COMPLETE;  /* Nothing to clean up */
+	} else if (bb_job->state < BB_STATE_TEARDOWN) {
+		/* Kill the stage-in or stage-out in progress, if any */
+		track_script_flush_job(job_ptr->job_id);
+		bb_job->state = BB_STATE_TEARDOWN;
+		bb_alloc = bb_find_alloc_rec(&bb_state, job_ptr);
+		if (bb_alloc) {
+			bb_alloc->state = BB_STATE_TEARDOWN;
+			bb_alloc->state_time = time(NULL);
+			bb_state.last_update_time = time(NULL);
+		}
+		_queue_teardown(job_ptr->job_id, job_ptr->user_id,
+				job_ptr->group_id);
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
 	return SLURM_SUCCESS;
 }
 
 /*
  * Translate a burst buffer string to it's equivalent TRES string
+ * (e.g. "cray:2G,generic:4M" -> "1004=2048,1005=4")
  * Caller must xfree the return value
  */
 extern char *bb_p_xlate_bb_2_tres_str(char *burst_buffer)
 {
-	return NULL;
+	char *save_ptr = NULL, *sep, *tmp, *tok;
+	char *result = NULL;
+	uint64_t size, total = 0;
+
+	if (!burst_buffer || (bb_state.tres_id < 1))
+		return result;
+
+	tmp = xstrdup(burst_buffer);
+	tok = strtok_r(tmp, ",", &save_ptr);
+	while (tok) {
+		sep = strchr(tok, ':');
+		if (sep) {
+			if (!xstrncmp(tok, "generic:", 8))
+				tok += 8;
+			else
+				tok = NULL;
+		}
+
+		if (tok) {
+			uint64_t mb_xlate = 1024 * 1024;
+			size = bb_get_size_num(tok,
+					       bb_state.bb_config.granularity);
+			total += (size + mb_xlate - 1) / mb_xlate;
+		}
+
+		tok = strtok_r(NULL, ",", &save_ptr);
+	}
+	xfree(tmp);
+
+	if (total)
+		xstrfmtcat(result, "%d=%"PRIu64, bb_state.tres_id, total);
+
+	return result;
+}
+
+/*
+ * Return the directory in which the slurmd daemons stage a job's files in
+ * and out, NULL if its burst buffer is not staged on the compute nodes
+ * IN stage_in - true for the stage-in limits, false for the stage-out ones
+ * OUT bandwidth - per node staging rate in bytes per second, 0 for no limit
+ * OUT timeout - staging time limit in seconds, 0 for no limit
+ * Caller must xfree the return value
+ */
+extern char *bb_p_job_get_node_dir(job_record_t *job_ptr, bool stage_in,
+				   uint64_t *bandwidth, uint32_t *timeout)
+{
+	char *job_dir = NULL;
+
+	slurm_mutex_lock(&bb_state.bb_mutex);
+	if (_stage_on_nodes() && bb_state.bb_config.directory &&
+	    _get_bb_job(job_ptr)) {
+		job_dir = _job_dir(job_ptr->job_id);
+		*bandwidth = bb_state.bb_config.stage_bandwidth;
+		*timeout = stage_in ? bb_state.bb_config.stage_in_timeout :
+				      bb_state.bb_config.stage_out_timeout;
+	}
+	slurm_mutex_unlock(&bb_state.bb_mutex);
+
+	return job_dir;
 }
@@ -94,6 +94,117 @@ const char plugin_name[] = "Job accounting gather cgroup plugin";
 const char plugin_type[] = "jobacct_gather/cgroup";
 const uint32_t plugin_version = SLURM_VERSION_NUMBER;
 
+/*
+ * On cgroup v2 hosts the task cgroups are read once per poll. /proc is only
+ * read for the fields a task cgroup does not provide.
+ */
+static bool cgroup_v2 = false;
+static bool need_vsize = false;
+static long hertz = 0;
+static cgroup_v2_stats_t *v2_stats = NULL;
+static int v2_stats_size = 0;
+static int v2_task_cnt = 0;
+
+static void _prec_extra_v2(jag_prec_t *prec, uint32_t taskid)
+{
+	cgroup_v2_stats_t *stats = NULL;
+	int i;
+
+	for (i = 0; i < v2_task_cnt; i++) {
+		if (v2_stats[i].taskid == taskid) {
+			stats = &v2_stats[i];
+			break;
+		}
+	}
+	if (!stats)
+		return;
+
+	if (stats->have_cpu) {
+		/* Unnormalized times, in clock ticks like /proc/<pid>/stat */
+		prec->usec = (double) stats->user_usec * hertz / 1000000;
+		prec->ssec = (double) stats->system_usec * hertz / 1000000;
+	}
+
+	if (stats->have_mem) {
+		prec->tres_data[TRES_ARRAY_MEM].size_read = stats->anon;
+		prec->tres_data[TRES_ARRAY_PAGES].size_read =
+			stats->pgmajfault;
+	}
+
+	/*
+	 * NOTE: io.stat counts block device I/O, unlike the rchar/wchar of
+	 * /proc/<pid>/io which include I/O satisfied from the page cache.
+	 */
+	if (stats->have_io) {
+		prec->tres_data[TRES_ARRAY_FS_DISK].size_read = stats->rbytes;
+		prec->tres_data[TRES_ARRAY_FS_DISK].size_write = stats->wbytes;
+	}
+}
+
+/*
+ * Read the cgroup of every task
+ * RET true if every cgroup provides all the fields, /proc is then not needed
+ */
+static bool _read_stats_v2(List task_list)
+{
+	struct jobacctinfo *jobacct;
+	ListIterator itr;
+	bool have_all = true;
+
+	v2_task_cnt = 0;
+	if (!task_list || !list_count(task_list))
+		return false;
+
+	if (v2_stats_size < list_count(task_list)) {
+		v2_stats_size = list_count(task_list);
+		xrecalloc(v2_stats, v2_stats_size, sizeof(cgroup_v2_stats_t));
+	}
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr)) && (v2_task_cnt < v2_stats_size)) {
+		cgroup_v2_stats_t *stats = &v2_stats[v2_task_cnt++];
+
+		jobacct_gather_cgroup_v2_read_stats(jobacct->id.taskid, stats);
+		if (!stats->have_cpu || !stats->have_mem || !stats->have_io)
+			have_all = false;
+	}
+	list_iterator_destroy(itr);
+
+	return have_all;
+}
+
+/*
+ * _get_precs_v2() - One record per task with nothing read from /proc, used
+ * when the task cgroups provide every field
+ */
+static List _get_precs_v2(List task_list, bool pgid_plugin, uint64_t cont_id,
+			  jag_callbacks_t *callbacks)
+{
+	List prec_list = list_create(destroy_jag_prec);
+	struct jobacctinfo *jobacct;
+	ListIterator itr;
+	jag_prec_t *prec;
+	int i;
+
+	itr = list_iterator_create(task_list);
+	while ((jobacct = list_next(itr))) {
+		prec = xmalloc(sizeof(jag_prec_t));
+		prec->pid = jobacct->pid;
+		prec->tres_count = jobacct->tres_count;
+		prec->tres_data = xcalloc(prec->tres_count,
+					  sizeof(acct_gather_data_t));
+		for (i = 0; i < prec->tres_count; i++) {
+			prec->tres_data[i].num_reads = INFINITE64;
+			prec->tres_data[i].num_writes = INFINITE64;
+			prec->tres_data[i].size_read = INFINITE64;
+			prec->tres_data[i].size_write = INFINITE64;
+		}
+		list_append(prec_list, prec);
+	}
+	list_iterator_destroy(itr);
+
+	return prec_list;
+}
+
 static void _prec_extra(jag_prec_t *prec, uint32_t taskid)
 {
 	unsigned long utime, stime, total_rss, total_pgpgin;
@@ -232,6 +343,20 @@ extern int init (void)
 			return SLURM_ERROR;
 		}
 
+		if (jobacct_gather_cgroup_v2_available()) {
+			cgroup_v2 = true;
+			if ((hertz = sysconf(_SC_CLK_TCK)) < 1)
+				hertz = 100;
+			/* VMem limits need /proc, cgroups have no vsize */
+			need_vsize = (slurm_get_vsize_factor() != 0);
+			debug("%s: using cgroup v2 step statistics", __func__);
+			if (jobacct_gather_cgroup_v2_init() != SLURM_SUCCESS) {
+				xcpuinfo_fini();
+				return SLURM_ERROR;
+			}
+			goto done;
+		}
+
 		/* enable cpuacct cgroup subsystem */
 		if (jobacct_gather_cgroup_cpuacct_init() != SLURM_SUCCESS) {
 			xcpuinfo_fini();
@@ -255,13 +380,19 @@ extern int init (void)
 		/* } */
 	}
 
+done:
 	debug("%s loaded", plugin_name);
 	return SLURM_SUCCESS;
 }
 
 extern int fini (void)
 {
-	if (running_in_slurmstepd()) {
+	if (running_in_slurmstepd() && cgroup_v2) {
+		jobacct_gather_cgroup_v2_fini();
+		xfree(v2_stats);
+		v2_stats_size = 0;
+		acct_gather_energy_fini();
+	} else if (running_in_slurmstepd()) {
 		jobacct_gather_cgroup_cpuacct_fini();
 		jobacct_gather_cgroup_memory_fini();
 		/* jobacct_gather_cgroup_blkio_fini(); */
@@ -299,6 +430,16 @@ extern void jobacct_gather_p_poll_data(
 		callbacks.prec_extra = _prec_extra;
 	}
 
+	if (cgroup_v2) {
+		bool have_all = _read_stats_v2(task_list);
+
+		callbacks.prec_extra = v2_task_cnt ? _prec_extra_v2 : NULL;
+		if (have_all && !need_vsize)
+			callbacks.get_precs = _get_precs_v2;
+		else
+			callbacks.get_precs = NULL;
+	}
+
 	jag_common_poll_data(task_list, pgid_plugin, cont_id, &callbacks,
 			     profile);
 
@@ -314,6 +455,9 @@ extern int jobacct_gather_p_endpoll(void)
 
 extern int jobacct_gather_p_add_task(pid_t pid, jobacct_id_t *jobacct_id)
 {
+	if (cgroup_v2)
+		return jobacct_gather_cgroup_v2_attach_task(pid, jobacct_id);
+
 	if (jobacct_gather_cgroup_cpuacct_attach_task(pid, jobacct_id) !=
 	    SLURM_SUCCESS)
 		return SLURM_ERROR;
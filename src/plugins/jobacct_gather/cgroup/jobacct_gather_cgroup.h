@@ -55,6 +55,20 @@ typedef struct task_cg_info {
 extern List task_memory_cg_list;
 extern List task_cpuacct_cg_list;
 
+/* Counters read from the cgroup v2 stat files of a task */
+typedef struct cgroup_v2_stats {
+	uint32_t taskid;
+	bool have_cpu;		/* cpu.stat */
+	uint64_t user_usec;
+	uint64_t system_usec;
+	bool have_mem;		/* memory.stat */
+	uint64_t anon;
+	uint64_t pgmajfault;
+	bool have_io;		/* io.stat */
+	uint64_t rbytes;
+	uint64_t wbytes;
+} cgroup_v2_stats_t;
+
 extern int jobacct_gather_cgroup_cpuacct_init(void);
 
 extern int jobacct_gather_cgroup_cpuacct_fini(void);
@@ -69,6 +83,20 @@ extern int jobacct_gather_cgroup_memory_fini(void);
 extern int jobacct_gather_cgroup_memory_attach_task(
 	pid_t pid, jobacct_id_t *jobacct_id);
 
+/* True if CgroupMountpoint holds the cgroup v2 unified hierarchy */
+extern bool jobacct_gather_cgroup_v2_available(void);
+
+extern int jobacct_gather_cgroup_v2_init(void);
+
+extern int jobacct_gather_cgroup_v2_fini(void);
+
+extern int jobacct_gather_cgroup_v2_attach_task(
+	pid_t pid, jobacct_id_t *jobacct_id);
+
+/* Read the counters of a task cgroup, one read per stat file */
+extern void jobacct_gather_cgroup_v2_read_stats(uint32_t taskid,
+						cgroup_v2_stats_t *stats);
+
 /* FIXME: Enable when kernel support ready. */
  /* extern xcgroup_t task_blkio_cg; */
 /* extern int jobacct_gather_cgroup_blkio_init( */
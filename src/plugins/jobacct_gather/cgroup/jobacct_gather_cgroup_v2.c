@@ -0,0 +1,346 @@
+/*****************************************************************************\
+ *  jobacct_gather_cgroup_v2.c - step level statistics from the cgroup v2
+ *  unified hierarchy for jobacct_gather/cgroup
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <limits.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "slurm/slurm_errno.h"
+#include "slurm/slurm.h"
+#include "src/common/xstring.h"
+#include "src/plugins/jobacct_gather/cgroup/jobacct_gather_cgroup.h"
+#include "src/slurmd/slurmstepd/slurmstepd_job.h"
+#include "src/slurmd/slurmd/slurmd.h"
+
+/*
+ * In the unified hierarchy every controller shares one tree, so a single
+ * uid_%u/job_%u/step_%u/task_%u leaf per task gives the task's cpu.stat,
+ * memory.stat and io.stat. Processes may only live in leaves, the step
+ * cgroup only enables the controllers of its task cgroups. The leaf of an
+ * exited task keeps its counters until the step ends.
+ */
+static xcgroup_ns_t unified_ns;
+
+static xcgroup_t user_cg;
+static xcgroup_t job_cg;
+static xcgroup_t step_cg;
+static bool step_cg_created = false;
+static List task_v2_cg_list = NULL;
+
+/* Enable controllers for the children of cg, missing ones are skipped */
+static void _enable_controllers(xcgroup_t *cg)
+{
+	char *ctrl[] = { "+cpu", "+memory", "+io", NULL };
+	int i;
+
+	for (i = 0; ctrl[i]; i++)
+		xcgroup_set_param(cg, "cgroup.subtree_control", ctrl[i]);
+}
+
+/* Value of the "<key> <value>" line of a flat keyed file like memory.stat */
+static bool _get_key_value(char *content, const char *key, uint64_t *value)
+{
+	size_t len = strlen(key);
+	char *ptr = content;
+
+	while (ptr && *ptr) {
+		if (!strncmp(ptr, key, len) && (ptr[len] == ' ')) {
+			*value = strtoull(ptr + len + 1, NULL, 10);
+			return true;
+		}
+		if ((ptr = strchr(ptr, '\n')))
+			ptr++;
+	}
+
+	return false;
+}
+
+/* Sum "<key>=<value>" over all the devices of io.stat */
+static uint64_t _sum_io_value(char *content, const char *key)
+{
+	size_t len = strlen(key);
+	uint64_t sum = 0;
+	char *ptr = content;
+
+	while ((ptr = strstr(ptr, key))) {
+		if (((ptr == content) || (ptr[-1] == ' ')) &&
+		    (ptr[len] == '='))
+			sum += strtoull(ptr + len + 1, NULL, 10);
+		ptr += len;
+	}
+
+	return sum;
+}
+
+extern bool jobacct_gather_cgroup_v2_available(void)
+{
+	slurm_cgroup_conf_t *cg_conf;
+	struct stat st;
+	char *file = NULL;
+	bool rc;
+
+	slurm_mutex_lock(&xcgroup_config_read_mutex);
+	cg_conf = xcgroup_get_slurm_cgroup_conf();
+	file = xstrdup_printf("%s/cgroup.controllers",
+			      cg_conf->cgroup_mountpoint);
+	slurm_mutex_unlock(&xcgroup_config_read_mutex);
+
+	rc = (stat(file, &st) == 0);
+	xfree(file);
+
+	return rc;
+}
+
+extern int jobacct_gather_cgroup_v2_init(void)
+{
+	slurm_cgroup_conf_t *cg_conf;
+
+	/* The unified hierarchy is mounted as a whole, never by us */
+	slurm_mutex_lock(&xcgroup_config_read_mutex);
+	cg_conf = xcgroup_get_slurm_cgroup_conf();
+	unified_ns.mnt_point = xstrdup(cg_conf->cgroup_mountpoint);
+	slurm_mutex_unlock(&xcgroup_config_read_mutex);
+	unified_ns.mnt_args = xstrdup("");
+	unified_ns.subsystems = xstrdup("unified");
+
+	FREE_NULL_LIST(task_v2_cg_list);
+	task_v2_cg_list = list_create(free_task_cg_info);
+
+	return SLURM_SUCCESS;
+}
+
+/* Remove the cgroup of a task, called from list_for_each() */
+static int _delete_task_cg(void *x, void *arg)
+{
+	task_cg_info_t *task_cg_info = x;
+
+	if (xcgroup_delete(&task_cg_info->task_cg) != XCGROUP_SUCCESS)
+		debug2("%s: failed to delete %s %m", __func__,
+		       task_cg_info->task_cg.path);
+
+	return 0;
+}
+
+extern int jobacct_gather_cgroup_v2_fini(void)
+{
+	/* Remove the leaves first, the parents may still hold other steps */
+	if (task_v2_cg_list)
+		(void) list_for_each(task_v2_cg_list, _delete_task_cg, NULL);
+	FREE_NULL_LIST(task_v2_cg_list);
+	if (step_cg_created) {
+		if (xcgroup_delete(&step_cg) != XCGROUP_SUCCESS)
+			debug2("%s: failed to delete %s %m", __func__,
+			       step_cg.path);
+		if (xcgroup_delete(&job_cg) != XCGROUP_SUCCESS)
+			debug2("%s: failed to delete %s %m", __func__,
+			       job_cg.path);
+		if (xcgroup_delete(&user_cg) != XCGROUP_SUCCESS)
+			debug2("%s: failed to delete %s %m", __func__,
+			       user_cg.path);
+		xcgroup_destroy(&user_cg);
+		xcgroup_destroy(&job_cg);
+		xcgroup_destroy(&step_cg);
+		step_cg_created = false;
+	}
+
+	xcgroup_ns_destroy(&unified_ns);
+
+	return SLURM_SUCCESS;
+}
+
+static int _create_step_cg(stepd_step_rec_t *job)
+{
+	xcgroup_t slurm_cg;
+	char *slurm_cgpath, *path = NULL;
+	uint32_t jobid;
+	int rc = SLURM_ERROR;
+
+	if (job->pack_jobid && (job->pack_jobid != NO_VAL))
+		jobid = job->pack_jobid;
+	else
+		jobid = job->jobid;
+
+	/* create slurm root cg in this cg namespace */
+	if (!(slurm_cgpath = jobacct_cgroup_create_slurm_cg(&unified_ns)))
+		return SLURM_ERROR;
+	if (xcgroup_create(&unified_ns, &slurm_cg, slurm_cgpath, 0, 0) ==
+	    XCGROUP_SUCCESS) {
+		_enable_controllers(&slurm_cg);
+		xcgroup_destroy(&slurm_cg);
+	}
+
+	xstrfmtcat(path, "%s/uid_%u", slurm_cgpath, job->uid);
+	if ((xcgroup_create(&unified_ns, &user_cg, path, job->uid, job->gid)
+	     != XCGROUP_SUCCESS) ||
+	    (xcgroup_instantiate(&user_cg) != XCGROUP_SUCCESS)) {
+		error("jobacct_gather/cgroup: unable to instantiate user %u "
+		      "cgroup", job->uid);
+		xcgroup_destroy(&user_cg);
+		goto fini;
+	}
+	_enable_controllers(&user_cg);
+
+	xstrfmtcat(path, "/job_%u", jobid);
+	if ((xcgroup_create(&unified_ns, &job_cg, path, job->uid, job->gid)
+	     != XCGROUP_SUCCESS) ||
+	    (xcgroup_instantiate(&job_cg) != XCGROUP_SUCCESS)) {
+		error("jobacct_gather/cgroup: unable to instantiate job %u "
+		      "cgroup", jobid);
+		xcgroup_destroy(&user_cg);
+		xcgroup_destroy(&job_cg);
+		goto fini;
+	}
+	_enable_controllers(&job_cg);
+
+	if (job->stepid == SLURM_BATCH_SCRIPT)
+		xstrcat(path, "/step_batch");
+	else if (job->stepid == SLURM_EXTERN_CONT)
+		xstrcat(path, "/step_extern");
+	else
+		xstrfmtcat(path, "/step_%u", job->stepid);
+	if ((xcgroup_create(&unified_ns, &step_cg, path, job->uid, job->gid)
+	     != XCGROUP_SUCCESS) ||
+	    (xcgroup_instantiate(&step_cg) != XCGROUP_SUCCESS)) {
+		error("jobacct_gather/cgroup: unable to instantiate jobstep "
+		      "%u.%u cgroup", jobid, job->stepid);
+		xcgroup_destroy(&user_cg);
+		xcgroup_destroy(&job_cg);
+		xcgroup_destroy(&step_cg);
+		goto fini;
+	}
+	_enable_controllers(&step_cg);
+
+	step_cg_created = true;
+	rc = SLURM_SUCCESS;
+fini:
+	xfree(path);
+	xfree(slurm_cgpath);
+	return rc;
+}
+
+extern int jobacct_gather_cgroup_v2_attach_task(pid_t pid,
+						jobacct_id_t *jobacct_id)
+{
+	stepd_step_rec_t *job = jobacct_id->job;
+	uint32_t taskid = jobacct_id->taskid;
+	task_cg_info_t *task_cg_info;
+	char *path;
+
+	if (!step_cg_created && (_create_step_cg(job) != SLURM_SUCCESS))
+		return SLURM_ERROR;
+
+	if (!(task_cg_info = list_find_first(task_v2_cg_list,
+					     find_task_cg_info, &taskid))) {
+		task_cg_info = xmalloc(sizeof(*task_cg_info));
+		task_cg_info->taskid = taskid;
+		path = xstrdup_printf("%s/task_%u", step_cg.name, taskid);
+		if (xcgroup_create(&unified_ns, &task_cg_info->task_cg, path,
+				   job->uid, job->gid) != XCGROUP_SUCCESS) {
+			error("jobacct_gather/cgroup: unable to create task %u "
+			      "cgroup", taskid);
+			/* Don't use free_task_cg_info as the task_cg isn't there */
+			xfree(task_cg_info);
+			xfree(path);
+			return SLURM_ERROR;
+		}
+		xfree(path);
+		if (xcgroup_instantiate(&task_cg_info->task_cg) !=
+		    XCGROUP_SUCCESS) {
+			error("jobacct_gather/cgroup: unable to instantiate "
+			      "task %u cgroup", taskid);
+			free_task_cg_info(task_cg_info);
+			return SLURM_ERROR;
+		}
+		list_append(task_v2_cg_list, task_cg_info);
+	}
+
+	if (xcgroup_add_pids(&task_cg_info->task_cg, &pid, 1) !=
+	    XCGROUP_SUCCESS) {
+		error("jobacct_gather/cgroup: unable to add task %u to cg '%s'",
+		      taskid, task_cg_info->task_cg.path);
+		return SLURM_ERROR;
+	}
+
+	return SLURM_SUCCESS;
+}
+
+extern void jobacct_gather_cgroup_v2_read_stats(uint32_t taskid,
+						cgroup_v2_stats_t *stats)
+{
+	task_cg_info_t *task_cg_info;
+	xcgroup_t *task_cg;
+	char *content = NULL;
+	size_t size = 0;
+
+	memset(stats, 0, sizeof(cgroup_v2_stats_t));
+	stats->taskid = taskid;
+	if (!task_v2_cg_list ||
+	    !(task_cg_info = list_find_first(task_v2_cg_list,
+					     find_task_cg_info, &taskid)))
+		return;
+	task_cg = &task_cg_info->task_cg;
+
+	if ((xcgroup_get_param(task_cg, "cpu.stat", &content, &size) ==
+	     XCGROUP_SUCCESS) && content) {
+		stats->have_cpu =
+			_get_key_value(content, "user_usec",
+				       &stats->user_usec) &&
+			_get_key_value(content, "system_usec",
+				       &stats->system_usec);
+	}
+	xfree(content);
+
+	if ((xcgroup_get_param(task_cg, "memory.stat", &content, &size) ==
+	     XCGROUP_SUCCESS) && content) {
+		/* anon is the cgroup v2 counterpart of v1 total_rss */
+		stats->have_mem =
+			_get_key_value(content, "anon", &stats->anon) &&
+			_get_key_value(content, "pgmajfault",
+				       &stats->pgmajfault);
+	}
+	xfree(content);
+
+	/* io.stat is empty until the task does block I/O */
+	if (xcgroup_get_param(task_cg, "io.stat", &content, &size) ==
+	    XCGROUP_SUCCESS) {
+		stats->have_io = true;
+		if (content) {
+			stats->rbytes = _sum_io_value(content, "rbytes");
+			stats->wbytes = _sum_io_value(content, "wbytes");
+		}
+	}
+	xfree(content);
+}
@@ -40,7 +40,9 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <signal.h>
+#include <sys/resource.h>
 #include <time.h>
 #include <ctype.h>
 
@@ -52,6 +54,7 @@
 #include "src/common/slurm_acct_gather_energy.h"
 #include "src/common/slurm_acct_gather_filesystem.h"
 #include "src/common/slurm_acct_gather_interconnect.h"
+#include "src/common/xhash.h"
 #include "src/common/xstring.h"
 #include "src/slurmd/common/proctrack.h"
 
@@ -78,6 +81,29 @@ static DIR  *slash_proc = NULL;
 static int energy_profile = ENERGY_DATA_NODE_ENERGY_UP;
 static uint64_t debug_flags = 0;
 
+/*
+ * Processes seen by the previous polls, keyed by pid. Their /proc files are
+ * kept open and reread with pread() and their records are reused, rather
+ * than opening, reading and closing each file and allocating each record
+ * on every poll. Processes not seen by a poll are removed.
+ */
+typedef struct {
+	pid_t pid;
+	int stat_fd;
+	int statm_fd;
+	int io_fd;
+	int lwp;		/* _is_a_lwp() of the process, -1 if unknown */
+	unsigned long starttime; /* tells a recycled pid from the process */
+	uint32_t seen;		/* poll_gen when last listed */
+	uint32_t valid;		/* poll_gen when prec was last filled in */
+	jag_prec_t prec;
+} jag_proc_t;
+
+static xhash_t *proc_hash = NULL;
+static uint32_t poll_gen = 0;
+static int proc_fd_cnt = 0;		/* open files of proc_hash */
+static int proc_fd_max = 0;
+
 static int _find_prec(void *x, void *key)
 {
 	jag_prec_t *prec = (jag_prec_t *) x;
@@ -304,91 +330,80 @@ again:
 	}
 }
 
-/* _get_process_data_line() - get line of data from /proc/<pid>/stat
+/* Fields of /proc/<pid>/stat, counted from ppid (the 4th field) onwards */
+enum {
+	STAT_PPID = 0,
+	STAT_MAJFLT = 8,
+	STAT_UTIME = 10,
+	STAT_STIME = 11,
+	STAT_STARTTIME = 18,
+	STAT_VSIZE = 19,
+	STAT_RSS = 20,
+	STAT_PROCESSOR = 35,
+	STAT_FIELD_CNT
+};
+
+/* _get_process_data_line() - parse the content of /proc/<pid>/stat
  *
- * IN:	in - input file descriptor
+ * IN:	sbuf - NUL terminated content of the file
  * OUT:	prec - the destination for the data
+ * OUT:	starttime - start time of the process, identifies reused pids
  *
  * RETVAL:	==0 - no valid data
  * 		!=0 - data are valid
  *
  * Based upon stat2proc() from the ps command. It can handle arbitrary
  * executable file basenames for `cmd', i.e. those with embedded whitespace or
- * embedded ')'s. Such names confuse %s (see scanf(3)), so the string is split
- * and %39c is used instead. (except for embedded ')' "(%[^)]c)" would work.
+ * embedded ')'s, by parsing only what follows the last ')'. The numeric
+ * fields are parsed in place, without sscanf() or any allocation.
  */
-static int _get_process_data_line(int in, jag_prec_t *prec) {
-	char sbuf[512], *tmp;
-	int num_read, nvals;
-	char cmd[40], state[1];
-	int ppid, pgrp, session, tty_nr, tpgid;
-	long unsigned flags, minflt, cminflt, majflt, cmajflt;
-	long unsigned utime, stime, starttime, vsize;
-	long int cutime, cstime, priority, nice, timeout, itrealvalue, rss;
-	long unsigned f1, f2, f3, f4, f5, f6, f7, f8, f9, f10, f11, f12, f13;
-	int exit_signal, last_cpu;
-
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
-
-	/*
-	 * split into "PID (cmd" and "<rest>" replace trailing ')' with NULL
-	 */
-	tmp = strrchr(sbuf, ')');
-	if (!tmp)
-		return 0;
-	*tmp = '\0';
+static int _get_process_data_line(char *sbuf, jag_prec_t *prec,
+				  unsigned long *starttime)
+{
+	unsigned long val[STAT_FIELD_CNT];
+	char *ptr, *end;
+	int i;
 
-	/* parse these two strings separately, skipping the leading "(". */
-	nvals = sscanf(sbuf, "%d (%39c", &prec->pid, cmd);
-	if (nvals < 2)
-		return 0;
+	prec->pid = strtol(sbuf, NULL, 10);
 
-	nvals = sscanf(tmp + 2,	 /* skip space after ')' too */
-		       "%c %d %d %d %d %d "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %ld %ld %ld %ld "
-		       "%ld %ld %lu %lu %ld "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %lu %lu "
-		       "%lu %lu %lu %d %d ",
-		       state, &ppid, &pgrp, &session, &tty_nr, &tpgid,
-		       &flags, &minflt, &cminflt, &majflt, &cmajflt,
-		       &utime, &stime, &cutime, &cstime, &priority, &nice,
-		       &timeout, &itrealvalue, &starttime, &vsize, &rss,
-		       &f1, &f2, &f3, &f4, &f5 ,&f6, &f7, &f8, &f9, &f10, &f11,
-		       &f12, &f13, &exit_signal, &last_cpu);
-	/* There are some additional fields, which we do not scan or use */
-	if ((nvals < 37) || (rss < 0))
+	/* skip ") <state> " after the last ')' */
+	if (!(ptr = strrchr(sbuf, ')')) || (ptr[1] != ' ') || !ptr[2] ||
+	    (ptr[3] != ' '))
 		return 0;
-
-	/* If current pid corresponds to a Light Weight Process (Thread POSIX) */
-	/* skip it, we will only account the original process (pid==tgid) */
-	if (_is_a_lwp(prec->pid) > 0)
+	ptr += 4;
+
+	/* There are some additional fields, which we do not parse or use */
+	for (i = 0; i < STAT_FIELD_CNT; i++) {
+		val[i] = strtoul(ptr, &end, 10);
+		if (end == ptr)
+			return 0;
+		ptr = end;
+	}
+	if ((long) val[STAT_RSS] < 0)
 		return 0;
 
 	/* Copy the values that slurm records into our data structure */
-	prec->ppid  = ppid;
+	prec->ppid  = val[STAT_PPID];
 
-	prec->tres_data[TRES_ARRAY_PAGES].size_read = majflt;
-	prec->tres_data[TRES_ARRAY_VMEM].size_read = vsize;
-	prec->tres_data[TRES_ARRAY_MEM].size_read = rss * my_pagesize;
+	prec->tres_data[TRES_ARRAY_PAGES].size_read = val[STAT_MAJFLT];
+	prec->tres_data[TRES_ARRAY_VMEM].size_read = val[STAT_VSIZE];
+	prec->tres_data[TRES_ARRAY_MEM].size_read =
+		val[STAT_RSS] * my_pagesize;
 
 	/*
 	 * Store unnormalized times, we will normalize in when
 	 * transfering to a struct jobacctinfo in job_common_poll_data()
 	 */
-	prec->usec = (double)utime;
-	prec->ssec = (double)stime;
-	prec->last_cpu = last_cpu;
+	prec->usec = (double) val[STAT_UTIME];
+	prec->ssec = (double) val[STAT_STIME];
+	prec->last_cpu = val[STAT_PROCESSOR];
+	*starttime = val[STAT_STARTTIME];
 	return 1;
 }
 
-/* _get_process_memory_line() - get line of data from /proc/<pid>/statm
+/* _get_process_memory_line() - parse the content of /proc/<pid>/statm
  *
- * IN:	in - input file descriptor
+ * IN:	sbuf - NUL terminated content of the file
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -399,22 +414,16 @@ static int _get_process_data_line(int in, jag_prec_t *prec) {
  * and return the updated struct.
  *
  */
-static int _get_process_memory_line(int in, jag_prec_t *prec)
+static int _get_process_memory_line(char *sbuf, jag_prec_t *prec)
 {
-	char sbuf[256];
-	int num_read, nvals;
-	long int size, rss, share, text, lib, data, dt;
-
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
-		return 0;
-	sbuf[num_read] = '\0';
-
-	nvals = sscanf(sbuf,
-		       "%ld %ld %ld %ld %ld %ld %ld",
-		       &size, &rss, &share, &text, &lib, &data, &dt);
-	/* There are some additional fields, which we do not scan or use */
-	if (nvals != 7)
+	long int rss, share;
+	char *ptr = sbuf, *end;
+
+	(void) strtol(ptr, &end, 10);		/* size */
+	rss = strtol(end, &ptr, 10);
+	share = strtol(ptr, &end, 10);
+	/* There are some additional fields, which we do not parse or use */
+	if (end == ptr)
 		return 0;
 
 	/* If shared > rss then there is a problem, give up... */
@@ -425,32 +434,14 @@ static int _get_process_memory_line(int in, jag_prec_t *prec)
 
 	/* Copy the values that slurm records into our data structure */
 	prec->tres_data[TRES_ARRAY_MEM].size_read =
-		(rss - share) * my_pagesize;;
+		(rss - share) * my_pagesize;
 
 	return 1;
 }
 
-static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
-{
-	FILE *statm_fp = NULL;
-	char proc_statm_file[256];	/* Allow ~20x extra length */
-	int rc = 0, fd;
-
-	snprintf(proc_statm_file, sizeof(proc_statm_file), "%sm",
-		 proc_stat_file);
-	if (!(statm_fp = fopen(proc_statm_file, "r")))
-		return rc;  /* Assume the process went away */
-	fd = fileno(statm_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_statm_file);
-	rc = _get_process_memory_line(fd, prec);
-	fclose(statm_fp);
-	return rc;
-}
-
-/* _get_process_io_data_line() - get line of data from /proc/<pid>/io
+/* _get_process_io_data_line() - parse the content of /proc/<pid>/io
  *
- * IN:	in - input file descriptor
+ * IN:	sbuf - NUL terminated content of the file
  * OUT:	prec - the destination for the data
  *
  * RETVAL:	==0 - no valid data
@@ -461,24 +452,17 @@ static int _remove_share_data(char *proc_stat_file, jag_prec_t *prec)
  * wrchar: <# of characters written>
  *   . . .
  */
-static int _get_process_io_data_line(int in, jag_prec_t *prec) {
-	char sbuf[256];
-	char f1[7], f3[7];
-	int num_read, nvals;
+static int _get_process_io_data_line(char *sbuf, jag_prec_t *prec)
+{
+	char *ptr;
 	uint64_t rchar, wchar;
 
-	num_read = read(in, sbuf, (sizeof(sbuf) - 1));
-	if (num_read <= 0)
+	if (!(ptr = strchr(sbuf, ':')))
 		return 0;
-	sbuf[num_read] = '\0';
-
-	nvals = sscanf(sbuf, "%s %"PRIu64" %s %"PRIu64"",
-		       f1, &rchar, f3, &wchar);
-	if (nvals < 4)
-		return 0;
-
-	if (_is_a_lwp(prec->pid) > 0)
+	rchar = strtoull(ptr + 1, &ptr, 10);
+	if (!(ptr = strchr(ptr, ':')))
 		return 0;
+	wchar = strtoull(ptr + 1, NULL, 10);
 
 	/* keep real value here since we aren't doubles */
 	prec->tres_data[TRES_ARRAY_FS_DISK].size_read = rchar;
@@ -487,17 +471,114 @@ static int _get_process_io_data_line(int in, jag_prec_t *prec) {
 	return 1;
 }
 
-static void _handle_stats(List prec_list, char *proc_stat_file,
-			  char *proc_io_file, char *proc_smaps_file,
+static void _proc_id(void *item, const char **key, uint32_t *key_len)
+{
+	jag_proc_t *proc = (jag_proc_t *) item;
+
+	*key = (const char *) &proc->pid;
+	*key_len = sizeof(pid_t);
+}
+
+static void _close_proc_fd(int *fd)
+{
+	if (*fd < 0)
+		return;
+	close(*fd);
+	*fd = -1;
+	proc_fd_cnt--;
+}
+
+static void _free_proc(void *item)
+{
+	jag_proc_t *proc = (jag_proc_t *) item;
+
+	_close_proc_fd(&proc->stat_fd);
+	_close_proc_fd(&proc->statm_fd);
+	_close_proc_fd(&proc->io_fd);
+	xfree(proc->prec.tres_data);
+	xfree(proc);
+}
+
+/* Remove the processes which were not listed in this poll */
+static void _sweep_proc(void *item, void *arg)
+{
+	jag_proc_t *proc = (jag_proc_t *) item;
+
+	if (proc->seen != poll_gen)
+		xhash_delete(proc_hash, (const char *) &proc->pid,
+			     sizeof(pid_t));
+}
+
+/* Return the prec filled in for pid by this poll, NULL if there is none */
+static jag_prec_t *_get_proc_prec(pid_t pid)
+{
+	jag_proc_t *proc;
+
+	proc = xhash_get(proc_hash, (const char *) &pid, sizeof(pid_t));
+	if (!proc || (proc->valid != poll_gen))
+		return NULL;
+	return &proc->prec;
+}
+
+/*
+ * _read_proc_file() - read /proc/<pid>/<name> into sbuf
+ *
+ * The file is reread with pread() on *fd if that is open. Otherwise it is
+ * opened, and kept open in *fd for the next poll while fewer than
+ * proc_fd_max files are open.
+ *
+ * RET: bytes read, sbuf is NUL terminated; -1 if the process went away
+ */
+static ssize_t _read_proc_file(pid_t pid, const char *name, int *fd,
+			       char *sbuf, size_t size)
+{
+	char path[64];
+	ssize_t n;
+	int tmp_fd;
+
+	if (*fd >= 0) {
+		if ((n = pread(*fd, sbuf, size - 1, 0)) > 0) {
+			sbuf[n] = '\0';
+			return n;
+		}
+		/* The process exited, its pid may have been reused since */
+		_close_proc_fd(fd);
+	}
+
+	snprintf(path, sizeof(path), "/proc/%d/%s", pid, name);
+	/*
+	 * Close the file on exec() of user tasks, which may be forked while
+	 * it is open.
+	 */
+	if ((tmp_fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	if ((n = read(tmp_fd, sbuf, size - 1)) <= 0) {
+		close(tmp_fd);
+		return -1;
+	}
+	sbuf[n] = '\0';
+
+	if (proc_fd_cnt < proc_fd_max) {
+		*fd = tmp_fd;
+		proc_fd_cnt++;
+	} else
+		close(tmp_fd);
+
+	return n;
+}
+
+static void _handle_stats(List prec_list, pid_t pid,
 			  jag_callbacks_t *callbacks,
 			  int tres_count)
 {
 	static int no_share_data = -1;
 	static int use_pss = -1;
-	FILE *stat_fp = NULL;
-	FILE *io_fp = NULL;
-	int fd, fd2, i;
-	jag_prec_t *prec = NULL;
+	char sbuf[512];
+	unsigned long starttime = 0;
+	acct_gather_data_t *tres_data;
+	jag_proc_t *proc;
+	jag_prec_t *prec;
+	int i;
 
 	if (no_share_data == -1) {
 		char *acct_params = slurm_get_jobacct_gather_params();
@@ -513,23 +594,19 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 		xfree(acct_params);
 	}
 
-	if (!(stat_fp = fopen(proc_stat_file, "r")))
-		return;  /* Assume the process went away */
-	/*
-	 * Close the file on exec() of user tasks.
-	 *
-	 * NOTE: If we fork() slurmstepd after the
-	 * fopen() above and before the fcntl() below,
-	 * then the user task may have this extra file
-	 * open, which can cause problems for
-	 * checkpoint/restart, but this should be a very rare
-	 * problem in practice.
-	 */
-	fd = fileno(stat_fp);
-	if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1)
-		error("%s: fcntl(%s): %m", __func__, proc_stat_file);
+	if (!(proc = xhash_get(proc_hash, (const char *) &pid,
+			       sizeof(pid_t)))) {
+		proc = xmalloc(sizeof(jag_proc_t));
+		proc->pid = pid;
+		proc->stat_fd = proc->statm_fd = proc->io_fd = -1;
+		proc->lwp = -1;
+		xhash_add(proc_hash, proc);
+	}
+	proc->seen = poll_gen;
 
-	prec = xmalloc(sizeof(jag_prec_t));
+	if (_read_proc_file(pid, "stat", &proc->stat_fd, sbuf,
+			    sizeof(sbuf)) < 0)
+		return;  /* Assume the process went away */
 
 	if (!tres_count) {
 		assoc_mgr_lock_t locks = {
@@ -540,9 +617,14 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 		assoc_mgr_unlock(&locks);
 	}
 
+	/* Reuse the record of the previous poll */
+	prec = &proc->prec;
+	tres_data = prec->tres_data;
+	if (prec->tres_count != tres_count)
+		xrealloc(tres_data, tres_count * sizeof(acct_gather_data_t));
+	memset(prec, 0, sizeof(jag_prec_t));
 	prec->tres_count = tres_count;
-	prec->tres_data = xmalloc(prec->tres_count *
-				  sizeof(acct_gather_data_t));
+	prec->tres_data = tres_data;
 
 	/* Initialize read/writes */
 	for (i = 0; i < prec->tres_count; i++) {
@@ -552,13 +634,21 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 		prec->tres_data[i].size_write = INFINITE64;
 	}
 
-	if (!_get_process_data_line(fd, prec)) {
-		xfree(prec->tres_data);
-		xfree(prec);
-		fclose(stat_fp);
+	if (!_get_process_data_line(sbuf, prec, &starttime))
 		return;
+
+	/* A new process with a recycled pid */
+	if (proc->starttime != starttime) {
+		proc->starttime = starttime;
+		proc->lwp = -1;
 	}
-	fclose(stat_fp);
+
+	/* If current pid corresponds to a Light Weight Process (Thread POSIX) */
+	/* skip it, we will only account the original process (pid==tgid) */
+	if (proc->lwp == -1)
+		proc->lwp = (_is_a_lwp(pid) > 0);
+	if (proc->lwp)
+		return;
 
 	if (acct_gather_filesystem_g_get_data(prec->tres_data) < 0) {
 		debug2("problem retrieving filesystem data");
@@ -569,42 +659,54 @@ static void _handle_stats(List prec_list, char *proc_stat_file,
 	}
 
 	/* Remove shared data from rss */
-	if (no_share_data)
-		_remove_share_data(proc_stat_file, prec);
+	if (no_share_data &&
+	    (_read_proc_file(pid, "statm", &proc->statm_fd, sbuf,
+			     sizeof(sbuf)) > 0))
+		_get_process_memory_line(sbuf, prec);
 
 	/* Use PSS instead if RSS */
 	if (use_pss) {
-		if (_get_pss(proc_smaps_file, prec) == -1) {
-			xfree(prec->tres_data);
-			xfree(prec);
+		char proc_smaps_file[64];
+
+		snprintf(proc_smaps_file, sizeof(proc_smaps_file),
+			 "/proc/%d/smaps", pid);
+		if (_get_pss(proc_smaps_file, prec) == -1)
 			return;
-		}
 	}
 
+	proc->valid = poll_gen;
 	list_append(prec_list, prec);
 
-	if ((io_fp = fopen(proc_io_file, "r"))) {
-		fd2 = fileno(io_fp);
-		if (fcntl(fd2, F_SETFD, FD_CLOEXEC) == -1)
-			error("%s: fcntl: %m", __func__);
-		_get_process_io_data_line(fd2, prec);
-		fclose(io_fp);
-	}
+	if (_read_proc_file(pid, "io", &proc->io_fd, sbuf, sizeof(sbuf)) > 0)
+		_get_process_io_data_line(sbuf, prec);
 }
 
 static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 		       jag_callbacks_t *callbacks)
 {
-	List prec_list = list_create(destroy_jag_prec);
-	char	proc_stat_file[256];	/* Allow ~20x extra length */
-	char	proc_io_file[256];	/* Allow ~20x extra length */
-	char	proc_smaps_file[256];	/* Allow ~20x extra length */
+	/* The records belong to proc_hash, they are reused by the next poll */
+	List prec_list = list_create(NULL);
 	static	int	slash_proc_open = 0;
 	int i;
 	struct jobacctinfo *jobacct = NULL;
 
 	xassert(task_list);
 
+	if (!proc_hash) {
+		struct rlimit rlim;
+
+		proc_hash = xhash_init(_proc_id, _free_proc);
+		/* Leave at least half of the file descriptors to the rest */
+		if (getrlimit(RLIMIT_NOFILE, &rlim) < 0) {
+			error("getrlimit(RLIMIT_NOFILE): %m");
+			proc_fd_max = 0;
+		} else if (rlim.rlim_cur == RLIM_INFINITY)
+			proc_fd_max = INT_MAX;
+		else
+			proc_fd_max = rlim.rlim_cur / 2;
+	}
+	poll_gen++;
+
 	jobacct = list_peek(task_list);
 
 	if (!pgid_plugin) {
@@ -634,17 +736,14 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			goto finished;
 		}
 		for (i = 0; i < npids; i++) {
-			snprintf(proc_stat_file, 256, "/proc/%d/stat", pids[i]);
-			snprintf(proc_io_file, 256, "/proc/%d/io", pids[i]);
-			snprintf(proc_smaps_file, 256, "/proc/%d/smaps", pids[i]);
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file, callbacks,
+			_handle_stats(prec_list, pids[i], callbacks,
 				      jobacct ? jobacct->tres_count : 0);
 		}
 		xfree(pids);
 	} else {
 		struct dirent *slash_proc_entry;
-		char  *iptr = NULL, *optr = NULL, *optr2 = NULL;
+		char *end;
+		long pid;
 
 		if (slash_proc_open) {
 			rewinddir(slash_proc);
@@ -656,84 +755,24 @@ static List _get_precs(List task_list, bool pgid_plugin, uint64_t cont_id,
 			}
 			slash_proc_open=1;
 		}
-		strcpy(proc_stat_file, "/proc/");
-		strcpy(proc_io_file, "/proc/");
-		strcpy(proc_smaps_file, "/proc/");
 
 		while ((slash_proc_entry = readdir(slash_proc))) {
-
-			/* Save a few cyles by simulating
-			 * strcat(statFileName, slash_proc_entry->d_name);
-			 * strcat(statFileName, "/stat");
-			 * while checking for a numeric filename (which really
-			 * should be a pid). Then do the same for the
-			 * /proc/<pid>/io file name.
-			 */
-			optr = proc_stat_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-
-			if (i == -1)
+			/* Only numeric file names, which are pids */
+			if ((slash_proc_entry->d_name[0] < '0') ||
+			    (slash_proc_entry->d_name[0] > '9'))
 				continue;
-			iptr = (char*)"/stat";
-
-			do {
-				*optr++ = *iptr++;
-			} while (*iptr);
-			*optr = 0;
-
-			optr2 = proc_io_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
-				continue;
-			iptr = (char*)"/io";
-
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			optr2 = proc_smaps_file + sizeof("/proc");
-			iptr = slash_proc_entry->d_name;
-			i = 0;
-			do {
-				if ((*iptr < '0') ||
-				    ((*optr2++ = *iptr++) > '9')) {
-					i = -1;
-					break;
-				}
-			} while (*iptr);
-			if (i == -1)
+			pid = strtol(slash_proc_entry->d_name, &end, 10);
+			if (*end)
 				continue;
-			iptr = (char*)"/smaps";
 
-			do {
-				*optr2++ = *iptr++;
-			} while (*iptr);
-			*optr2 = 0;
-
-			_handle_stats(prec_list, proc_stat_file, proc_io_file,
-				      proc_smaps_file,callbacks,
+			_handle_stats(prec_list, pid, callbacks,
 				      jobacct ? jobacct->tres_count : 0);
 		}
 	}
 
 finished:
+	/* Close the files of processes which have gone away */
+	xhash_walk(proc_hash, _sweep_proc, NULL);
 
 	return prec_list;
 }
@@ -887,6 +926,7 @@ extern void jag_common_fini(void)
 {
 	if (slash_proc)
 		(void) closedir(slash_proc);
+	xhash_free(proc_hash);
 }
 
 extern void destroy_jag_prec(void *object)
@@ -929,7 +969,7 @@ extern void jag_common_poll_data(
 	/* Update the data */
 	List prec_list = NULL;
 	uint64_t total_job_mem = 0, total_job_vsize = 0;
-	ListIterator itr;
+	ListIterator itr, prec_itr;
 	jag_prec_t *prec = NULL;
 	struct jobacctinfo *jobacct = NULL;
 	static int processing = 0;
@@ -963,10 +1003,18 @@ extern void jag_common_poll_data(
 		goto finished;	/* We have no business being here! */
 
 	itr = list_iterator_create(task_list);
+	prec_itr = list_iterator_create(prec_list);
 	while ((jobacct = list_next(itr))) {
 		double cpu_calc;
 		double last_total_cputime;
-		if (!(prec = list_find_first(prec_list, _find_prec, jobacct)))
+		if (callbacks->get_precs == _get_precs) {
+			prec = _get_proc_prec(jobacct->pid);
+		} else if (!(prec = list_next(prec_itr)) ||
+			   (prec->pid != jobacct->pid)) {
+			/* Records not built in task order, search for it */
+			prec = list_find_first(prec_list, _find_prec, jobacct);
+		}
+		if (!prec)
 			continue;
 
 		/*
@@ -1116,6 +1164,7 @@ extern void jag_common_poll_data(
 		}
 	}
 	list_iterator_destroy(itr);
+	list_iterator_destroy(prec_itr);
 
 	if (over_memory_kill == -1)
 		over_memory_kill = slurm_get_job_acct_oom_kill();
@@ -0,0 +1,226 @@
+/*****************************************************************************\
+ *  jag-bench.c - cost of a jobacct_gather poll for many tasks
+ *****************************************************************************
+ *  The given number of sleeping children are forked and polled as the tasks
+ *  of a step with jag_common_poll_data(), as jobacct_gather/linux does with
+ *  JobAcctGatherParams=NoShare. The proctrack container holds the children,
+ *  the acct_gather plugins and profiling are stubbed out. The first poll
+ *  opens the /proc files of the tasks, later polls reuse them as long as
+ *  half of RLIMIT_NOFILE allows, so raise "ulimit -n" for large task counts.
+ *  To compare with another version of common_jag.c, build this program
+ *  against it.
+ *
+ *  Usage: jag-bench [tasks [polls]]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "src/common/list.h"
+#include "src/common/slurm_acct_gather_energy.h"
+#include "src/common/slurm_acct_gather_filesystem.h"
+#include "src/common/slurm_acct_gather_interconnect.h"
+#include "src/common/slurm_acct_gather_profile.h"
+#include "src/common/slurm_jobacct_gather.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/slurmctld.h"
+#include "src/slurmd/common/proctrack.h"
+
+#include "common_jag.h"
+
+static pid_t *task_pids = NULL;
+static int task_cnt = 0;
+
+/* The children make up the proctrack container */
+extern int proctrack_g_get_pids(uint64_t cont_id, pid_t **pids, int *npids)
+{
+	*pids = xcalloc(task_cnt, sizeof(pid_t));
+	memcpy(*pids, task_pids, task_cnt * sizeof(pid_t));
+	*npids = task_cnt;
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_energy_g_get_data(enum acct_energy_type data_type,
+					 void *data)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_filesystem_g_get_data(acct_gather_data_t *data)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_interconnect_g_get_data(acct_gather_data_t *data)
+{
+	return SLURM_SUCCESS;
+}
+
+extern int acct_gather_profile_g_get(enum acct_gather_profile_info info_type,
+				     void *data)
+{
+	*(uint32_t *) data = ACCT_GATHER_PROFILE_NONE;
+	return SLURM_SUCCESS;
+}
+
+extern bool acct_gather_profile_g_is_active(uint32_t type)
+{
+	return false;
+}
+
+extern void jobacct_gather_handle_mem_limit(uint64_t total_job_mem,
+					    uint64_t total_job_vsize)
+{
+}
+
+static struct jobacctinfo *_alloc_task(pid_t pid, int taskid)
+{
+	struct jobacctinfo *jobacct = xmalloc(sizeof(struct jobacctinfo));
+	int i;
+
+	jobacct->pid = pid;
+	jobacct->id.taskid = taskid;
+	jobacct->tres_count = TRES_ARRAY_TOTAL_CNT;
+	jobacct->tres_usage_in_max = xcalloc(TRES_ARRAY_TOTAL_CNT,
+					     sizeof(uint64_t));
+	jobacct->tres_usage_in_min = xcalloc(TRES_ARRAY_TOTAL_CNT,
+					     sizeof(uint64_t));
+	jobacct->tres_usage_in_tot = xcalloc(TRES_ARRAY_TOTAL_CNT,
+					     sizeof(uint64_t));
+	jobacct->tres_usage_out_max = xcalloc(TRES_ARRAY_TOTAL_CNT,
+					      sizeof(uint64_t));
+	jobacct->tres_usage_out_min = xcalloc(TRES_ARRAY_TOTAL_CNT,
+					      sizeof(uint64_t));
+	jobacct->tres_usage_out_tot = xcalloc(TRES_ARRAY_TOTAL_CNT,
+					      sizeof(uint64_t));
+	for (i = 0; i < TRES_ARRAY_TOTAL_CNT; i++) {
+		jobacct->tres_usage_in_max[i] = INFINITE64;
+		jobacct->tres_usage_out_max[i] = INFINITE64;
+	}
+
+	return jobacct;
+}
+
+static void _free_task(void *x)
+{
+	struct jobacctinfo *jobacct = x;
+
+	xfree(jobacct->tres_usage_in_max);
+	xfree(jobacct->tres_usage_in_min);
+	xfree(jobacct->tres_usage_in_tot);
+	xfree(jobacct->tres_usage_out_max);
+	xfree(jobacct->tres_usage_out_min);
+	xfree(jobacct->tres_usage_out_tot);
+	xfree(jobacct);
+}
+
+/* RET msec for the poll */
+static double _poll(List task_list, jag_callbacks_t *callbacks)
+{
+	struct timeval tv1, tv2;
+
+	gettimeofday(&tv1, NULL);
+	jag_common_poll_data(task_list, false, 1, callbacks, false);
+	gettimeofday(&tv2, NULL);
+
+	return ((tv2.tv_sec - tv1.tv_sec) * 1000.0) +
+	       ((tv2.tv_usec - tv1.tv_usec) / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+	char conf_file[] = "/tmp/jag-bench.conf.XXXXXX";
+	char *conf_str;
+	jag_callbacks_t callbacks;
+	List task_list;
+	struct rlimit rlim;
+	double first, total = 0.0;
+	int fd, i, polls = 5;
+
+	task_cnt = 1000;
+	if (argc > 1)
+		task_cnt = atoi(argv[1]);
+	if (argc > 2)
+		polls = atoi(argv[2]);
+	if ((task_cnt < 1) || (polls < 1)) {
+		fprintf(stderr, "Usage: %s [tasks [polls]]\n", argv[0]);
+		exit(1);
+	}
+
+	if ((fd = mkstemp(conf_file)) < 0) {
+		perror("mkstemp");
+		exit(1);
+	}
+	conf_str = xstrdup("ClusterName=unit\n"
+			   "SlurmctldHost=localhost\n"
+			   "JobAcctGatherParams=NoShare\n");
+	if (write(fd, conf_str, strlen(conf_str)) != strlen(conf_str)) {
+		perror("write");
+		exit(1);
+	}
+	close(fd);
+	xfree(conf_str);
+	setenv("SLURM_CONF", conf_file, 1);
+
+	task_pids = xcalloc(task_cnt, sizeof(pid_t));
+	task_list = list_create(_free_task);
+	for (i = 0; i < task_cnt; i++) {
+		if ((task_pids[i] = fork()) < 0) {
+			perror("fork");
+			task_cnt = i;
+			break;
+		} else if (task_pids[i] == 0) {
+			pause();
+			_exit(0);
+		}
+		list_append(task_list, _alloc_task(task_pids[i], i));
+	}
+
+	memset(&callbacks, 0, sizeof(callbacks));
+	jag_common_init(0);
+
+	getrlimit(RLIMIT_NOFILE, &rlim);
+	printf("%d tasks, NOFILE=%lu\n", task_cnt,
+	       (unsigned long) rlim.rlim_cur);
+	first = _poll(task_list, &callbacks);
+	for (i = 0; i < polls; i++)
+		total += _poll(task_list, &callbacks);
+	printf("first poll: %.1f ms\n", first);
+	printf("later polls: %.1f ms mean of %d\n", total / polls, polls);
+
+	jag_common_fini();
+	for (i = 0; i < task_cnt; i++)
+		kill(task_pids[i], SIGKILL);
+	for (i = 0; i < task_cnt; i++)
+		waitpid(task_pids[i], NULL, 0);
+	FREE_NULL_LIST(task_list);
+	xfree(task_pids);
+	unlink(conf_file);
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+/*****************************************************************************\
+ **  kvs-bench.c - cost of a PMI2 KVS fence for synthetic rank counts
+ *****************************************************************************
+ *  Every rank puts a business card unique to it and a value shared by the
+ *  ranks of its node, as MPI libraries typically do at startup. For each node
+ *  count the fence is modeled for the former uncompressed format through the
+ *  tree, the packed format through the tree and the packed format exchanged
+ *  by allgather. The packing and unpacking are measured, the transfer time
+ *  is estimated from the busiest link and the given bandwidth.
+ *
+ *  Usage: kvs-bench [ranks_per_node [max_nodes [MB_per_sec]]]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/pack.h"
+
+#include "kvs_pack.h"
+
+/* default TreeWidth, fanout of srun's broadcast */
+#define TREE_WIDTH	50
+
+static struct timeval tv;
+
+static void _start(void)
+{
+	gettimeofday(&tv, NULL);
+}
+
+static double _stop(void)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv.tv_sec) * 1e3 +
+	       (tv2.tv_usec - tv.tv_usec) / 1e3;
+}
+
+/* Pairs put by the ranks of a node */
+static void _node_pairs(Buf raw, int node, int ranks_per_node)
+{
+	char key[64], val[128];
+	int i, rank;
+
+	for (i = 0; i < ranks_per_node; i++) {
+		rank = node * ranks_per_node + i;
+		snprintf(key, sizeof(key), "P%d-businesscard", rank);
+		snprintf(val, sizeof(val),
+			 "description#tux%05d$port#%d$ifname#10.%d.%d.%d$",
+			 node, 40000 + i, (node >> 16) & 255, (node >> 8) & 255,
+			 node & 255);
+		packstr(key, raw);
+		packstr(val, raw);
+		snprintf(key, sizeof(key), "P%d-shm", rank);
+		snprintf(val, sizeof(val), "/dev/shm/mpich_shar_tmp%05d_%d",
+			 node, 4242);
+		packstr(key, raw);
+		packstr(val, raw);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int ranks_per_node = 32, max_nodes = 4096, nodes, i;
+	double mb_per_sec = 1250;	/* 10 Gb/s */
+	uint16_t compress = kvs_pack_compress_default();
+
+	if (argc > 1)
+		ranks_per_node = atoi(argv[1]);
+	if (argc > 2)
+		max_nodes = atoi(argv[2]);
+	if (argc > 3)
+		mb_per_sec = atof(argv[3]);
+	if ((ranks_per_node < 1) || (max_nodes < 1) || (mb_per_sec <= 0)) {
+		fprintf(stderr, "Usage: %s [ranks_per_node [max_nodes "
+			"[MB_per_sec]]]\n", argv[0]);
+		exit(1);
+	}
+
+	printf("%d ranks per node, %.0f MB/s links, compression %s\n",
+	       ranks_per_node, mb_per_sec,
+	       (compress == COMPRESS_LZ4) ? "lz4" :
+	       (compress == COMPRESS_ZLIB) ? "zlib" : "none");
+	printf("%-7s %-8s %10s %10s %10s %10s %10s %10s\n", "nodes", "ranks",
+	       "raw MB", "packed MB", "pack ms", "unpack ms", "tree ms",
+	       "allgath ms");
+
+	for (nodes = 2; nodes <= max_nodes; nodes *= 2) {
+		Buf raw = init_buf(0), all = init_buf(0), packed = init_buf(0);
+		Buf local = init_buf(0), local_packed = init_buf(0);
+		double pack_ms, unpack_ms, local_ms, raw_mb, packed_mb;
+		double fanout, old_ms, tree_ms, ag_ms;
+
+		for (i = 0; i < nodes; i++)
+			_node_pairs(raw, i, ranks_per_node);
+		_node_pairs(local, 0, ranks_per_node);
+		raw_mb = get_buf_offset(raw) / 1e6;
+
+		_start();
+		kvs_pack(local, compress, local_packed);
+		local_ms = _stop();
+
+		_start();
+		kvs_pack(raw, compress, packed);
+		pack_ms = _stop();
+		packed_mb = get_buf_offset(packed) / 1e6;
+
+		_start();
+		set_buf_offset(packed, 0);
+		if (kvs_unpack(packed, all) ||
+		    (get_buf_offset(all) != get_buf_offset(raw))) {
+			fprintf(stderr, "unpacked pairs differ\n");
+			exit(1);
+		}
+		unpack_ms = _stop();
+
+		/*
+		 * Through the tree srun receives every pair, then sends the
+		 * full set to up to TREE_WIDTH nodes which forward it.
+		 * srun unpacks and packs it once, every node unpacks it.
+		 */
+		fanout = (nodes < TREE_WIDTH) ? nodes : TREE_WIDTH;
+		old_ms = (raw_mb * (1 + fanout)) / mb_per_sec * 1e3;
+		tree_ms = (packed_mb * (1 + fanout)) / mb_per_sec * 1e3 +
+			  local_ms + 2 * unpack_ms + pack_ms;
+
+		/*
+		 * By allgather every node sends and receives about the full
+		 * set once over its own link, packing and unpacking what it
+		 * holds at each round.
+		 */
+		ag_ms = (2 * packed_mb) / mb_per_sec * 1e3 + 2 * pack_ms +
+			2 * unpack_ms;
+
+		printf("%-7d %-8d %10.2f %10.2f %10.1f %10.1f %10.1f %10.1f "
+		       "(was %.1f)\n", nodes, nodes * ranks_per_node, raw_mb,
+		       packed_mb, pack_ms, unpack_ms, tree_ms, ag_ms, old_ms);
+
+		free_buf(raw);
+		free_buf(all);
+		free_buf(packed);
+		free_buf(local);
+		free_buf(local_packed);
+	}
+
+	return 0;
+}
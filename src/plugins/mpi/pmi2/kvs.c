@@ -38,10 +38,16 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include "src/common/slurm_xlator.h"
+#include "src/common/hostlist.h"
+#include "src/common/macros.h"
+
 #include "kvs.h"
+#include "kvs_pack.h"
 #include "setup.h"
 #include "tree.h"
 #include "pmi.h"
+#include "client.h"
 
 #define MAX_RETRIES 5
 
@@ -50,6 +56,9 @@ int tasks_to_wait = 0;
 int children_to_wait = 0;
 int kvs_seq = 1; /* starting from 1 */
 int waiting_kvs_resp = 0;
+int kvs_fence_mode = KVS_FENCE_TREE;
+int kvs_packed = 0;
+int kvs_fence_allgather = 0;
 
 
 /* bucket of key-value pairs */
@@ -62,12 +71,34 @@ typedef struct kvs_bucket {
 static kvs_bucket_t *kvs_hash = NULL;
 static uint32_t hash_size = 0;
 
-static char *temp_kvs_buf = NULL;
-static int temp_kvs_cnt = 0;
-static int temp_kvs_size = 0;
+/* pairs put since the last fence, packstr(key) packstr(val) */
+static Buf temp_kvs = NULL;
 
 static int no_dup_keys = 0;
 
+/*
+ * Allgather fence by recursive doubling. With ag_pow2 the largest power of
+ * two not above the node count, node i >= ag_pow2 first hands its pairs to
+ * node i - ag_pow2 (step 0). Nodes below ag_pow2 then swap all the pairs
+ * they have with node i ^ (1 << (s - 1)) at steps s = 1 to ag_rounds, and
+ * finally pass the complete set on to node i + ag_pow2 (last step).
+ * Pairs a peer sends before this node reached the step are kept until then,
+ * those of the next fence too since a peer may be one fence ahead.
+ */
+#define AG_MAX_STEPS	34	/* 32 rounds plus the first and last step */
+
+typedef struct {
+	char *node;		/* peer stepd node name */
+	Buf buf;		/* message to send */
+} ag_send_t;
+
+static int ag_step = -1;	/* current step, -1 if not in a fence */
+static bool ag_sent = false;	/* pairs of ag_step sent */
+static int ag_rounds = 0;
+static uint32_t ag_pow2 = 1;
+static Buf ag_pending[2][AG_MAX_STEPS];	/* received, by kvs_seq parity */
+static hostlist_t ag_nodes = NULL;
+
 #define TASKS_PER_BUCKET 8
 #define TEMP_KVS_SIZE_INC 2048
 
@@ -75,6 +106,9 @@ static int no_dup_keys = 0;
 #define VAL_INDEX(i) (i * 2 + 1)
 #define HASH(key) ( _hash(key) % hash_size)
 
+static int _ag_start(void);
+static void _ag_init(void);
+
 inline static uint32_t
 _hash(char *key)
 {
@@ -93,44 +127,9 @@ _hash(char *key)
 extern int
 temp_kvs_init(void)
 {
-	uint16_t cmd;
-	uint32_t nodeid, num_children, size;
-	Buf buf = NULL;
-
-	xfree(temp_kvs_buf);
-	temp_kvs_cnt = 0;
-	temp_kvs_size = TEMP_KVS_SIZE_INC;
-	temp_kvs_buf = xmalloc(temp_kvs_size);
-
-	/* put the tree cmd here to simplify message sending */
-	if (in_stepd()) {
-		cmd = TREE_CMD_KVS_FENCE;
-	} else {
-		cmd = TREE_CMD_KVS_FENCE_RESP;
-	}
-
-	buf = init_buf(1024);
-	pack16(cmd, buf);
-	if (in_stepd()) {
-		nodeid = job_info.nodeid;
-		/* XXX: TBC */
-		num_children = tree_info.num_children + 1;
-
-		pack32(nodeid, buf); /* from_nodeid */
-		packstr(tree_info.this_node, buf); /* from_node */
-		pack32(num_children, buf); /* num_children */
-		pack32(kvs_seq, buf);
-	} else {
-		pack32(kvs_seq, buf);
-	}
-	size = get_buf_offset(buf);
-	if (temp_kvs_cnt + size > temp_kvs_size) {
-		temp_kvs_size += TEMP_KVS_SIZE_INC;
-		xrealloc(temp_kvs_buf, temp_kvs_size);
-	}
-	memcpy(&temp_kvs_buf[temp_kvs_cnt], get_buf_data(buf), size);
-	temp_kvs_cnt += size;
-	free_buf(buf);
+	if (temp_kvs)
+		free_buf(temp_kvs);
+	temp_kvs = init_buf(TEMP_KVS_SIZE_INC);
 
 	tasks_to_wait = 0;
 	children_to_wait = 0;
@@ -141,48 +140,51 @@ temp_kvs_init(void)
 extern int
 temp_kvs_add(char *key, char *val)
 {
-	Buf buf;
-	uint32_t size;
-
 	if ( key == NULL || val == NULL )
 		return SLURM_SUCCESS;
 
-	buf = init_buf(PMI2_MAX_KEYLEN + PMI2_MAX_VALLEN + 2 * sizeof(uint32_t));
-	packstr(key, buf);
-	packstr(val, buf);
-	size = get_buf_offset(buf);
-	if (temp_kvs_cnt + size > temp_kvs_size) {
-		temp_kvs_size += TEMP_KVS_SIZE_INC;
-		xrealloc(temp_kvs_buf, temp_kvs_size);
-	}
-	memcpy(&temp_kvs_buf[temp_kvs_cnt], get_buf_data(buf), size);
-	temp_kvs_cnt += size;
-	free_buf(buf);
+	packstr(key, temp_kvs);
+	packstr(val, temp_kvs);
 
 	return SLURM_SUCCESS;
 }
 
-extern int
-temp_kvs_merge(Buf buf)
+/*
+ * Append the pairs of a fence payload to raw. The payload is encoded by
+ * kvs_pack() if sent as a *_PACKED tree command, otherwise it is the raw
+ * pairs themselves.
+ */
+static int
+_kvs_unpack(Buf buf, bool encoded, Buf raw)
 {
-	char *data;
-	uint32_t offset, size;
+	uint32_t size;
+
+	if (encoded)
+		return kvs_unpack(buf, raw);
 
 	size = remaining_buf(buf);
-	if (size == 0) {
-		return SLURM_SUCCESS;
-	}
-	data = get_buf_data(buf);
-	offset = get_buf_offset(buf);
+	packmem_array(&get_buf_data(buf)[get_buf_offset(buf)], size, raw);
+	set_buf_offset(buf, get_buf_offset(buf) + size);
+	return SLURM_SUCCESS;
+}
 
-	if (temp_kvs_cnt + size > temp_kvs_size) {
-		temp_kvs_size += size;
-		xrealloc(temp_kvs_buf, temp_kvs_size);
-	}
-	memcpy(&temp_kvs_buf[temp_kvs_cnt], &data[offset], size);
-	temp_kvs_cnt += size;
+/* Append the pairs of raw to buf as a fence payload, see _kvs_unpack() */
+static void
+_kvs_pack(Buf raw, Buf buf)
+{
+	if (kvs_packed)
+		kvs_pack(raw, kvs_pack_compress_default(), buf);
+	else
+		packmem_array(get_buf_data(raw), get_buf_offset(raw), buf);
+}
 
-	return SLURM_SUCCESS;
+extern int
+temp_kvs_merge(Buf buf, bool encoded)
+{
+	if (remaining_buf(buf) == 0) {
+		return SLURM_SUCCESS;
+	}
+	return _kvs_unpack(buf, encoded, temp_kvs);
 }
 
 extern int
@@ -191,13 +193,32 @@ temp_kvs_send(void)
 	int rc = SLURM_ERROR, retry = 0;
 	unsigned int delay = 1;
 	char *nodelist = NULL;
+	Buf buf;
+
+	if (kvs_fence_mode == KVS_FENCE_ALLGATHER)
+		return _ag_start();
 
 	if (!in_stepd())	/* srun */
 		nodelist = xstrdup(job_info.step_nodelist);
 	else if (tree_info.parent_node)
 		nodelist = xstrdup(tree_info.parent_node);
 
-	/* cmd included in temp_kvs_buf */
+	buf = init_buf(get_buf_offset(temp_kvs) / 2 + 1024);
+	if (in_stepd()) {
+		pack16(kvs_packed ? TREE_CMD_KVS_FENCE_PACKED :
+		       TREE_CMD_KVS_FENCE, buf);
+		pack32(job_info.nodeid, buf); /* from_nodeid */
+		packstr(tree_info.this_node, buf); /* from_node */
+		/* XXX: TBC */
+		pack32(tree_info.num_children + 1, buf); /* num_children */
+		pack32(kvs_seq, buf);
+	} else {
+		pack16(kvs_packed ? TREE_CMD_KVS_FENCE_RESP_PACKED :
+		       TREE_CMD_KVS_FENCE_RESP, buf);
+		pack32(kvs_seq, buf);
+	}
+	_kvs_pack(temp_kvs, buf);
+
 	kvs_seq++; /* expecting new kvs after now */
 
 	while (1) {
@@ -208,10 +229,11 @@ temp_kvs_send(void)
 			/* srun or non-first-level stepds */
 			rc = slurm_forward_data(&nodelist,
 						tree_sock_addr,
-						temp_kvs_cnt,
-						temp_kvs_buf);
+						get_buf_offset(buf),
+						get_buf_data(buf));
 		else		/* first level stepds */
-			rc = tree_msg_to_srun(temp_kvs_cnt, temp_kvs_buf);
+			rc = tree_msg_to_srun(get_buf_offset(buf),
+					      get_buf_data(buf));
 
 		if (rc == SLURM_SUCCESS)
 			break;
@@ -222,6 +244,7 @@ temp_kvs_send(void)
 		sleep(delay);
 		delay *= 2;
 	}
+	free_buf(buf);
 	temp_kvs_init();	/* clear old temp kvs */
 
 	xfree(nodelist);
@@ -229,6 +252,280 @@ temp_kvs_send(void)
 	return rc;
 }
 
+/*
+ * Put the pairs of raw, from its start to its current offset, into the kvs
+ * RET SLURM_ERROR if the last pair is truncated
+ */
+static int
+_kvs_put_raw(Buf raw)
+{
+	char *key, *val;
+	uint32_t end = get_buf_offset(raw), len;
+	int rc = SLURM_SUCCESS;
+
+	set_buf_offset(raw, 0);
+	while (get_buf_offset(raw) < end) {
+		/* a pair may only be cut at end, within the allocated size */
+		if (unpackmem_ptr(&key, &len, raw) ||
+		    unpackmem_ptr(&val, &len, raw) ||
+		    (get_buf_offset(raw) > end)) {
+			error("mpi/pmi2: truncated kvs pair");
+			rc = SLURM_ERROR;
+			break;
+		}
+		kvs_put(key, val);
+	}
+	set_buf_offset(raw, end);
+	return rc;
+}
+
+extern int
+kvs_put_packed(Buf buf, bool encoded)
+{
+	Buf raw = init_buf(remaining_buf(buf) + 1);
+	int rc;
+
+	if ((rc = _kvs_unpack(buf, encoded, raw)) == SLURM_SUCCESS)
+		rc = _kvs_put_raw(raw);
+	free_buf(raw);
+
+	return rc;
+}
+
+/*
+ * Called in stepds once srun sent a fence response packed with kvs_pack(),
+ * i.e. once srun and every stepd of the step accept packed pairs. Later
+ * fences are sent packed, and by allgather if it was requested.
+ */
+extern void
+kvs_packed_enable(void)
+{
+	if (kvs_packed)
+		return;
+	kvs_packed = 1;
+	if (kvs_fence_allgather) {
+		debug("mpi/pmi2: kvs fences now by allgather");
+		kvs_fence_mode = KVS_FENCE_ALLGATHER;
+		/* no child stepd reports to this one's fence */
+		tree_info.num_children = 0;
+		_ag_init();
+	}
+}
+
+/**************************************************************/
+
+/* RET the node this one sends its pairs to at step, -1 if none */
+static int
+_ag_send_peer(int step)
+{
+	uint32_t id = job_info.nodeid;
+
+	if (step == 0)
+		return (id >= ag_pow2) ? (id - ag_pow2) : -1;
+	if (step <= ag_rounds)
+		return (id < ag_pow2) ? (id ^ (1 << (step - 1))) : -1;
+	return ((id + ag_pow2) < job_info.nnodes) ? (id + ag_pow2) : -1;
+}
+
+/* RET the node this one receives pairs from at step, -1 if none */
+static int
+_ag_recv_peer(int step)
+{
+	uint32_t id = job_info.nodeid;
+
+	if (step == 0)
+		return ((id + ag_pow2) < job_info.nnodes) ? (id + ag_pow2) : -1;
+	if (step <= ag_rounds)
+		return (id < ag_pow2) ? (id ^ (1 << (step - 1))) : -1;
+	return (id >= ag_pow2) ? (id - ag_pow2) : -1;
+}
+
+static void *
+_ag_send_thread(void *arg)
+{
+	ag_send_t *send = arg;
+	int rc = SLURM_ERROR, retry = 0;
+	unsigned int delay = 1;
+
+	/*
+	 * Sent from a thread of its own so that the agent keeps reading the
+	 * pairs the peer sends at the same time.
+	 */
+	while (1) {
+		rc = slurm_forward_data(&send->node, tree_sock_addr,
+					get_buf_offset(send->buf),
+					get_buf_data(send->buf));
+		if (rc == SLURM_SUCCESS)
+			break;
+		if (++retry >= MAX_RETRIES)
+			break;
+		verbose("mpi/pmi2: failed to send kvs to %s, rc=%d, retrying",
+			send->node, rc);
+		/* wait, in case the peer stepd is not ready */
+		sleep(delay);
+		delay *= 2;
+	}
+	if (rc != SLURM_SUCCESS) {
+		error("mpi/pmi2: failed to send kvs to %s", send->node);
+		/* cancel the step to avoid tasks hang */
+		slurm_kill_job_step(job_info.jobid, job_info.stepid, SIGKILL);
+	}
+
+	xfree(send->node);
+	free_buf(send->buf);
+	xfree(send);
+	return NULL;
+}
+
+static void
+_ag_send(int peer, int step)
+{
+	ag_send_t *send = xmalloc(sizeof(ag_send_t));
+	char *node;
+
+	send->buf = init_buf(get_buf_offset(temp_kvs) / 2 + 1024);
+	pack16(TREE_CMD_KVS_ALLGATHER, send->buf);
+	pack32(kvs_seq, send->buf);
+	pack32(job_info.nodeid, send->buf);
+	pack32(step, send->buf);
+	kvs_pack(temp_kvs, kvs_pack_compress_default(), send->buf);
+
+	node = hostlist_nth(ag_nodes, peer);
+	send->node = xstrdup(node);
+	free(node);
+
+	debug3("mpi/pmi2: kvs allgather step %d, sending %u bytes to %s",
+	       step, get_buf_offset(send->buf), send->node);
+	slurm_thread_create_detached(NULL, _ag_send_thread, send);
+}
+
+static void
+_ag_fail(char *errmsg)
+{
+	error("%s", errmsg);
+	ag_step = -1;
+	send_kvs_fence_resp_to_clients(SLURM_ERROR, errmsg);
+	/* cancel the step to avoid tasks hang */
+	slurm_kill_job_step(job_info.jobid, job_info.stepid, SIGKILL);
+}
+
+static void
+_ag_done(void)
+{
+	if (_kvs_put_raw(temp_kvs) != SLURM_SUCCESS) {
+		_ag_fail("mpi/pmi2: unpack kvs error in allgather");
+		return;
+	}
+	ag_step = -1;
+	kvs_seq++;
+	temp_kvs_init();
+	send_kvs_fence_resp_to_clients(SLURM_SUCCESS, NULL);
+}
+
+/* Go through the steps whose pairs have been received */
+static void
+_ag_progress(void)
+{
+	int last = ag_rounds + 1, peer;
+	Buf buf;
+
+	while (ag_step >= 0) {
+		if (ag_step > last) {
+			_ag_done();
+			return;
+		}
+		if (!ag_sent) {
+			if ((peer = _ag_send_peer(ag_step)) >= 0)
+				_ag_send(peer, ag_step);
+			ag_sent = true;
+		}
+		if (_ag_recv_peer(ag_step) >= 0) {
+			if (!(buf = ag_pending[kvs_seq & 1][ag_step]))
+				return;
+			ag_pending[kvs_seq & 1][ag_step] = NULL;
+			/* the complete set includes this node's pairs */
+			if (ag_step == last)
+				set_buf_offset(temp_kvs, 0);
+			if (kvs_unpack(buf, temp_kvs) != SLURM_SUCCESS) {
+				free_buf(buf);
+				_ag_fail("mpi/pmi2: unpack kvs error in "
+					 "allgather");
+				return;
+			}
+			free_buf(buf);
+		}
+		ag_step++;
+		ag_sent = false;
+	}
+}
+
+static void
+_ag_init(void)
+{
+	ag_nodes = hostlist_create(job_info.step_nodelist);
+	ag_pow2 = 1;
+	ag_rounds = 0;
+	while ((ag_pow2 * 2) <= job_info.nnodes) {
+		ag_pow2 *= 2;
+		ag_rounds++;
+	}
+}
+
+static int
+_ag_start(void)
+{
+	debug3("mpi/pmi2: kvs allgather seq %d started", kvs_seq);
+	ag_step = 0;
+	ag_sent = false;
+	_ag_progress();
+	return SLURM_SUCCESS;
+}
+
+extern int
+kvs_allgather_recv(Buf buf)
+{
+	uint32_t seq, from_nodeid, step, len;
+	Buf *slot;
+	char *data;
+
+	safe_unpack32(&seq, buf);
+	safe_unpack32(&from_nodeid, buf);
+	safe_unpack32(&step, buf);
+
+	debug3("mpi/pmi2: in kvs_allgather_recv, from node %u step %u "
+	       "seq %u", from_nodeid, step, seq);
+	/* the peer got the packed fence response before this stepd did */
+	if (kvs_fence_allgather)
+		kvs_packed_enable();
+	if ((kvs_fence_mode != KVS_FENCE_ALLGATHER) ||
+	    (step > (ag_rounds + 1)) ||
+	    (from_nodeid != _ag_recv_peer(step)) ||
+	    ((seq != kvs_seq) && (seq != (kvs_seq + 1)))) {
+		error("mpi/pmi2: unexpected kvs allgather from node %u "
+		      "ignored, step %u seq %u", from_nodeid, step, seq);
+		return SLURM_ERROR;
+	}
+
+	slot = &ag_pending[seq & 1][step];
+	if (*slot) {
+		info("mpi/pmi2: duplicate kvs allgather from node %u ignored, "
+		     "step %u seq %u", from_nodeid, step, seq);
+		return SLURM_SUCCESS;
+	}
+	len = remaining_buf(buf);
+	data = xmalloc_nz(len);
+	memcpy(data, &get_buf_data(buf)[get_buf_offset(buf)], len);
+	*slot = create_buf(data, len);
+
+	if ((seq == kvs_seq) && (ag_step >= 0))
+		_ag_progress();
+	return SLURM_SUCCESS;
+
+unpack_error:
+	error("mpi/pmi2: failed to unpack kvs allgather message");
+	return SLURM_ERROR;
+}
+
 /**************************************************************/
 
 extern int
@@ -323,5 +620,12 @@ kvs_clear(void)
 	}
 	xfree(kvs_hash);
 
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < AG_MAX_STEPS; j++)
+			FREE_NULL_BUFFER(ag_pending[i][j]);
+	}
+	FREE_NULL_HOSTLIST(ag_nodes);
+	FREE_NULL_BUFFER(temp_kvs);
+
 	return SLURM_SUCCESS;
 }
@@ -44,19 +44,29 @@
 #include "src/common/pack.h"
 
 
+/* how stepds exchange the pairs put before a fence */
+#define KVS_FENCE_TREE		0 /* up the tree to srun, which broadcasts */
+#define KVS_FENCE_ALLGATHER	1 /* directly, by recursive doubling */
+
 extern int tasks_to_wait;
 extern int children_to_wait;
 extern int kvs_seq;
 extern int waiting_kvs_resp;
+extern int kvs_fence_mode;
+extern int kvs_packed;		/* fence pairs encoded by kvs_pack() */
+extern int kvs_fence_allgather;	/* allgather once kvs_packed is enabled */
 
 extern int   temp_kvs_init(void);
 extern int   temp_kvs_add(char *key, char *val);
-extern int   temp_kvs_merge(Buf buf);
+extern int   temp_kvs_merge(Buf buf, bool encoded);
 extern int   temp_kvs_send(void);
+extern int   kvs_allgather_recv(Buf buf);
 
 extern int   kvs_init(void);
 extern char *kvs_get(char *key);
 extern int   kvs_put(char *key, char *val);
+extern int   kvs_put_packed(Buf buf, bool encoded);
+extern void  kvs_packed_enable(void);
 extern int   kvs_clear(void);
 
 
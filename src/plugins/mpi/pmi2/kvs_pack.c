@@ -0,0 +1,353 @@
+/*****************************************************************************\
+ **  kvs_pack.c - KVS fence payload encoding
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "config.h"
+
+#include <string.h>
+
+#if HAVE_LIBZ
+# include <zlib.h>
+#endif
+
+#if HAVE_LZ4
+# include <lz4.h>
+#endif
+
+#include "slurm/slurm_errno.h"
+
+#include "src/common/slurm_xlator.h"
+#include "src/common/log.h"
+#include "src/common/pack.h"
+#include "src/common/slurm_protocol_defs.h"
+#include "src/common/xmalloc.h"
+
+#include "kvs_pack.h"
+
+#define VAL_TABLE_MIN 1024
+
+/* distinct values of a payload being packed, by their index in the payload */
+typedef struct val_table {
+	char **val;		/* values, pointing into the raw pairs */
+	uint32_t *len;		/* packed length of each value */
+	uint32_t cnt;		/* number of distinct values */
+	uint32_t *slot;		/* open addressed hash of value index + 1 */
+	uint32_t slot_cnt;	/* power of two, at least twice cnt */
+} val_table_t;
+
+/* FNV-1a hash of a value */
+static uint32_t
+_hash(const char *data, uint32_t len)
+{
+	uint32_t hash = 2166136261U, i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+static void
+_val_table_grow(val_table_t *table)
+{
+	uint32_t i, j, mask;
+
+	table->slot_cnt = table->slot_cnt ? table->slot_cnt * 2 :
+					    VAL_TABLE_MIN;
+	mask = table->slot_cnt - 1;
+	xfree(table->slot);
+	table->slot = xmalloc(sizeof(uint32_t) * table->slot_cnt);
+	xrealloc(table->val, sizeof(char *) * (table->slot_cnt / 2));
+	xrealloc(table->len, sizeof(uint32_t) * (table->slot_cnt / 2));
+
+	for (i = 0; i < table->cnt; i++) {
+		for (j = _hash(table->val[i], table->len[i]) & mask;
+		     table->slot[j]; j = (j + 1) & mask)
+			;
+		table->slot[j] = i + 1;
+	}
+}
+
+/*
+ * Return the index of a value in the payload, adding it to the table and to
+ * the packed values if not seen before
+ */
+static uint32_t
+_val_index(val_table_t *table, char *val, uint32_t len, Buf val_buf)
+{
+	uint32_t i, mask;
+
+	if ((table->cnt + 1) * 2 > table->slot_cnt)
+		_val_table_grow(table);
+	mask = table->slot_cnt - 1;
+
+	for (i = _hash(val, len) & mask; table->slot[i]; i = (i + 1) & mask) {
+		uint32_t inx = table->slot[i] - 1;
+
+		if ((table->len[inx] == len) &&
+		    !memcmp(table->val[inx], val, len))
+			return inx;
+	}
+
+	table->slot[i] = table->cnt + 1;
+	table->val[table->cnt] = val;
+	table->len[table->cnt] = len;
+	packmem(val, len, val_buf);
+	return table->cnt++;
+}
+
+/* Append the packed contents of src to dst */
+static void
+_append_buf(Buf dst, Buf src)
+{
+	uint32_t len = get_buf_offset(src);
+
+	reserve_buf(dst, len);
+	memcpy(&get_buf_data(dst)[get_buf_offset(dst)], get_buf_data(src), len);
+	set_buf_offset(dst, get_buf_offset(dst) + len);
+}
+
+/* RET the largest compressed size of len bytes or 0 if not supported */
+static uint32_t
+_compress_bound(uint16_t compress, uint32_t len)
+{
+	switch (compress) {
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+		return LZ4_compressBound(len);
+#endif
+#if HAVE_LIBZ
+	case COMPRESS_ZLIB:
+		return compressBound(len);
+#endif
+	default:
+		return 0;
+	}
+}
+
+/* RET the compressed size or 0 on failure */
+static uint32_t
+_compress(uint16_t compress, char *in, uint32_t in_len, char *out,
+	  uint32_t out_len)
+{
+	switch (compress) {
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+	{
+		int rc = LZ4_compress_default(in, out, in_len, out_len);
+		return (rc > 0) ? rc : 0;
+	}
+#endif
+#if HAVE_LIBZ
+	case COMPRESS_ZLIB:
+	{
+		uLongf len = out_len;
+		if (compress2((Bytef *) out, &len, (Bytef *) in, in_len,
+			      Z_BEST_SPEED) != Z_OK)
+			return 0;
+		return len;
+	}
+#endif
+	default:
+		return 0;
+	}
+}
+
+static int
+_decompress(uint16_t compress, char *in, uint32_t in_len, char *out,
+	    uint32_t out_len)
+{
+	switch (compress) {
+	case COMPRESS_OFF:
+		if (in_len != out_len)
+			return SLURM_ERROR;
+		memcpy(out, in, in_len);
+		return SLURM_SUCCESS;
+#if HAVE_LZ4
+	case COMPRESS_LZ4:
+		if (LZ4_decompress_safe(in, out, in_len, out_len) != out_len)
+			return SLURM_ERROR;
+		return SLURM_SUCCESS;
+#endif
+#if HAVE_LIBZ
+	case COMPRESS_ZLIB:
+	{
+		uLongf len = out_len;
+		if ((uncompress((Bytef *) out, &len, (Bytef *) in, in_len) !=
+		     Z_OK) || (len != out_len))
+			return SLURM_ERROR;
+		return SLURM_SUCCESS;
+	}
+#endif
+	default:
+		error("mpi/pmi2: kvs compression type %hu not supported",
+		      compress);
+		return SLURM_ERROR;
+	}
+}
+
+extern uint16_t
+kvs_pack_compress_default(void)
+{
+#if HAVE_LZ4
+	return COMPRESS_LZ4;
+#elif HAVE_LIBZ
+	return COMPRESS_ZLIB;
+#else
+	return COMPRESS_OFF;
+#endif
+}
+
+extern void
+kvs_pack(Buf raw, uint16_t compress, Buf buf)
+{
+	uint32_t end = get_buf_offset(raw), key_len, val_len, pair_cnt = 0;
+	uint32_t body_len, data_len = 0, bound = 0, hdr_offset;
+	char *key, *val;
+	val_table_t table;
+	Buf val_buf, pair_buf, body;
+
+	memset(&table, 0, sizeof(table));
+	val_buf = init_buf(end / 2 + 1);
+	pair_buf = init_buf(end / 2 + 1);
+
+	set_buf_offset(raw, 0);
+	while (get_buf_offset(raw) < end) {
+		if (unpackmem_ptr(&key, &key_len, raw) ||
+		    unpackmem_ptr(&val, &val_len, raw))
+			break;
+		packmem(key, key_len, pair_buf);
+		pack32(_val_index(&table, val, val_len, val_buf), pair_buf);
+		pair_cnt++;
+	}
+	set_buf_offset(raw, end);
+
+	body = init_buf(2 * sizeof(uint32_t) + get_buf_offset(val_buf) +
+			get_buf_offset(pair_buf));
+	pack32(table.cnt, body);
+	_append_buf(body, val_buf);
+	pack32(pair_cnt, body);
+	_append_buf(body, pair_buf);
+	body_len = get_buf_offset(body);
+	free_buf(val_buf);
+	free_buf(pair_buf);
+	xfree(table.val);
+	xfree(table.len);
+	xfree(table.slot);
+
+	/* lengths are filled in once the data is known */
+	hdr_offset = get_buf_offset(buf);
+	pack16(COMPRESS_OFF, buf);
+	pack32(body_len, buf);
+	pack32(0, buf);
+
+	if (body_len >= KVS_PACK_COMPRESS_MIN)
+		bound = _compress_bound(compress, body_len);
+	if (bound) {
+		reserve_buf(buf, bound);
+		data_len = _compress(compress, get_buf_data(body), body_len,
+				     &get_buf_data(buf)[get_buf_offset(buf)],
+				     bound);
+	}
+	if (!data_len || (data_len >= body_len)) {
+		compress = COMPRESS_OFF;
+		data_len = body_len;
+		reserve_buf(buf, body_len);
+		memcpy(&get_buf_data(buf)[get_buf_offset(buf)],
+		       get_buf_data(body), body_len);
+	}
+	free_buf(body);
+
+	end = get_buf_offset(buf) + data_len;
+	set_buf_offset(buf, hdr_offset);
+	pack16(compress, buf);
+	pack32(body_len, buf);
+	pack32(data_len, buf);
+	set_buf_offset(buf, end);
+}
+
+extern int
+kvs_unpack(Buf buf, Buf raw)
+{
+	uint16_t compress;
+	uint32_t body_len, data_len, val_cnt = 0, pair_cnt, key_len, inx, i;
+	uint32_t *val_len = NULL;
+	char *data, *key, **val = NULL;
+	Buf body = NULL;
+	int rc = SLURM_ERROR;
+
+	safe_unpack16(&compress, buf);
+	safe_unpack32(&body_len, buf);
+	safe_unpack32(&data_len, buf);
+	if ((remaining_buf(buf) < data_len) || (body_len < 2 * sizeof(uint32_t))
+	    || (body_len > MAX_PACK_MEM_LEN))
+		goto unpack_error;
+	data = &get_buf_data(buf)[get_buf_offset(buf)];
+	set_buf_offset(buf, get_buf_offset(buf) + data_len);
+
+	body = create_buf(xmalloc_nz(body_len), body_len);
+	if (_decompress(compress, data, data_len, get_buf_data(body),
+			body_len))
+		goto unpack_error;
+
+	safe_unpack32(&val_cnt, body);
+	if (val_cnt > (body_len / sizeof(uint32_t)))
+		goto unpack_error;
+	val = xmalloc(sizeof(char *) * val_cnt);
+	val_len = xmalloc(sizeof(uint32_t) * val_cnt);
+	for (i = 0; i < val_cnt; i++) {
+		safe_unpackmem_ptr(&val[i], &val_len[i], body);
+		if (val_len[i] && val[i][val_len[i] - 1])
+			goto unpack_error;	/* not a string */
+	}
+
+	safe_unpack32(&pair_cnt, body);
+	for (i = 0; i < pair_cnt; i++) {
+		safe_unpackmem_ptr(&key, &key_len, body);
+		safe_unpack32(&inx, body);
+		if (!key_len || key[key_len - 1] || (inx >= val_cnt))
+			goto unpack_error;
+		packmem(key, key_len, raw);
+		packmem(val[inx], val_len[inx], raw);
+	}
+	rc = SLURM_SUCCESS;
+
+unpack_error:
+	if (rc != SLURM_SUCCESS)
+		error("mpi/pmi2: malformed kvs payload");
+	xfree(val);
+	xfree(val_len);
+	if (body)
+		free_buf(body);
+	return rc;
+}
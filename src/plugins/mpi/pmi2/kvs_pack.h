@@ -0,0 +1,71 @@
+/*****************************************************************************\
+ **  kvs_pack.h - KVS fence payload encoding
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  In addition, as a special exception, the copyright holders give permission
+ *  to link the code of portions of this program with the OpenSSL library under
+ *  certain conditions as described in each individual source file, and
+ *  distribute linked combinations including the two. You must obey the GNU
+ *  General Public License in all respects for all of the code used other than
+ *  OpenSSL. If you modify file(s) with this exception, you may extend this
+ *  exception to your version of the file(s), but you are not obligated to do
+ *  so. If you do not wish to do so, delete this exception statement from your
+ *  version.  If you delete this exception statement from all source files in
+ *  the program, then also delete it here.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#ifndef _KVS_PACK_H
+#define _KVS_PACK_H
+
+#include <inttypes.h>
+
+#include "src/common/pack.h"
+
+/*
+ * Key-value pairs travel between stepds and srun as a table of the distinct
+ * values followed by the keys, each with the index of its value, compressed
+ * once larger than KVS_PACK_COMPRESS_MIN bytes.
+ *
+ * Pairs are accumulated in "raw" buffers with packstr(key), packstr(val).
+ */
+#define KVS_PACK_COMPRESS_MIN	4096
+
+/*
+ * Return the best COMPRESS_* method this build supports
+ */
+extern uint16_t kvs_pack_compress_default(void);
+
+/*
+ * Pack the pairs of raw, from its start to its current offset, into buf
+ * IN raw - pairs to pack
+ * IN compress - COMPRESS_* method to use for large payloads
+ * IN/OUT buf - buffer to append the payload to
+ */
+extern void kvs_pack(Buf raw, uint16_t compress, Buf buf);
+
+/*
+ * Unpack a payload packed by kvs_pack()
+ * IN/OUT buf - buffer at the start of the payload, left after its end
+ * IN/OUT raw - buffer to append the pairs to
+ * RET SLURM_SUCCESS or SLURM_ERROR if the payload is malformed
+ */
+extern int kvs_unpack(Buf buf, Buf raw);
+
+#endif	/* _KVS_PACK_H */
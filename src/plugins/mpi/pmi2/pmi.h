@@ -237,6 +237,8 @@
 /* old PMIv1 envs */
 #define PMI2_PMI_DEBUGGED_ENV   "PMI_DEBUG"
 #define PMI2_KVS_NO_DUP_KEYS_ENV "SLURM_PMI_KVS_NO_DUP_KEYS"
+#define PMI2_KVS_FENCE_ENV      "SLURM_PMI2_KVS_FENCE"
+#define PMI2_KVS_PACK_ENV       "SLURM_PMI2_KVS_PACK"
 
 
 extern int handle_pmi1_cmd(int fd, int lrank);
@@ -347,17 +347,59 @@ _setup_stepd_sockets(const stepd_step_rec_t *job, char ***env)
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Tell srun this stepd accepts fence pairs packed by kvs_pack(). If this
+ * fails srun keeps sending the pairs as they are.
+ */
+static void
+_announce_kvs_packed(void)
+{
+	Buf buf = init_buf(64);
+
+	pack16(TREE_CMD_KVS_PACK_CAPABLE, buf);
+	pack32(job_info.nodeid, buf);
+	if (tree_msg_to_srun(get_buf_offset(buf), get_buf_data(buf)) !=
+	    SLURM_SUCCESS)
+		debug("mpi/pmi2: failed to announce packed kvs pairs to srun");
+	free_buf(buf);
+}
+
 static int
 _setup_stepd_kvs(char ***env)
 {
 	int rc = SLURM_SUCCESS, i = 0, pp_cnt = 0;
 	char *p, env_key[32], *ppkey, *ppval;
+	bool pack_capable = false;
 
 	kvs_seq = 1;
 	rc = temp_kvs_init();
 	if (rc != SLURM_SUCCESS)
 		return rc;
 
+	/* set by srun if it accepts pairs packed by kvs_pack() */
+	if (getenvp(*env, PMI2_KVS_PACK_ENV)) {
+		pack_capable = true;
+		unsetenvp(*env, PMI2_KVS_PACK_ENV);
+		_announce_kvs_packed();
+	}
+
+	p = getenvp(*env, PMI2_KVS_FENCE_ENV);
+	if (!xstrcasecmp(p, "allgather") && !pack_capable) {
+		/* an older srun never packs a fence response */
+		info("mpi/pmi2: %s=allgather not supported by srun, using tree",
+		     PMI2_KVS_FENCE_ENV);
+	} else if (!xstrcasecmp(p, "allgather")) {
+		/*
+		 * Older stepds of the step would only join a tree fence, so
+		 * the tree is used until srun packs a fence response, see
+		 * kvs_packed_enable().
+		 */
+		kvs_fence_allgather = 1;
+	} else if (p && xstrcasecmp(p, "tree")) {
+		error("mpi/pmi2: invalid %s value %s ignored",
+		      PMI2_KVS_FENCE_ENV, p);
+	}
+
 	rc = kvs_init();
 	if (rc != SLURM_SUCCESS)
 		return rc;
@@ -728,6 +770,8 @@ _setup_srun_environ(const mpi_plugin_client_info_t *job, char ***env)
 				job_info.step_nodelist);
 	env_array_overwrite_fmt(env, PMI2_PROC_MAPPING_ENV, "%s",
 				job_info.proc_mapping);
+	/* stepds announce they accept packed pairs in reply */
+	env_array_overwrite(env, PMI2_KVS_PACK_ENV, "1");
 	return SLURM_SUCCESS;
 }
 
@@ -47,6 +47,7 @@
 #include <unistd.h>
 
 #include "src/common/slurm_xlator.h"
+#include "src/common/bitstring.h"
 #include "src/common/slurm_protocol_interface.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/xmalloc.h"
@@ -68,6 +69,10 @@ static int _handle_name_unpublish(int fd, Buf buf);
 static int _handle_name_lookup(int fd, Buf buf);
 static int _handle_ring(int fd, Buf buf);
 static int _handle_ring_resp(int fd, Buf buf);
+static int _handle_kvs_allgather(int fd, Buf buf);
+static int _handle_kvs_fence_packed(int fd, Buf buf);
+static int _handle_kvs_fence_resp_packed(int fd, Buf buf);
+static int _handle_kvs_pack_capable(int fd, Buf buf);
 
 static uint32_t  spawned_srun_ports_size = 0;
 static uint16_t *spawned_srun_ports = NULL;
@@ -83,6 +88,10 @@ static int (*tree_cmd_handlers[]) (int fd, Buf buf) = {
 	_handle_name_lookup,
 	_handle_ring,
 	_handle_ring_resp,
+	_handle_kvs_allgather,
+	_handle_kvs_fence_packed,
+	_handle_kvs_fence_resp_packed,
+	_handle_kvs_pack_capable,
 	NULL
 };
 
@@ -96,11 +105,15 @@ static char *tree_cmd_names[] = {
 	"TREE_CMD_NAME_LOOKUP",
 	"TREE_CMD_RING",
 	"TREE_CMD_RING_RESP",
+	"TREE_CMD_KVS_ALLGATHER",
+	"TREE_CMD_KVS_FENCE_PACKED",
+	"TREE_CMD_KVS_FENCE_RESP_PACKED",
+	"TREE_CMD_KVS_PACK_CAPABLE",
 	NULL,
 };
 
 static int
-_handle_kvs_fence(int fd, Buf buf)
+_kvs_fence(int fd, Buf buf, bool encoded)
 {
 	uint32_t from_nodeid, num_children, temp32, seq;
 	char *from_node = NULL;
@@ -111,7 +124,7 @@ _handle_kvs_fence(int fd, Buf buf)
 	safe_unpack32(&num_children, buf);
 	safe_unpack32(&seq, buf);
 
-	debug3("mpi/pmi2: in _handle_kvs_fence, from node %u(%s) representing"
+	debug3("mpi/pmi2: in _kvs_fence, from node %u(%s) representing"
 	       " %u offspring, seq=%u", from_nodeid, from_node, num_children,
 	       seq);
 	if (seq != kvs_seq) {
@@ -125,6 +138,8 @@ _handle_kvs_fence(int fd, Buf buf)
 		      "ignored, seq=%u", from_nodeid, from_node, seq);
 		goto out;
 	}
+	if (temp_kvs_merge(buf, encoded) != SLURM_SUCCESS)
+		goto unpack_error;
 	tree_info.children_kvs_seq[from_nodeid] = seq;
 
 	if (tasks_to_wait == 0 && children_to_wait == 0) {
@@ -133,8 +148,6 @@ _handle_kvs_fence(int fd, Buf buf)
 	}
 	children_to_wait -= num_children;
 
-	temp_kvs_merge(buf);
-
 	if ((children_to_wait == 0) && (tasks_to_wait == 0)) {
 		rc = temp_kvs_send();
 		if (rc != SLURM_SUCCESS) {
@@ -157,7 +170,7 @@ _handle_kvs_fence(int fd, Buf buf)
 				waiting_kvs_resp = 1;
 		}
 	}
-	debug3("mpi/pmi2: out _handle_kvs_fence, tasks_to_wait=%d, "
+	debug3("mpi/pmi2: out _kvs_fence, tasks_to_wait=%d, "
 	       "children_to_wait=%d", tasks_to_wait, children_to_wait);
 out:
 	xfree(from_node);
@@ -170,13 +183,25 @@ unpack_error:
 }
 
 static int
-_handle_kvs_fence_resp(int fd, Buf buf)
+_handle_kvs_fence(int fd, Buf buf)
+{
+	return _kvs_fence(fd, buf, false);
+}
+
+static int
+_handle_kvs_fence_packed(int fd, Buf buf)
 {
-	char *key, *val, *errmsg = NULL;
+	return _kvs_fence(fd, buf, true);
+}
+
+static int
+_kvs_fence_resp(int fd, Buf buf, bool encoded)
+{
+	char *errmsg = NULL;
 	int rc = SLURM_SUCCESS;
 	uint32_t temp32, seq;
 
-	debug3("mpi/pmi2: in _handle_kvs_fence_resp");
+	debug3("mpi/pmi2: in _kvs_fence_resp");
 
 	safe_unpack32(&seq, buf);
 	if (seq == kvs_seq - 2) {
@@ -200,14 +225,8 @@ _handle_kvs_fence_resp(int fd, Buf buf)
 	temp32 = remaining_buf(buf);
 	debug3("mpi/pmi2: buf length: %u", temp32);
 	/* put kvs into local hash */
-	while (remaining_buf(buf) > 0) {
-		safe_unpackstr_xmalloc(&key, &temp32, buf);
-		safe_unpackstr_xmalloc(&val, &temp32, buf);
-		kvs_put(key, val);
-		//temp32 = remaining_buf(buf);
-		xfree(key);
-		xfree(val);
-	}
+	if (kvs_put_packed(buf, encoded) != SLURM_SUCCESS)
+		goto unpack_error;
 
 resp:
 	send_kvs_fence_resp_to_clients(rc, errmsg);
@@ -223,6 +242,52 @@ unpack_error:
 	goto resp;
 }
 
+static int
+_handle_kvs_fence_resp(int fd, Buf buf)
+{
+	return _kvs_fence_resp(fd, buf, false);
+}
+
+/* only called in stepd */
+static int
+_handle_kvs_fence_resp_packed(int fd, Buf buf)
+{
+	/* srun only packs the pairs once every stepd of the step accepts it */
+	kvs_packed_enable();
+	return _kvs_fence_resp(fd, buf, true);
+}
+
+/*
+ * only called in srun
+ * Once every stepd of the step announced it accepts pairs encoded by
+ * kvs_pack(), srun sends the later fence responses packed.
+ */
+static int
+_handle_kvs_pack_capable(int fd, Buf buf)
+{
+	static bitstr_t *capable = NULL;
+	uint32_t nodeid;
+
+	safe_unpack32(&nodeid, buf);
+	if (nodeid >= job_info.nnodes) {
+		error("mpi/pmi2: invalid node id %u of packed kvs capability",
+		      nodeid);
+		return SLURM_ERROR;
+	}
+	if (!capable)
+		capable = bit_alloc(job_info.nnodes);
+	bit_set(capable, nodeid);
+	if (!kvs_packed && (bit_set_count(capable) == job_info.nnodes)) {
+		debug("mpi/pmi2: all stepds accept packed kvs pairs");
+		kvs_packed = 1;
+	}
+	return SLURM_SUCCESS;
+
+unpack_error:
+	error("mpi/pmi2: failed to unpack kvs pack capability message");
+	return SLURM_ERROR;
+}
+
 /* only called in srun */
 static int
 _handle_spawn(int fd, Buf buf)
@@ -591,6 +656,13 @@ unpack_error:
 	goto out;
 }
 
+/* only called in stepd */
+static int
+_handle_kvs_allgather(int fd, Buf buf)
+{
+	return kvs_allgather_recv(buf);
+}
+
 /**************************************************************/
 extern int
 handle_tree_cmd(int fd)
@@ -48,6 +48,10 @@ enum {
 	TREE_CMD_NAME_LOOKUP,
 	TREE_CMD_RING,
 	TREE_CMD_RING_RESP,
+	TREE_CMD_KVS_ALLGATHER,
+	TREE_CMD_KVS_FENCE_PACKED,	/* pairs encoded by kvs_pack() */
+	TREE_CMD_KVS_FENCE_RESP_PACKED,
+	TREE_CMD_KVS_PACK_CAPABLE,	/* stepd accepts packed pairs */
 	TREE_CMD_COUNT
 };
 
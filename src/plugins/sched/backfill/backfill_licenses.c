@@ -194,8 +194,12 @@ static int _lt_find_lic_name(void *x, void *key) {
 }
 
 void dump_lic_tracker(lic_tracker_p lt) {
-  ListIterator iter = list_iterator_create(lt->other_licenses);
+  ListIterator iter;
   lt_entry_t *entry;
+  /* everything below is debug3, do not walk the trackers for nothing */
+  if (get_log_level() < LOG_LEVEL_DEBUG3)
+    return;
+  iter = list_iterator_create(lt->other_licenses);
   debug3("dumping licenses tracker; resolution: %d", lt->resolution);
   while ((entry = list_next(iter))) {
     debug3("license: %s, total: %d", entry->name, entry->total);
@@ -215,6 +215,8 @@ _dump_item(void *item, void *arg) {
 
 void
 ut_int_dump(utracker_int_t ut) {
+  if (get_log_level() < LOG_LEVEL_DEBUG3)
+    return;
   log("--------------------------------");
   list_for_each(ut, _dump_item, NULL);
   log("--------------------------------");
@@ -4167,8 +4167,8 @@ extern bitstr_t * select_p_resv_test(resv_desc_msg_t *resv_desc_ptr,
 	for (i=0; i<switch_record_cnt; i++) {
 		switches_bitmap[i] = bit_copy(switch_record_table[i].
 					      node_bitmap);
-		bit_and(switches_bitmap[i], avail_bitmap);
-		switches_node_cnt[i] = bit_set_count(switches_bitmap[i]);
+		switches_node_cnt[i] = bit_and_count(switches_bitmap[i],
+						     avail_bitmap);
 	}
 
 #if SELECT_DEBUG
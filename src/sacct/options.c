@@ -588,40 +588,17 @@ static void _remove_duplicate_fed_jobs(List jobs)
 	xfree(hash_job);
 }
 
-extern int get_data(void)
+/* Set the uid and aggregate the step statistics of the jobs */
+static void _process_jobs(List job_list)
 {
 	slurmdb_job_rec_t *job = NULL;
 	slurmdb_step_rec_t *step = NULL;
 	ListIterator itr = NULL;
 	ListIterator itr_step = NULL;
-	slurmdb_job_cond_t *job_cond = params.job_cond;
 	int cnt;
 	char *tmp_usage;
 
-	if (params.opt_completion) {
-		jobs = slurmdb_jobcomp_jobs_get(job_cond);
-		return SLURM_SUCCESS;
-	} else {
-		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
-	}
-
-	if (!jobs)
-		return SLURM_ERROR;
-
-	/*
-	 * Remove duplicate federated jobs. The db will remove duplicates for
-	 * one cluster but not when jobs for multiple clusters are requested.
-	 * Remove the current job if there were jobs with the same id submitted
-	 * in the future.
-	 * Else sort the jobs to order the jobs so the last task of arrays don't
-	 * appear to run before any of the other tasks.
-	 */
-	if (params.cluster_name && !(job_cond->flags & JOBCOND_FLAG_DUP))
-		_remove_duplicate_fed_jobs(jobs);
-	else
-		list_sort(jobs, _sort_desc_submit_time);
-
-	itr = list_iterator_create(jobs);
+	itr = list_iterator_create(job_list);
 	while ((job = list_next(itr))) {
 
 		if (job->user) {
@@ -667,10 +644,88 @@ extern int get_data(void)
 		list_iterator_destroy(itr_step);
 	}
 	list_iterator_destroy(itr);
+}
+
+extern int get_data(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+
+	if (params.opt_completion) {
+		jobs = slurmdb_jobcomp_jobs_get(job_cond);
+		return SLURM_SUCCESS;
+	} else {
+		jobs = slurmdb_jobs_get(acct_db_conn, job_cond);
+	}
+
+	if (!jobs)
+		return SLURM_ERROR;
+
+	/*
+	 * Remove duplicate federated jobs. The db will remove duplicates for
+	 * one cluster but not when jobs for multiple clusters are requested.
+	 * Remove the current job if there were jobs with the same id submitted
+	 * in the future.
+	 * Else sort the jobs to order the jobs so the last task of arrays don't
+	 * appear to run before any of the other tasks.
+	 */
+	if (params.cluster_name && !(job_cond->flags & JOBCOND_FLAG_DUP))
+		_remove_duplicate_fed_jobs(jobs);
+	else
+		list_sort(jobs, _sort_desc_submit_time);
+
+	_process_jobs(jobs);
 
 	return SLURM_SUCCESS;
 }
 
+/*
+ * Jobs of a single cluster not needing federated duplicates removed can be
+ * listed a page at a time as they come from the database.
+ */
+extern bool paged_data(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+
+	if (params.opt_completion)
+		return false;
+	if (params.cluster_name && !(job_cond->flags & JOBCOND_FLAG_DUP))
+		return false;
+	if (!job_cond->cluster_list || (list_count(job_cond->cluster_list) != 1))
+		return false;
+
+	return true;
+}
+
+/*
+ * Get and list the jobs a page at a time, neither sacct nor the slurmdbd hold
+ * more than SACCT_PAGE_JOBS jobs. Jobs are sorted by submit time in a page,
+ * and pages come in job id order.
+ */
+extern int get_and_list_paged_data(void)
+{
+	slurmdb_job_cond_t *job_cond = params.job_cond;
+	slurmdb_job_cursor_t cursor;
+	int rc = SLURM_SUCCESS;
+
+	memset(&cursor, 0, sizeof(cursor));
+	cursor.max_jobs = SACCT_PAGE_JOBS;
+
+	while (!cursor.done) {
+		if (!(jobs = slurmdb_jobs_get_page(acct_db_conn, job_cond,
+						   &cursor))) {
+			rc = SLURM_ERROR;
+			break;
+		}
+		list_sort(jobs, _sort_desc_submit_time);
+		_process_jobs(jobs);
+		do_list();
+		FREE_NULL_LIST(jobs);
+	}
+	slurmdb_free_job_cursor_members(&cursor);
+
+	return rc;
+}
+
 extern void parse_command_line(int argc, char **argv)
 {
 	extern int optind;
@@ -182,6 +182,11 @@ int main(int argc, char **argv)
 	switch (op) {
 	case SACCT_LIST:
 		print_fields_header(print_fields_list);
+		if (paged_data()) {
+			if (get_and_list_paged_data() == SLURM_ERROR)
+				exit(errno);
+			break;
+		}
 		if (get_data() == SLURM_ERROR)
 			exit(errno);
 		if (params.opt_completion)
@@ -71,6 +71,7 @@
 #define LONG_COMP_FIELDS "jobid,uid,jobname,partition,nnodes,nodelist,state,start,end,timelimit"
 
 #define MAX_PRINTFIELDS 100
+#define SACCT_PAGE_JOBS 1000	/* jobs got from the database at once */
 #define FORMAT_STRING_SIZE 34
 
 #define SECONDS_IN_MINUTE 60
@@ -230,6 +231,8 @@ void print_fields(type_t type, void *object);
 
 /* options.c */
 int  get_data(void);
+bool paged_data(void);
+int  get_and_list_paged_data(void);
 void parse_command_line(int argc, char **argv);
 void do_help(void);
 void do_list(void);
@@ -309,6 +309,11 @@ extern char *process_options_first_pass(int argc, char **argv)
 		error("Script arguments not permitted with --wrap option");
 		exit(error_exit);
 	}
+	if (sbopt.manifest &&
+	    ((local_argc > optind) || sbopt.wrap || (local_argc != argc))) {
+		error("--manifest is not permitted with a batch script, --wrap or heterogeneous job options");
+		exit(error_exit);
+	}
 	if (local_argc > optind) {
 		int i;
 		char **leftover;
@@ -1142,6 +1147,8 @@ static void _help(void)
 "      --mail-type=type        notify on state change: BEGIN, END, FAIL or ALL\n"
 "      --mail-user=user        who to send email notification for job state\n"
 "                              changes\n"
+"      --manifest=file         submit every batch script listed in file as a\n"
+"                              separate job with a single request\n"
 "      --mcs-label=mcs         mcs label if mcs plugin mcs/group is used\n"
 "  -n, --ntasks=ntasks         number of tasks to run\n"
 "      --nice[=value]          decrease scheduling priority by value\n"
@@ -81,6 +81,7 @@ static int   _set_rlimit_env(void);
 static void  _set_spank_env(void);
 static void  _set_submit_dir_env(void);
 static int   _set_umask_env(void);
+static int   _submit_manifest(int argc, char **argv, bool quiet);
 
 int main(int argc, char **argv)
 {
@@ -130,6 +131,9 @@ int main(int argc, char **argv)
 		log_alter(logopt, 0, NULL);
 	}
 
+	if (sbopt.manifest)
+		exit(_submit_manifest(argc, argv, quiet));
+
 	if (sbopt.wrap != NULL) {
 		script_body = _script_wrap(sbopt.wrap);
 	} else {
@@ -353,6 +357,177 @@ int main(int argc, char **argv)
 	return rc;
 }
 
+/* Replace sbopt's script arguments with the words of a manifest line */
+static void _set_manifest_script_args(char *line)
+{
+	char *tok, *save_ptr = NULL, *fullpath;
+	int i;
+
+	for (i = 0; i < sbopt.script_argc; i++)
+		xfree(sbopt.script_argv[i]);
+	xfree(sbopt.script_argv);
+	sbopt.script_argc = 0;
+
+	tok = strtok_r(line, " \t\n", &save_ptr);
+	while (tok) {
+		xrealloc(sbopt.script_argv,
+			 (sbopt.script_argc + 2) * sizeof(char *));
+		sbopt.script_argv[sbopt.script_argc++] = xstrdup(tok);
+		tok = strtok_r(NULL, " \t\n", &save_ptr);
+	}
+	if (!sbopt.script_argc)
+		return;
+	sbopt.script_argv[sbopt.script_argc] = NULL;
+
+	if ((fullpath = search_path(opt.chdir, sbopt.script_argv[0], false,
+				    R_OK, false))) {
+		xfree(sbopt.script_argv[0]);
+		sbopt.script_argv[0] = fullpath;
+	}
+}
+
+static void _free_job_desc(void *x)
+{
+	slurm_free_job_desc_msg((job_desc_msg_t *) x);
+}
+
+/*
+ * Submit every batch script listed in the --manifest file as an independent
+ * job with a single RPC. Each line names a batch script followed by its
+ * arguments, blank lines and lines starting with '#' are ignored. Options
+ * from the command line and environment apply to every job, on top of the
+ * #SBATCH options of its script.
+ * RET exit code for sbatch
+ */
+static int _submit_manifest(int argc, char **argv, bool quiet)
+{
+	FILE *fp;
+	char *line = NULL, *script_name, *script_body;
+	size_t line_size = 0;
+	int argc_off = 0, script_size, line_cnt = 0, rc = 0;
+	bool more_packs = false;
+	List job_req_list, resp_list = NULL;
+	ListIterator iter;
+	job_desc_msg_t *desc;
+	submit_response_msg_t *resp;
+
+	if (!(fp = fopen(sbopt.manifest, "r"))) {
+		error("Unable to open manifest %s: %m", sbopt.manifest);
+		return error_exit;
+	}
+
+	job_req_list = list_create(_free_job_desc);
+	while (getline(&line, &line_size, fp) != -1) {
+		line_cnt++;
+		_set_manifest_script_args(line);
+		if (!sbopt.script_argc || (sbopt.script_argv[0][0] == '#'))
+			continue;
+
+		script_name = sbopt.script_argv[0];
+		if (!(script_body = _get_script_buffer(script_name,
+							&script_size))) {
+			error("%s line %d: invalid batch script %s",
+			      sbopt.manifest, line_cnt, script_name);
+			rc = error_exit;
+			break;
+		}
+
+		init_envs(&pack_env);
+		process_options_second_pass(argc, argv, &argc_off, 0,
+					    &more_packs,
+					    xbasename(script_name),
+					    script_body, script_size);
+		if (more_packs) {
+			error("%s line %d: heterogeneous jobs are not supported with --manifest",
+			      sbopt.manifest, line_cnt);
+			xfree(script_body);
+			rc = error_exit;
+			break;
+		}
+		if (sbopt.test_only || sbopt.wait) {
+			error("--test-only and --wait are not supported with --manifest");
+			xfree(script_body);
+			rc = error_exit;
+			break;
+		}
+
+		if (opt.burst_buffer_file) {
+			Buf buf = create_mmap_buf(opt.burst_buffer_file);
+			if (!buf) {
+				error("Invalid --bbf specification");
+				exit(error_exit);
+			}
+			_add_bb_to_script(&script_body, get_buf_data(buf));
+			free_buf(buf);
+		}
+
+		if (spank_init_post_opt() < 0) {
+			error("Plugin stack post-option processing failed");
+			exit(error_exit);
+		}
+
+		if (opt.get_user_env_time < 0)
+			(void) _set_rlimit_env();
+		if (sbopt.export_file != NULL)
+			env_unset_environment();
+
+		_set_prio_process_env();
+		_set_spank_env();
+		_set_submit_dir_env();
+		_set_umask_env();
+
+		desc = xmalloc(sizeof(job_desc_msg_t));
+		slurm_init_job_desc_msg(desc);
+		if (_fill_job_desc_from_opts(desc) == -1)
+			exit(error_exit);
+		set_env_from_opts(&opt, &desc->environment, -1);
+		set_envs(&desc->environment, &pack_env, -1);
+		desc->env_size = envcount(desc->environment);
+		desc->script = script_body;
+		list_append(job_req_list, desc);
+	}
+	free(line);
+	fclose(fp);
+
+	if (rc == 0) {
+		if (list_count(job_req_list) == 0) {
+			error("No batch scripts found in manifest %s",
+			      sbopt.manifest);
+			rc = error_exit;
+		} else if (slurm_submit_batch_job_list(job_req_list,
+						       &resp_list) < 0) {
+			error("Batch job submission failed: %m");
+			rc = error_exit;
+		}
+	}
+
+	if (resp_list) {
+		iter = list_iterator_create(resp_list);
+		while ((resp = list_next(iter))) {
+			print_multi_line_string(resp->job_submit_user_msg, -1,
+						LOG_LEVEL_INFO);
+			if (!resp->job_id) {
+				error("Batch job submission failed: %s",
+				      slurm_strerror(resp->error_code));
+				rc = error_exit;
+				continue;
+			}
+			cli_filter_plugin_post_submit(0, resp->job_id, NO_VAL);
+			if (quiet)
+				continue;
+			if (!sbopt.parsable)
+				printf("Submitted batch job %u\n", resp->job_id);
+			else
+				printf("%u\n", resp->job_id);
+		}
+		list_iterator_destroy(iter);
+		FREE_NULL_LIST(resp_list);
+	}
+	FREE_NULL_LIST(job_req_list);
+
+	return rc;
+}
+
 /* Insert the contents of "burst_buffer_file" into "script_body" */
 static void  _add_bb_to_script(char **script_body, char *burst_buffer_file)
 {
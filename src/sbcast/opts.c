@@ -72,16 +72,20 @@ extern void parse_command_line(int argc, char **argv)
 {
 	char *sbcast_parameters;
 	char *end_ptr = NULL, *env_val = NULL, *sep, *tmp;
-	int opt_char;
+	int opt_char, i;
 	int option_index;
 	static struct option long_options[] = {
 		{"compress",  optional_argument, 0, 'C'},
 		{"fanout",    required_argument, 0, 'F'},
 		{"force",     no_argument,       0, 'f'},
 		{"jobid",     required_argument, 0, 'j'},
+		{"parallel",  required_argument, 0, 'P'},
 		{"preserve",  no_argument,       0, 'p'},
+		{"recursive", no_argument,       0, 'r'},
 		{"size",      required_argument, 0, 's'},
+		{"sparse",    no_argument,       0, 'S'},
 		{"timeout",   required_argument, 0, 't'},
+		{"update",    no_argument,       0, 'u'},
 		{"verbose",   no_argument,       0, 'v'},
 		{"version",   no_argument,       0, 'V'},
 		{"help",      no_argument,       0, OPT_LONG_HELP},
@@ -111,17 +115,23 @@ extern void parse_command_line(int argc, char **argv)
 	params.pack_job_offset = NO_VAL;
 	params.step_id = NO_VAL;
 
+	if ( ( env_val = getenv("SBCAST_PARALLEL") ) )
+		params.parallel = atoi(env_val);
 	if (getenv("SBCAST_PRESERVE"))
 		params.preserve = true;
 	if ( ( env_val = getenv("SBCAST_SIZE") ) )
 		params.block_size = _map_size(env_val);
 	else
 		params.block_size = 8 * 1024 * 1024;
+	if (getenv("SBCAST_SPARSE"))
+		params.sparse = true;
 	if ( ( env_val = getenv("SBCAST_TIMEOUT") ) )
 		params.timeout = (atoi(env_val) * 1000);
+	if (getenv("SBCAST_UPDATE"))
+		params.update = true;
 
 	optind = 0;
-	while ((opt_char = getopt_long(argc, argv, "CfF:j:ps:t:vV",
+	while ((opt_char = getopt_long(argc, argv, "CfF:j:P:prs:St:uvV",
 			long_options, &option_index)) != -1) {
 		switch (opt_char) {
 		case (int)'?':
@@ -147,15 +157,27 @@ extern void parse_command_line(int argc, char **argv)
 			if (end_ptr[0] == '.')
 				params.step_id = strtol(end_ptr+1, NULL, 10);
 			break;
+		case (int)'P':
+			params.parallel = atoi(optarg);
+			break;
 		case (int)'p':
 			params.preserve = true;
 			break;
+		case (int)'r':
+			params.recursive = true;
+			break;
 		case (int) 's':
 			params.block_size = _map_size(optarg);
 			break;
+		case (int)'S':
+			params.sparse = true;
+			break;
 		case (int)'t':
 			params.timeout = (atoi(optarg) * 1000);
 			break;
+		case (int)'u':
+			params.update = true;
+			break;
 		case (int) 'v':
 			params.verbose++;
 			break;
@@ -171,13 +193,17 @@ extern void parse_command_line(int argc, char **argv)
 		}
 	}
 
-	if ((argc - optind) != 2) {
-		fprintf(stderr, "Need two file names, have %d names\n",
+	if ((argc - optind) < 2) {
+		fprintf(stderr, "Need at least two file names, have %d names\n",
 			(argc - optind));
 		fprintf(stderr, "Try \"sbcast --help\" for more information\n");
 		exit(1);
 	}
 
+	/* the update check compares the times kept by earlier updates */
+	if (params.update)
+		params.preserve = true;
+
 	if (params.job_id == NO_VAL) {
 		if (!(env_val = getenv("SLURM_JOB_ID"))) {
 			error("Need a job id to run this command.  "
@@ -190,17 +216,26 @@ extern void parse_command_line(int argc, char **argv)
 			params.step_id = strtol(end_ptr+1, NULL, 10);
 	}
 
-	params.src_fname = xstrdup(argv[optind]);
+	if ((argc - optind) == 2) {
+		params.src_fname = xstrdup(argv[optind]);
+	} else {
+		/* several sources, copied into the DEST directory */
+		params.src_cnt = argc - optind - 1;
+		params.src_fnames = xmalloc(sizeof(char *) * params.src_cnt);
+		for (i = 0; i < params.src_cnt; i++)
+			params.src_fnames[i] = xstrdup(argv[optind + i]);
+	}
+	optind = argc - 1;
 
-	if (argv[optind+1][0] == '/') {
-		params.dst_fname = xstrdup(argv[optind+1]);
+	if (argv[optind][0] == '/') {
+		params.dst_fname = xstrdup(argv[optind]);
 	} else if (sbcast_parameters &&
 		   (tmp = strcasestr(sbcast_parameters, "DestDir="))) {
 		tmp += 8;
 		sep = strchr(tmp, ',');
 		if (sep)
 			sep[0] = '\0';
-		xstrfmtcat(params.dst_fname, "%s/%s", tmp, argv[optind+1]);
+		xstrfmtcat(params.dst_fname, "%s/%s", tmp, argv[optind]);
 		if (sep)
 			sep[0] = ',';
 	} else {
@@ -210,7 +245,7 @@ extern void parse_command_line(int argc, char **argv)
 		tmp = malloc(PATH_MAX);
 		tmp = getcwd(tmp, PATH_MAX);
 #endif
-		xstrfmtcat(params.dst_fname, "%s/%s", tmp, argv[optind+1]);
+		xstrfmtcat(params.dst_fname, "%s/%s", tmp, argv[optind]);
 		free(tmp);
 	}
 
@@ -246,6 +281,8 @@ static uint32_t _map_size( char *buf )
 /* print the parameters specified */
 static void _print_options( void )
 {
+	int i;
+
 	info("-----------------------------");
 	info("block_size = %u", params.block_size);
 	info("compress   = %u", params.compress);
@@ -268,10 +305,18 @@ static void _print_options( void )
 			     params.step_id);
 		}
 	}
+	info("parallel   = %d", params.parallel);
 	info("preserve   = %s", params.preserve ? "true" : "false");
+	info("recursive  = %s", params.recursive ? "true" : "false");
+	info("sparse     = %s", params.sparse ? "true" : "false");
 	info("timeout    = %d", params.timeout);
+	info("update     = %s", params.update ? "true" : "false");
 	info("verbose    = %d", params.verbose);
-	info("source     = %s", params.src_fname);
+	if (params.src_cnt) {
+		for (i = 0; i < params.src_cnt; i++)
+			info("source     = %s", params.src_fnames[i]);
+	} else
+		info("source     = %s", params.src_fname);
 	info("dest       = %s", params.dst_fname);
 	info("-----------------------------");
 }
@@ -279,20 +324,26 @@ static void _print_options( void )
 
 static void _usage( void )
 {
-	printf("Usage: sbcast [-CfFjpvV] SOURCE DEST\n");
+	printf("Usage: sbcast [-CfFjPprsStuvV] SOURCE... DEST\n");
 }
 
 static void _help( void )
 {
 	printf ("\
 Usage: sbcast [OPTIONS] SOURCE DEST\n\
+       sbcast [OPTIONS] SOURCE... DIRECTORY\n\
   -C, --compress[=lib]  compress the file being transmitted\n\
   -f, --force           replace destination file as required\n\
   -F, --fanout=num      specify message fanout\n\
   -j, --jobid=#[+#][.#] specify job ID with optional pack job offset and/or step ID\n\
+  -P, --parallel=num    number of blocks sent at once\n\
   -p, --preserve        preserve modes and times of source file\n\
+  -r, --recursive       copy directories recursively\n\
   -s, --size=num        block size in bytes (rounded off)\n\
+  -S, --sparse          do not send blocks holding only zeros\n\
   -t, --timeout=secs    specify message timeout (seconds)\n\
+  -u, --update          skip files of same size and mtime on the nodes,\n\
+                        implies --preserve\n\
   -v, --verbose         provide detailed event logging\n\
   -V, --version         print version information and exit\n\
 \nHelp options:\n\
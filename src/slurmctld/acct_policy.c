@@ -40,6 +40,7 @@
 
 #include "src/common/assoc_mgr.h"
 #include "src/common/slurm_accounting_storage.h"
+#include "src/common/xhash.h"
 
 #include "src/slurmctld/slurmctld.h"
 #include "src/slurmctld/acct_policy.h"
@@ -69,6 +70,203 @@ typedef struct pack_limits {
 	slurmdb_qos_rec_t *qos_ptr_2;
 } pack_limits_t;
 
+/*
+ * Remaining room under the group TRES limits of one association.  Entries are
+ * built lazily while the scheduler evaluates jobs and stay valid until the
+ * association data changes, so most post select checks reduce to a vector
+ * compare instead of recomputing usage for every level of the hierarchy.
+ */
+typedef struct {
+	uint32_t assoc_id;
+	bool usable;			/* false if a limit is already reached
+					 * or can not be expressed as room */
+	uint64_t *grp_tres;		/* grp_tres_ctld - grp_used_tres */
+	uint64_t *grp_tres_mins;	/* grp_tres_mins_ctld - usage (- run
+					 * minutes when using safe limits) */
+	uint64_t *grp_tres_run_mins;	/* grp_tres_run_mins_ctld - run mins */
+} assoc_headroom_t;
+
+static pthread_mutex_t headroom_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xhash_t *headroom_hash = NULL;
+static uint32_t headroom_gen = 0;
+static uint32_t headroom_tres_cnt = 0;
+static uint16_t headroom_enforce = 0;
+
+static void _headroom_identify(void *item, const char **key,
+			       uint32_t *key_len)
+{
+	assoc_headroom_t *headroom = (assoc_headroom_t *)item;
+
+	*key = (const char *)&headroom->assoc_id;
+	*key_len = sizeof(headroom->assoc_id);
+}
+
+static void _headroom_free(void *item)
+{
+	assoc_headroom_t *headroom = (assoc_headroom_t *)item;
+
+	if (!headroom)
+		return;
+	xfree(headroom->grp_tres);
+	xfree(headroom->grp_tres_mins);
+	xfree(headroom->grp_tres_run_mins);
+	xfree(headroom);
+}
+
+/*
+ * Fill in the room left under the group limits of an association from its
+ * current usage.  The room is computed so that a request fitting in it passes
+ * the corresponding checks in acct_policy_job_runnable_post_select() no
+ * matter which QOS or admin overrides apply.  Anything else (a limit already
+ * reached, a GrpTRES node limit which depends on the nodes selected) marks
+ * the entry unusable so the full check is done.
+ * NOTE: assoc_mgr READ_LOCK on assoc must be held.
+ */
+static void _headroom_fill(assoc_headroom_t *headroom,
+			   slurmdb_assoc_rec_t *assoc_ptr)
+{
+	slurmdb_assoc_usage_t *usage = assoc_ptr->usage;
+	bool safe_limits = (headroom_enforce & ACCOUNTING_ENFORCE_SAFE);
+	uint64_t limit, used, usage_mins, run_mins;
+	int i;
+
+	headroom->usable = true;
+	if (assoc_ptr->grp_tres_ctld[TRES_ARRAY_NODE] != INFINITE64)
+		headroom->usable = false;
+
+	for (i = 0; i < headroom_tres_cnt; i++) {
+		usage_mins = (uint64_t)(usage->usage_tres_raw[i] / 60);
+		run_mins = usage->grp_used_tres_run_secs[i] / 60;
+
+		limit = assoc_ptr->grp_tres_ctld[i];
+		used = usage->grp_used_tres[i];
+		if (limit == INFINITE64)
+			headroom->grp_tres[i] = INFINITE64;
+		else if (used > limit)
+			headroom->usable = false;
+		else
+			headroom->grp_tres[i] = limit - used;
+
+		limit = assoc_ptr->grp_tres_mins_ctld[i];
+		if (limit == INFINITE64)
+			headroom->grp_tres_mins[i] = INFINITE64;
+		else if (usage_mins >= limit)
+			headroom->usable = false;
+		else if (!safe_limits)
+			headroom->grp_tres_mins[i] = INFINITE64;
+		else if (run_mins > (limit - usage_mins))
+			headroom->usable = false;
+		else
+			headroom->grp_tres_mins[i] =
+				limit - usage_mins - run_mins;
+
+		limit = assoc_ptr->grp_tres_run_mins_ctld[i];
+		if (limit == INFINITE64)
+			headroom->grp_tres_run_mins[i] = INFINITE64;
+		else if (run_mins > limit)
+			headroom->usable = false;
+		else
+			headroom->grp_tres_run_mins[i] = limit - run_mins;
+	}
+}
+
+/* Throw away all cached headroom. NOTE: headroom_mutex must be locked. */
+static void _headroom_flush(void)
+{
+	if (headroom_hash)
+		xhash_free(headroom_hash);
+	headroom_hash = xhash_init(_headroom_identify, _headroom_free);
+	headroom_gen = g_assoc_write_gen;
+	headroom_tres_cnt = g_tres_count;
+	headroom_enforce = accounting_enforce;
+}
+
+/*
+ * Check the job's request against the cached group limit headroom of an
+ * association.
+ * RET true if the request fits, in which case the group TRES, TRES minutes
+ *     and TRES running minutes checks of this association would pass and may
+ *     be skipped.  false means nothing, the full checks must be done.
+ * NOTE: assoc_mgr READ_LOCK on assoc must be held.
+ */
+static bool _assoc_headroom_fits(slurmdb_assoc_rec_t *assoc_ptr,
+				 uint64_t *tres_req_cnt,
+				 uint64_t *job_tres_time_limit)
+{
+	assoc_headroom_t *headroom;
+	bool fits = true;
+	int i;
+
+	slurm_mutex_lock(&headroom_mutex);
+	if (!headroom_hash || (headroom_gen != g_assoc_write_gen) ||
+	    (headroom_tres_cnt != g_tres_count) ||
+	    (headroom_enforce != accounting_enforce))
+		_headroom_flush();
+
+	if (!(headroom = xhash_get(headroom_hash,
+				   (const char *)&assoc_ptr->id,
+				   sizeof(assoc_ptr->id)))) {
+		headroom = xmalloc(sizeof(assoc_headroom_t));
+		headroom->assoc_id = assoc_ptr->id;
+		headroom->grp_tres = xcalloc(headroom_tres_cnt,
+					     sizeof(uint64_t));
+		headroom->grp_tres_mins = xcalloc(headroom_tres_cnt,
+						  sizeof(uint64_t));
+		headroom->grp_tres_run_mins = xcalloc(headroom_tres_cnt,
+						      sizeof(uint64_t));
+		_headroom_fill(headroom, assoc_ptr);
+		xhash_add(headroom_hash, headroom);
+	}
+
+	if (!headroom->usable) {
+		fits = false;
+	} else {
+		for (i = 0; i < headroom_tres_cnt; i++) {
+			if ((tres_req_cnt[i] > headroom->grp_tres[i]) ||
+			    (job_tres_time_limit[i] >
+			     headroom->grp_tres_mins[i]) ||
+			    (job_tres_time_limit[i] >
+			     headroom->grp_tres_run_mins[i])) {
+				fits = false;
+				break;
+			}
+		}
+	}
+	slurm_mutex_unlock(&headroom_mutex);
+
+	return fits;
+}
+
+/*
+ * Bring the cached headroom of an association and its parents up to date
+ * after their usage was changed by us.  If anybody else wrote association
+ * data since the cache was last validated, the cache is thrown away on the
+ * next lookup instead.
+ * NOTE: assoc_mgr WRITE_LOCK on assoc must be held.
+ */
+static void _headroom_update(slurmdb_assoc_rec_t *assoc_ptr)
+{
+	assoc_headroom_t *headroom;
+
+	slurm_mutex_lock(&headroom_mutex);
+	if (!headroom_hash || ((headroom_gen + 1) != g_assoc_write_gen) ||
+	    (headroom_tres_cnt != g_tres_count) ||
+	    (headroom_enforce != accounting_enforce)) {
+		slurm_mutex_unlock(&headroom_mutex);
+		return;
+	}
+	headroom_gen = g_assoc_write_gen;
+
+	while (assoc_ptr) {
+		if ((headroom = xhash_get(headroom_hash,
+					  (const char *)&assoc_ptr->id,
+					  sizeof(assoc_ptr->id))))
+			_headroom_fill(headroom, assoc_ptr);
+		assoc_ptr = assoc_ptr->usage->parent_assoc_ptr;
+	}
+	slurm_mutex_unlock(&headroom_mutex);
+}
+
 /*
  * Update a job's allocated node count to reflect only nodes that are not
  * already allocated to this association.  Needed to enforce GrpNode limit.
@@ -1018,6 +1216,7 @@ static void _adjust_limit_usage(int type, job_record_t *job_ptr)
 		/* now handle all the group limits of the parents */
 		assoc_ptr = assoc_ptr->usage->parent_assoc_ptr;
 	}
+	_headroom_update(job_ptr->assoc_ptr);
 	assoc_mgr_unlock(&locks);
 }
 
@@ -2695,6 +2894,7 @@ extern void acct_policy_alter_job(job_record_t *job_ptr,
 		/* now handle all the group limits of the parents */
 		assoc_ptr = assoc_ptr->usage->parent_assoc_ptr;
 	}
+	_headroom_update(job_ptr->assoc_ptr);
 	assoc_mgr_unlock(&locks);
 }
 
@@ -3740,6 +3940,15 @@ extern bool acct_policy_job_runnable_post_select(job_record_t *job_ptr,
 
 	assoc_ptr = job_ptr->assoc_ptr;
 	while (assoc_ptr) {
+		/*
+		 * If the request fits in the room left under this
+		 * association's group limits none of the group checks below
+		 * can hold the job.
+		 */
+		if (_assoc_headroom_fits(assoc_ptr, tres_req_cnt,
+					 job_tres_time_limit))
+			goto grp_limits_checked;
+
 		for (i = 0; i < slurmctld_tres_cnt; i++) {
 			tres_usage_mins[i] =
 				(uint64_t)(assoc_ptr->usage->usage_tres_raw[i]
@@ -3921,7 +4130,7 @@ extern bool acct_policy_job_runnable_post_select(job_record_t *job_ptr,
 
 		/* we don't need to check grp_wall here */
 
-
+grp_limits_checked:
 		/* We don't need to look at the regular limits for
 		 * parents since we have pre-propogated them, so just
 		 * continue with the next parent
@@ -80,6 +80,10 @@ typedef struct slurm_bb_ops {
 	int		(*job_test_stage_out) (job_record_t *job_ptr);
 	int		(*job_cancel) (job_record_t *job_ptr);
 	char *		(*xlate_bb_2_tres_str) (char *burst_buffer);
+	char *		(*job_get_node_dir) (job_record_t *job_ptr,
+					     bool stage_in,
+					     uint64_t *bandwidth,
+					     uint32_t *timeout);
 } slurm_bb_ops_t;
 
 /*
@@ -103,7 +107,8 @@ static const char *syms[] = {
 	"bb_p_job_test_post_run",
 	"bb_p_job_test_stage_out",
 	"bb_p_job_cancel",
-	"bb_p_xlate_bb_2_tres_str"
+	"bb_p_xlate_bb_2_tres_str",
+	"bb_p_job_get_node_dir"
 };
 
 static int g_context_cnt = -1;
@@ -804,3 +809,35 @@ extern char *bb_g_xlate_bb_2_tres_str(char *burst_buffer)
 
 	return tmp;
 }
+
+/*
+ * Return the directory in which the slurmd daemons stage a job's files in
+ * and out, NULL if its burst buffer is not staged on the compute nodes
+ * IN stage_in - true for the stage-in limits, false for the stage-out ones
+ * OUT bandwidth - per node staging rate in bytes per second, 0 for no limit
+ * OUT timeout - staging time limit in seconds, 0 for no limit
+ * Caller must xfree the return value
+ */
+extern char *bb_g_job_get_node_dir(job_record_t *job_ptr, bool stage_in,
+				   uint64_t *bandwidth, uint32_t *timeout)
+{
+	DEF_TIMERS;
+	int i;
+	char *dir = NULL;
+
+	*bandwidth = 0;
+	*timeout = 0;
+	if (!job_ptr->burst_buffer || !job_ptr->burst_buffer[0])
+		return NULL;
+
+	START_TIMER;
+	(void) bb_g_init();
+	slurm_mutex_lock(&g_context_lock);
+	for (i = 0; (i < g_context_cnt) && !dir; i++)
+		dir = (*(ops[i].job_get_node_dir))(job_ptr, stage_in,
+						     bandwidth, timeout);
+	slurm_mutex_unlock(&g_context_lock);
+	END_TIMER2(__func__);
+
+	return dir;
+}
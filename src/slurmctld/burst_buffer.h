@@ -219,4 +219,15 @@ extern int bb_g_job_cancel(job_record_t *job_ptr);
  */
 extern char *bb_g_xlate_bb_2_tres_str(char *burst_buffer);
 
+/*
+ * Return the directory in which the slurmd daemons stage a job's files in
+ * and out, NULL if its burst buffer is not staged on the compute nodes
+ * IN stage_in - true for the stage-in limits, false for the stage-out ones
+ * OUT bandwidth - per node staging rate in bytes per second, 0 for no limit
+ * OUT timeout - staging time limit in seconds, 0 for no limit
+ * Caller must xfree the return value
+ */
+extern char *bb_g_job_get_node_dir(job_record_t *job_ptr, bool stage_in,
+				   uint64_t *bandwidth, uint32_t *timeout);
+
 #endif /* !_SLURM_BURST_BUFFER_H */
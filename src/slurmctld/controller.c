@@ -253,6 +253,7 @@ static void         _update_assoc(slurmdb_assoc_rec_t *rec);
 inline static void  _update_cred_key(void);
 static void         _update_diag_job_state_counts(void);
 static void         _update_cluster_tres(void);
+static void         _update_log_async(void);
 static void         _update_nice(void);
 static void         _update_qos(slurmdb_qos_rec_t *rec);
 inline static void  _usage(char *prog_name);
@@ -335,6 +336,8 @@ int main(int argc, char **argv)
 			  slurmctld_conf.slurmctld_logfile);
 		sched_log_alter(sched_log_opts, LOG_DAEMON,
 				slurmctld_conf.sched_logfile);
+		/* the log writer thread did not survive daemonizing */
+		_update_log_async();
 		sched_debug("slurmctld starting");
 	} else {
 		slurmctld_config.daemonize = 0;
@@ -2827,6 +2830,7 @@ void update_logging(void)
 		  slurmctld_conf.slurmctld_logfile);
 
 	log_set_timefmt(slurmctld_conf.log_fmt);
+	_update_log_async();
 
 	debug("Log file re-opened");
 
@@ -2859,6 +2863,22 @@ void update_logging(void)
 	}
 }
 
+/* Set asynchronous logging from SlurmctldParameters=log_async[=block|drop] */
+static void _update_log_async(void)
+{
+	log_async_t mode = LOG_ASYNC_OFF;
+	char *tmp_ptr;
+
+	if ((tmp_ptr = xstrcasestr(slurmctld_conf.slurmctld_params,
+				   "log_async"))) {
+		if (!xstrncasecmp(tmp_ptr, "log_async=drop", 14))
+			mode = LOG_ASYNC_DROP;
+		else
+			mode = LOG_ASYNC_BLOCK;
+	}
+	log_set_async(mode);
+}
+
 /* Reset slurmd nice value */
 static void _update_nice(void)
 {
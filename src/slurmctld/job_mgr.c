@@ -157,6 +157,8 @@ static uint32_t highest_prio = 0;
 static uint32_t lowest_prio  = TOP_PRIORITY;
 static int      hash_table_size = 0;
 static int      job_count = 0;		/* job's in the system */
+static uint32_t job_pack_size = 0;	/* avg packed job in pack_all_jobs */
+static pthread_mutex_t job_pack_size_lock = PTHREAD_MUTEX_INITIALIZER;
 static uint32_t job_id_sequence = 0;	/* first job_id to assign new job */
 static struct   job_record **job_hash = NULL;
 static struct   job_record **job_array_hash_j = NULL;
@@ -4364,6 +4366,46 @@ int init_job_conf(void)
 	return SLURM_SUCCESS;
 }
 
+static int _rehash_job(void *x, void *arg)
+{
+	job_record_t *job_ptr = (job_record_t *) x;
+
+	job_ptr->job_next = NULL;
+	job_ptr->job_array_next_j = NULL;
+	job_ptr->job_array_next_t = NULL;
+	_add_job_hash(job_ptr);
+	_add_job_array_hash(job_ptr);
+
+	return 0;
+}
+
+/*
+ * _resize_job_hash - Replace the job hash tables with ones of a new size and
+ *	re-insert every job record
+ * IN new_size - new number of hash buckets
+ * Globals: hash tables and hash_table_size updated
+ */
+static void _resize_job_hash(int new_size)
+{
+	DEF_TIMERS;
+
+	START_TIMER;
+	xfree(job_hash);
+	xfree(job_array_hash_j);
+	xfree(job_array_hash_t);
+
+	hash_table_size = new_size;
+	job_hash = xcalloc(hash_table_size, sizeof(job_record_t *));
+	job_array_hash_j = xcalloc(hash_table_size, sizeof(job_record_t *));
+	job_array_hash_t = xcalloc(hash_table_size, sizeof(job_record_t *));
+
+	if (job_list)
+		list_for_each(job_list, _rehash_job, NULL);
+	END_TIMER2("_resize_job_hash");
+	info("%s: job hash tables resized to %d entries for %d jobs %s",
+	     __func__, hash_table_size, job_count, TIME_STR);
+}
+
 /*
  * rehash_jobs - Create or rebuild the job hash table.
  */
@@ -4379,13 +4421,14 @@ extern void rehash_jobs(void)
 					   sizeof(job_record_t *));
 		job_array_hash_t = xcalloc(hash_table_size,
 					   sizeof(job_record_t *));
-	} else if (hash_table_size < (slurmctld_conf.max_job_cnt / 2)) {
-		/* If the MaxJobCount grows by too much, the hash table will
-		 * be ineffective without rebuilding. We don't presently bother
-		 * to rebuild the hash table, but cut MaxJobCount back as
-		 * needed. */
-		error ("MaxJobCount reset too high, restart slurmctld");
-		slurmctld_conf.max_job_cnt = hash_table_size;
+	} else if (hash_table_size < slurmctld_conf.max_job_cnt) {
+		/*
+		 * If the MaxJobCount grows the hash chains get longer and
+		 * every job lookup slows down, so rebuild the tables with the
+		 * new size. This is done once per reconfiguration while
+		 * holding the job write lock.
+		 */
+		_resize_job_hash(slurmctld_conf.max_job_cnt);
 	}
 }
 
@@ -9577,7 +9620,8 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 			  uint16_t show_flags, uid_t uid, uint32_t filter_uid,
 			  uint16_t protocol_version)
 {
-	uint32_t jobs_packed = 0, tmp_offset;
+	uint32_t jobs_packed = 0, tmp_offset, hdr_offset;
+	uint64_t reserve;
 	_foreach_pack_job_info_t pack_info = {0};
 	Buf buffer;
 	ListIterator itr;
@@ -9592,6 +9636,16 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	/* put in a place holder job record count of 0 for now */
 	pack32(jobs_packed, buffer);
 	pack_time(time(NULL), buffer);
+	hdr_offset = get_buf_offset(buffer);
+
+	/* Size the buffer from the previous reply to avoid growing it */
+	if (filter_uid == NO_VAL) {
+		slurm_mutex_lock(&job_pack_size_lock);
+		reserve = (uint64_t) job_pack_size * list_count(job_list);
+		slurm_mutex_unlock(&job_pack_size_lock);
+		if (reserve)
+			reserve_buf(buffer, MIN(reserve, REASONABLE_BUF_SIZE));
+	}
 
 	/* write individual job records */
 	pack_info.buffer           = buffer;
@@ -9613,6 +9667,12 @@ extern void pack_all_jobs(char **buffer_ptr, int *buffer_size,
 	pack32(jobs_packed, buffer);
 	set_buf_offset(buffer, tmp_offset);
 
+	if (jobs_packed) {
+		slurm_mutex_lock(&job_pack_size_lock);
+		job_pack_size = (tmp_offset - hdr_offset) / jobs_packed;
+		slurm_mutex_unlock(&job_pack_size_lock);
+	}
+
 	*buffer_size = get_buf_offset(buffer);
 	buffer_ptr[0] = xfer_buf_data(buffer);
 }
@@ -14206,6 +14266,11 @@ static void _send_job_kill(job_record_t *job_ptr)
 	kill_job->spank_job_env = xduparray(job_ptr->spank_job_env_size,
 					    job_ptr->spank_job_env);
 	kill_job->spank_job_env_size = job_ptr->spank_job_env_size;
+	kill_job->bb_dir = bb_g_job_get_node_dir(job_ptr, false,
+						 &kill_job->bb_bandwidth,
+						 &kill_job->bb_timeout);
+	if (kill_job->bb_dir)
+		kill_job->burst_buffer = xstrdup(job_ptr->burst_buffer);
 
 #ifdef HAVE_FRONT_END
 	if (job_ptr->batch_host &&
@@ -1,7 +1,7 @@
 /*****************************************************************************\
  *  node_mgr.c - manage the node records of slurm
  *	Note: there is a global node table (node_record_table_ptr), its
- *	hash table (node_hash_table), time stamp (last_node_update) and
+ *	name index (node_slot), time stamp (last_node_update) and
  *	configuration list (config_list)
  *****************************************************************************
  *  Copyright (C) 2002-2007 The Regents of the University of California.
@@ -519,6 +519,11 @@ extern void deallocate_nodes(job_record_t *job_ptr, bool timeout,
 	kill_job->spank_job_env = xduparray(job_ptr->spank_job_env_size,
 					    job_ptr->spank_job_env);
 	kill_job->spank_job_env_size = job_ptr->spank_job_env_size;
+	kill_job->bb_dir = bb_g_job_get_node_dir(job_ptr, false,
+						 &kill_job->bb_bandwidth,
+						 &kill_job->bb_timeout);
+	if (kill_job->bb_dir)
+		kill_job->burst_buffer = xstrdup(job_ptr->burst_buffer);
 
 #ifdef HAVE_FRONT_END
 	if (job_ptr->batch_host &&
@@ -1389,9 +1394,8 @@ static int _get_req_features(struct node_set *node_set_ptr, int node_set_size,
 					continue;
 				inactive_bitmap =
 					bit_copy(node_set_ptr[i].my_bitmap);
-				bit_and_not(inactive_bitmap,
-					    feat_ptr->node_bitmap_active);
-				if (bit_ffs(inactive_bitmap) == -1) {
+				if (!bit_and_not_any(inactive_bitmap,
+						feat_ptr->node_bitmap_active)) {
 					/* No inactive nodes (require reboot) */
 					FREE_NULL_BITMAP(inactive_bitmap);
 					continue;
@@ -3368,6 +3372,11 @@ extern void launch_prolog(job_record_t *job_ptr)
 	prolog_msg_ptr->spank_job_env_size = job_ptr->spank_job_env_size;
 	prolog_msg_ptr->spank_job_env = xduparray(job_ptr->spank_job_env_size,
 						  job_ptr->spank_job_env);
+	prolog_msg_ptr->bb_dir = bb_g_job_get_node_dir(job_ptr, true,
+					&prolog_msg_ptr->bb_bandwidth,
+					&prolog_msg_ptr->bb_timeout);
+	if (prolog_msg_ptr->bb_dir)
+		prolog_msg_ptr->burst_buffer = xstrdup(job_ptr->burst_buffer);
 
 	xassert(job_ptr->job_resrcs);
 	job_resrcs_ptr = job_ptr->job_resrcs;
@@ -4691,6 +4700,11 @@ extern void re_kill_job(job_record_t *job_ptr)
 	kill_job->spank_job_env = xduparray(job_ptr->spank_job_env_size,
 					    job_ptr->spank_job_env);
 	kill_job->spank_job_env_size = job_ptr->spank_job_env_size;
+	kill_job->bb_dir = bb_g_job_get_node_dir(job_ptr, false,
+						 &kill_job->bb_bandwidth,
+						 &kill_job->bb_timeout);
+	if (kill_job->bb_dir)
+		kill_job->burst_buffer = xstrdup(job_ptr->burst_buffer);
 
 	/* On a Cray system this will start the NHC early so it is
 	 * able to gather any information it can from the apparent
@@ -321,6 +321,9 @@ void ping_nodes (void)
 			continue;
 		}
 
+		/* Nodes pushing heartbeats (SlurmdParameters=heartbeat)
+		 * keep these times current and are only pinged once
+		 * their heartbeat is overdue. */
 		if ((!IS_NODE_NO_RESPOND(node_ptr)) &&
 		    (node_ptr->last_response >= still_live_time) &&
 		    (node_ptr->cpu_load_time >= old_cpu_load_time) &&
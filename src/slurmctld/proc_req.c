@@ -104,6 +104,11 @@
 #include "src/slurmctld/state_save.h"
 #include "src/slurmctld/trigger_mgr.h"
 
+/* Jobs per REQUEST_SUBMIT_BATCH_JOB_LIST, see max_submit_job_list */
+#define DEFAULT_MAX_SUBMIT_JOB_LIST	1000
+/* Jobs created per hold of the job write lock for such a request */
+#define SUBMIT_JOB_LIST_CHUNK		100
+
 static pthread_mutex_t rpc_mutex = PTHREAD_MUTEX_INITIALIZER;
 static int rpc_type_size = 0;	/* Size of rpc_type_* arrays */
 static uint16_t *rpc_type_id = NULL;
@@ -178,6 +183,8 @@ inline static void  _slurm_rpc_job_will_run(slurm_msg_t * msg);
 inline static void  _slurm_rpc_job_alloc_info(slurm_msg_t * msg);
 inline static void  _slurm_rpc_job_pack_alloc_info(slurm_msg_t * msg);
 inline static void  _slurm_rpc_kill_job(slurm_msg_t *msg);
+inline static void  _slurm_rpc_node_heartbeat(slurm_msg_t *msg,
+					      bool running_composite);
 inline static void  _slurm_rpc_node_registration(slurm_msg_t *msg,
 						 bool running_composite);
 inline static void  _slurm_rpc_ping(slurm_msg_t * msg);
@@ -207,6 +214,7 @@ inline static void  _slurm_rpc_step_layout(slurm_msg_t * msg);
 inline static void  _slurm_rpc_step_update(slurm_msg_t * msg);
 inline static void  _slurm_rpc_submit_batch_job(slurm_msg_t * msg);
 inline static void  _slurm_rpc_submit_batch_pack_job(slurm_msg_t * msg);
+inline static void  _slurm_rpc_submit_batch_job_list(slurm_msg_t * msg);
 inline static void  _slurm_rpc_suspend(slurm_msg_t * msg);
 inline static void  _slurm_rpc_top_job(slurm_msg_t * msg);
 inline static void  _slurm_rpc_trigger_clear(slurm_msg_t * msg);
@@ -406,6 +414,9 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	case MESSAGE_NODE_REGISTRATION_STATUS:
 		_slurm_rpc_node_registration(msg, 0);
 		break;
+	case MESSAGE_NODE_HEARTBEAT:
+		_slurm_rpc_node_heartbeat(msg, 0);
+		break;
 	case REQUEST_JOB_ALLOCATION_INFO:
 		_slurm_rpc_job_alloc_info(msg);
 		break;
@@ -439,6 +450,9 @@ void slurmctld_req(slurm_msg_t *msg, connection_arg_t *arg)
 	case REQUEST_SUBMIT_BATCH_JOB_PACK:
 		_slurm_rpc_submit_batch_pack_job(msg);
 		break;
+	case REQUEST_SUBMIT_BATCH_JOB_LIST:
+		_slurm_rpc_submit_batch_job_list(msg);
+		break;
 	case REQUEST_UPDATE_FRONT_END:
 		_slurm_rpc_update_front_end(msg);
 		break;
@@ -3029,6 +3043,49 @@ static void _slurm_rpc_event_log(slurm_msg_t * msg)
 	slurm_send_rc_msg(msg, error_code);
 }
 
+/* _slurm_rpc_node_heartbeat - process a heartbeat pushed by slurmd, record
+ *	the node as responding so that ping_nodes() need not ping it */
+static void _slurm_rpc_node_heartbeat(slurm_msg_t *msg,
+				      bool running_composite)
+{
+	static int active_rpc_cnt = 0;
+	DEF_TIMERS;
+	/* Locks: Read configuration, write node */
+	slurmctld_lock_t node_write_lock = {
+		READ_LOCK, NO_LOCK, WRITE_LOCK, NO_LOCK, NO_LOCK };
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
+	node_heartbeat_msg_t *hb_msg = (node_heartbeat_msg_t *) msg->data;
+
+	START_TIMER;
+	debug3("Processing RPC: MESSAGE_NODE_HEARTBEAT from uid=%d", uid);
+	if (!validate_slurm_user(uid)) {
+		error("Security violation, NODE_HEARTBEAT RPC from uid=%d",
+		      uid);
+		return;
+	}
+
+	/* Only throttle on non-composite messages, the lock should
+	 * already be set earlier. */
+	if (!running_composite) {
+		_throttle_start(&active_rpc_cnt);
+		lock_slurmctld(node_write_lock);
+	}
+
+	node_did_resp(hb_msg->node_name);
+	reset_node_load(hb_msg->node_name, hb_msg->cpu_load);
+	reset_node_free_mem(hb_msg->node_name, hb_msg->free_mem);
+
+	if (!running_composite) {
+		unlock_slurmctld(node_write_lock);
+		_throttle_fini(&active_rpc_cnt);
+	}
+
+	END_TIMER2("_slurm_rpc_node_heartbeat");
+	log_flag(ROUTE, "%s: node_name = %s %s",
+		 __func__, hb_msg->node_name, TIME_STR);
+	/* NOTE: RPC has no response */
+}
+
 /* _slurm_rpc_node_registration - process RPC to determine if a node's
  *	actual configuration satisfies the configured specification */
 static void _slurm_rpc_node_registration(slurm_msg_t * msg,
@@ -4326,6 +4383,202 @@ send_msg:
 	xfree(job_submit_user_msg);
 }
 
+/*
+ * _slurm_rpc_submit_batch_job_list - process RPC to submit a list of
+ *	independent batch jobs. All requests are validated (including the
+ *	job_submit plugins) under one job read lock and created under the job
+ *	write lock, which is released every SUBMIT_JOB_LIST_CHUNK jobs. A
+ *	response with the job ID or error of every request is returned.
+ */
+static void _slurm_rpc_submit_batch_job_list(slurm_msg_t *msg)
+{
+	static int active_rpc_cnt = 0;
+	static time_t config_update = 0;
+	static int max_job_cnt = DEFAULT_MAX_SUBMIT_JOB_LIST;
+	ListIterator req_iter, resp_iter;
+	int error_code = SLURM_SUCCESS, job_cnt = 0, submit_cnt = 0;
+	int chunk_cnt = 0;
+	DEF_TIMERS;
+	job_record_t *job_ptr;
+	slurm_msg_t response_msg;
+	submit_response_msg_t *submit_msg;
+	job_desc_msg_t *job_desc_msg;
+	/* Locks: Read config, read job, read node, read partition */
+	slurmctld_lock_t job_read_lock = {
+		READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK, READ_LOCK };
+	/* Locks: Read config, write job, write node, read partition, read
+	 * federation */
+	slurmctld_lock_t job_write_lock = {
+		READ_LOCK, WRITE_LOCK, WRITE_LOCK, READ_LOCK, READ_LOCK };
+	List job_req_list = (List) msg->data;
+	List resp_list = NULL;
+	uid_t uid = g_slurm_auth_get_uid(msg->auth_cred);
+	gid_t gid = g_slurm_auth_get_gid(msg->auth_cred);
+	char *hostname = g_slurm_auth_get_host(msg->auth_cred);
+	char *err_msg = NULL;
+	bool reject_job;
+
+	START_TIMER;
+	debug2("Processing RPC: REQUEST_SUBMIT_BATCH_JOB_LIST from uid=%d",
+	       uid);
+	if (config_update != slurmctld_conf.last_update) {
+		char *sched_params = slurm_get_sched_params();
+		char *tmp_ptr;
+
+		max_job_cnt = DEFAULT_MAX_SUBMIT_JOB_LIST;
+		if ((tmp_ptr = xstrcasestr(sched_params,
+					   "max_submit_job_list="))) {
+			max_job_cnt = atoi(tmp_ptr + 20);
+			if (max_job_cnt < 1) {
+				error("Invalid max_submit_job_list: %d",
+				      max_job_cnt);
+				max_job_cnt = DEFAULT_MAX_SUBMIT_JOB_LIST;
+			}
+		}
+		xfree(sched_params);
+		config_update = slurmctld_conf.last_update;
+	}
+
+	if (job_req_list)
+		job_cnt = list_count(job_req_list);
+	if (job_cnt == 0) {
+		info("REQUEST_SUBMIT_BATCH_JOB_LIST from uid=%d with empty job list",
+		     uid);
+		error_code = SLURM_ERROR;
+		goto send_rc;
+	}
+	if (job_cnt > max_job_cnt) {
+		info("REQUEST_SUBMIT_BATCH_JOB_LIST from uid=%d with %d jobs, max_submit_job_list is %d",
+		     uid, job_cnt, max_job_cnt);
+		error_code = ESLURM_JOB_LIST_TOO_LONG;
+		goto send_rc;
+	}
+	if (slurmctld_config.submissions_disabled) {
+		info("Submissions disabled on system");
+		error_code = ESLURM_SUBMISSIONS_DISABLED;
+		goto send_rc;
+	}
+	if (fed_mgr_fed_rec) {
+		/* Sibling jobs are submitted one at a time */
+		error_code = ESLURM_NOT_SUPPORTED;
+		goto send_rc;
+	}
+
+	resp_list = list_create(slurm_destroy_submit_response_object);
+
+	/* Validate the individual requests */
+	lock_slurmctld(job_read_lock);     /* Locks for job_submit plugin use */
+	req_iter = list_iterator_create(job_req_list);
+	while ((job_desc_msg = list_next(req_iter))) {
+		submit_msg = xmalloc(sizeof(submit_response_msg_t));
+		submit_msg->step_id = SLURM_BATCH_SCRIPT;
+		list_append(resp_list, submit_msg);
+
+		if ((submit_msg->error_code =
+		     _valid_id("REQUEST_SUBMIT_BATCH_JOB_LIST",
+			       job_desc_msg, uid, gid)))
+			continue;
+
+		/* use the credential to validate where we came from */
+		if (hostname) {
+			xfree(job_desc_msg->alloc_node);
+			job_desc_msg->alloc_node = xstrdup(hostname);
+		}
+
+		if ((job_desc_msg->alloc_node == NULL) ||
+		    (job_desc_msg->alloc_node[0] == '\0')) {
+			error("REQUEST_SUBMIT_BATCH_JOB_LIST lacks alloc_node from uid=%d",
+			      uid);
+			submit_msg->error_code = ESLURM_INVALID_NODE_NAME;
+			continue;
+		}
+
+		dump_job_desc(job_desc_msg);
+
+		job_desc_msg->pack_job_offset = NO_VAL;
+		submit_msg->error_code = validate_job_create_req(
+			job_desc_msg, uid, &submit_msg->job_submit_user_msg);
+	}
+	list_iterator_destroy(req_iter);
+	xfree(hostname);
+	unlock_slurmctld(job_read_lock);
+
+	/* Create the jobs which passed validation */
+	_throttle_start(&active_rpc_cnt);
+	lock_slurmctld(job_write_lock);
+	START_TIMER;	/* Restart after we have locks */
+	req_iter = list_iterator_create(job_req_list);
+	resp_iter = list_iterator_create(resp_list);
+	while ((job_desc_msg = list_next(req_iter)) &&
+	       (submit_msg = list_next(resp_iter))) {
+		if (submit_msg->error_code != SLURM_SUCCESS)
+			continue;
+
+		/* Let other RPCs in between chunks of jobs */
+		if (++chunk_cnt > SUBMIT_JOB_LIST_CHUNK) {
+			unlock_slurmctld(job_write_lock);
+			lock_slurmctld(job_write_lock);
+			chunk_cnt = 1;
+		}
+
+		job_ptr = NULL;
+		job_desc_msg->pack_job_offset = NO_VAL;
+		error_code = job_allocate(job_desc_msg,
+					  job_desc_msg->immediate,
+					  false, NULL, 0, uid, &job_ptr,
+					  &err_msg, msg->protocol_version);
+		reject_job = (!job_ptr ||
+			      (error_code &&
+			       (job_ptr->job_state == JOB_FAILED)));
+		if (job_desc_msg->immediate &&
+		    (error_code != SLURM_SUCCESS)) {
+			error_code = ESLURM_CAN_NOT_START_IMMEDIATELY;
+			reject_job = true;
+		}
+		submit_msg->error_code = error_code;
+
+		if (reject_job) {
+			if (err_msg) {
+				xstrfmtcat(submit_msg->job_submit_user_msg,
+					   "%s%s",
+					   submit_msg->job_submit_user_msg ?
+					   "\n" : "", err_msg);
+			}
+		} else {
+			submit_msg->job_id = job_ptr->job_id;
+			submit_cnt++;
+		}
+		xfree(err_msg);
+	}
+	list_iterator_destroy(resp_iter);
+	list_iterator_destroy(req_iter);
+	unlock_slurmctld(job_write_lock);
+	_throttle_fini(&active_rpc_cnt);
+
+	END_TIMER2("_slurm_rpc_submit_batch_job_list");
+	info("%s: %d of %d jobs submitted %s",
+	     __func__, submit_cnt, job_cnt, TIME_STR);
+
+	response_init(&response_msg, msg);
+	response_msg.msg_type = RESPONSE_SUBMIT_BATCH_JOB_LIST;
+	response_msg.data = resp_list;
+	slurm_send_node_msg(msg->conn_fd, &response_msg);
+	FREE_NULL_LIST(resp_list);
+
+	if (submit_cnt) {
+		schedule_job_save();	/* Has own locks */
+		schedule_node_save();	/* Has own locks */
+		queue_job_scheduler();
+	}
+	return;
+
+send_rc:
+	END_TIMER2("_slurm_rpc_submit_batch_job_list");
+	info("%s: %s", __func__, slurm_strerror(error_code));
+	xfree(hostname);
+	slurm_send_rc_msg(msg, error_code);
+}
+
 /* _slurm_rpc_update_job - process RPC to update the configuration of a
  * job (e.g. priority)
  */
@@ -6412,6 +6665,9 @@ static void  _slurm_rpc_comp_msg_list(composite_msg_t * comp_msg,
 		case MESSAGE_NODE_REGISTRATION_STATUS:
 			_slurm_rpc_node_registration(next_msg, 1);
 			break;
+		case MESSAGE_NODE_HEARTBEAT:
+			_slurm_rpc_node_heartbeat(next_msg, 1);
+			break;
 		default:
 			error("_slurm_rpc_comp_msg_list: invalid msg type");
 			break;
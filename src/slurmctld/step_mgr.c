@@ -940,6 +940,57 @@ static bitstr_t *_pick_step_nodes_cpus(job_record_t *job_ptr,
 	return NULL;
 }
 
+/*
+ * Pick nodes for an exclusive step needing only CPUs, visiting just the job's
+ * nodes with idle CPUs. Nodes are picked in the same order as by the full
+ * scan in _pick_step_nodes().
+ * IN job_resrcs_ptr - job's resources
+ * IN nodes_avail - nodes usable by the step
+ * IN step_spec - job step specification
+ * IN cpus_per_task - CPUs required by each task, must be non-zero
+ * RET bitmap of picked nodes or NULL if the step does not fit
+ */
+static bitstr_t *_pick_step_nodes_idle(job_resources_t *job_resrcs_ptr,
+				       bitstr_t *nodes_avail,
+				       job_step_create_request_msg_t *step_spec,
+				       int cpus_per_task)
+{
+	job_resources_index_t *index;
+	bitstr_t *picked_node_bitmap;
+	uint32_t nodes_picked_cnt = 0, tasks_picked_cnt = 0;
+	int avail_tasks, i, node_inx;
+
+	if (!(index = get_job_resources_index(job_resrcs_ptr)))
+		return NULL;
+
+	picked_node_bitmap = bit_alloc(bit_size(nodes_avail));
+	for (node_inx = bit_ffs(index->node_free); node_inx >= 0;
+	     node_inx = bit_ffs_from_bit(index->node_free, node_inx + 1)) {
+		if (nodes_picked_cnt >= step_spec->max_nodes)
+			break;
+		if ((nodes_picked_cnt >= step_spec->min_nodes) &&
+		    (tasks_picked_cnt > 0) &&
+		    (tasks_picked_cnt >= step_spec->num_tasks))
+			break;
+		i = index->node_inx[node_inx];
+		if (!bit_test(nodes_avail, i))
+			continue;	/* node now DOWN */
+		avail_tasks = (job_resrcs_ptr->cpus[node_inx] -
+			       job_resrcs_ptr->cpus_used[node_inx]) /
+			      cpus_per_task;
+		if (avail_tasks <= 0)
+			continue;
+		bit_set(picked_node_bitmap, i);
+		nodes_picked_cnt++;
+		tasks_picked_cnt += avail_tasks;
+	}
+
+	if (tasks_picked_cnt >= step_spec->num_tasks)
+		return picked_node_bitmap;
+	bit_free(picked_node_bitmap);
+	return NULL;
+}
+
 /*
  * _pick_step_nodes - select nodes for a job step that satisfy its requirements
  *	we satisfy the super-set of constraints.
@@ -1080,6 +1131,24 @@ static bitstr_t *_pick_step_nodes(job_record_t *job_ptr,
 		bitstr_t *selected_nodes = NULL, *non_selected_nodes = NULL;
 		int *non_selected_tasks = NULL;
 
+		/*
+		 * Steps needing only CPUs are placed from the job's index of
+		 * nodes with idle CPUs. If they do not fit, the full scan
+		 * below determines the reason.
+		 */
+		if (!step_spec->node_list && !step_gres_list &&
+		    !select_nodes_avail && (cpus_per_task > 0) &&
+		    !(step_spec->pn_min_memory && _is_mem_resv()) &&
+		    (!step_spec->plane_size ||
+		     (step_spec->plane_size == NO_VAL16)) &&
+		    (nodes_picked = _pick_step_nodes_idle(job_resrcs_ptr,
+							  nodes_avail,
+							  step_spec,
+							  cpus_per_task))) {
+			FREE_NULL_BITMAP(nodes_avail);
+			return nodes_picked;
+		}
+
 		if (step_spec->node_list) {
 			error_code = node_name2bitmap(step_spec->node_list,
 						      false,
@@ -1831,6 +1900,7 @@ static void _pick_step_cores(step_record_t *step_ptr,
 			     job_resources_t *job_resrcs_ptr,
 			     int job_node_inx, uint16_t task_cnt)
 {
+	job_resources_index_t *index;
 	int bit_offset, core_inx, i, sock_inx;
 	uint16_t sockets, cores;
 	int cpu_cnt = (int) task_cnt;
@@ -1841,9 +1911,10 @@ static void _pick_step_cores(step_record_t *step_ptr,
 		step_ptr->core_bitmap_job =
 			bit_alloc(bit_size(job_resrcs_ptr->core_bitmap));
 
-	if (get_job_resources_cnt(job_resrcs_ptr, job_node_inx,
-				  &sockets, &cores))
-		fatal("get_job_resources_cnt");
+	if (!(index = get_job_resources_index(job_resrcs_ptr)))
+		fatal("get_job_resources_index");
+	sockets = index->sockets[job_node_inx];
+	cores = index->cores[job_node_inx];
 
 	if (task_cnt == (cores * sockets))
 		use_all_cores = true;
@@ -1855,12 +1926,8 @@ static void _pick_step_cores(step_record_t *step_ptr,
 	/* select idle cores first */
 	for (sock_inx=0; sock_inx<sockets; sock_inx++) {
 		for (core_inx=0; core_inx<cores; core_inx++) {
-			bit_offset = get_job_resources_offset(job_resrcs_ptr,
-							       job_node_inx,
-							       sock_inx,
-							       core_inx);
-			if (bit_offset < 0)
-				fatal("get_job_resources_offset");
+			bit_offset = index->core_offset[job_node_inx] +
+				     (sock_inx * cores) + core_inx;
 			if (!bit_test(job_resrcs_ptr->core_bitmap, bit_offset))
 				continue;
 			if ((use_all_cores == false) &&
@@ -1891,12 +1958,8 @@ static void _pick_step_cores(step_record_t *step_ptr,
 	for (i=0; i<cores; i++) {
 		core_inx = (last_core_inx + i) % cores;
 		for (sock_inx=0; sock_inx<sockets; sock_inx++) {
-			bit_offset = get_job_resources_offset(job_resrcs_ptr,
-							       job_node_inx,
-							       sock_inx,
-							       core_inx);
-			if (bit_offset < 0)
-				fatal("get_job_resources_offset");
+			bit_offset = index->core_offset[job_node_inx] +
+				     (sock_inx * cores) + core_inx;
 			if (!bit_test(job_resrcs_ptr->core_bitmap, bit_offset))
 				continue;
 			if (bit_test(step_ptr->core_bitmap_job, bit_offset))
@@ -1959,6 +2022,14 @@ extern void step_alloc_lps(step_record_t *step_ptr)
 		step_ptr->pn_min_memory = 0;
 	}
 
+	/* Skip the job's nodes preceding the step's first node */
+	i_node = bit_ffs(step_ptr->step_node_bitmap);
+	if (i_node > i_first) {
+		job_node_inx = bit_set_count_range(job_resrcs_ptr->node_bitmap,
+						   i_first, i_node) - 1;
+		i_first = i_node;
+	}
+
 	rem_nodes = bit_set_count(step_ptr->step_node_bitmap);
 	for (i_node = i_first; i_node <= i_last; i_node++) {
 		if (!bit_test(job_resrcs_ptr->node_bitmap, i_node))
@@ -1977,6 +2048,7 @@ extern void step_alloc_lps(step_record_t *step_ptr)
 		cpus_alloc = step_ptr->step_layout->tasks[step_node_inx] *
 			     step_ptr->cpus_per_task;
 		job_resrcs_ptr->cpus_used[job_node_inx] += cpus_alloc;
+		update_job_resources_index(job_resrcs_ptr, job_node_inx);
 		gres_plugin_step_alloc(step_ptr->gres_list, job_ptr->gres_list,
 				job_node_inx, first_step_node,
 				step_ptr->step_layout->tasks[step_node_inx],
@@ -2084,6 +2156,14 @@ static void _step_dealloc_lps(step_record_t *step_ptr)
 		step_ptr->pn_min_memory = 0;
 	}
 
+	/* Skip the job's nodes preceding the step's first node */
+	i_node = bit_ffs(step_ptr->step_node_bitmap);
+	if (i_node > i_first) {
+		job_node_inx = bit_set_count_range(job_resrcs_ptr->node_bitmap,
+						   i_first, i_node) - 1;
+		i_first = i_node;
+	}
+
 	for (i_node = i_first; i_node <= i_last; i_node++) {
 		if (!bit_test(job_resrcs_ptr->node_bitmap, i_node))
 			continue;
@@ -2104,6 +2184,7 @@ static void _step_dealloc_lps(step_record_t *step_ptr)
 			      cpus_alloc, job_node_inx);
 			job_resrcs_ptr->cpus_used[job_node_inx] = 0;
 		}
+		update_job_resources_index(job_resrcs_ptr, job_node_inx);
 		if (step_ptr->pn_min_memory && _is_mem_resv()) {
 			uint64_t mem_use = step_ptr->pn_min_memory;
 			if (mem_use & MEM_PER_CPU) {
@@ -2864,6 +2945,13 @@ extern slurm_step_layout_t *step_layout_create(step_record_t *step_ptr,
 		last_bit = bit_fls(job_ptr->node_bitmap);
 	else
 		last_bit = -2;
+	/* Skip the job's nodes preceding the step's first node */
+	i = bit_ffs(step_ptr->step_node_bitmap);
+	if ((first_bit >= 0) && (i > first_bit)) {
+		job_node_offset = bit_set_count_range(job_ptr->node_bitmap,
+						      first_bit, i) - 1;
+		first_bit = i;
+	}
 	for (i = first_bit; i <= last_bit; i++) {
 		uint16_t cpus, cpus_used;
 
@@ -56,6 +56,7 @@
 #include <string.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <sys/wait.h>
@@ -64,6 +65,7 @@
 #include <utime.h>
 
 #include "src/common/assoc_mgr.h"
+#include "src/common/bb_stage.h"
 #include "src/common/callerid.h"
 #include "src/common/cpu_frequency.h"
 #include "src/common/env.h"
@@ -279,6 +281,21 @@ static pthread_cond_t  file_bcast_cond  = PTHREAD_COND_INITIALIZER;
 static int fb_read_lock = 0, fb_write_wait_lock = 0, fb_write_lock = 0;
 static List file_bcast_list = NULL;
 
+/* Jobs whose burst buffer is being staged out, see _bb_drain() */
+static pthread_mutex_t bb_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  bb_drain_cond  = PTHREAD_COND_INITIALIZER;
+static List bb_drain_jobs = NULL;
+
+typedef struct {
+	uint64_t bandwidth;
+	char *bb_dir;
+	char *burst_buffer;
+	uint32_t job_id;
+	uid_t uid;
+	bool multi_node;
+	uint32_t timeout;
+} bb_drain_args_t;
+
 void
 slurmd_req(slurm_msg_t *msg)
 {
@@ -439,7 +456,6 @@ slurmd_req(slurm_msg_t *msg)
 	case MESSAGE_COMPOSITE:
 		error("Processing RPC: MESSAGE_COMPOSITE: "
 		      "This should never happen");
-		msg_aggr_add_msg(msg, 0, NULL);
 		break;
 	case RESPONSE_MESSAGE_COMPOSITE:
 		debug2("Processing RPC: RESPONSE_MESSAGE_COMPOSITE");
@@ -1633,6 +1649,27 @@ done:
 		send_registration_msg(errnum, false);
 }
 
+/*
+ * Create the missing parent directories of a path
+ * RET 0 on success, -1 on error
+ */
+static int _mkdir_parents(char *path_name)
+{
+	char path[PATH_MAX], *sep = path;
+
+	if (strlcpy(path, path_name, sizeof(path)) >= sizeof(path))
+		return -1;
+	while ((sep = strchr(sep + 1, '/'))) {
+		*sep = '\0';
+		if (mkdir(path, 0700) && (errno != EEXIST)) {
+			error("%s: can't create `%s`: %m", __func__, path);
+			return -1;
+		}
+		*sep = '/';
+	}
+	return 0;
+}
+
 /*
  * Open file based upon permissions of a different user
  * IN path_name - name of file to open
@@ -1641,11 +1678,12 @@ done:
  * IN jobid - (optional) job id
  * IN uid - User ID to use for file access check
  * IN gid - Group ID to use for file access check
+ * IN mkdirs - if set create the missing parent directories of path_name
  * RET -1 on error, file descriptor otherwise
  */
 static int _open_as_other(char *path_name, int flags, int mode,
 			  uint32_t jobid, uid_t uid, gid_t gid,
-			  int ngids, gid_t *gids)
+			  int ngids, gid_t *gids, bool mkdirs)
 {
 	pid_t child;
 	int pipe[2];
@@ -1721,6 +1759,9 @@ static int _open_as_other(char *path_name, int flags, int mode,
 	}
 
 	fd = open(path_name, flags, mode);
+	if ((fd == -1) && (errno == ENOENT) && mkdirs &&
+	    !_mkdir_parents(path_name))
+		fd = open(path_name, flags, mode);
 	if (fd == -1) {
 		 error("%s: uid:%u can't open `%s`: %m",
 			__func__, uid, path_name);
@@ -1752,7 +1793,7 @@ _prolog_error(batch_job_launch_msg_t *req, int rc)
 	path_name = fname_create2(req);
 	if ((fd = _open_as_other(path_name, flags, 0644,
 				 jobid, req->uid, req->gid,
-				 req->ngids, req->gids)) == -1) {
+				 req->ngids, req->gids, false)) == -1) {
 		error("Unable to open %s: Permission denied", path_name);
 		xfree(path_name);
 		return;
@@ -2194,6 +2235,268 @@ static int _spawn_prolog_stepd(slurm_msg_t *msg)
 	return rc;
 }
 
+/*
+ * Create a job's burst buffer directory on this node, or reuse the one left
+ * by an earlier run, and give it to the job's user. The parent directory
+ * must be owned by user root and not writable by others, so that users can
+ * not substitute their own files or links for those of slurmd.
+ * IN capacity - bytes the job requested, which must be free
+ * RET SLURM_SUCCESS or SLURM_ERROR
+ */
+static int _bb_make_dir(uint32_t job_id, char *job_dir, uid_t uid, gid_t gid,
+			uint64_t capacity)
+{
+	char *root_dir, *sep;
+	struct stat st;
+	struct statvfs fs;
+	int fd, rc = SLURM_ERROR;
+
+	root_dir = xstrdup(job_dir);
+	if ((sep = strrchr(root_dir, '/')))
+		sep[(sep == root_dir) ? 1 : 0] = '\0';
+	if (stat(root_dir, &st) < 0) {
+		error("[job %u] burst buffer stat(%s): %m", job_id, root_dir);
+	} else if (!S_ISDIR(st.st_mode) || (st.st_uid != 0) ||
+		   (st.st_mode & (S_IWGRP | S_IWOTH))) {
+		error("[job %u] burst buffer %s is not a directory owned by root and only writable by it",
+		      job_id, root_dir);
+	} else if (statvfs(root_dir, &fs) < 0) {
+		error("[job %u] burst buffer statvfs(%s): %m",
+		      job_id, root_dir);
+	} else if (((uint64_t) fs.f_bavail * fs.f_frsize) < capacity) {
+		error("[job %u] burst buffer %s has %"PRIu64" bytes free, %"PRIu64" requested",
+		      job_id, root_dir,
+		      (uint64_t) fs.f_bavail * fs.f_frsize, capacity);
+	} else {
+		rc = SLURM_SUCCESS;
+	}
+	xfree(root_dir);
+	if (rc != SLURM_SUCCESS)
+		return rc;
+
+	if ((mkdir(job_dir, 0700) < 0) && (errno != EEXIST)) {
+		error("[job %u] burst buffer mkdir(%s): %m", job_id, job_dir);
+		return SLURM_ERROR;
+	}
+	/* never follow a link, the directory is checked through its fd */
+	if ((fd = open(job_dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW)) < 0) {
+		error("[job %u] burst buffer open(%s): %m", job_id, job_dir);
+		return SLURM_ERROR;
+	}
+	rc = SLURM_ERROR;
+	if (fstat(fd, &st) < 0) {
+		error("[job %u] burst buffer fstat(%s): %m", job_id, job_dir);
+	} else if ((st.st_uid != 0) && (st.st_uid != uid)) {
+		error("[job %u] burst buffer %s is owned by user %u",
+		      job_id, job_dir, (uint32_t) st.st_uid);
+	} else if (fchown(fd, uid, gid) < 0) {
+		error("[job %u] burst buffer fchown(%s): %m", job_id, job_dir);
+	} else {
+		rc = SLURM_SUCCESS;
+	}
+	close(fd);
+
+	return rc;
+}
+
+/* Remove a job's burst buffer directory and its contents as the job's user */
+static void _bb_remove_dir(uint32_t job_id, char *job_dir, uid_t uid,
+			   gid_t gid)
+{
+	char *resp = NULL;
+	int status = 0;
+
+	resp = bb_stage_run("teardown", NULL, 0, job_dir, uid, gid, 0, 0,
+			    &status);
+	if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+		error("[job %u] burst buffer teardown status=%d: %s",
+		      job_id, status, resp);
+	else if ((rmdir(job_dir) < 0) && (errno != ENOENT))
+		error("[job %u] burst buffer rmdir(%s): %m", job_id, job_dir);
+	xfree(resp);
+}
+
+/* Wait for the stage-out of an earlier run of a requeued job to end */
+static void _bb_wait_drain(uint32_t job_id)
+{
+	slurm_mutex_lock(&bb_drain_mutex);
+	while (bb_drain_jobs &&
+	       list_find_first(bb_drain_jobs, _match_jobid, &job_id)) {
+		debug("[job %u] waiting for burst buffer stage_out of previous run",
+		      job_id);
+		slurm_cond_wait(&bb_drain_cond, &bb_drain_mutex);
+	}
+	slurm_mutex_unlock(&bb_drain_mutex);
+}
+
+/*
+ * Create a job's burst buffer on this node and stage its files in, as
+ * requested by the generic burst buffer plugin when it does not stage on the
+ * controller. Runs after the Prolog, so no task starts before it ends.
+ * RET SLURM_SUCCESS or ESLURMD_BURST_BUFFER_STAGE_IN
+ */
+static int _bb_stage_in(prolog_launch_msg_t *req)
+{
+	bb_stage_spec_t *spec = NULL;
+	char *err_msg = NULL, *resp = NULL;
+	int status = 0, rc = SLURM_SUCCESS;
+	DEF_TIMERS;
+
+	if (!req->bb_dir)
+		return SLURM_SUCCESS;
+
+	_bb_wait_drain(req->job_id);
+	if (bb_stage_parse(req->burst_buffer, &spec, &err_msg)) {
+		error("[job %u] invalid burst buffer: %s",
+		      req->job_id, err_msg);
+		xfree(err_msg);
+		return ESLURMD_BURST_BUFFER_STAGE_IN;
+	}
+	if (_bb_make_dir(req->job_id, req->bb_dir, req->uid, req->gid,
+			 spec->capacity) != SLURM_SUCCESS) {
+		bb_stage_spec_free(spec);
+		return ESLURMD_BURST_BUFFER_STAGE_IN;
+	}
+
+	if (spec->stage_in_cnt) {
+		bb_stage_set_bandwidth(req->bb_bandwidth);
+		START_TIMER;
+		resp = bb_stage_run("stage_in", spec->stage_in,
+				    spec->stage_in_cnt, req->bb_dir, req->uid,
+				    req->gid, req->bb_timeout * 1000, 0,
+				    &status);
+		END_TIMER;
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+			error("[job %u] burst buffer stage_in failed status=%d: %s",
+			      req->job_id, status, resp);
+			_bb_remove_dir(req->job_id, req->bb_dir, req->uid,
+				       req->gid);
+			rc = ESLURMD_BURST_BUFFER_STAGE_IN;
+		} else {
+			debug("[job %u] burst buffer stage_in ran for %s",
+			      req->job_id, TIME_STR);
+		}
+		xfree(resp);
+	}
+	bb_stage_spec_free(spec);
+
+	return rc;
+}
+
+static void _bb_drain_args_free(bb_drain_args_t *args)
+{
+	xfree(args->bb_dir);
+	xfree(args->burst_buffer);
+	xfree(args);
+}
+
+static void *_bb_drain_thread(void *arg)
+{
+	bb_drain_args_t *args = arg;
+	bb_stage_spec_t *spec = NULL;
+	char *err_msg = NULL, *resp = NULL, *dst;
+	struct stat st;
+	int i, status = 0;
+	DEF_TIMERS;
+
+	if (lstat(args->bb_dir, &st) < 0) {
+		/* Drained by an earlier request, or never staged in */
+		if (errno != ENOENT)
+			error("[job %u] burst buffer lstat(%s): %m",
+			      args->job_id, args->bb_dir);
+		goto fini;
+	}
+	if (!S_ISDIR(st.st_mode) || (st.st_uid != args->uid)) {
+		error("[job %u] burst buffer %s is not a directory owned by user %u, not staging out",
+		      args->job_id, args->bb_dir, (uint32_t) args->uid);
+		goto fini;
+	}
+	if (bb_stage_parse(args->burst_buffer, &spec, &err_msg)) {
+		error("[job %u] invalid burst buffer: %s, files left in %s",
+		      args->job_id, err_msg, args->bb_dir);
+		xfree(err_msg);
+		goto fini;
+	}
+
+	if (spec->stage_out_cnt) {
+		/* Each node stages out its own files */
+		for (i = 0; args->multi_node && (i < spec->stage_out_cnt);
+		     i++) {
+			dst = xstrdup_printf("%s.%s", spec->stage_out[i].dst,
+					     conf->node_name);
+			xfree(spec->stage_out[i].dst);
+			spec->stage_out[i].dst = dst;
+		}
+		bb_stage_set_bandwidth(args->bandwidth);
+		START_TIMER;
+		resp = bb_stage_run("stage_out", spec->stage_out,
+				    spec->stage_out_cnt, args->bb_dir,
+				    st.st_uid, st.st_gid, args->timeout * 1000,
+				    0, &status);
+		END_TIMER;
+		if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+			/* Leave the files for recovery by the administrator */
+			error("[job %u] burst buffer stage_out failed status=%d: %s, files left in %s",
+			      args->job_id, status, resp, args->bb_dir);
+			xfree(resp);
+			goto fini;
+		}
+		debug("[job %u] burst buffer stage_out ran for %s",
+		      args->job_id, TIME_STR);
+		xfree(resp);
+	}
+	_bb_remove_dir(args->job_id, args->bb_dir, st.st_uid, st.st_gid);
+
+fini:
+	bb_stage_spec_free(spec);
+	slurm_mutex_lock(&bb_drain_mutex);
+	list_delete_all(bb_drain_jobs, _match_jobid, &args->job_id);
+	slurm_cond_broadcast(&bb_drain_cond);
+	slurm_mutex_unlock(&bb_drain_mutex);
+	_bb_drain_args_free(args);
+
+	return NULL;
+}
+
+/*
+ * Stage a job's burst buffer out of this node and remove it, in the
+ * background so that the node is released as soon as the epilog completes
+ */
+static void _bb_drain(kill_job_msg_t *req)
+{
+	bb_drain_args_t *args;
+	uint32_t *job_id;
+	hostlist_t hl;
+
+	if (!req->bb_dir)
+		return;
+
+	slurm_mutex_lock(&bb_drain_mutex);
+	if (!bb_drain_jobs)
+		bb_drain_jobs = list_create(slurm_destroy_uint32_ptr);
+	if (list_find_first(bb_drain_jobs, _match_jobid, &req->job_id)) {
+		slurm_mutex_unlock(&bb_drain_mutex);
+		return;
+	}
+	job_id = xmalloc(sizeof(uint32_t));
+	*job_id = req->job_id;
+	list_append(bb_drain_jobs, job_id);
+	slurm_mutex_unlock(&bb_drain_mutex);
+
+	args = xmalloc(sizeof(bb_drain_args_t));
+	args->bandwidth = req->bb_bandwidth;
+	args->bb_dir = xstrdup(req->bb_dir);
+	args->burst_buffer = xstrdup(req->burst_buffer);
+	args->job_id = req->job_id;
+	args->uid = req->job_uid;
+	args->timeout = req->bb_timeout;
+	if ((hl = hostlist_create(req->nodes))) {
+		args->multi_node = (hostlist_count(hl) > 1);
+		hostlist_destroy(hl);
+	}
+	slurm_thread_create_detached(NULL, _bb_drain_thread, args);
+}
+
 static void _rpc_prolog(slurm_msg_t *msg)
 {
 	int rc = SLURM_SUCCESS, alt_rc = SLURM_ERROR, node_id = 0;
@@ -2277,6 +2580,9 @@ static void _rpc_prolog(slurm_msg_t *msg)
 			rc = ESLURMD_PROLOG_FAILED;
 		}
 
+		if (rc == SLURM_SUCCESS)
+			rc = _bb_stage_in(req);
+
 		if ((rc == SLURM_SUCCESS) &&
 		    (slurmctld_conf.prolog_flags & PROLOG_FLAG_CONTAIN))
 			rc = _spawn_prolog_stepd(msg);
@@ -2308,7 +2614,9 @@ static void _rpc_prolog(slurm_msg_t *msg)
 
 		if (rc != SLURM_SUCCESS) {
 			alt_rc = _launch_job_fail(req->job_id, rc);
-			send_registration_msg(rc, false);
+			/* The job's staging failed, not the node */
+			if (rc != ESLURMD_BURST_BUFFER_STAGE_IN)
+				send_registration_msg(rc, false);
 		}
 
 		if (alt_rc != SLURM_SUCCESS) {
@@ -4110,7 +4418,7 @@ static void _free_file_bcast_info_t(void *arg)
 		return;
 
 	xfree(f->fname);
-	if (f->fd)
+	if (f->fd >= 0)
 		close(f->fd);
 	xfree(f);
 }
@@ -4180,8 +4488,8 @@ static int _rpc_file_bcast(slurm_msg_t *msg)
 #endif
 
 #if 0
-	info("last_block=%u force=%u modes=%o",
-	     req->last_block, req->force, req->modes);
+	info("last_block=%u flags=%u modes=%o",
+	     req->last_block, req->flags, req->modes);
 	info("uid=%u gid=%u atime=%lu mtime=%lu block_len[0]=%u",
 	     req->uid, req->gid, req->atime, req->mtime, req->block_len);
 #if 0
@@ -4217,6 +4525,15 @@ static int _rpc_file_bcast(slurm_msg_t *msg)
 		return SLURM_ERROR;
 	}
 
+	/* file already current on this node, ignore the data */
+	if (file_info->fd < 0) {
+		file_info->last_update = time(NULL);
+		_fb_rdunlock();
+		if (req->last_block)
+			_file_bcast_close_file(&key);
+		return ESLURMD_FILE_BCAST_CURRENT;
+	}
+
 	/* now decompress file */
 	if (bcast_decompress_data(req) < 0) {
 		error("sbcast: data decompression error for UID %u, file %s",
@@ -4225,10 +4542,12 @@ static int _rpc_file_bcast(slurm_msg_t *msg)
 		return SLURM_ERROR;
 	}
 
+	/* blocks other than the first and last one may arrive in any order */
 	offset = 0;
 	while (req->block_len - offset) {
-		inx = write(file_info->fd, &req->block[offset],
-			    (req->block_len - offset));
+		inx = pwrite(file_info->fd, &req->block[offset],
+			     (req->block_len - offset),
+			     req->block_offset + offset);
 		if (inx == -1) {
 			if ((errno == EINTR) || (errno == EAGAIN))
 				continue;
@@ -4265,6 +4584,9 @@ static int _rpc_file_bcast(slurm_msg_t *msg)
 	if (req->last_block) {
 		_file_bcast_close_file(&key);
 	}
+	/* tell sbcast it may send the next blocks out of order */
+	if ((req->block_no == 1) && (req->flags & FILE_BCAST_ANY_ORDER))
+		return ESLURMD_FILE_BCAST_ANY_ORDER;
 	return SLURM_SUCCESS;
 }
 
@@ -4325,8 +4647,9 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 				     file_bcast_info_t *key)
 {
 	file_bcast_msg_t *req = msg->data;
-	int fd, flags;
+	int fd, flags, rc = SLURM_SUCCESS;
 	file_bcast_info_t *file_info;
+	struct stat stat_buf;
 
 	/* may still be unset in credential */
 	if (!cred_arg->ngids || !cred_arg->gids)
@@ -4334,19 +4657,42 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 						     cred_arg->user_name,
 						     &cred_arg->gids);
 
+	/* with FILE_BCAST_UPDATE the file is truncated below if not current */
 	flags = O_WRONLY | O_CREAT;
-	if (req->force)
+	if (req->flags & FILE_BCAST_UPDATE)
+		;
+	else if (req->flags & FILE_BCAST_FORCE)
 		flags |= O_TRUNC;
 	else
 		flags |= O_EXCL;
 
 	if ((fd = _open_as_other(req->fname, flags, 0700,
 				 key->job_id, key->uid, key->gid,
-				 cred_arg->ngids, cred_arg->gids)) == -1) {
+				 cred_arg->ngids, cred_arg->gids,
+				 (req->flags & FILE_BCAST_MKDIR))) == -1) {
 		error("Unable to open %s: Permission denied", req->fname);
 		return SLURM_ERROR;
 	}
 
+	if (req->flags & FILE_BCAST_UPDATE) {
+		if (!fstat(fd, &stat_buf) &&
+		    (stat_buf.st_size == req->file_size) &&
+		    (stat_buf.st_mtime == req->mtime)) {
+			debug("sbcast: `%s` already current", req->fname);
+			close(fd);
+			if (req->last_block)
+				return ESLURMD_FILE_BCAST_CURRENT;
+			/* registered to ignore the remaining blocks */
+			fd = -1;
+			rc = ESLURMD_FILE_BCAST_CURRENT;
+		} else if (ftruncate(fd, 0)) {
+			error("sbcast: uid:%u can't truncate `%s`: %m",
+			      key->uid, req->fname);
+			close(fd);
+			return SLURM_ERROR;
+		}
+	}
+
 	file_info = xmalloc(sizeof(file_bcast_info_t));
 	file_info->fd = fd;
 	file_info->fname = xstrdup(req->fname);
@@ -4360,7 +4706,7 @@ static int _file_bcast_register_file(slurm_msg_t *msg,
 	list_append(file_bcast_list, file_info);
 	_fb_wrunlock();
 
-	return SLURM_SUCCESS;
+	return rc;
 }
 
 static void
@@ -5424,7 +5770,8 @@ _rpc_terminate_job(slurm_msg_t *msg)
 			slurm_send_rc_msg(msg,
 					  ESLURMD_KILL_JOB_ALREADY_COMPLETE);
 		}
-		slurm_cred_begin_expiration(conf->vctx, req->job_id);
+		if (slurm_cred_begin_expiration(conf->vctx, req->job_id) == 0)
+			_bb_drain(req);
 		save_cred_state(conf->vctx);
 		_waiter_complete(req->job_id);
 
@@ -5513,6 +5860,7 @@ _rpc_terminate_job(slurm_msg_t *msg)
 		rc = ESLURMD_EPILOG_FAILED;
 	} else
 		debug("completed epilog for jobid %u", req->job_id);
+	_bb_drain(req);
 	if (container_g_delete(jobid))
 		error("container_g_delete(%u): %m", req->job_id);
 	_launch_complete_rm(req->job_id);
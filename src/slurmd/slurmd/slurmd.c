@@ -202,6 +202,7 @@ static void      _process_cmdline(int ac, char **av);
 static void      _read_config(void);
 static void      _reconfigure(void);
 static void     *_registration_engine(void *arg);
+static void     *_heartbeat_engine(void *arg);
 static void      _resource_spec_fini(void);
 static int       _resource_spec_init(void);
 static int       _restore_cred_state(slurm_cred_ctx_t ctx);
@@ -395,6 +396,7 @@ main (int argc, char **argv)
 			     conf->msg_aggr_window_msgs);
 
 	slurm_thread_create_detached(NULL, _registration_engine, NULL);
+	slurm_thread_create_detached(NULL, _heartbeat_engine, NULL);
 
 	_msg_engine();
 
@@ -444,6 +446,73 @@ _registration_engine(void *arg)
 	return NULL;
 }
 
+/*
+ * Send one heartbeat carrying the node's CPU load and free memory. Use
+ * message aggregation (and thus the route tree) when it is configured.
+ */
+static void _send_heartbeat(void)
+{
+	node_heartbeat_msg_t *msg = xmalloc(sizeof(node_heartbeat_msg_t));
+
+	get_cpu_load(&msg->cpu_load);
+	get_free_mem(&msg->free_mem);
+	msg->node_name = xstrdup(conf->node_name);
+
+	if (conf->msg_aggr_window_msgs > 1) {
+		slurm_msg_t *req = xmalloc_nz(sizeof(slurm_msg_t));
+
+		slurm_msg_t_init(req);
+		req->msg_type = MESSAGE_NODE_HEARTBEAT;
+		req->data     = msg;
+
+		msg_aggr_add_msg(req, 0, NULL);
+	} else {
+		slurm_msg_t req;
+
+		slurm_msg_t_init(&req);
+		req.msg_type = MESSAGE_NODE_HEARTBEAT;
+		req.data     = msg;
+
+		if (slurm_send_only_controller_msg(&req, working_cluster_rec)
+		    < 0)
+			debug("Unable to send heartbeat: %m");
+		slurm_free_node_heartbeat_msg(msg);
+	}
+}
+
+/*
+ * With SlurmdParameters=heartbeat, push a heartbeat to slurmctld at a
+ * randomized interval of at most SlurmdTimeout/4 so that slurmctld only
+ * needs to ping this node when its heartbeat is overdue. The jitter keeps
+ * a large cluster from reporting in lock step.
+ */
+static void *
+_heartbeat_engine(void *arg)
+{
+	unsigned int seed = (unsigned int) (time(NULL) ^ getpid());
+
+	while (!_shutdown) {
+		bool enabled;
+		int period;
+
+		slurm_mutex_lock(&conf->config_mutex);
+		enabled = conf->heartbeat && (conf->slurmd_timeout > 0);
+		period = MAX(conf->slurmd_timeout / 4, 2);
+		slurm_mutex_unlock(&conf->config_mutex);
+
+		if (!enabled || !sent_reg_time) {
+			sleep(5);
+			continue;
+		}
+
+		sleep(period - (rand_r(&seed) % (period / 2)));
+		if (!_shutdown)
+			_send_heartbeat();
+	}
+
+	return NULL;
+}
+
 static void
 _msg_engine(void)
 {
@@ -1091,6 +1160,8 @@ _read_config(void)
 	if (cf->slurmctld_port == 0)
 		fatal("Unable to establish controller port");
 	conf->slurmd_timeout = cf->slurmd_timeout;
+	conf->heartbeat = xstrcasestr(cf->slurmd_params, "heartbeat") ?
+			  true : false;
 	conf->kill_wait = cf->kill_wait;
 	conf->use_pam = cf->conf_flags & CTL_CONF_PAM;
 	conf->task_plugin_param = cf->task_plugin_param;
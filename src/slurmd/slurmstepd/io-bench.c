@@ -0,0 +1,227 @@
+/*****************************************************************************\
+ *  io-bench.c - throughput of the slurmstepd task output path
+ *****************************************************************************
+ *  Drives io.c itself: a writer thread plays the task and writes lines to a
+ *  pipe, _task_read() reads them into the task's cbuf and queues framed
+ *  messages for a client, and _client_write() writes them to a loopback TCP
+ *  connection read by a thread playing srun, which reads each message header
+ *  and body and closes its end after the task's eof message. Both objects
+ *  are run by eio_handle_mainloop(), as in slurmstepd.
+ *
+ *  io-bench is built with the io.h defaults. io-bench-single is built with
+ *  STDIO_MAX_WRITEV=1 and a 4 KB cbuf, i.e. one message per write() as
+ *  slurmstepd did before messages were batched with writev().
+ *
+ *  Usage: io-bench [-u] [-l line_size] [-m megabytes]
+ *	-u	unbuffered output (srun -u), otherwise output is line buffered
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include "io.c"
+
+#include <netinet/in.h>
+#include <sys/time.h>
+
+static int line_size = 80;
+static int megabytes = 256;
+static bool unbuffered = false;
+static uint64_t writes = 0;
+
+static int _count_client_write(eio_obj_t *obj, List objs)
+{
+	writes++;
+	return _client_write(obj, objs);
+}
+
+static void *_task(void *arg)
+{
+	int fd = *(int *) arg;
+	char *chunk;
+	size_t total = (size_t) megabytes * 1024 * 1024, len, off;
+	ssize_t n;
+	int i;
+
+	/* Whole lines in 64 KB writes, as a task writing through stdio */
+	len = (65536 / line_size) * line_size;
+	chunk = xmalloc(len);
+	memset(chunk, 'x', len);
+	for (i = line_size - 1; i < len; i += line_size)
+		chunk[i] = '\n';
+
+	while (total > 0) {
+		if (len > total)
+			len = total;
+		for (off = 0; off < len; off += n) {
+			if ((n = write(fd, chunk + off, len - off)) < 0) {
+				perror("write");
+				exit(1);
+			}
+		}
+		total -= len;
+	}
+	close(fd);
+	xfree(chunk);
+	return NULL;
+}
+
+static void *_srun(void *arg)
+{
+	int fd = *(int *) arg;
+	char buf[MAX_MSG_LEN];
+	struct slurm_io_header hdr;
+	size_t *received = xmalloc(sizeof(size_t));
+	ssize_t n;
+	uint32_t off;
+
+	while (io_hdr_read_fd(fd, &hdr) > 0) {
+		if (hdr.length == 0)		/* task eof */
+			break;
+		for (off = 0; off < hdr.length; off += n) {
+			if ((n = read(fd, buf, hdr.length - off)) <= 0) {
+				perror("read");
+				exit(1);
+			}
+		}
+		*received += hdr.length;
+	}
+	/* Our stdin eof ends the client's reads, as srun exiting would */
+	shutdown(fd, SHUT_WR);
+	return received;
+}
+
+static int _connect(int *srun_fd)
+{
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	int lfd, fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (((lfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+	    bind(lfd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(lfd, 1) ||
+	    getsockname(lfd, (struct sockaddr *) &addr, &len) ||
+	    ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) ||
+	    connect(fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    ((*srun_fd = accept(lfd, NULL, NULL)) < 0)) {
+		perror("loopback connection");
+		exit(1);
+	}
+	close(lfd);
+	return fd;
+}
+
+int main(int argc, char **argv)
+{
+	stepd_step_rec_t job;
+	stepd_step_task_info_t task, *tasks[1] = { &task };
+	struct client_io_info *client;
+	struct io_operations ops = client_ops;
+	struct timeval start, end;
+	pthread_t task_tid, srun_tid;
+	int pipe_fd[2], sock_fd, srun_fd, opt;
+	size_t *received;
+	double secs, mb;
+
+	while ((opt = getopt(argc, argv, "l:m:u")) != -1) {
+		switch (opt) {
+		case 'l':
+			line_size = atoi(optarg);
+			break;
+		case 'm':
+			megabytes = atoi(optarg);
+			break;
+		case 'u':
+			unbuffered = true;
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-u] [-l line_size] [-m megabytes]\n",
+				argv[0]);
+			exit(1);
+		}
+	}
+	if ((line_size < 2) || (line_size > 65536) || (megabytes < 1)) {
+		fprintf(stderr, "%s: bad line size or megabytes\n", argv[0]);
+		exit(1);
+	}
+
+	memset(&job, 0, sizeof(job));
+	job.flags = unbuffered ? 0 : LAUNCH_BUFFERED_IO;
+	job.clients = list_create(NULL);
+	job.free_outgoing = list_create(NULL);
+	job.free_incoming = list_create(NULL);
+	job.outgoing_cache = list_create(NULL);
+	job.eio = eio_handle_create(0);
+	job.node_tasks = 1;
+	job.task = tasks;
+	memset(&task, 0, sizeof(task));
+
+	if (pipe(pipe_fd)) {
+		perror("pipe");
+		exit(1);
+	}
+	sock_fd = _connect(&srun_fd);
+	fd_set_nonblocking(pipe_fd[0]);
+	fd_set_nonblocking(sock_fd);
+
+	task.out = _create_task_out_eio(pipe_fd[0], SLURM_IO_STDOUT, &job,
+					&task);
+	eio_new_initial_obj(job.eio, task.out);
+
+	/* As io_client_connect(), counting the writes to the socket */
+	client = xmalloc(sizeof(struct client_io_info));
+#ifndef NDEBUG
+	client->magic = CLIENT_IO_MAGIC;
+#endif
+	client->job = &job;
+	client->ltaskid_stdout = -1;
+	client->ltaskid_stderr = -1;
+	ops.handle_write = _count_client_write;
+	eio_new_initial_obj(job.eio, eio_obj_create(sock_fd, &ops, client));
+
+	gettimeofday(&start, NULL);
+	slurm_thread_create(&task_tid, _task, &pipe_fd[1]);
+	slurm_thread_create(&srun_tid, _srun, &srun_fd);
+	eio_handle_mainloop(job.eio);
+	pthread_join(task_tid, NULL);
+	pthread_join(srun_tid, (void **) &received);
+	gettimeofday(&end, NULL);
+
+	if (*received != (size_t) megabytes * 1024 * 1024) {
+		fprintf(stderr, "%s: srun received %zu bytes, expected %d MB\n",
+			argv[0], *received, megabytes);
+		exit(1);
+	}
+
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_usec - start.tv_usec) / 1e6;
+	mb = megabytes;
+	printf("%d MB of %d byte lines, %s, writev batch %d, cbuf %d\n",
+	       megabytes, line_size,
+	       unbuffered ? "unbuffered" : "line buffered",
+	       STDIO_MAX_WRITEV, STDIO_MAX_CBUF_LEN);
+	printf("  %.1f MB/s, %.0f socket writes per MB\n",
+	       mb / secs, writes / mb);
+
+	xfree(received);
+	return 0;
+}
@@ -56,6 +56,7 @@
 #include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <termios.h>
 #include <unistd.h>
 
@@ -433,8 +434,10 @@ static int
 _client_write(eio_obj_t *obj, List objs)
 {
 	struct client_io_info *client = (struct client_io_info *) obj->arg;
-	void *buf;
-	int n;
+	struct iovec iov[STDIO_MAX_WRITEV];
+	struct io_buf *msg;
+	ListIterator itr;
+	int cnt, n;
 
 	xassert(client->magic == CLIENT_IO_MAGIC);
 
@@ -458,12 +461,23 @@ _client_write(eio_obj_t *obj, List objs)
 	debug5("  client->out_remaining = %d", client->out_remaining);
 
 	/*
-	 * Write message to socket.
+	 * Write the rest of the current message and the messages queued
+	 * behind it to the socket in one system call, straight from the
+	 * message buffers.
 	 */
-	buf = client->out_msg->data +
+	iov[0].iov_base = client->out_msg->data +
 		(client->out_msg->length - client->out_remaining);
+	iov[0].iov_len = client->out_remaining;
+	cnt = 1;
+	itr = list_iterator_create(client->msg_queue);
+	while ((cnt < STDIO_MAX_WRITEV) && (msg = list_next(itr))) {
+		iov[cnt].iov_base = msg->data;
+		iov[cnt].iov_len = msg->length;
+		cnt++;
+	}
+	list_iterator_destroy(itr);
 again:
-	if ((n = write(obj->fd, buf, client->out_remaining)) < 0) {
+	if ((n = writev(obj->fd, iov, cnt)) < 0) {
 		if (errno == EINTR) {
 			goto again;
 		} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
@@ -475,17 +489,19 @@ again:
 			return SLURM_SUCCESS;
 		}
 	}
-	if (n < client->out_remaining) {
-		error("Only wrote %d of %d bytes to socket",
-		      n, client->out_remaining);
-	} else
-		debug5("Wrote %d bytes to socket", n);
-	client->out_remaining -= n;
-	if (client->out_remaining > 0)
-		return SLURM_SUCCESS;
+	debug5("Wrote %d bytes of %d messages to socket", n, cnt);
 
-	_free_outgoing_msg(client->out_msg, client->job);
-	client->out_msg = NULL;
+	/* Release the messages written, the last one may be partial */
+	while (n >= client->out_remaining) {
+		n -= client->out_remaining;
+		_free_outgoing_msg(client->out_msg, client->job);
+		if (!(client->out_msg = list_dequeue(client->msg_queue)))
+			return SLURM_SUCCESS;
+		client->out_remaining = client->out_msg->length;
+		if (!n)
+			return SLURM_SUCCESS;
+	}
+	client->out_remaining -= n;
 
 	return SLURM_SUCCESS;
 }
@@ -719,7 +735,7 @@ _create_task_out_eio(int fd, uint16_t type,
 	out->gtaskid = task->gtid;
 	out->ltaskid = task->id;
 	out->job = job;
-	out->buf = cbuf_create(MAX_MSG_LEN, MAX_MSG_LEN*4);
+	out->buf = cbuf_create(MAX_MSG_LEN, STDIO_MAX_CBUF_LEN);
 	out->eof = false;
 	out->eof_msg_sent = false;
 	if (cbuf_opt_set(out->buf, CBUF_OPT_OVERWRITE, CBUF_NO_DROP) == -1)
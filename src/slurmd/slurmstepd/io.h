@@ -50,6 +50,18 @@
 #define STDIO_MAX_FREE_BUF 1024
 #define STDIO_MAX_MSG_CACHE 128
 
+/*
+ * Task output is read from the pipe into a buffer of up to STDIO_MAX_CBUF_LEN
+ * bytes before being cut into messages, and up to STDIO_MAX_WRITEV messages
+ * are written to a client with one writev().
+ */
+#ifndef STDIO_MAX_CBUF_LEN
+#define STDIO_MAX_CBUF_LEN (MAX_MSG_LEN * 16)
+#endif
+#ifndef STDIO_MAX_WRITEV
+#define STDIO_MAX_WRITEV 64
+#endif
+
 struct io_buf {
 	int ref_count;
 	uint32_t length;
@@ -54,6 +54,7 @@
 #include "src/common/macros.h"
 #include "src/common/node_select.h"
 #include "src/common/slurm_jobacct_gather.h"
+#include "src/common/slurm_acct_gather_filesystem.h"
 #include "src/common/slurm_acct_gather_profile.h"
 #include "src/common/slurm_protocol_api.h"
 #include "src/common/uid.h"
@@ -457,6 +458,7 @@ extern stepd_step_rec_t *stepd_step_rec_create(launch_tasks_request_msg_t *msg,
 	   and only really looks at the profile in the job.
 	*/
 	acct_gather_profile_g_node_step_start(job);
+	acct_gather_filesystem_g_node_step_start(job);
 
 	acct_gather_profile_startpoll(msg->acctg_freq,
 				      conf->job_acct_gather_freq);
@@ -556,10 +558,14 @@ batch_stepd_step_rec_create(batch_job_launch_msg_t *msg)
 	/* give them all to the 1 task */
 	job->cpus_per_task = job->cpus;
 
+	/* acct_gather_filesystem_g_node_step_start() may add to it */
+	job->env     = _array_copy(msg->envc, msg->environment);
+
 	/* This needs to happen before acct_gather_profile_startpoll
 	   and only really looks at the profile in the job.
 	*/
 	acct_gather_profile_g_node_step_start(job);
+	acct_gather_filesystem_g_node_step_start(job);
 	/* needed for the jobacct_gather plugin to start */
 	acct_gather_profile_startpoll(msg->acctg_freq,
 				      conf->job_acct_gather_freq);
@@ -569,7 +575,6 @@ batch_stepd_step_rec_create(batch_job_launch_msg_t *msg)
 
 	job->cwd     = xstrdup(msg->work_dir);
 
-	job->env     = _array_copy(msg->envc, msg->environment);
 	job->eio     = eio_handle_create(0);
 	job->sruns   = list_create((ListDelF) _srun_info_destructor);
 	job->envtp   = xmalloc(sizeof(env_t));
@@ -124,6 +124,9 @@ static int   _get_events(slurmdbd_conn_t *slurmdbd_conn,
 static int   _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 			    persist_msg_t *msg, Buf *out_buffer,
 			    uint32_t *uid);
+static int   _get_jobs_page(slurmdbd_conn_t *slurmdbd_conn,
+			    persist_msg_t *msg, Buf *out_buffer,
+			    uint32_t *uid);
 static int   _get_probs(slurmdbd_conn_t *slurmdbd_conn,
 			persist_msg_t *msg, Buf *out_buffer, uint32_t *uid);
 static int   _get_qos(slurmdbd_conn_t *slurmdbd_conn,
@@ -366,6 +369,10 @@ proc_req(void *conn, persist_msg_t *msg,
 		rc = _get_jobs_cond(slurmdbd_conn,
 				    msg, out_buffer, uid);
 		break;
+	case DBD_GET_JOBS_PAGE:
+		rc = _get_jobs_page(slurmdbd_conn,
+				    msg, out_buffer, uid);
+		break;
 	case DBD_GET_PROBS:
 		rc = _get_probs(slurmdbd_conn,
 				msg, out_buffer, uid);
@@ -557,13 +564,26 @@ proc_req(void *conn, persist_msg_t *msg,
 		      slurmdbd_conn->conn->fd,
 		      slurmdbd_msg_type_2_str(msg->msg_type, 1));
 	else if (slurmdbd_conn->conn->rem_port
-		 && !slurmdbd_conf->commit_delay) {
+		 && !slurmdbd_conf->commit_delay
+		 && !slurmdbd_conn->in_mult_msg) {
 		/* If we are dealing with the slurmctld do the
 		   commit (SUCCESS or NOT) afterwards since we
 		   do transactions for performance reasons.
 		   (don't ever use autocommit with innodb)
 		*/
-		acct_storage_g_commit(slurmdbd_conn->db_conn, 1);
+		if ((acct_storage_g_commit(slurmdbd_conn->db_conn, 1) !=
+		     SLURM_SUCCESS) && (rc == SLURM_SUCCESS)) {
+			/* The message was rolled back, have it sent again */
+			rc = SLURM_ERROR;
+			comment = "Commit failed";
+			error("CONN:%u %s for %s",
+			      slurmdbd_conn->conn->fd, comment,
+			      slurmdbd_msg_type_2_str(msg->msg_type, 1));
+			free_buf(*out_buffer);
+			*out_buffer = slurm_persist_make_rc_msg(
+				slurmdbd_conn->conn, rc, comment,
+				msg->msg_type);
+		}
 	}
 
 	END_TIMER;
@@ -1427,16 +1447,12 @@ static int _get_events(slurmdbd_conn_t *slurmdbd_conn,
 	return rc;
 }
 
-static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
-			  persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
+/* Reject job queries the uid may not do, used by DBD_GET_JOBS_* */
+static int _validate_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
+			       slurmdb_job_cond_t *job_cond,
+			       uint16_t msg_type, Buf *out_buffer,
+			       uint32_t *uid)
 {
-	dbd_cond_msg_t *cond_msg = msg->data;
-	dbd_list_msg_t list_msg = { NULL };
-	slurmdb_job_cond_t *job_cond = cond_msg->cond;
-	int rc = SLURM_SUCCESS;
-
-	debug2("DBD_GET_JOBS_COND: called");
-
 	/* fail early if requesting runaways and not super user */
 	if ((job_cond->flags & JOBCOND_FLAG_RUNAWAY) &&
 	    !_validate_operator(*uid, slurmdbd_conn)) {
@@ -1445,7 +1461,7 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 			slurmdbd_conn->conn,
 			ESLURM_ACCESS_DENIED,
 			"You must have an AdminLevel>=Operator to fix runaway jobs",
-			DBD_GET_JOBS_COND);
+			msg_type);
 		return SLURM_ERROR;
 	}
 	/* fail early if too wide a query */
@@ -1466,11 +1482,28 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 			*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
 								ESLURM_DB_QUERY_TOO_WIDE,
 								slurm_strerror(ESLURM_DB_QUERY_TOO_WIDE),
-								DBD_GET_JOBS_COND);
+								msg_type);
 			return SLURM_ERROR;
 		}
 	}
 
+	return SLURM_SUCCESS;
+}
+
+static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
+			  persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
+{
+	dbd_cond_msg_t *cond_msg = msg->data;
+	dbd_list_msg_t list_msg = { NULL };
+	slurmdb_job_cond_t *job_cond = cond_msg->cond;
+	int rc = SLURM_SUCCESS;
+
+	debug2("DBD_GET_JOBS_COND: called");
+
+	if (_validate_jobs_cond(slurmdbd_conn, job_cond, DBD_GET_JOBS_COND,
+				out_buffer, uid) != SLURM_SUCCESS)
+		return SLURM_ERROR;
+
 	list_msg.my_list = jobacct_storage_g_get_jobs_cond(
 		slurmdbd_conn->db_conn, *uid, job_cond);
 
@@ -1494,6 +1527,48 @@ static int _get_jobs_cond(slurmdbd_conn_t *slurmdbd_conn,
 	return rc;
 }
 
+/*
+ * Only one page of jobs is held and packed at a time, the client asks for the
+ * next one with the cursor sent back.
+ */
+static int _get_jobs_page(slurmdbd_conn_t *slurmdbd_conn,
+			  persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
+{
+	dbd_job_page_msg_t *page_msg = msg->data;
+	slurmdbd_msg_t resp;
+	int rc = SLURM_SUCCESS;
+
+	debug2("DBD_GET_JOBS_PAGE: called");
+
+	if (_validate_jobs_cond(slurmdbd_conn, page_msg->cond,
+				DBD_GET_JOBS_PAGE, out_buffer, uid) !=
+	    SLURM_SUCCESS)
+		return SLURM_ERROR;
+
+	page_msg->my_list = jobacct_storage_g_get_jobs_page(
+		slurmdbd_conn->db_conn, *uid, page_msg->cond,
+		&page_msg->cursor);
+
+	if (!errno) {
+		if (!page_msg->my_list)
+			page_msg->my_list = list_create(NULL);
+		resp.msg_type = DBD_GOT_JOBS_PAGE;
+		resp.data = page_msg;
+		*out_buffer = pack_slurmdbd_msg(&resp,
+						slurmdbd_conn->conn->version);
+	} else {
+		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+							errno,
+							slurm_strerror(errno),
+							DBD_GET_JOBS_PAGE);
+		rc = SLURM_ERROR;
+	}
+
+	FREE_NULL_LIST(page_msg->my_list);
+
+	return rc;
+}
+
 static int _get_probs(slurmdbd_conn_t *slurmdbd_conn,
 		      persist_msg_t *msg, Buf *out_buffer, uint32_t *uid)
 {
@@ -3315,30 +3390,19 @@ static int   _send_mult_job_start(slurmdbd_conn_t *slurmdbd_conn,
 	return SLURM_SUCCESS;
 }
 
-static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
-			    persist_msg_t *msg, Buf *out_buffer,
-			    uint32_t *uid)
+/*
+ * Apply the messages of a DBD_SEND_MULT_MSG until one fails, appending their
+ * replies to ret_list
+ * RET SLURM_SUCCESS or the error of the failed message
+ */
+static int _proc_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
+			  dbd_list_msg_t *get_msg, List ret_list,
+			  uint32_t *uid)
 {
-	dbd_list_msg_t *get_msg = msg->data;
-	dbd_list_msg_t list_msg = { NULL };
-	char *comment = NULL;
 	ListIterator itr = NULL;
 	Buf req_buf = NULL, ret_buf = NULL;
 	int rc = SLURM_SUCCESS;
-	/* DEF_TIMERS; */
-
-	if (!_validate_slurm_user(*uid)) {
-		comment = "DBD_SEND_MULT_MSG message from invalid uid";
-		error("%s %u", comment, *uid);
-		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
-							ESLURM_ACCESS_DENIED,
-							comment,
-							DBD_SEND_MULT_MSG);
-		return SLURM_ERROR;
-	}
 
-	list_msg.my_list = list_create(slurmdbd_free_buffer);
-	/* START_TIMER; */
 	itr = list_iterator_create(get_msg->my_list);
 	while ((req_buf = list_next(itr))) {
 		persist_msg_t sub_msg;
@@ -3356,11 +3420,57 @@ static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
 		}
 
 		if (ret_buf)
-			list_append(list_msg.my_list, ret_buf);
+			list_append(ret_list, ret_buf);
 		if (rc != SLURM_SUCCESS)
 			break;
 	}
 	list_iterator_destroy(itr);
+
+	return rc;
+}
+
+static int   _send_mult_msg(slurmdbd_conn_t *slurmdbd_conn,
+			    persist_msg_t *msg, Buf *out_buffer,
+			    uint32_t *uid)
+{
+	dbd_list_msg_t *get_msg = msg->data;
+	dbd_list_msg_t list_msg = { NULL };
+	char *comment = NULL;
+	int rc = SLURM_SUCCESS;
+	/* DEF_TIMERS; */
+
+	if (!_validate_slurm_user(*uid)) {
+		comment = "DBD_SEND_MULT_MSG message from invalid uid";
+		error("%s %u", comment, *uid);
+		*out_buffer = slurm_persist_make_rc_msg(slurmdbd_conn->conn,
+							ESLURM_ACCESS_DENIED,
+							comment,
+							DBD_SEND_MULT_MSG);
+		return SLURM_ERROR;
+	}
+
+	list_msg.my_list = list_create(slurmdbd_free_buffer);
+	/*
+	 * The messages are applied in one transaction, committed here so that
+	 * no reply acknowledges what a failed commit rolled back. They are
+	 * then applied again one at a time, each committed by proc_req(), so
+	 * that the reply tells the agent which one failed and has to be sent
+	 * again. With CommitDelay nothing is committed before the reply.
+	 */
+	slurmdbd_conn->in_mult_msg = true;
+	/* START_TIMER; */
+	rc = _proc_mult_msg(slurmdbd_conn, get_msg, list_msg.my_list, uid);
+	slurmdbd_conn->in_mult_msg = false;
+	if ((rc == SLURM_SUCCESS) && slurmdbd_conn->conn->rem_port &&
+	    !slurmdbd_conf->commit_delay &&
+	    (acct_storage_g_commit(slurmdbd_conn->db_conn, 1) !=
+	     SLURM_SUCCESS)) {
+		error("CONN:%u DBD_SEND_MULT_MSG commit failed, applying its %d messages one at a time",
+		      slurmdbd_conn->conn->fd, list_count(get_msg->my_list));
+		list_flush(list_msg.my_list);
+		(void) _proc_mult_msg(slurmdbd_conn, get_msg, list_msg.my_list,
+				      uid);
+	}
 	/* END_TIMER; */
 	/* info("%d multi took %s", list_count(get_msg->my_list), TIME_STR); */
 
@@ -47,6 +47,7 @@ typedef struct {
 	slurm_persist_conn_t *conn;
 	void *db_conn; /* database connection */
 	char *tres_str;
+	bool in_mult_msg; /* commit once at the end of DBD_SEND_MULT_MSG */
 } slurmdbd_conn_t;
 
 /* Process an incoming RPC
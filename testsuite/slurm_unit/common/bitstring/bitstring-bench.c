@@ -0,0 +1,130 @@
+/*****************************************************************************\
+ *  bitstring-bench.c - time the bitstring operations used by node selection
+ *****************************************************************************
+ *  Each operation is run on bitmaps of a cluster sized number of nodes and
+ *  the average time per call is reported.
+ *
+ *  Usage: bitstring-bench [nodes [iterations]]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "src/common/bitstring.h"
+
+static struct timeval tv;
+static volatile long sink;
+
+static void _start(void)
+{
+	gettimeofday(&tv, NULL);
+}
+
+static void _stop(const char *name, int iterations)
+{
+	struct timeval tv2;
+	double usecs;
+
+	gettimeofday(&tv2, NULL);
+	usecs = (tv2.tv_sec - tv.tv_sec) * 1e6 + (tv2.tv_usec - tv.tv_usec);
+	printf("%-20s %10.1f ns/call\n", name, usecs * 1000 / iterations);
+}
+
+int main(int argc, char **argv)
+{
+	int nodes = 16384, iterations = 100000, i;
+	bitstr_t *b1, *b2, *b3;
+
+	if (argc > 1)
+		nodes = atoi(argv[1]);
+	if (argc > 2)
+		iterations = atoi(argv[2]);
+	if ((nodes < 1) || (iterations < 1)) {
+		fprintf(stderr, "Usage: %s [nodes [iterations]]\n", argv[0]);
+		exit(1);
+	}
+
+	/* Two overlapping halves of the cluster, b3 is b1 without the overlap */
+	b1 = bit_alloc(nodes);
+	b2 = bit_alloc(nodes);
+	bit_nset(b1, 0, (nodes * 3 / 4) - 1);
+	bit_nset(b2, nodes / 4, nodes - 1);
+	b3 = bit_copy(b1);
+	bit_and_not(b3, b2);
+	printf("%d nodes, %d iterations\n", nodes, iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		bit_and(b3, b1);
+	_stop("bit_and", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		bit_or(b3, b3);
+	_stop("bit_or", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_set_count(b1);
+	_stop("bit_set_count", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_set_count_range(b1, 1, nodes - 1);
+	_stop("bit_set_count_range", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_overlap(b1, b2);
+	_stop("bit_overlap", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_overlap_any(b3, b2);
+	_stop("bit_overlap_any", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_super_set(b3, b1);
+	_stop("bit_super_set", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_ffs(b2);
+	_stop("bit_ffs", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_and_count(b3, b1);
+	_stop("bit_and_count", iterations);
+
+	_start();
+	for (i = 0; i < iterations; i++)
+		sink += bit_and_not_any(b3, b2);
+	_stop("bit_and_not_any", iterations);
+
+	bit_free(b1);
+	bit_free(b2);
+	bit_free(b3);
+
+	return 0;
+}
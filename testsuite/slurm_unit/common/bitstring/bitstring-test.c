@@ -207,6 +207,79 @@ main(int argc, char *argv[])
 		TEST(bit_equal(bs, bs2), "bitstring");
 	}
 
+	note("Testing bit_overlap");
+	{
+		bitstr_t *bs1 = bit_alloc(128);
+		bitstr_t *bs2 = bit_alloc(128);
+
+		bit_nset(bs1, 0, 79);
+		bit_set(bs2, 40);
+		bit_set(bs2, 70);
+		bit_set(bs2, 100);
+		TEST(bit_overlap(bs1, bs2) == 2, "bit_overlap high word bits");
+		TEST(bit_overlap_any(bs1, bs2), "bit_overlap_any");
+		bit_clear(bs2, 40);
+		bit_clear(bs2, 70);
+		TEST(!bit_overlap_any(bs1, bs2), "bit_overlap_any none");
+
+		bit_free(bs1);
+		bit_free(bs2);
+	}
+
+	note("Testing word kernels on a large bitmap");
+	{
+		bitstr_t *bs1 = bit_alloc(10007);
+		bitstr_t *bs2 = bit_alloc(10007);
+		bitstr_t *bs3;
+		int i, and_cnt = 0, and_not_cnt = 0;
+
+		for (i = 0; i < 10007; i++) {
+			if ((i % 3) == 0)
+				bit_set(bs1, i);
+			if ((i % 5) == 0)
+				bit_set(bs2, i);
+			if (((i % 3) == 0) && ((i % 5) == 0))
+				and_cnt++;
+			if (((i % 3) == 0) && ((i % 5) != 0))
+				and_not_cnt++;
+		}
+		TEST(bit_set_count(bs1) == 3336, "set_count");
+		TEST(bit_set_count_range(bs1, 1, 10000) == 3333,
+		     "set_count_range");
+		TEST(bit_overlap(bs1, bs2) == and_cnt, "overlap");
+		TEST(!bit_super_set(bs1, bs2), "super_set");
+
+		bs3 = bit_copy(bs1);
+		TEST(bit_and_count(bs3, bs2) == and_cnt, "and_count");
+		TEST(bit_super_set(bs3, bs2), "and_count result");
+		TEST(bit_ffs(bs3) == 0, "ffs");
+		bit_free(bs3);
+
+		bs3 = bit_copy(bs1);
+		TEST(bit_and_not_any(bs3, bs2), "and_not_any");
+		TEST(bit_set_count(bs3) == and_not_cnt, "and_not_any result");
+		TEST(bit_ffs(bs3) == 3, "ffs");
+		TEST(!bit_and_not_any(bs3, bs1), "and_not_any none left");
+		TEST(bit_ffs(bs3) == -1, "ffs empty");
+		bit_set(bs3, 10006);
+		TEST(bit_ffs(bs3) == 10006, "ffs last bit");
+		TEST(bit_ffs_from_bit(bs3, 5) == 10006, "ffs_from_bit far");
+		bit_set(bs3, 64);
+		TEST(bit_ffs_from_bit(bs3, 64) == 64, "ffs_from_bit word start");
+		TEST(bit_ffs_from_bit(bs3, 65) == 10006, "ffs_from_bit skip");
+		bit_free(bs3);
+
+		TEST(bit_ffs_from_bit(bs1, 0) == 0, "ffs_from_bit first");
+		TEST(bit_ffs_from_bit(bs1, 1) == 3, "ffs_from_bit partial word");
+		TEST(bit_ffs_from_bit(bs1, 127) == 129, "ffs_from_bit next word");
+		TEST(bit_ffs_from_bit(bs1, 10005) == 10005, "ffs_from_bit last");
+		TEST(bit_ffs_from_bit(bs1, 10006) == -1, "ffs_from_bit none");
+		TEST(bit_ffs_from_bit(bs1, 20000) == -1, "ffs_from_bit past end");
+
+		bit_free(bs1);
+		bit_free(bs2);
+	}
+
 	totals();
 	return failed;
 }
@@ -0,0 +1,184 @@
+/*****************************************************************************\
+ *  gres-bench.c - cost of gres_plugin_job_test() on an 8 GPU node
+ *****************************************************************************
+ *  A job requesting 4 GPUs per node is tested against a two socket node with
+ *  GPUs 0-3 local to socket 0 and GPUs 4-7 local to socket 1, once with all
+ *  GPUs free (the job fits) and once with 6 allocated (it does not).
+ *
+ *  Usage: gres-bench [calls]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/gres.h"
+#include "src/common/list.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+
+#define CORE_CNT 64
+#define GPU_CNT 8
+
+static gres_node_state_t *_alloc_node_gres(void)
+{
+	gres_node_state_t *node_gres;
+	int i;
+
+	node_gres = xmalloc(sizeof(gres_node_state_t));
+	node_gres->gres_cnt_config = GPU_CNT;
+	node_gres->gres_cnt_avail = GPU_CNT;
+	node_gres->topo_cnt = GPU_CNT;
+	node_gres->topo_core_bitmap = xcalloc(GPU_CNT, sizeof(bitstr_t *));
+	node_gres->topo_gres_cnt_alloc = xcalloc(GPU_CNT, sizeof(uint64_t));
+	node_gres->topo_gres_cnt_avail = xcalloc(GPU_CNT, sizeof(uint64_t));
+	node_gres->topo_type_id = xcalloc(GPU_CNT, sizeof(uint32_t));
+	node_gres->topo_type_name = xcalloc(GPU_CNT, sizeof(char *));
+	for (i = 0; i < GPU_CNT; i++) {
+		node_gres->topo_core_bitmap[i] = bit_alloc(CORE_CNT);
+		if (i < (GPU_CNT / 2))
+			bit_nset(node_gres->topo_core_bitmap[i], 0,
+				 (CORE_CNT / 2) - 1);
+		else
+			bit_nset(node_gres->topo_core_bitmap[i],
+				 CORE_CNT / 2, CORE_CNT - 1);
+		node_gres->topo_gres_cnt_avail[i] = 1;
+	}
+
+	return node_gres;
+}
+
+static void _free_node_gres(gres_node_state_t *node_gres)
+{
+	int i;
+
+	for (i = 0; i < node_gres->topo_cnt; i++)
+		FREE_NULL_BITMAP(node_gres->topo_core_bitmap[i]);
+	xfree(node_gres->topo_core_bitmap);
+	xfree(node_gres->topo_gres_cnt_alloc);
+	xfree(node_gres->topo_gres_cnt_avail);
+	xfree(node_gres->topo_type_id);
+	xfree(node_gres->topo_type_name);
+	xfree(node_gres);
+}
+
+/* Mark the first alloc_cnt GPUs of the node as allocated */
+static void _set_node_alloc(gres_node_state_t *node_gres, int alloc_cnt)
+{
+	int i;
+
+	node_gres->gres_cnt_alloc = alloc_cnt;
+	for (i = 0; i < node_gres->topo_cnt; i++)
+		node_gres->topo_gres_cnt_alloc[i] = (i < alloc_cnt) ? 1 : 0;
+}
+
+/* RET nsec per call */
+static double _bench(List job_gres_list, List node_gres_list,
+		     bitstr_t *core_bitmap, long calls)
+{
+	struct timeval tv1, tv2;
+	long i;
+
+	gettimeofday(&tv1, NULL);
+	for (i = 0; i < calls; i++) {
+		(void) gres_plugin_job_test(job_gres_list, node_gres_list,
+					    false, core_bitmap, 0,
+					    CORE_CNT - 1, 1, "node1");
+	}
+	gettimeofday(&tv2, NULL);
+
+	return (((tv2.tv_sec - tv1.tv_sec) * 1000000.0) +
+		(tv2.tv_usec - tv1.tv_usec)) * 1000.0 / calls;
+}
+
+int main(int argc, char **argv)
+{
+	char conf_file[] = "/tmp/gres-bench.conf.XXXXXX";
+	char *conf_str;
+	List job_gres_list, node_gres_list;
+	gres_state_t job_gres_state, node_gres_state;
+	gres_job_state_t job_gres;
+	gres_node_state_t *node_gres;
+	bitstr_t *core_bitmap;
+	long calls = 1000000;
+	int fd;
+
+	if (argc > 1)
+		calls = atol(argv[1]);
+	if (calls < 1) {
+		fprintf(stderr, "Usage: %s [calls]\n", argv[0]);
+		exit(1);
+	}
+
+	/* Build the gres/gpu context by hand, as gres-test does */
+	if ((fd = mkstemp(conf_file)) < 0) {
+		perror("mkstemp");
+		exit(1);
+	}
+	conf_str = xstrdup("ClusterName=unit\n"
+			   "SlurmctldHost=localhost\n");
+	if (write(fd, conf_str, strlen(conf_str)) != strlen(conf_str)) {
+		perror("write");
+		exit(1);
+	}
+	close(fd);
+	xfree(conf_str);
+	setenv("SLURM_CONF", conf_file, 1);
+	gres_plugin_init();
+	gres_plugin_add("gpu");
+
+	memset(&job_gres, 0, sizeof(job_gres));
+	job_gres.gres_name = "gpu";
+	job_gres.gres_per_node = 4;
+	job_gres_state.plugin_id = gres_plugin_build_id("gpu");
+	job_gres_state.gres_data = &job_gres;
+	job_gres_list = list_create(NULL);
+	list_append(job_gres_list, &job_gres_state);
+
+	node_gres = _alloc_node_gres();
+	node_gres_state.plugin_id = gres_plugin_build_id("gpu");
+	node_gres_state.gres_data = node_gres;
+	node_gres_list = list_create(NULL);
+	list_append(node_gres_list, &node_gres_state);
+
+	core_bitmap = bit_alloc(CORE_CNT);
+	bit_set_all(core_bitmap);
+
+	printf("%ld calls of gres_plugin_job_test\n", calls);
+	_set_node_alloc(node_gres, 0);
+	printf("fit:    %.1f nsec per call\n",
+	       _bench(job_gres_list, node_gres_list, core_bitmap, calls));
+	_set_node_alloc(node_gres, 6);
+	printf("no fit: %.1f nsec per call\n",
+	       _bench(job_gres_list, node_gres_list, core_bitmap, calls));
+
+	FREE_NULL_BITMAP(core_bitmap);
+	FREE_NULL_LIST(job_gres_list);
+	FREE_NULL_LIST(node_gres_list);
+	_free_node_gres(node_gres);
+	gres_plugin_fini();
+	unlink(conf_file);
+
+	return 0;
+}
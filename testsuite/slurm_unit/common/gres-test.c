@@ -0,0 +1,177 @@
+/*
+ * Test of src/common/gres.c job selection tests on a homogeneous 8 GPU node.
+ *
+ * Avoid duplicate wait() symbol definition (in both testsuite/dejagnu.h
+ * and sys/wait.h
+ */
+#define _SYS_WAIT_H 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <src/common/bitstring.h>
+#include <src/common/gres.h>
+#include <src/common/list.h>
+#include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
+#include <testsuite/dejagnu.h>
+
+/*
+ * Test for failure:
+ */
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+#define CORE_CNT 64
+#define GPU_CNT 8
+
+static gres_node_state_t *_alloc_node_gres(void)
+{
+	gres_node_state_t *node_gres;
+	int i;
+
+	node_gres = xmalloc(sizeof(gres_node_state_t));
+	node_gres->gres_cnt_config = GPU_CNT;
+	node_gres->gres_cnt_avail = GPU_CNT;
+	node_gres->topo_cnt = GPU_CNT;
+	node_gres->topo_core_bitmap = xcalloc(GPU_CNT, sizeof(bitstr_t *));
+	node_gres->topo_gres_cnt_alloc = xcalloc(GPU_CNT, sizeof(uint64_t));
+	node_gres->topo_gres_cnt_avail = xcalloc(GPU_CNT, sizeof(uint64_t));
+	node_gres->topo_type_id = xcalloc(GPU_CNT, sizeof(uint32_t));
+	node_gres->topo_type_name = xcalloc(GPU_CNT, sizeof(char *));
+	for (i = 0; i < GPU_CNT; i++) {
+		/* GPUs 0-3 are on socket 0, GPUs 4-7 on socket 1 */
+		node_gres->topo_core_bitmap[i] = bit_alloc(CORE_CNT);
+		if (i < (GPU_CNT / 2))
+			bit_nset(node_gres->topo_core_bitmap[i], 0,
+				 (CORE_CNT / 2) - 1);
+		else
+			bit_nset(node_gres->topo_core_bitmap[i],
+				 CORE_CNT / 2, CORE_CNT - 1);
+		node_gres->topo_gres_cnt_avail[i] = 1;
+	}
+
+	return node_gres;
+}
+
+static void _free_node_gres(gres_node_state_t *node_gres)
+{
+	int i;
+
+	for (i = 0; i < node_gres->topo_cnt; i++)
+		FREE_NULL_BITMAP(node_gres->topo_core_bitmap[i]);
+	xfree(node_gres->topo_core_bitmap);
+	xfree(node_gres->topo_gres_cnt_alloc);
+	xfree(node_gres->topo_gres_cnt_avail);
+	xfree(node_gres->topo_type_id);
+	xfree(node_gres->topo_type_name);
+	xfree(node_gres);
+}
+
+/* Mark the first alloc_cnt GPUs of the node as allocated */
+static void _set_node_alloc(gres_node_state_t *node_gres, int alloc_cnt)
+{
+	int i;
+
+	node_gres->gres_cnt_alloc = alloc_cnt;
+	for (i = 0; i < node_gres->topo_cnt; i++)
+		node_gres->topo_gres_cnt_alloc[i] = (i < alloc_cnt) ? 1 : 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char conf_file[] = "/tmp/gres-test.conf.XXXXXX";
+	char *conf_str;
+	List job_gres_list, node_gres_list;
+	gres_state_t job_gres_state, node_gres_state;
+	gres_job_state_t job_gres;
+	gres_node_state_t *node_gres;
+	bitstr_t *core_bitmap;
+	uint32_t rc;
+	int fd;
+
+	/*
+	 * Build the gres/gpu context by hand rather than through GresTypes,
+	 * which would also load the select plugin. Without the gres/gpu
+	 * plugin itself, GRES counts are still tracked.
+	 */
+	if ((fd = mkstemp(conf_file)) < 0) {
+		fail("mkstemp");
+		return 1;
+	}
+	conf_str = xstrdup("ClusterName=unit\n"
+			   "SlurmctldHost=localhost\n");
+	if (write(fd, conf_str, strlen(conf_str)) != strlen(conf_str))
+		fail("write config");
+	close(fd);
+	xfree(conf_str);
+	setenv("SLURM_CONF", conf_file, 1);
+	gres_plugin_init();
+	gres_plugin_add("gpu");
+
+	memset(&job_gres, 0, sizeof(job_gres));
+	job_gres.gres_name = "gpu";
+	job_gres.gres_per_node = 4;
+	job_gres_state.plugin_id = gres_plugin_build_id("gpu");
+	job_gres_state.gres_data = &job_gres;
+	job_gres_list = list_create(NULL);
+	list_append(job_gres_list, &job_gres_state);
+
+	node_gres = _alloc_node_gres();
+	node_gres_state.plugin_id = gres_plugin_build_id("gpu");
+	node_gres_state.gres_data = node_gres;
+	node_gres_list = list_create(NULL);
+	list_append(node_gres_list, &node_gres_state);
+
+	core_bitmap = bit_alloc(CORE_CNT);
+	bit_set_all(core_bitmap);
+
+	note("Testing gres_plugin_job_test");
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, false,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == CORE_CNT, "4 of 8 free GPUs, all cores usable");
+
+	job_gres.gres_per_node = 9;
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, false,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == 0, "9 GPUs on an 8 GPU node");
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, true,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == 0, "9 GPUs on an 8 GPU node, use_total_gres");
+
+	job_gres.gres_per_node = 4;
+	_set_node_alloc(node_gres, 6);
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, false,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == 0, "4 GPUs with 2 free");
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, true,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == CORE_CNT, "4 GPUs with 2 free, use_total_gres");
+
+	/* Socket 1 GPUs free, but only socket 0 cores usable */
+	_set_node_alloc(node_gres, 4);
+	bit_nclear(core_bitmap, CORE_CNT / 2, CORE_CNT - 1);
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, false,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == 0, "4 free GPUs not local to usable cores");
+	bit_set_all(core_bitmap);
+	bit_nclear(core_bitmap, 0, (CORE_CNT / 2) - 1);
+	rc = gres_plugin_job_test(job_gres_list, node_gres_list, false,
+				  core_bitmap, 0, CORE_CNT - 1, 1, "node1");
+	TEST(rc == (CORE_CNT / 2), "4 free GPUs local to usable cores");
+
+	FREE_NULL_BITMAP(core_bitmap);
+	FREE_NULL_LIST(job_gres_list);
+	FREE_NULL_LIST(node_gres_list);
+	_free_node_gres(node_gres);
+	gres_plugin_fini();
+	unlink(conf_file);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,246 @@
+/*
+ * Test of src/common/hostlist.c host lookups
+ *
+ * Lists with more than a few ranges are searched through a range index from
+ * their second lookup on, so every lookup is made twice and must give the
+ * same result as the first one, which scans the ranges.
+ *
+ * Avoid duplicate wait() symbol definition (in both testsuite/dejagnu.h
+ * and sys/wait.h
+ */
+#define _SYS_WAIT_H 1
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <src/common/hostlist.h>
+#include <src/common/xmalloc.h>
+#include <testsuite/dejagnu.h>
+
+/*
+ * Test for failure:
+ */
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+/* Position of the first host of hl printed as host, or -1 */
+static int _scan(hostlist_t hl, const char *host)
+{
+	int i, cnt = hostlist_count(hl), pos = -1;
+	char *name;
+
+	for (i = 0; (i < cnt) && (pos == -1); i++) {
+		name = hostlist_nth(hl, i);
+		if (!strcmp(name, host))
+			pos = i;
+		free(name);
+	}
+	return pos;
+}
+
+/* Look host up twice in hl, both must find it at pos */
+static void _test_find(hostlist_t hl, const char *host, int pos)
+{
+	char msg[128];
+	int first = hostlist_find(hl, host);
+	int second = hostlist_find(hl, host);
+
+	snprintf(msg, sizeof(msg), "hostlist_find(%s) %d %d, expected %d",
+		 host, first, second, pos);
+	TEST((first == pos) && (second == pos), msg);
+}
+
+/* Look every host of hosts up in hl, as in the list of printed hosts */
+static void _test_find_all(hostlist_t hl, const char *hosts)
+{
+	hostlist_t query = hostlist_create(hosts);
+	char *host;
+
+	while ((host = hostlist_shift(query))) {
+		_test_find(hl, host, _scan(hl, host));
+		free(host);
+	}
+	hostlist_destroy(query);
+}
+
+static void _test_ranged(hostlist_t hl, const char *expect)
+{
+	char msg[256];
+	char *str = hostlist_ranged_string_xmalloc(hl);
+
+	snprintf(msg, sizeof(msg), "ranged string %s, expected %s",
+		 str, expect);
+	TEST(!strcmp(str, expect), msg);
+	xfree(str);
+}
+
+static void _test_set(hostset_t set, const char *expect)
+{
+	char msg[512], str[256];
+
+	hostset_ranged_string(set, sizeof(str), str);
+	snprintf(msg, sizeof(msg), "hostset %s, expected %s", str, expect);
+	TEST(!strcmp(str, expect), msg);
+}
+
+static void _test_range(hostlist_t hl, int n, const char *prefix,
+			unsigned long lo, unsigned long hi, int width)
+{
+	char msg[256];
+	unsigned long lo2 = 0, hi2 = 0;
+	int width2 = 0;
+	char *prefix2 = hostlist_nth_range_values(hl, n, &lo2, &hi2, &width2);
+
+	snprintf(msg, sizeof(msg),
+		 "range %d %s %lu-%lu/%d, expected %s %lu-%lu/%d", n,
+		 prefix2 ? prefix2 : "NULL", lo2, hi2, width2, prefix, lo, hi,
+		 width);
+	TEST(prefix2 && !strcmp(prefix2, prefix) && (lo2 == lo) &&
+	     (hi2 == hi) && (width2 == width), msg);
+	free(prefix2);
+}
+
+static const char *query_hosts =
+	"a[1-3],b[0-3],n[0-9],n[00-10],nid[0-12],nid[00-12],nid[000-012],"
+	"nid[0000-0012],nid[00000-00012],nid000000,nid0000,lx,lx0,nid";
+
+int main(int argc, char *argv[])
+{
+	hostlist_t hl;
+	hostset_t set;
+
+	note("Testing hostlist_find with duplicate hosts");
+	hl = hostlist_create("b1,n[1-3],a2,n2,n[2-4],b2,n3");
+	TEST(hostlist_count(hl) == 11, "hostlist_count with duplicates");
+	_test_find(hl, "n2", 2);
+	_test_find(hl, "n3", 3);
+	_test_find(hl, "n4", 8);
+	_test_find(hl, "b2", 9);
+	_test_find(hl, "n5", -1);
+	_test_find_all(hl, query_hosts);
+	hostlist_destroy(hl);
+
+	note("Testing hostlist_find with mixed suffix widths");
+	hl = hostlist_create("nid[0001-0004],x1,nid[1-4],y1,nid[08-12],z1");
+	_test_find(hl, "nid0001", 0);
+	_test_find(hl, "nid1", 5);
+	_test_find(hl, "nid4", 8);
+	_test_find(hl, "nid01", -1);
+	_test_find(hl, "nid001", -1);
+	_test_find(hl, "nid08", 10);
+	_test_find(hl, "nid8", -1);
+	_test_find(hl, "nid10", 12);
+	_test_find(hl, "nid010", -1);
+	_test_find_all(hl, query_hosts);
+	hostlist_destroy(hl);
+
+	note("Testing hostlist_find with prefixes ending in zeros");
+	hl = hostlist_create("nid0000[2-7],a1,nid[10-12],b1,nid00[10-12],b3");
+	_test_find(hl, "nid00002", 0);
+	_test_find(hl, "nid00007", 5);
+	_test_find(hl, "nid00008", -1);
+	_test_find(hl, "nid2", -1);
+	_test_find(hl, "nid000002", -1);
+	_test_find(hl, "nid10", 7);
+	_test_find(hl, "nid0010", 11);
+	_test_find_all(hl, query_hosts);
+	hostlist_destroy(hl);
+
+	/* A shorter prefix must not make a longer one match */
+	hl = hostlist_create("n,nid012,lx[0024,13],a1b[10-19],nid[14,0010-0012],"
+			     "n[03-05,0000],nid[0021,0039],a1b11");
+	_test_find(hl, "nid34", -1);
+	_test_find(hl, "nid0", -1);
+	_test_find(hl, "n0000", 21);
+	_test_find(hl, "n", 0);
+	_test_find_all(hl, query_hosts);
+	hostlist_destroy(hl);
+
+	note("Testing hostlist_find after sort, uniq and delete");
+	hl = hostlist_create("n[5-9],a[1-3],n[1-4],b2,n3,a2,nid[0001-0003],"
+			     "nid[1-3]");
+	_test_find(hl, "n3", 10);
+	hostlist_sort(hl);
+	_test_ranged(hl, "a[1-2,2-3],b2,n[1-3,3-9],nid[1-3,0001-0003]");
+	_test_find(hl, "n3", 7);
+	_test_find(hl, "nid2", 16);
+	_test_find(hl, "nid0002", 19);
+	_test_find_all(hl, query_hosts);
+	hostlist_uniq(hl);
+	_test_ranged(hl, "a[1-3],b2,n[1-9],nid[1-3,0001-0003]");
+	_test_find(hl, "n3", 6);
+	_test_find(hl, "nid0001", 16);
+	_test_find_all(hl, query_hosts);
+	TEST(hostlist_delete(hl, "n[2-4],a1,nid0002") == 5, "hostlist_delete");
+	_test_ranged(hl, "a[2-3],b2,n[1,5-9],nid[1-3,0001,0003]");
+	_test_find(hl, "n5", 4);
+	_test_find(hl, "n3", -1);
+	_test_find(hl, "nid0003", 13);
+	_test_find_all(hl, query_hosts);
+	hostlist_destroy(hl);
+
+	note("Testing hostlist_nth_range_values");
+	hl = hostlist_create("tux[0-9,20-29],lx[08-12],solo,nid0000[2-7],b3");
+	_test_range(hl, 0, "tux", 0, 9, 1);
+	_test_range(hl, 1, "tux", 20, 29, 2);
+	_test_range(hl, 2, "lx", 8, 12, 2);
+	_test_range(hl, 3, "solo", 0, 0, -1);
+	_test_range(hl, 4, "nid0000", 2, 7, 1);
+	_test_range(hl, 5, "b", 3, 3, 1);
+	{
+		unsigned long lo = 1, hi = 1;
+		int width = 1;
+		char *prefix;
+
+		prefix = hostlist_nth_range_values(hl, 6, &lo, &hi, &width);
+		TEST(!prefix && (lo == 1) && (hi == 1) && (width == 1),
+		     "range past the last one");
+		prefix = hostlist_nth_range_values(hl, -1, &lo, &hi, &width);
+		TEST(!prefix, "negative range");
+	}
+	TEST(hostlist_count(hl) == 33, "hostlist unchanged");
+	hostlist_destroy(hl);
+
+	note("Testing hostset_within and hostset_intersects");
+	set = hostset_create("nid[0001-0100],lx[1-5],nid[1-3],a,b,c");
+	TEST(hostset_within(set, "nid[0002-0004]"), "within padded");
+	TEST(!hostset_within(set, "nid[2-4]"), "not within unpadded");
+	TEST(hostset_within(set, "nid[2-3],lx[2-4],b"), "within mixed");
+	TEST(!hostset_within(set, "nid0001,lx9"), "not within one missing");
+	TEST(!hostset_within(set, "nid02"), "not within other width");
+	TEST(hostset_intersects(set, "nid0001,lx9"), "intersects one");
+	TEST(hostset_intersects(set, "d,c"), "intersects singlet");
+	TEST(!hostset_intersects(set, "nid[4-9],nid[101-200]"),
+	     "no intersection");
+	TEST(!hostset_intersects(set, "nid[0101-0200],lx0,d"),
+	     "no intersection padded");
+	hostset_destroy(set);
+
+	set = hostset_create("nid0000[2-7],nid[10-12],lx[1-2],x,y,z");
+	TEST(hostset_within(set, "nid0000[3-4],nid12"), "within zero prefix");
+	TEST(!hostset_within(set, "nid00003,nid3"), "not within zero prefix");
+	TEST(hostset_intersects(set, "nid3,nid00006"),
+	     "intersects zero prefix");
+	TEST(!hostset_intersects(set, "nid[2-7],nid0010"),
+	     "no intersection zero prefix");
+	hostset_destroy(set);
+
+	note("Testing hostset_insert");
+	set = hostset_create("n[1-3],lx5");
+	TEST(hostset_insert(set, "n2,n[5-6]") == 2, "insert with duplicate");
+	TEST(hostset_insert(set, "n4") == 1, "insert joining ranges");
+	_test_set(set, "lx5,n[1-6]");
+	TEST(hostset_insert(set, "n01,n[001-002],n0") == 4,
+	     "insert other widths");
+	_test_set(set, "lx5,n[0-6,01,001-002]");
+	TEST(hostset_insert(set, "n[1-6],lx5") == 0, "insert all duplicates");
+	TEST(hostset_count(set) == 11, "hostset_count");
+	TEST(hostset_within(set, "n[001-002],n01,n0"), "within inserted");
+	hostset_destroy(set);
+
+	totals();
+	return failed;
+}
@@ -52,6 +52,7 @@ int
 main(int argc, char *argv[])
 {
 	job_resources_t *job1, *job2;
+	job_resources_index_t *index;
 
 	note("Testing job_resources_or");
 	job1 = _alloc_job_res();
@@ -157,6 +158,51 @@ main(int argc, char *argv[])
 	_free_job_res(job1);
 	_free_job_res(job2);
 
+	note("Testing job_resources index");
+	job1 = _alloc_job_res();
+	job1->nhosts = 3;
+	job1->cpus = xcalloc(3, sizeof(uint16_t));
+	job1->cpus_used = xcalloc(3, sizeof(uint16_t));
+	job1->cores_per_socket[0] = 4;
+	job1->sockets_per_node[0] = 2;
+	job1->sock_core_rep_count[0] = 2;
+	job1->cores_per_socket[1] = 5;
+	job1->sockets_per_node[1] = 3;
+	job1->sock_core_rep_count[1] = 1;
+	bit_set(job1->node_bitmap, 1);	/* Node 1, Cores 0-7 */
+	bit_set(job1->node_bitmap, 4);	/* Node 4, Cores 8-15 */
+	bit_set(job1->node_bitmap, 6);	/* Node 6, Cores 16-30 */
+	job1->cpus[0] = 8;
+	job1->cpus[1] = 8;
+	job1->cpus[2] = 15;
+	job1->cpus_used[1] = 8;
+	if (!(index = get_job_resources_index(job1))) {
+		fail("get_job_resources_index function fail");
+	} else {
+		TEST(index == get_job_resources_index(job1), "index reused");
+		TEST(index->node_inx[0] == 1, "node_inx[0] value");
+		TEST(index->node_inx[1] == 4, "node_inx[1] value");
+		TEST(index->node_inx[2] == 6, "node_inx[2] value");
+		TEST(index->core_offset[1] == 8, "core_offset[1] value");
+		TEST(index->core_offset[2] == 16, "core_offset[2] value");
+		TEST(index->core_offset[2] + 2 * index->cores[2] + 4 ==
+		     get_job_resources_offset(job1, 2, 2, 4),
+		     "core_offset matches get_job_resources_offset");
+		TEST(bit_test(index->node_free, 0), "node 0 free");
+		TEST(!bit_test(index->node_free, 1), "node 1 busy");
+		job1->cpus_used[0] = 8;
+		update_job_resources_index(job1, 0);
+		job1->cpus_used[1] = 2;
+		update_job_resources_index(job1, 1);
+		TEST(!bit_test(index->node_free, 0), "node 0 busy");
+		TEST(bit_test(index->node_free, 1), "node 1 free");
+	}
+	free_job_resources_index(job1);
+	TEST(job1->step_index == NULL, "index freed");
+	xfree(job1->cpus);
+	xfree(job1->cpus_used);
+	_free_job_res(job1);
+
 	totals();
 	return failed;
 }
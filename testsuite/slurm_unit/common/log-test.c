@@ -1,14 +1,75 @@
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <slurm/slurm_errno.h>
 #include "src/common/log.h"
 
+#define ASYNC_THREADS	4
+#define ASYNC_MSGS	10000
+
 int bad_func()
 {
 	slurm_seterrno_ret(EINVAL);
 }
+static void *_async_logger(void *arg)
+{
+	int i;
+
+	for (i = 0; i < ASYNC_MSGS; i++)
+		debug("async thread %ld message %d", (long) arg, i);
+	return NULL;
+}
+
+/* Log from several threads through the log writer thread, every message
+ * must reach the logfile in order */
+static int _test_async(void)
+{
+	log_options_t log_opts = LOG_OPTS_INITIALIZER;
+	char logfile[] = "/tmp/log-test.XXXXXX", line[256];
+	pthread_t tids[ASYNC_THREADS];
+	int next[ASYNC_THREADS] = { 0 };
+	long i;
+	int fd, n, rc = 0;
+	FILE *fp;
+
+	if ((fd = mkstemp(logfile)) < 0)
+		return 1;
+	close(fd);
+	log_opts.stderr_level = LOG_LEVEL_QUIET;
+	log_opts.syslog_level = LOG_LEVEL_QUIET;
+	log_opts.logfile_level = LOG_LEVEL_DEBUG;
+	log_alter(log_opts, 0, logfile);
+
+	log_set_async(LOG_ASYNC_BLOCK);
+	for (i = 0; i < ASYNC_THREADS; i++)
+		pthread_create(&tids[i], NULL, _async_logger, (void *) i);
+	for (i = 0; i < ASYNC_THREADS; i++)
+		pthread_join(tids[i], NULL);
+	log_set_async(LOG_ASYNC_OFF);
+	info("synchronous again");
+
+	if (!(fp = fopen(logfile, "r")))
+		return 1;
+	while (fgets(line, sizeof(line), fp)) {
+		char *p = strstr(line, "async thread ");
+		if (p && (sscanf(p, "async thread %ld message %d", &i, &n) == 2)) {
+			if ((i >= ASYNC_THREADS) || (n != next[i]++))
+				rc = 1;
+		}
+	}
+	fclose(fp);
+	unlink(logfile);
+	for (i = 0; i < ASYNC_THREADS; i++) {
+		if (next[i] != ASYNC_MSGS)
+			rc = 1;
+	}
+	return rc;
+}
+
 int main(int ac, char **av)
 {
 	/* test elements */
@@ -62,6 +123,11 @@ int main(int ac, char **av)
 
 	if (bad_func() < 0)
 		error("bad_func: %m");
+
+	if (_test_async()) {
+		fprintf(stderr, "asynchronous logging lost messages\n");
+		return 1;
+	}
 	return 0;
 }
 	
@@ -0,0 +1,270 @@
+/*
+ * Test of src/common/node_conf.c node name and NodeHostName index, and of
+ * node_name2bitmap() resolving hostlist ranges in bulk.
+ *
+ * Avoid duplicate wait() symbol definition (in both testsuite/dejagnu.h
+ * and sys/wait.h
+ */
+#define _SYS_WAIT_H 1
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <src/common/bitstring.h>
+#include <src/common/node_conf.h>
+#include <src/common/node_select.h>
+#include <src/common/xmalloc.h>
+#include <src/common/xstring.h>
+#include <testsuite/dejagnu.h>
+
+/*
+ * Test for failure:
+ */
+#define TEST(_tst, _msg) do {		\
+	if (! (_tst))			\
+		fail( _msg );		\
+	else				\
+		pass( _msg );		\
+} while (0)
+
+/* Smallest index of node_conf.c, it holds up to half as many keys */
+#define NODE_SLOT_MIN 64
+
+/* FNV-1a hash of a node name, as the index of node_conf.c uses */
+static uint32_t _hash(const char *key)
+{
+	uint32_t hash = 2166136261U;
+
+	for ( ; *key; key++) {
+		hash ^= (unsigned char) *key;
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+/* Node records are created without loading a select plugin */
+extern dynamic_plugin_data_t *select_g_select_nodeinfo_alloc(void)
+{
+	return NULL;
+}
+
+extern int select_g_select_nodeinfo_free(dynamic_plugin_data_t *nodeinfo)
+{
+	return SLURM_SUCCESS;
+}
+
+static config_record_t *config_ptr = NULL;
+
+static void _add_nodes(const char *fmt, int first, int last)
+{
+	char name[64];
+	int i;
+
+	for (i = first; i <= last; i++) {
+		snprintf(name, sizeof(name), fmt, i);
+		create_node_record(config_ptr, name);
+	}
+}
+
+/* Reset the node table to the nodes of the names hostlist expression */
+static void _set_nodes(char *names)
+{
+	hostlist_t hl = hostlist_create(names);
+	char *name;
+
+	init_node_conf();
+	config_ptr = create_config_record();
+	while ((name = hostlist_shift(hl))) {
+		create_node_record(config_ptr, name);
+		free(name);
+	}
+	hostlist_destroy(hl);
+}
+
+/* Test that every node record is found by name at its offset */
+static void _test_all_found(const char *msg)
+{
+	int i, bad = 0;
+
+	for (i = 0; i < node_record_count; i++) {
+		if (find_node_record_no_alias(node_record_table_ptr[i].name) !=
+		    (node_record_table_ptr + i))
+			bad++;
+	}
+	TEST(bad == 0, msg);
+}
+
+static void _test_bitmap(char *names, bool best_effort, int rc,
+			 char *expect)
+{
+	bitstr_t *bitmap = NULL;
+	char msg[256], *str;
+	hostlist_t hl;
+	int rc2;
+
+	rc2 = node_name2bitmap(names, best_effort, &bitmap);
+	str = bitmap2node_name(bitmap);
+	snprintf(msg, sizeof(msg), "node_name2bitmap(%s) %d %s, expected %d %s",
+		 names, rc2, str, rc, expect);
+	TEST((rc2 == rc) && !xstrcmp(str, expect), msg);
+	xfree(str);
+
+	/* hostlist2bitmap() must set the same bits */
+	hl = hostlist_create(names);
+	rc2 = hostlist2bitmap(hl, best_effort, &bitmap);
+	str = bitmap2node_name(bitmap);
+	snprintf(msg, sizeof(msg), "hostlist2bitmap(%s) %d %s, expected %d %s",
+		 names, rc2, str, rc, expect);
+	TEST((rc2 == rc) && !xstrcmp(str, expect), msg);
+	xfree(str);
+	hostlist_destroy(hl);
+	FREE_NULL_BITMAP(bitmap);
+}
+
+int main(int argc, char *argv[])
+{
+	char conf_file[] = "/tmp/node_conf-test.conf.XXXXXX";
+	char *conf_str, name[64], *collide[8];
+	node_record_t *node_ptr;
+	uint32_t slot;
+	int collide_cnt = 0, fd, i;
+
+	/* NodeHostName lookups not in the index fall back to slurm.conf */
+	if ((fd = mkstemp(conf_file)) < 0) {
+		fail("mkstemp");
+		return 1;
+	}
+	conf_str = xstrdup("ClusterName=unit\n"
+			   "SlurmctldHost=localhost\n");
+	if (write(fd, conf_str, strlen(conf_str)) != strlen(conf_str))
+		fail("write config");
+	close(fd);
+	xfree(conf_str);
+	setenv("SLURM_CONF", conf_file, 1);
+
+	note("Testing node index collisions");
+	/* Names hashing to the same slot of the smallest index */
+	slot = _hash("tux0") & (NODE_SLOT_MIN - 1);
+	for (i = 1; collide_cnt < 8; i++) {
+		snprintf(name, sizeof(name), "tux%d", i);
+		if ((_hash(name) & (NODE_SLOT_MIN - 1)) == slot)
+			collide[collide_cnt++] = xstrdup(name);
+	}
+	init_node_conf();
+	config_ptr = create_config_record();
+	create_node_record(config_ptr, "tux0");
+	for (i = 0; i < 4; i++)
+		create_node_record(config_ptr, collide[i]);
+	_add_nodes("lx%d", 0, 9);
+	_test_all_found("colliding names found");
+	for (i = 4; i < 8; i++) {
+		snprintf(name, sizeof(name), "%s not found", collide[i]);
+		TEST(!find_node_record_no_alias(collide[i]), name);
+	}
+	/* Fill the smallest index up to the point it would grow */
+	for (i = 4; i < 8; i++)
+		create_node_record(config_ptr, collide[i]);
+	_add_nodes("lx%d", 10, 22);
+	TEST(node_record_count == (NODE_SLOT_MIN / 2), "smallest index filled");
+	_test_all_found("filled index found");
+	TEST(!find_node_record_no_alias("lx23"), "lx23 not found");
+	for (i = 0; i < 8; i++)
+		xfree(collide[i]);
+
+	note("Testing node index rehash after add and remove");
+	_add_nodes("nid%05d", 0, 4999);
+	_test_all_found("nodes found after the index grew");
+	TEST(find_node_record_no_alias("nid04999") ==
+	     (node_record_table_ptr + node_record_count - 1), "last node found");
+	TEST(!find_node_record_no_alias("nid05000"), "nid05000 not found");
+	TEST(!find_node_record_no_alias("nid4999"), "nid4999 not found");
+
+	/* Drop the last 2500 nodes, their slots are left in the index */
+	for (i = node_record_count - 2500; i < node_record_count; i++)
+		purge_node_rec(node_record_table_ptr + i);
+	memset(node_record_table_ptr + node_record_count - 2500, 0,
+	       sizeof(node_record_t) * 2500);
+	node_record_count -= 2500;
+	TEST(!find_node_record_no_alias("nid04999"), "dropped node not found");
+	TEST(!find_node_record_no_alias("nid02500"),
+	     "first dropped node not found");
+	_test_all_found("remaining nodes found");
+	rehash_node();
+	_test_all_found("remaining nodes found after rehash");
+	TEST(!find_node_record_no_alias("nid04999"),
+	     "dropped node not found after rehash");
+
+	note("Testing node index stale slot reuse");
+	_set_nodes("nid[00000-00999]");
+	for (i = node_record_count - 100; i < node_record_count; i++)
+		purge_node_rec(node_record_table_ptr + i);
+	memset(node_record_table_ptr + node_record_count - 100, 0,
+	       sizeof(node_record_t) * 100);
+	node_record_count -= 100;
+	/* The offsets of nid[00900-00949] are reused by other names */
+	_add_nodes("new%d", 0, 49);
+	_add_nodes("nid%05d", 950, 999);
+	_test_all_found("nodes reusing stale slots found");
+	TEST(!find_node_record_no_alias("nid00900"),
+	     "node replaced at its offset not found");
+	node_ptr = find_node_record_no_alias("nid00950");
+	TEST(node_ptr && ((node_ptr - node_record_table_ptr) == 950),
+	     "node added again at its offset found");
+
+	/* Renamed records are found by their new name once rehashed */
+	xfree(node_record_table_ptr[10].name);
+	node_record_table_ptr[10].name = xstrdup("renamed");
+	TEST(!find_node_record_no_alias("nid00010"), "old name not found");
+	rehash_node();
+	TEST(find_node_record_no_alias("renamed") ==
+	     (node_record_table_ptr + 10), "new name found after rehash");
+	_test_all_found("nodes found after rename");
+
+	note("Testing NodeHostName index");
+	_set_nodes("n[0-9]");
+	for (i = 0; i < node_record_count; i++) {
+		snprintf(name, sizeof(name), "host%d", i);
+		node_record_table_ptr[i].node_hostname = xstrdup(name);
+	}
+	/* n8 and n9 share a NodeHostName */
+	xfree(node_record_table_ptr[9].node_hostname);
+	node_record_table_ptr[9].node_hostname = xstrdup("host8");
+	rehash_node();
+	TEST(find_node_record2("host3") == (node_record_table_ptr + 3),
+	     "found by NodeHostName");
+	TEST(!find_node_record_no_alias("host3"),
+	     "not found by NodeHostName without alias");
+	TEST(!find_node_record2("host8"), "shared NodeHostName not resolved");
+	TEST(find_node_record2("n8") == (node_record_table_ptr + 8),
+	     "node with shared NodeHostName found by name");
+	/* A NodeHostName equal to a node name resolves to that node */
+	xfree(node_record_table_ptr[1].node_hostname);
+	node_record_table_ptr[1].node_hostname = xstrdup("n2");
+	rehash_node();
+	TEST(find_node_record2("n2") == (node_record_table_ptr + 2),
+	     "node name before NodeHostName");
+
+	note("Testing node_name2bitmap ranges");
+	_set_nodes("tux[0-9,20-29],lx[08-12],b3,b1,b2,c9,c10,solo");
+	_test_bitmap("tux[0-9,20-29]", false, SLURM_SUCCESS,
+		     "tux[0-9,20-29]");
+	_test_bitmap("tux[5-22]", false, EINVAL, "tux[5-9,20-22]");
+	_test_bitmap("tux[5-22]", true, SLURM_SUCCESS, "tux[5-9,20-22]");
+	_test_bitmap("tux[25-29,0-3]", false, SLURM_SUCCESS,
+		     "tux[0-3,25-29]");
+	_test_bitmap("lx[08-12]", false, SLURM_SUCCESS, "lx[08-12]");
+	_test_bitmap("lx[8-12]", true, SLURM_SUCCESS, "lx[10-12]");
+	_test_bitmap("lx[008-012]", true, SLURM_SUCCESS, "");
+	_test_bitmap("b[1-3]", false, SLURM_SUCCESS, "b[1-3]");
+	_test_bitmap("c[09-10]", true, SLURM_SUCCESS, "c10");
+	_test_bitmap("c[9-10]", false, SLURM_SUCCESS, "c[9-10]");
+	_test_bitmap("solo,tux0", false, SLURM_SUCCESS, "solo,tux0");
+	_test_bitmap("tux[8-9],tux[9-10]", false, EINVAL, "tux[8-9]");
+
+	node_fini2();
+	unlink(conf_file);
+
+	totals();
+	return failed;
+}
@@ -0,0 +1,139 @@
+/*****************************************************************************\
+ *  pack-bench.c - pack and unpack throughput of job-like records
+ *****************************************************************************
+ *  Packs records shaped like a small job record into a buffer starting
+ *  empty, counting the times the buffer grows, then unpacks and checks them.
+ *  A second pass reserves the space of the first with reserve_buf(), as
+ *  pack_all_jobs() does.
+ *
+ *  Usage: pack-bench [records]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "src/common/pack.h"
+#include "src/common/xmalloc.h"
+
+static struct timeval tv;
+
+static void _start(void)
+{
+	gettimeofday(&tv, NULL);
+}
+
+static double _stop(void)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv.tv_sec) + (tv2.tv_usec - tv.tv_usec) / 1e6;
+}
+
+/* Pack the records, return the count of times the buffer grew */
+static int _pack(Buf buffer, uint32_t records)
+{
+	char name[] = "benchmark_job_name";
+	uint32_t i, size = size_buf(buffer);
+	int grown = 0;
+
+	for (i = 0; i < records; i++) {
+		pack32(i, buffer);
+		pack64((uint64_t) i << 32, buffer);
+		packstr(name, buffer);
+		pack16(1, buffer);
+		if (size_buf(buffer) != size) {
+			size = size_buf(buffer);
+			grown++;
+		}
+	}
+	return grown;
+}
+
+/* Unpack the records, return the count of bad ones */
+static uint32_t _unpack(Buf buffer, uint32_t records)
+{
+	char *outstr;
+	uint32_t i, out32, len, bad = 0;
+	uint64_t out64;
+	uint16_t out16;
+
+	set_buf_offset(buffer, 0);
+	for (i = 0; i < records; i++) {
+		if (unpack32(&out32, buffer) ||
+		    unpack64(&out64, buffer) ||
+		    unpackstr_xmalloc(&outstr, &len, buffer) ||
+		    unpack16(&out16, buffer)) {
+			bad += records - i;
+			break;
+		}
+		bad += ((out32 != i) || (out64 != ((uint64_t) i << 32)) ||
+			(out16 != 1));
+		xfree(outstr);
+	}
+	return bad;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t records = 1024 * 1024, len;
+	double secs;
+	int grown;
+	Buf buffer;
+
+	if (argc > 1)
+		records = strtoul(argv[1], NULL, 10);
+	if (records < 1) {
+		fprintf(stderr, "Usage: %s [records]\n", argv[0]);
+		exit(1);
+	}
+
+	buffer = init_buf(0);
+	_start();
+	grown = _pack(buffer, records);
+	secs = _stop();
+	len = get_buf_offset(buffer);
+	printf("pack:         %u records %u bytes in %.3f s, %.1f MB/s, buffer grew %d times\n",
+	       records, len, secs, len / secs / (1024 * 1024), grown);
+
+	_start();
+	if (_unpack(buffer, records)) {
+		fprintf(stderr, "unpacked records differ from packed ones\n");
+		exit(1);
+	}
+	secs = _stop();
+	printf("unpack:       %u records %u bytes in %.3f s, %.1f MB/s\n",
+	       records, len, secs, len / secs / (1024 * 1024));
+	free_buf(buffer);
+
+	buffer = init_buf(0);
+	_start();
+	reserve_buf(buffer, len);
+	grown = _pack(buffer, records);
+	secs = _stop();
+	printf("reserve+pack: %u records %u bytes in %.3f s, %.1f MB/s, buffer grew %d times\n",
+	       records, len, secs, len / secs / (1024 * 1024), grown);
+	free_buf(buffer);
+
+	return 0;
+}
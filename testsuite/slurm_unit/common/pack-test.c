@@ -17,6 +17,46 @@
 		pass( _msg );       \
 } while (0)
 
+/* Pack enough records to grow an empty buffer many times over */
+static void _test_growth(void)
+{
+	char name[] = "growth_test_name", *outstr;
+	uint32_t i, out32, len, bad = 0;
+	uint64_t out64;
+	uint16_t out16;
+	Buf buffer;
+
+	buffer = init_buf(0);
+	for (i = 0; i < 64 * 1024; i++) {
+		pack32(i, buffer);
+		pack64((uint64_t) i << 32, buffer);
+		packstr(name, buffer);
+		pack16(1, buffer);
+	}
+	TEST(size_buf(buffer) > (2 * get_buf_offset(buffer) + BUF_SIZE),
+	     "geometric buffer growth");
+
+	len = get_buf_offset(buffer);
+	set_buf_offset(buffer, 0);
+	for (i = 0; i < 64 * 1024; i++) {
+		unpack32(&out32, buffer);
+		bad += (out32 != i);
+		unpack64(&out64, buffer);
+		bad += (out64 != ((uint64_t) i << 32));
+		unpackstr_xmalloc(&outstr, &out32, buffer);
+		xfree(outstr);
+		unpack16(&out16, buffer);
+		bad += (out16 != 1);
+	}
+	TEST(bad || (get_buf_offset(buffer) != len), "grown buffer round trip");
+	free_buf(buffer);
+
+	buffer = init_buf(BUF_SIZE);
+	grow_buf(buffer, 1);
+	TEST(size_buf(buffer) < (2 * BUF_SIZE), "grow_buf grows geometrically");
+	free_buf(buffer);
+}
+
 int main (int argc, char *argv[])
 {
 	Buf buffer;
@@ -83,6 +123,20 @@ int main (int argc, char *argv[])
 	xfree(outstring);
 
 	free_buf(buffer);
+
+	buffer = init_buf(0);
+	reserve_buf(buffer, 4 * BUF_SIZE);
+	TEST(remaining_buf(buffer) < (4 * BUF_SIZE), "reserve_buf");
+	pack32(test32, buffer);
+	free_buf_pooled(buffer);
+	data = (char *) buffer;
+	buffer = init_buf_pooled(0);
+	TEST(((char *) buffer != data) || get_buf_offset(buffer),
+	     "init_buf_pooled reuses a released buffer");
+	free_buf(buffer);
+
+	_test_growth();
+
 	totals();
 	return failed;
 
@@ -0,0 +1,142 @@
+/*****************************************************************************\
+ *  ring_queue-bench.c - producer/consumer contention, ring_queue vs List
+ *****************************************************************************
+ *  Half of the threads enqueue items and the other half dequeue them, through
+ *  a List with list_enqueue()/list_dequeue(), through a ring_queue with the
+ *  non-blocking calls and through a ring_queue with the blocking calls.
+ *  Consumers of the non-blocking queues yield when they find them empty.
+ *
+ *  Usage: ring_queue-bench [items [max_threads]]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "src/common/list.h"
+#include "src/common/ring_queue.h"
+
+#define QUEUE_SIZE 1024
+
+enum {
+	MODE_LIST,
+	MODE_RING,
+	MODE_RING_WAIT,
+};
+
+static int mode;
+static long per_thread;
+static List list;
+static ring_queue_t *ring;
+
+static void *_producer(void *arg)
+{
+	uintptr_t i;
+
+	for (i = 1; i <= per_thread; i++) {
+		if (mode == MODE_LIST) {
+			list_enqueue(list, (void *) i);
+		} else if (mode == MODE_RING) {
+			while (!ring_queue_try_enqueue(ring, (void *) i))
+				sched_yield();
+		} else {
+			ring_queue_enqueue(ring, (void *) i);
+		}
+	}
+	return NULL;
+}
+
+static void *_consumer(void *arg)
+{
+	long i;
+	void *x;
+
+	for (i = 0; i < per_thread; i++) {
+		if (mode == MODE_LIST) {
+			while (!(x = list_dequeue(list)))
+				sched_yield();
+		} else if (mode == MODE_RING) {
+			while (!(x = ring_queue_try_dequeue(ring)))
+				sched_yield();
+		} else {
+			x = ring_queue_dequeue(ring, -1);
+		}
+	}
+	return NULL;
+}
+
+static double _run(int m, int threads)
+{
+	pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+	struct timeval tv1, tv2;
+	int i;
+
+	mode = m;
+	gettimeofday(&tv1, NULL);
+	for (i = 0; i < threads; i++)
+		pthread_create(&tids[i], NULL, (i % 2) ? _consumer : _producer,
+			       NULL);
+	for (i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+	gettimeofday(&tv2, NULL);
+	free(tids);
+
+	return (per_thread * (threads / 2)) /
+	       ((tv2.tv_sec - tv1.tv_sec) * 1e6 + (tv2.tv_usec - tv1.tv_usec));
+}
+
+int main(int argc, char **argv)
+{
+	long items = 4 * 1024 * 1024;
+	int max_threads = 64, threads;
+
+	if (argc > 1)
+		items = atol(argv[1]);
+	if (argc > 2)
+		max_threads = atoi(argv[2]);
+	if ((items < 1) || (max_threads < 2)) {
+		fprintf(stderr, "Usage: %s [items [max_threads]]\n", argv[0]);
+		exit(1);
+	}
+
+	list = list_create(NULL);
+	ring = ring_queue_create(QUEUE_SIZE, NULL);
+
+	printf("%-8s %16s %16s %16s\n", "threads", "List Mops/s",
+	       "ring Mops/s", "ring wait Mops/s");
+	for (threads = 2; threads <= max_threads; threads *= 2) {
+		double l, r, w;
+
+		per_thread = items / (threads / 2);
+		l = _run(MODE_LIST, threads);
+		r = _run(MODE_RING, threads);
+		w = _run(MODE_RING_WAIT, threads);
+		printf("%-8d %16.2f %16.2f %16.2f\n", threads, l, r, w);
+	}
+
+	list_destroy(list);
+	ring_queue_destroy(ring);
+
+	return 0;
+}
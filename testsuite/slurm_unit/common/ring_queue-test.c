@@ -0,0 +1,115 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <src/common/ring_queue.h>
+#include <src/common/xmalloc.h>
+
+#include <testsuite/dejagnu.h>
+
+/* Test for failure:
+*/
+#define TEST(_tst, _msg) do {			\
+	if (_tst)				\
+		fail( _msg );       \
+	else					\
+		pass( _msg );       \
+} while (0)
+
+#define THREADS		4
+#define ITEMS		(256 * 1024)
+
+static ring_queue_t *queue;
+static uint64_t sums[THREADS];
+static int freed;
+
+static void _free_item(void *x)
+{
+	freed++;
+}
+
+static void *_producer(void *arg)
+{
+	uintptr_t i, base = (uintptr_t) arg * ITEMS;
+
+	for (i = 1; i <= ITEMS; i++)
+		ring_queue_enqueue(queue, (void *) (base + i));
+	return NULL;
+}
+
+static void *_consumer(void *arg)
+{
+	uint64_t *sum = arg;
+	void *x;
+
+	while ((x = ring_queue_dequeue(queue, -1)))
+		*sum += (uintptr_t) x;
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t prod[THREADS], cons[THREADS];
+	uint64_t expect = 0, total = 0;
+	struct timeval tv1, tv2;
+	uintptr_t i;
+	int in_order = 1;
+
+	/* Single thread FIFO behavior */
+	queue = ring_queue_create(5, _free_item);
+	TEST(ring_queue_try_dequeue(queue) != NULL, "dequeue of empty queue");
+	for (i = 1; ring_queue_try_enqueue(queue, (void *) i); i++)
+		;
+	TEST(i != 9, "size rounded up to a power of two");
+	TEST(ring_queue_count(queue) != 8, "ring_queue_count of full queue");
+	for (i = 1; i <= 4; i++) {
+		if (ring_queue_try_dequeue(queue) != (void *) i)
+			in_order = 0;
+	}
+	for (i = 9; i <= 12; i++)
+		ring_queue_try_enqueue(queue, (void *) i);
+	for (i = 5; i <= 10; i++) {
+		if (ring_queue_try_dequeue(queue) != (void *) i)
+			in_order = 0;
+	}
+	TEST(!in_order, "items dequeued in order across laps");
+	ring_queue_destroy(queue);
+	TEST(freed != 2, "ring_queue_destroy frees the items left");
+
+	/* Timed wait on an empty queue */
+	queue = ring_queue_create(16, NULL);
+	gettimeofday(&tv1, NULL);
+	TEST(ring_queue_dequeue(queue, 50) != NULL,
+	     "ring_queue_dequeue times out on empty queue");
+	gettimeofday(&tv2, NULL);
+	TEST((tv2.tv_sec - tv1.tv_sec) * 1000000 +
+	     (tv2.tv_usec - tv1.tv_usec) < 50000,
+	     "ring_queue_dequeue waits for the timeout");
+	ring_queue_destroy(queue);
+
+	/* Concurrent producers and consumers through a small queue */
+	queue = ring_queue_create(64, NULL);
+	for (i = 0; i < THREADS; i++) {
+		pthread_create(&cons[i], NULL, _consumer, &sums[i]);
+		pthread_create(&prod[i], NULL, _producer, (void *) i);
+	}
+	for (i = 0; i < THREADS; i++)
+		pthread_join(prod[i], NULL);
+	ring_queue_shutdown(queue);
+	for (i = 0; i < THREADS; i++) {
+		pthread_join(cons[i], NULL);
+		total += sums[i];
+	}
+	for (i = 1; i <= (uintptr_t) THREADS * ITEMS; i++)
+		expect += i;
+	TEST(total != expect, "every item dequeued exactly once");
+	TEST(ring_queue_count(queue) != 0, "queue drained after shutdown");
+	TEST(ring_queue_dequeue(queue, -1) != NULL,
+	     "ring_queue_dequeue does not wait after shutdown");
+	ring_queue_destroy(queue);
+
+	totals();
+	return failed;
+}
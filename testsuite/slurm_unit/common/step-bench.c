@@ -0,0 +1,269 @@
+/*****************************************************************************\
+ *  step-bench.c - cost of placing single core steps in a large allocation
+ *****************************************************************************
+ *  Every core of the allocation runs a step. Each iteration ends a random
+ *  step and places a new one needing one core, as for a stream of "srun -n1
+ *  --exclusive" in a batch script. Placement is modeled the former way, by
+ *  walking the job's nodes from the first and looking up core offsets for
+ *  each core tried, and with the job's step placement index. Both ways must
+ *  place the steps on the same cores.
+ *
+ *  Usage: step-bench [steps [max_nodes [cores_per_node]]]
+ *****************************************************************************
+ *  This file is part of Slurm, a resource management program.
+ *  For details, see <https://slurm.schedmd.com/>.
+ *  Please also read the included file: DISCLAIMER.
+ *
+ *  Slurm is free software; you can redistribute it and/or modify it under
+ *  the terms of the GNU General Public License as published by the Free
+ *  Software Foundation; either version 2 of the License, or (at your option)
+ *  any later version.
+ *
+ *  Slurm is distributed in the hope that it will be useful, but WITHOUT ANY
+ *  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ *  FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ *  details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with Slurm; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA.
+\*****************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "src/common/bitstring.h"
+#include "src/common/job_resources.h"
+#include "src/common/xmalloc.h"
+
+#define SOCKETS 2
+
+typedef struct {
+	int node_inx;
+	int core;
+} step_t;
+
+static struct timeval tv;
+
+static void _start(void)
+{
+	gettimeofday(&tv, NULL);
+}
+
+static double _stop(void)
+{
+	struct timeval tv2;
+
+	gettimeofday(&tv2, NULL);
+	return (tv2.tv_sec - tv.tv_sec) + (tv2.tv_usec - tv.tv_usec) / 1e6;
+}
+
+/* Allocation of node_cnt nodes, the nodes' rep counts split in runs of 16 */
+static job_resources_t *_alloc_job(int node_cnt, int cores)
+{
+	job_resources_t *job = xmalloc(sizeof(job_resources_t));
+	int i, reps = (node_cnt + 15) / 16;
+
+	job->nhosts = node_cnt;
+	job->node_bitmap = bit_alloc(node_cnt);
+	bit_nset(job->node_bitmap, 0, node_cnt - 1);
+	job->core_bitmap = bit_alloc(node_cnt * cores);
+	bit_nset(job->core_bitmap, 0, node_cnt * cores - 1);
+	job->core_bitmap_used = bit_alloc(node_cnt * cores);
+	job->cpus = xcalloc(node_cnt, sizeof(uint16_t));
+	job->cpus_used = xcalloc(node_cnt, sizeof(uint16_t));
+	for (i = 0; i < node_cnt; i++)
+		job->cpus[i] = cores;
+	job->cores_per_socket = xcalloc(reps, sizeof(uint16_t));
+	job->sockets_per_node = xcalloc(reps, sizeof(uint16_t));
+	job->sock_core_rep_count = xcalloc(reps, sizeof(uint32_t));
+	for (i = 0; i < reps; i++) {
+		job->cores_per_socket[i] = cores / SOCKETS;
+		job->sockets_per_node[i] = SOCKETS;
+		job->sock_core_rep_count[i] = MIN(16, node_cnt - i * 16);
+	}
+
+	return job;
+}
+
+/* Walk the job's nodes up to node_inx, as step_alloc_lps() did */
+static int _old_walk(job_resources_t *job, int node_inx)
+{
+	int i, i_first, i_last, job_node_inx = -1;
+
+	i_first = bit_ffs(job->node_bitmap);
+	i_last = bit_fls(job->node_bitmap);
+	for (i = i_first; i <= i_last; i++) {
+		if (!bit_test(job->node_bitmap, i))
+			continue;
+		if (++job_node_inx == node_inx)
+			break;
+	}
+	return job_node_inx;
+}
+
+static void _old_place(job_resources_t *job, step_t *step)
+{
+	int i, i_first, i_last, node_inx = -1, offset, s, c;
+	uint16_t sockets, cores;
+
+	/* Exclusive mode scan of _pick_step_nodes() */
+	i_first = bit_ffs(job->node_bitmap);
+	i_last = bit_fls(job->node_bitmap);
+	for (i = i_first; i <= i_last; i++) {
+		if (!bit_test(job->node_bitmap, i))
+			continue;
+		node_inx++;
+		if (job->cpus[node_inx] > job->cpus_used[node_inx])
+			break;
+	}
+
+	node_inx = _old_walk(job, node_inx);
+	job->cpus_used[node_inx]++;
+	get_job_resources_cnt(job, node_inx, &sockets, &cores);
+	for (s = 0; s < sockets; s++) {
+		for (c = 0; c < cores; c++) {
+			offset = get_job_resources_offset(job, node_inx, s, c);
+			if (bit_test(job->core_bitmap_used, offset))
+				continue;
+			bit_set(job->core_bitmap_used, offset);
+			step->node_inx = node_inx;
+			step->core = offset;
+			return;
+		}
+	}
+}
+
+static void _old_end(job_resources_t *job, step_t *step)
+{
+	int node_inx = _old_walk(job, step->node_inx);
+
+	job->cpus_used[node_inx]--;
+	bit_clear(job->core_bitmap_used, step->core);
+}
+
+static void _new_place(job_resources_t *job, step_t *step)
+{
+	job_resources_index_t *index = get_job_resources_index(job);
+	int node_inx, offset, s, c;
+
+	node_inx = bit_ffs(index->node_free);
+	job->cpus_used[node_inx]++;
+	update_job_resources_index(job, node_inx);
+	for (s = 0; s < index->sockets[node_inx]; s++) {
+		for (c = 0; c < index->cores[node_inx]; c++) {
+			offset = index->core_offset[node_inx] +
+				 s * index->cores[node_inx] + c;
+			if (bit_test(job->core_bitmap_used, offset))
+				continue;
+			bit_set(job->core_bitmap_used, offset);
+			step->node_inx = node_inx;
+			step->core = offset;
+			return;
+		}
+	}
+}
+
+static void _new_end(job_resources_t *job, step_t *step)
+{
+	job->cpus_used[step->node_inx]--;
+	update_job_resources_index(job, step->node_inx);
+	bit_clear(job->core_bitmap_used, step->core);
+}
+
+/* Run a step on every core of the job */
+static void _fill(job_resources_t *job, step_t *steps, int cores)
+{
+	int j;
+
+	for (j = 0; j < job->nhosts; j++)
+		job->cpus_used[j] = cores;
+	bit_nset(job->core_bitmap_used, 0, job->nhosts * cores - 1);
+	for (j = 0; j < job->nhosts * cores; j++) {
+		steps[j].node_inx = j / cores;
+		steps[j].core = j;
+	}
+}
+
+/* End and place steps, RET sum of the cores picked */
+static uint64_t _run(job_resources_t *job, step_t *steps, int step_cnt,
+		     long iterations, bool use_index)
+{
+	uint64_t sum = 0;
+	unsigned int seed = 1;
+	long i;
+	int j;
+
+	for (i = 0; i < iterations; i++) {
+		j = rand_r(&seed) % step_cnt;
+		if (use_index) {
+			_new_end(job, &steps[j]);
+			_new_place(job, &steps[j]);
+		} else {
+			_old_end(job, &steps[j]);
+			_old_place(job, &steps[j]);
+		}
+		sum += steps[j].core;
+	}
+	return sum;
+}
+
+int main(int argc, char **argv)
+{
+	long iterations = 200000;
+	int max_nodes = 8192, cores = 64, nodes;
+
+	if (argc > 1)
+		iterations = atol(argv[1]);
+	if (argc > 2)
+		max_nodes = atoi(argv[2]);
+	if (argc > 3)
+		cores = atoi(argv[3]);
+	if ((iterations < 1) || (max_nodes < 1) || (cores < SOCKETS) ||
+	    (cores % SOCKETS)) {
+		fprintf(stderr, "Usage: %s [steps [max_nodes "
+			"[cores_per_node]]]\n", argv[0]);
+		exit(1);
+	}
+
+	printf("%ld steps, %d cores per node\n", iterations, cores);
+	printf("%-7s %14s %14s\n", "nodes", "scan steps/s", "index steps/s");
+
+	for (nodes = 16; nodes <= max_nodes; nodes *= 2) {
+		job_resources_t *old_job = _alloc_job(nodes, cores);
+		job_resources_t *new_job = _alloc_job(nodes, cores);
+		step_t *steps = xcalloc(nodes * cores, sizeof(step_t));
+		double old_sec, new_sec;
+		uint64_t old_sum, new_sum;
+
+		_fill(old_job, steps, cores);
+		_start();
+		old_sum = _run(old_job, steps, nodes * cores, iterations,
+			       false);
+		old_sec = _stop();
+
+		_fill(new_job, steps, cores);
+		_start();
+		new_sum = _run(new_job, steps, nodes * cores, iterations,
+			       true);
+		new_sec = _stop();
+
+		if ((old_sum != new_sum) ||
+		    !bit_equal(old_job->core_bitmap_used,
+			       new_job->core_bitmap_used)) {
+			fprintf(stderr, "steps placed differently\n");
+			exit(1);
+		}
+
+		printf("%-7d %14.0f %14.0f\n", nodes, iterations / old_sec,
+		       iterations / new_sec);
+
+		free_job_resources(&old_job);
+		free_job_resources(&new_job);
+		xfree(steps);
+	}
+
+	return 0;
+}